@@ -0,0 +1,136 @@
+#ifndef BURST_STRUCTURE_H
+#define BURST_STRUCTURE_H
+#include <stdint.h>
+
+/**
+ * \brief counters for pulses grouped into bursts, and bursts grouped into
+ *  trains.
+ * \details Only the off time after the last pulse of a burst (or train)
+ *  changes. It is replaced with the inter-burst (or inter-train) gap.
+ */
+class BurstStructure
+{
+public:
+/**
+ * \param pulses_per_burst 0 disables the structure.
+ * \param burst_gap_us off time between the last and first pulse of
+ *  consecutive bursts.
+ * \param train_gap_us off time between the last and first pulse of
+ *  consecutive trains.
+ * \param trains 0 = repeat trains forever.
+ */
+    inline void configure(uint32_t pulses_per_burst, uint32_t burst_gap_us,
+                          uint32_t bursts_per_train, uint32_t train_gap_us,
+                          uint32_t trains)
+    {
+        pulses_per_burst_ = pulses_per_burst;
+        burst_gap_us_ = burst_gap_us;
+        bursts_per_train_ = (bursts_per_train == 0)? 1: bursts_per_train;
+        train_gap_us_ = train_gap_us;
+        trains_ = trains;
+        restart();
+    }
+
+    inline void restart()
+    {pulse_ = burst_ = train_ = 0;}
+
+/**
+ * \brief the counters, i.e: the part of a BurstStructure that changes as it
+ *  runs.
+ */
+    struct checkpoint_t
+    {
+        uint32_t pulse;
+        uint32_t burst;
+        uint32_t train;
+    };
+
+    inline checkpoint_t checkpoint() const
+    {return {pulse_, burst_, train_};}
+
+    inline void restore(const checkpoint_t& checkpoint)
+    {
+        pulse_ = checkpoint.pulse;
+        burst_ = checkpoint.burst;
+        train_ = checkpoint.train;
+    }
+
+    inline bool enabled() const
+    {return pulses_per_burst_ != 0;}
+
+/**
+ * \brief true once the last pulse of the last train has ended.
+ */
+    inline bool finished() const
+    {return (trains_ > 0) && (train_ == trains_);}
+
+/**
+ * \brief count the end of a pulse and return the off time that follows it.
+ * \details the last pulse of the last train is followed by the ordinary off
+ *  time, like the last cycle of a counted PwmSettings output, rather than an
+ *  inter-train gap that no train follows.
+ * \param off_time_us off time to use within a burst.
+ */
+    inline uint32_t end_pulse(uint32_t off_time_us)
+    {
+        if (++pulse_ < pulses_per_burst_)
+            return off_time_us;
+        pulse_ = 0;
+        if (++burst_ < bursts_per_train_)
+            return burst_gap_us_;
+        burst_ = 0;
+        ++train_;
+        return finished()? off_time_us: train_gap_us_;
+    }
+
+/**
+ * \brief total pulses, or 0 if the trains repeat forever.
+ */
+    inline uint32_t total_pulses() const
+    {
+        uint64_t pulses = uint64_t(pulses_per_burst_) * bursts_per_train_
+                          * trains_;
+        return (pulses > UINT32_MAX)? UINT32_MAX: uint32_t(pulses);
+    }
+
+/**
+ * \brief true if bursts are separated by burst_gap_us, i.e: a train holds
+ *  more than one burst.
+ */
+    static inline bool needs_burst_gap(uint32_t bursts_per_train)
+    {return bursts_per_train > 1;}
+
+/**
+ * \brief true if trains are separated by train_gap_us. A single train never
+ *  reaches its trailing gap.
+ */
+    static inline bool needs_train_gap(uint32_t trains)
+    {return trains != 1;}
+
+/**
+ * \brief shortest gap this structure inserts.
+ */
+    inline uint32_t min_gap_us() const
+    {
+        bool has_train_gap = needs_train_gap(trains_);
+        bool has_burst_gap = needs_burst_gap(bursts_per_train_);
+        uint32_t gap_us = UINT32_MAX;
+        if (has_burst_gap)
+            gap_us = burst_gap_us_;
+        if (has_train_gap && (train_gap_us_ < gap_us))
+            gap_us = train_gap_us_;
+        return gap_us;
+    }
+
+private:
+    uint32_t pulses_per_burst_ = 0;
+    uint32_t burst_gap_us_ = 0;
+    uint32_t bursts_per_train_ = 1;
+    uint32_t train_gap_us_ = 0;
+    uint32_t trains_ = 0;
+
+    uint32_t pulse_ = 0; /// pulses finished in the current burst.
+    uint32_t burst_ = 0; /// bursts finished in the current train.
+    uint32_t train_ = 0; /// trains finished.
+};
+#endif // BURST_STRUCTURE_H
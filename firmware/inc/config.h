@@ -1,11 +1,40 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-inline constexpr size_t NUM_GPIOS = 8;
-inline constexpr size_t PORT_BASE = 8;
-inline constexpr size_t PORT_DIR_BASE = 16;
-inline constexpr size_t PORT_MASK = 0x000000FF << PORT_BASE;
-inline constexpr size_t PORT_DIR_MASK = 0x000000FF << PORT_DIR_BASE;
+// Board variant. Defaults describe the Cuttlefish: 8 channels on GPIO 8-15
+// with their direction buffer control pins on GPIO 16-23. Larger RP2040
+// breakouts override these from CMake.
+#ifndef CUTTLEFISH_NUM_CHANNELS
+#define CUTTLEFISH_NUM_CHANNELS (8)
+#endif
+#ifndef CUTTLEFISH_PORT_BASE
+#define CUTTLEFISH_PORT_BASE (8)
+#endif
+#ifndef CUTTLEFISH_HAS_DIR_BUFFER
+#define CUTTLEFISH_HAS_DIR_BUFFER (1)
+#endif
+#ifndef CUTTLEFISH_PORT_DIR_BASE
+#define CUTTLEFISH_PORT_DIR_BASE (16)
+#endif
+
+inline constexpr size_t NUM_GPIOS = CUTTLEFISH_NUM_CHANNELS;
+inline constexpr size_t PORT_BASE = CUTTLEFISH_PORT_BASE;
+inline constexpr size_t PORT_DIR_BASE = CUTTLEFISH_PORT_DIR_BASE;
+inline constexpr size_t PORT_MASK = ((1u << NUM_GPIOS) - 1) << PORT_BASE;
+inline constexpr size_t PORT_DIR_MASK = CUTTLEFISH_HAS_DIR_BUFFER?
+    ((1u << NUM_GPIOS) - 1) << PORT_DIR_BASE : 0;
+static_assert((PORT_MASK & PORT_DIR_MASK) == 0,
+              "Port pins overlap with direction buffer control pins.");
+
+// Extra PWMTasks that can be overlaid on the output channels, shared by all
+// channels. Each costs a PWMTask in the scheduler and in every schedule slot.
+inline constexpr size_t PWM_OVERLAY_TASKS = 4;
+inline constexpr size_t MAX_PWM_TASKS = NUM_GPIOS + PWM_OVERLAY_TASKS;
+
+// Depth of the queue of precomputed port states that the alarm ISR consumes.
+inline constexpr size_t PORT_EVENT_QUEUE_DEPTH = NUM_GPIOS;
+// Depth of the queue of captured input edges that core0 dispatches.
+inline constexpr size_t EDGE_EVENT_QUEUE_DEPTH = 32;
 
 #define DEBUG_UART (uart0)
 #define SYNC_UART (uart1)
@@ -29,6 +58,94 @@ inline constexpr size_t UNUSED_SERIAL_NUMBER = 0; // Deprecated in favor of R_UU
 
 inline constexpr size_t INTERCORE_COM_TIMEOUT_US = 1000;
 
+// Schedule admission control limits.
+// Starting cost for computing one PortEvent. Raised at runtime to the worst
+// cost measured by the scheduler.
+inline constexpr uint32_t DEFAULT_EDGE_COST_US = 10;
+// Minimum spacing between distinct alarms so the alarm ISR can re-arm itself.
+inline constexpr uint32_t MIN_EDGE_SPACING_US = 5;
+// Bound the analysis. A start request may wait for it, so it also stops after
+// FEASIBILITY_MAX_TIME_US of CPU time to leave core1 time to answer within
+// INTERCORE_COM_TIMEOUT_US on any clock.
+inline constexpr size_t FEASIBILITY_MAX_EDGES = 1024;
+inline constexpr uint32_t FEASIBILITY_MAX_SPAN_US = 60'000'000;
+inline constexpr uint32_t FEASIBILITY_MAX_TIME_US = INTERCORE_COM_TIMEOUT_US / 2;
+
+// Output edge event log. Port writes recorded by the alarm ISR are sent to the
+// PC in batches of up to OUTPUT_EVENT_BATCH_SIZE records, at least every
+// OUTPUT_EVENT_FLUSH_US.
+inline constexpr size_t OUTPUT_EVENT_LOG_DEPTH = 512; // must be a power of 2.
+inline constexpr size_t OUTPUT_EVENT_BATCH_SIZE = 16;
+inline constexpr uint32_t OUTPUT_EVENT_FLUSH_US = 1000;
+
+// Host-streamed waveform. Records are written to the device in blocks of up
+// to STREAM_BLOCK_RECORDS and buffered in a ring of STREAM_RING_DEPTH.
+inline constexpr size_t STREAM_RING_DEPTH = 1024; // must be a power of 2.
+inline constexpr size_t STREAM_BLOCK_RECORDS = 16;
+inline constexpr size_t STREAM_DEFAULT_LOW_WATERMARK = STREAM_RING_DEPTH / 4;
+
+// Number of preloaded schedules that can be switched with a single write.
+inline constexpr size_t SCHEDULE_SLOT_COUNT = 8;
+// Saving a slot may wait for core1 to finish analyzing the schedule.
+inline constexpr uint32_t SCHEDULE_SLOT_TIMEOUT_US = 20000;
+
+// Trial state machine on core1. A whole program (20 bytes per state) is
+// written in one Harp message, which holds at most 255 bytes.
+inline constexpr size_t STATE_MACHINE_MAX_STATES = 12;
+
+// Stored configuration. Kept in the last flash sectors. Bump the version when
+// the stored layout changes so that older images are ignored.
+inline constexpr uint32_t CONFIG_STORE_VERSION = 6;
+
+// Logic analyzer. Port samples are captured into a ring of
+// 2^LOGIC_ANALYZER_RING_BITS bytes, run-length encoded on core0 (at most
+// LOGIC_ANALYZER_SAMPLES_PER_UPDATE samples per pass), and sent to the PC in
+// batches of up to LOGIC_ANALYZER_BATCH_RUNS runs, at least every
+// LOGIC_ANALYZER_FLUSH_US.
+inline constexpr size_t LOGIC_ANALYZER_RING_BITS = 14;
+inline constexpr size_t LOGIC_ANALYZER_SAMPLES_PER_UPDATE = 512;
+inline constexpr size_t LOGIC_ANALYZER_BATCH_RUNS = 24;
+inline constexpr uint32_t LOGIC_ANALYZER_FLUSH_US = 10000;
+inline constexpr uint32_t LOGIC_ANALYZER_MAX_RATE_HZ = 1'000'000;
+
+// PIO output engine. Port writes are encoded into a ring of
+// 2^PIO_OUTPUT_RING_BITS bytes that DMA feeds to a PIO state machine.
+// Schedules start PIO_OUTPUT_START_LEAD_US after the start request so that the
+// first words are queued before the state machine needs them.
+inline constexpr size_t PIO_OUTPUT_RING_BITS = 10;
+inline constexpr uint32_t PIO_OUTPUT_START_LEAD_US = 200;
+
+// Input capture. Edge records from a PIO state machine are captured into a
+// ring of 2^INPUT_CAPTURE_RING_BITS bytes, decoded on core0 (at most
+// INPUT_CAPTURE_RECORDS_PER_UPDATE records per pass), and sent to the PC in
+// batches of up to INPUT_CAPTURE_BATCH_SIZE edges, at least every
+// INPUT_CAPTURE_FLUSH_US.
+inline constexpr size_t INPUT_CAPTURE_RING_BITS = 12;
+inline constexpr size_t INPUT_CAPTURE_RECORDS_PER_UPDATE = 256;
+inline constexpr size_t INPUT_CAPTURE_BATCH_SIZE = 16;
+inline constexpr uint32_t INPUT_CAPTURE_FLUSH_US = 1000;
+
+// Outgoing Harp events. Queued in a buffer of HARP_TX_BATCH_BYTES (room for
+// the largest message) and handed to USB at least every HARP_TX_FLUSH_US
+// (one full-speed USB frame), or once HARP_TX_FLUSH_BYTES are queued.
+inline constexpr size_t HARP_TX_BATCH_BYTES = 512;
+inline constexpr size_t HARP_TX_FLUSH_BYTES = 256;
+inline constexpr uint32_t HARP_TX_FLUSH_US = 1000;
+
+// Loopback latency calibration. An output looped back to an input by a jumper
+// toggles LOOPBACK_CALIBRATION_EDGES times, LOOPBACK_CALIBRATION_SPACING_US
+// apart. Results are taken LOOPBACK_CALIBRATION_SETTLE_US after the last edge,
+// and only kept if at least LOOPBACK_CALIBRATION_MIN_EDGES edges were seen
+// both ways. Alarms fire at most MAX_ALARM_LEAD_US early, and interrupt
+// timestamps are corrected by at most MAX_INPUT_LATENCY_US.
+inline constexpr uint32_t LOOPBACK_CALIBRATION_EDGES = 4000;
+inline constexpr uint32_t LOOPBACK_CALIBRATION_SPACING_US = 200;
+inline constexpr uint32_t LOOPBACK_CALIBRATION_SETTLE_US = 10000;
+inline constexpr uint32_t LOOPBACK_CALIBRATION_MIN_EDGES =
+    LOOPBACK_CALIBRATION_EDGES / 2;
+inline constexpr uint32_t MAX_ALARM_LEAD_US = MIN_EDGE_SPACING_US;
+inline constexpr uint32_t MAX_INPUT_LATENCY_US = 100;
+
 
 
 #endif // CONFIG_H
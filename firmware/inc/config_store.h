@@ -0,0 +1,141 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <cstring>
+
+/**
+ * \brief header written in front of the stored configuration.
+ */
+struct config_store_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t payload_size;
+    uint32_t crc32; /// of the payload.
+};
+
+/**
+ * \brief CRC-32 (IEEE 802.3) of \p size bytes of \p data.
+ * \param crc the result of a previous call to continue a checksum.
+ */
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/**
+ * \brief Save and load a block of configuration data in a reserved region of
+ *  NOR flash.
+ * \details The Flash backend provides:
+ *  - PAGE_SIZE and SECTOR_SIZE constants,
+ *  - region_size(): size of the reserved region in bytes,
+ *  - read(offset): pointer to the (memory-mapped) region contents,
+ *  - erase(offset, size): erase whole sectors to 0xFF,
+ *  - program(offset, data, size): program whole pages.
+ *  Offsets are relative to the start of the reserved region.
+ */
+template <typename Flash>
+class ConfigStore
+{
+public:
+    static constexpr uint32_t MAGIC = 0x43464348; // "HCFC" in memory.
+
+/**
+ * \brief constructor.
+ * \param version of the stored layout. Data saved with a different version
+ *  is never loaded.
+ */
+    ConfigStore(Flash& flash, uint32_t version)
+    : flash_{flash}, version_{version}{}
+
+/**
+ * \brief true if \p size bytes would fit in the reserved region.
+ */
+    bool fits(size_t size) const
+    {return erase_size(size) <= flash_.region_size();}
+
+/**
+ * \brief overwrite the stored configuration with \p size bytes of \p data.
+ * \returns true if the data was written and reads back intact.
+ */
+    bool save(const void* data, size_t size);
+
+/**
+ * \brief copy the stored configuration into \p data.
+ * \returns false (and leaves \p data untouched) if nothing valid of exactly
+ *  \p size bytes and the current version is stored.
+ */
+    bool load(void* data, size_t size) const;
+
+/**
+ * \brief true if a valid configuration of \p size bytes is stored.
+ */
+    bool valid(size_t size) const;
+
+/**
+ * \brief invalidate the stored configuration.
+ */
+    void erase()
+    {flash_.erase(0, Flash::SECTOR_SIZE);}
+
+private:
+    static constexpr size_t round_up(size_t size, size_t multiple)
+    {return ((size + multiple - 1) / multiple) * multiple;}
+
+    static constexpr size_t erase_size(size_t size)
+    {return round_up(sizeof(config_store_header_t) + size, Flash::SECTOR_SIZE);}
+
+    Flash& flash_;
+    const uint32_t version_;
+};
+
+
+template <typename Flash>
+bool ConfigStore<Flash>::save(const void* data, size_t size)
+{
+    if (!fits(size))
+        return false;
+    config_store_header_t header{MAGIC, version_, uint32_t(size),
+                                 crc32((const uint8_t*)data, size)};
+    flash_.erase(0, erase_size(size));
+    // Program the header and payload as one stream of whole pages.
+    size_t total_size = sizeof(header) + size;
+    uint8_t page[Flash::PAGE_SIZE];
+    for (size_t offset = 0; offset < total_size; offset += Flash::PAGE_SIZE)
+    {
+        memset(page, 0xFF, sizeof(page));
+        for (size_t i = 0; (i < sizeof(page)) && (offset + i < total_size); ++i)
+        {
+            size_t index = offset + i;
+            page[i] = (index < sizeof(header))
+                ? ((const uint8_t*)&header)[index]
+                : ((const uint8_t*)data)[index - sizeof(header)];
+        }
+        flash_.program(offset, page, sizeof(page));
+    }
+    return valid(size);
+}
+
+
+template <typename Flash>
+bool ConfigStore<Flash>::valid(size_t size) const
+{
+    if (!fits(size))
+        return false;
+    config_store_header_t header;
+    memcpy(&header, flash_.read(0), sizeof(header));
+    if ((header.magic != MAGIC) || (header.version != version_)
+        || (header.payload_size != size))
+        return false;
+    return crc32(flash_.read(sizeof(header)), size) == header.crc32;
+}
+
+
+template <typename Flash>
+bool ConfigStore<Flash>::load(void* data, size_t size) const
+{
+    if (!valid(size))
+        return false;
+    memcpy(data, flash_.read(sizeof(config_store_header_t)), size);
+    return true;
+}
+
+#endif // CONFIG_STORE_H
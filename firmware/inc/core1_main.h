@@ -5,6 +5,8 @@
 #include <pwm_task.h>
 #include <pwm_scheduler.h>
 #include <schedule_ctrl_queues.h>
+#include <trial_repeat.h>
+#include <pico/multicore.h>
 #if defined(DEBUG) || defined(PROFILE_CPU)
     #include <stdio.h>
     #include <cstdio> // for printf
@@ -12,8 +14,56 @@
 
 extern core1_state_t state;
 extern bool schedule_failed;
+extern feasibility_report_t schedule_report;
 
-extern PWMScheduler scheduler;
+using CuttlefishScheduler = PWMScheduler<MAX_PWM_TASKS, PORT_EVENT_QUEUE_DEPTH>;
+extern CuttlefishScheduler scheduler;
+extern TrialRepeat trial_repeat;
+
+using CuttlefishStateMachine = TrialStateMachine<STATE_MACHINE_MAX_STATES>;
+extern CuttlefishStateMachine state_machine;
+
+/**
+ * \brief a schedule compiled into core1's ready-to-run form.
+ */
+struct ScheduleSlot
+{
+    etl::vector<pwm_task_spec_t, MAX_PWM_TASKS> tasks;
+    uint32_t merge_tolerance_us;
+    feasibility_report_t report; /// admission control verdict when saved.
+};
+extern ScheduleSlot schedule_slots[SCHEDULE_SLOT_COUNT];
+
+/**
+ * \brief start the schedule and report the start of its gates, phase locks,
+ *  and trial to core0.
+ * \returns the system time that the schedule starts at.
+ */
+uint64_t start_schedule();
+
+/**
+ * \brief replace the current schedule with schedule slot \p slot.
+ */
+void load_schedule_slot(size_t slot);
+
+/**
+ * \brief start, stop, or step the trial state machine, and apply the entry
+ *  actions of the state it enters.
+ * \details Its schedule actions start and stop the schedule in place of
+ *  core0, which is told as if it had asked.
+ */
+void run_state_machine(bool start, bool stop);
+
+/**
+ * \brief take a STOP that core0 queued behind a START it stopped waiting for.
+ * \returns true if the start was cancelled.
+ */
+bool start_cancelled();
+
+/**
+ * \brief one pass of core1's scheduler state machine.
+ */
+void run_task_loop();
 
 void core1_main();
 
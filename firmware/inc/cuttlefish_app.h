@@ -2,15 +2,28 @@
 #define CUTTLEFISH_APP_H
 #include <pico/stdlib.h>
 #include <cstring>
+#include <array>
+#include <algorithm>
+#include <utility>
 #include <config.h>
 #include <harp_message.h>
 #include <harp_core.h>
 #include <harp_c_app.h>
 #include <etl/vector.h>
 #include <pwm_settings.h>
+#include <port_layout.h>
 #include <edge_event_queue.h>
+#include <output_event_log.h>
+#include <waveform_stream.h>
 #include <schedule_ctrl_queues.h>
 #include <core1_main.h>
+#include <config_store.h>
+#include <pico_flash.h>
+#include <port_sampler.h>
+#include <sample_rle.h>
+#include <edge_capture.h>
+#include <harp_tx_batch.h>
+#include <loopback_calibration.h>
 #include <pico/multicore.h>
 #include <hardware/irq.h>
 #include <hardware/gpio.h>
@@ -22,6 +35,8 @@
 
 using enum reg_type_t;
 using Harp = HarpCore; // make an alias.
+using Port = PortLayout<NUM_GPIOS, PORT_BASE>;
+using port_t = Port::port_t; // Port registers have 1 bit per channel.
 
 // Setup for Harp App
 extern const size_t APP_REG_COUNT;
@@ -32,28 +47,119 @@ inline constexpr uint8_t FALLING_EDGE_EVENTS_ADDRESS =
     Harp::APP_REG_START_ADDRESS + 7;
 inline constexpr uint8_t PWM_STATE_ADDRESS =
     Harp::APP_REG_START_ADDRESS + 8;
+inline constexpr uint8_t PWM_SETTINGS_ADDRESS =
+    Harp::APP_REG_START_ADDRESS + 9;
+// Registers after the per-channel PwmSettings registers.
+inline constexpr uint8_t OUTPUT_EDGE_EVENTS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 3;
+inline constexpr uint8_t STREAM_LOW_WATERMARK_REACHED_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 8;
+inline constexpr uint8_t STREAM_UNDERRUN_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 9;
+inline constexpr uint8_t SCHEDULE_SLOT_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 13;
+inline constexpr uint8_t SAVE_SCHEDULE_SLOT_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 14;
+inline constexpr uint8_t LOGIC_ANALYZER_SAMPLES_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 18;
+inline constexpr uint8_t LOGIC_ANALYZER_OVERFLOW_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 19;
+inline constexpr uint8_t PWM_GATE_STATE_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 21;
+inline constexpr uint8_t PWM_PHASE_LOCK_STATE_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 23;
+inline constexpr uint8_t INPUT_CAPTURE_EVENTS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 27;
+inline constexpr uint8_t INPUT_CAPTURE_OVERFLOW_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 28;
+inline constexpr uint8_t PWM_TRIAL_START_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 31;
+inline constexpr uint8_t STATE_MACHINE_TRANSITION_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 34;
+inline constexpr uint8_t LATENCY_STATISTICS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 37;
+
+// ScheduleSlot bit to start the schedule right after loading the slot.
+inline constexpr uint8_t SCHEDULE_SLOT_START = 0x80;
+
+/**
+ * \brief commands written to the StoredConfiguration register.
+ */
+enum class stored_config_cmd_t: uint8_t
+{
+    SAVE = 1, /// store the configuration and all schedules in flash.
+    LOAD = 2, /// replace the configuration and all schedules with the stored ones.
+    ERASE = 3, /// forget the stored configuration.
+};
+
+/**
+ * \brief what to do with the stored configuration at power up.
+ */
+enum class boot_action_t: uint8_t
+{
+    NONE = 0,
+    RESTORE = 1,
+    RESTORE_AND_START = 2,
+};
 
 extern uint8_t pwm_task_mask;
-extern PWMScheduler pwm_schedule;
-extern RegSpec app_reg_specs[];
+extern RegSpec* const app_reg_specs;
 extern HarpCApp& app;
 
 #pragma pack(push, 1)
 struct app_regs_t
 {
-    volatile uint8_t port_dir; // 1 = output; 0 = input.
-    volatile uint8_t port_state; // current gpio state. Readable and writeable.
-    volatile uint8_t port_set;
-    volatile uint8_t port_clear;
+    volatile port_t port_dir; // 1 = output; 0 = input.
+    volatile port_t port_state; // current gpio state. Readable and writeable.
+    volatile port_t port_set;
+    volatile port_t port_clear;
 
-    volatile uint8_t enable_rising_edge_events;
-    volatile uint8_t rising_edge_events;
-    volatile uint8_t enable_falling_edge_events;
-    volatile uint8_t falling_edge_events;
+    volatile port_t enable_rising_edge_events;
+    volatile port_t rising_edge_events;
+    volatile port_t enable_falling_edge_events;
+    volatile port_t falling_edge_events;
 
     uint8_t pwm_state;
     pwm_settings_t pwm_settings[NUM_GPIOS];
-    uint8_t pwm_ready;
+    feasibility_report_t schedule_diagnostics;
+    uint32_t edge_merge_tolerance_us;
+    port_t enable_output_edge_events;
+    uint32_t output_edge_events[3 * OUTPUT_EVENT_BATCH_SIZE];
+    uint32_t output_edge_events_dropped;
+    uint8_t stream_mode;
+    uint32_t stream_records[3 * STREAM_BLOCK_RECORDS];
+    uint32_t stream_low_watermark;
+    uint32_t stream_low_watermark_reached;
+    uint32_t stream_underrun;
+    pwm_random_settings_t pwm_random_settings;
+    pwm_ramp_settings_t pwm_ramp_settings;
+    pwm_burst_settings_t pwm_burst_settings;
+    uint8_t schedule_slot;
+    uint8_t save_schedule_slot;
+    uint8_t stored_configuration;
+    uint8_t boot_action;
+    uint32_t logic_analyzer_rate_hz;
+    uint32_t logic_analyzer_samples[2 * LOGIC_ANALYZER_BATCH_RUNS];
+    uint32_t logic_analyzer_overflow;
+    pwm_gate_settings_t pwm_gate_settings;
+    port_t pwm_gate_state;
+    pwm_phase_lock_settings_t pwm_phase_lock_settings;
+    port_t pwm_phase_lock_state;
+    phase_lock_stats_t pwm_phase_lock_statistics;
+    uint8_t output_engine;
+    uint8_t input_capture;
+    uint32_t input_capture_events[3 * INPUT_CAPTURE_BATCH_SIZE];
+    uint32_t input_capture_overflow;
+    pwm_overlay_settings_t pwm_overlay_settings;
+    pwm_trial_settings_t pwm_trial_settings;
+    uint32_t pwm_trial_start;
+    sm_state_t state_machine_program[STATE_MACHINE_MAX_STATES];
+    uint8_t state_machine_control;
+    sm_event_t state_machine_transition;
+    loopback_calibration_t loopback_calibration;
+    latency_compensation_t latency_compensation;
+    latency_stats_t latency_statistics;
+    port_t pwm_ready;
 };
 #pragma pack(pop)
 
@@ -63,6 +169,16 @@ extern app_regs_t app_regs;
 inline uint32_t time_us_32_fast()
 {return timer_hw->timerawl;}
 
+/**
+ * \brief extend a recent (32-bit) system time to 64 bits.
+ * \note valid for timestamps up to ~71 minutes in the past.
+ */
+inline uint64_t extend_time_us_32(uint32_t time_us)
+{
+    uint64_t now_us = time_us_64();
+    return now_us - uint32_t(uint32_t(now_us) - time_us);
+}
+
 
 void reset_schedule();
 
@@ -73,12 +189,12 @@ void reset_schedule();
 void write_port_dir(msg_t& msg);
 
 /**
- * \brief read the 8-channel port simultaneousy
+ * \brief read all port channels simultaneousy
  */
 void read_port_state(uint8_t reg_address);
 
 /**
- * \brief write to the 8-channel port as a group. (Values for pins specified
+ * \brief write to all port channels as a group. (Values for pins specified
  *  as inputs will be ignored.)
  */
 void write_port_state(msg_t& msg);
@@ -87,14 +203,357 @@ void write_port_set(msg_t& msg);
 void write_port_clear(msg_t& msg);
 
 
+/**
+ * \brief apply the rising and falling edge event enable registers, and the
+ *  edges of phase-lock reference inputs, to the GPIO interrupts.
+ */
+void apply_edge_event_enables();
+
 void write_enable_rising_edge_events(msg_t& msg);
 void write_enable_falling_edge_events(msg_t& msg);
 
+/**
+ * \brief enable logging of the port writes issued by the PWM schedule for
+ *  the channels in the mask.
+ */
+void write_enable_output_edge_events(msg_t& msg);
+
+void read_output_edge_events_dropped(uint8_t reg_address);
+
+/**
+ * \brief send logged port writes to the PC in batches.
+ * \details Each batch is one OutputEdgeEvents EVENT timestamped with the
+ *  first record's time. Its payload holds (time offset [us] from the message
+ *  timestamp, mask, state) U32 triplets.
+ */
+void send_output_edge_events();
+
 void read_reg_error(uint8_t reg_address);
 void write_reg_error(msg_t& msg);
 
 void write_pwm_state(msg_t& msg);
 
+/**
+ * \brief ask core1 to start (\p new_state > 0) or stop the schedule and wait
+ *  (briefly) for the outcome. Updates the PwmState register to match.
+ * \param[out] timestamp_us system time of the state change, or 0 if core1
+ *  did not answer.
+ * \return WRITE on success. WRITE_ERROR otherwise.
+ */
+msg_type_t request_pwm_state(uint8_t old_state, uint8_t new_state,
+                             uint64_t& timestamp_us);
+
+/**
+ * \brief ask core1 to save or load a schedule slot (or to clear the current
+ *  schedule) and wait for the outcome.
+ * \return false if core1 did not answer in time, or if a ScheduleSlot or
+ *  SaveScheduleSlot write still waits for its answer.
+ */
+bool request_schedule_slot(schedule_param_t request, uint8_t slot);
+
+/**
+ * \brief ask core1 to save or load a schedule slot without waiting for the
+ *  outcome. finish_slot_request() replies to the write once core1 answers.
+ * \param start start the schedule once the slot is loaded.
+ */
+bool send_slot_request(schedule_param_t request, uint8_t slot, bool start);
+
+/**
+ * \brief reply to the pending ScheduleSlot or SaveScheduleSlot write once
+ *  core1 answers, and mirror the slot in the registers if it succeeded.
+ * \details If core1 takes longer than SCHEDULE_SLOT_TIMEOUT_US, the write is
+ *  answered with WRITE_ERROR right away, and a late success is reported as an
+ *  EVENT instead.
+ */
+void finish_slot_request();
+
+/**
+ * \brief true while the schedule cannot change: it runs, a slot write
+ *  waits for core1, or the trial state machine or a loopback calibration
+ *  owns it. A calibration keeps it until it settles, after its schedule is
+ *  done.
+ */
+bool schedule_busy();
+
+struct schedule_regs_t;
+
+/**
+ * \brief copy the registers that describe the current schedule into \p regs.
+ */
+void save_schedule_regs(schedule_regs_t& regs);
+
+/**
+ * \brief make the registers describe the schedule in \p regs. Does not send
+ *  anything to core1.
+ */
+void load_schedule_regs(const schedule_regs_t& regs);
+
+/**
+ * \brief rebuild the schedule in \p regs on core1 from scratch and make the
+ *  registers describe it.
+ */
+bool restore_schedule(const schedule_regs_t& regs);
+
+/**
+ * \brief replace the current PWM schedule with a preloaded slot. Setting
+ *  the SCHEDULE_SLOT_START bit also starts it.
+ * \details The reply follows once core1 has loaded the slot. It is
+ *  timestamped with the start time when started.
+ */
+void write_schedule_slot(msg_t& msg);
+
+/**
+ * \brief copy the current PWM schedule (as compiled by core1) into a slot.
+ * \details The reply follows once core1 has saved the slot.
+ */
+void write_save_schedule_slot(msg_t& msg);
+
+/**
+ * \brief select whether starting the schedule plays the PwmSettings (0) or
+ *  the records streamed through StreamRecords (1). Only writeable while the
+ *  schedule is stopped.
+ */
+void write_stream_mode(msg_t& msg);
+
+/**
+ * \brief queue a block of (delta time [us], port mask, port state) U32
+ *  triplets for playback. Accepted before and during playback.
+ * \details The whole block is rejected if it does not fit in the ring, so the
+ *  PC may simply retry it later. Triplets that are all zero are padding and
+ *  are skipped.
+ */
+void write_stream_records(msg_t& msg);
+
+/**
+ * \brief send StreamLowWatermarkReached and StreamUnderrun EVENTs.
+ */
+void send_stream_events();
+
+/**
+ * \brief set the window (in [us]) within which edges of different PWM
+ *  outputs are merged into a single port write. Only writeable while the
+ *  schedule is stopped.
+ */
+void write_edge_merge_tolerance_us(msg_t& msg);
+
+/**
+ * \brief forward the EdgeMergeToleranceUs register to core1.
+ */
+bool apply_edge_merge_tolerance_us();
+
+/**
+ * \brief draw the off times of one PWM output from a random distribution.
+ * \details The output's PwmSettings must be written first. A seed of 0 is
+ *  replaced with a fresh seed, which is stored in the register (and echoed in
+ *  the reply) so the run can be reproduced.
+ */
+void write_pwm_random_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ * \details Fills in a seed if none was given.
+ */
+bool apply_pwm_random_settings(pwm_random_settings_t& settings);
+
+/**
+ * \brief sweep the period and duty cycle of one PWM output from start to end
+ *  values over a ramp duration, then hold the end values.
+ * \details The output's PwmSettings must be written first. Its offset, cycle
+ *  count and inversion still apply.
+ */
+void write_pwm_ramp_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ */
+bool apply_pwm_ramp_settings(const pwm_ramp_settings_t& settings);
+
+/**
+ * \brief group the pulses of one PWM output into bursts separated by a gap,
+ *  and bursts into trains separated by another gap.
+ * \details The output's PwmSettings must be written first. The burst
+ *  structure replaces its cycle count.
+ */
+void write_pwm_burst_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ */
+bool apply_pwm_burst_settings(const pwm_burst_settings_t& settings);
+
+/**
+ * \brief gate one PWM output with a port input. While the gate is closed the
+ *  output idles, and its waveform either keeps running or pauses.
+ * \details The output's PwmSettings must be written first. The gate input
+ *  must be another channel that is configured as an input.
+ */
+void write_pwm_gate_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ */
+bool apply_pwm_gate_settings(const pwm_gate_settings_t& settings);
+
+/**
+ * \brief send a timestamped PwmGateState EVENT whenever gated outputs open
+ *  or close (and once as the schedule starts).
+ */
+void send_gate_events();
+
+/**
+ * \brief App register handler function to lock the phase of a PWM output to
+ *  the edges of an input. Only writeable while the schedule is stopped.
+ */
+void write_pwm_phase_lock_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings, forward them to core1, and enable the edge
+ *  interrupts of the reference input.
+ */
+bool apply_pwm_phase_lock_settings(const pwm_phase_lock_settings_t& settings);
+
+/**
+ * \brief reply with core1's phase-lock statistics of the current (or last)
+ *  run.
+ */
+void read_pwm_phase_lock_statistics(uint8_t reg_address);
+
+/**
+ * \brief send a timestamped PwmPhaseLockState EVENT whenever phase-locked
+ *  outputs gain or lose their lock (and once as the schedule starts).
+ */
+void send_phase_lock_events();
+
+/**
+ * \brief select what applies the schedule's port writes (output_engine_t).
+ *  Only writeable while the schedule is stopped.
+ * \details The PIO engine cannot play streams, FREEZE gates, or phase locks.
+ */
+void write_output_engine(msg_t& msg);
+
+/**
+ * \brief timestamp the enabled rising and falling input edges with a PIO
+ *  state machine instead of the GPIO interrupt. 0 = interrupt, 1 = PIO.
+ * \details Captured edges are sent as InputCaptureEvents instead of
+ *  RisingEdgeEvents and FallingEdgeEvents.
+ */
+void write_input_capture(msg_t& msg);
+
+/**
+ * \brief start timestamping input edges with the PIO state machine, dropping
+ *  the unsent tail of an earlier capture.
+ */
+bool start_edge_capture();
+
+/**
+ * \brief decode new capture records and send batches of (time offset [ns],
+ *  rising pins, falling pins) U32 triples, each timestamped with the time of
+ *  its first edge (rounded down to the microsecond).
+ * \details Records that are overwritten before they are decoded, or dropped
+ *  by the state machine, are counted in an InputCaptureOverflow EVENT.
+ */
+void send_input_capture_events();
+
+/**
+ * \brief send the pending captured edges as an InputCaptureEvents EVENT.
+ */
+void send_input_capture_batch();
+
+/**
+ * \brief App register handler function to add, change, or remove a pulse
+ *  train that combines with a PWM output. Only writeable while the schedule
+ *  is stopped.
+ */
+void write_pwm_overlay_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ * \details Overlays take the next free task of the PWM_OVERLAY_TASKS that
+ *  all outputs share.
+ */
+bool apply_pwm_overlay_settings(const pwm_overlay_settings_t& settings);
+
+/**
+ * \brief App register handler function to repeat finite schedules as a
+ *  series of trials. Only writeable while the schedule is stopped.
+ * \details The trigger input must be a channel that is configured as an
+ *  input. A seed of 0 is replaced with one from the timer.
+ */
+void write_pwm_trial_settings(msg_t& msg);
+
+/**
+ * \brief validate \p settings and forward them to core1.
+ */
+bool apply_pwm_trial_settings(pwm_trial_settings_t& settings);
+
+/**
+ * \brief send a timestamped PwmTrialStart EVENT as each trial of a repeated
+ *  schedule starts.
+ */
+void send_trial_events();
+
+/**
+ * \brief App register handler function to upload a trial state machine
+ *  program. Only writeable while the state machine is stopped.
+ * \details The payload holds 1 to STATE_MACHINE_MAX_STATES sm_state_t.
+ *  States may only lead to other states of the program or end it.
+ */
+void write_state_machine_program(msg_t& msg);
+
+/**
+ * \brief App register handler function to start (1) or stop (0) the trial
+ *  state machine.
+ * \details Starting requires a stopped schedule, outputs that are not driven
+ *  by a schedule the program may run, inputs that are inputs, and saved
+ *  slots. The outputs of those slots become outputs. While the state machine
+ *  runs, it owns the schedule, so PwmState and ScheduleSlot writes are
+ *  refused.
+ */
+void write_state_machine_control(msg_t& msg);
+
+/**
+ * \brief send a timestamped StateMachineTransition EVENT for every state
+ *  change of the trial state machine, and mirror the schedule slots that it
+ *  loads.
+ */
+void send_state_machine_events();
+
+/**
+ * \brief App register handler function to start (run = 1) or stop (run = 0)
+ *  a loopback calibration between two channels that a jumper connects.
+ * \details Starting requires a stopped schedule played by the alarm, no
+ *  stream, trials, state machine, or input capture, and an input channel
+ *  that is an input. The current schedule is set aside and restored when
+ *  the calibration finishes.
+ */
+void write_loopback_calibration(msg_t& msg);
+
+/**
+ * \brief clear the schedule, toggle the output channel, and time the input's
+ *  edges with both the edge capture and the GPIO interrupt.
+ */
+bool start_loopback_calibration();
+
+/**
+ * \brief stop the calibration, keep its compensation if it saw enough edges
+ *  (and \p measured is true), restore the schedule, and send a
+ *  LatencyStatistics EVENT.
+ */
+void finish_loopback_calibration(bool measured);
+
+/**
+ * \brief App register handler function to set the alarm lead and input
+ *  latency compensation by hand. Only writeable while the schedule is
+ *  stopped.
+ */
+void write_latency_compensation(msg_t& msg);
+
+/**
+ * \brief forward the LatencyCompensation register to core1 and the edge
+ *  interrupt.
+ */
+bool apply_latency_compensation();
+
 /**
  * \brief App register handler function to write pwm settings to the given PWM
  *  output (1 per IO).
@@ -102,6 +561,69 @@ void write_pwm_state(msg_t& msg);
  */
 void write_any_pwm_settings(msg_t& msg);
 
+/**
+ * \brief forward PwmSettings register \p channel to core1 and drive the
+ *  channel as an output.
+ */
+bool apply_pwm_settings(size_t channel);
+
+/**
+ * \brief store the I/O configuration, the current schedule, all schedule
+ *  slots, the latency compensation, and the boot action in flash.
+ */
+bool save_configuration();
+
+/**
+ * \brief replace the I/O configuration, the current schedule, all schedule
+ *  slots, and the latency compensation with the stored ones.
+ */
+bool load_configuration();
+
+/**
+ * \brief reads 1 if a valid configuration is stored in flash and 0
+ *  otherwise.
+ */
+void read_stored_configuration(uint8_t reg_address);
+
+/**
+ * \brief save, load, or erase the stored configuration. Only writeable while
+ *  the schedule is stopped.
+ * \details The reply holds the register read after the command.
+ */
+void write_stored_configuration(msg_t& msg);
+
+/**
+ * \brief select what happens with the stored configuration at power up.
+ *  Takes effect when the configuration is saved.
+ */
+void write_boot_action(msg_t& msg);
+
+/**
+ * \brief restore (and optionally start) the stored configuration according
+ *  to its boot action. Called once at power up after reset_app().
+ */
+void boot_from_stored_configuration();
+
+/**
+ * \brief sample all port pins at (close to) the given rate [Hz] and send
+ *  them run-length encoded as LogicAnalyzerSamples EVENTs. 0 = stop.
+ * \details The register (and the reply) holds the rate in use.
+ */
+void write_logic_analyzer_rate_hz(msg_t& msg);
+
+/**
+ * \brief encode new port samples and send batches of (port state, run
+ *  length) U32 pairs, each timestamped with the time of its first sample.
+ * \details Samples that are overwritten before they are encoded are skipped
+ *  and counted in a LogicAnalyzerOverflow EVENT.
+ */
+void send_logic_analyzer_events();
+
+/**
+ * \brief send the encoder's ready batch as a LogicAnalyzerSamples EVENT.
+ */
+void send_logic_analyzer_batch();
+
 /**
  * \brief a single callback to handle all GPIO pin change events including
  *  simultaneous events.
@@ -0,0 +1,83 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <config.h>
+#include <edge_capture_decoder.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
+#include <hardware/timer.h>
+
+/**
+ * \brief timestamp input edges on the port pins with a PIO state machine.
+ * \details EdgeCaptureProgram samples the pins every few system clock cycles
+ *  and pushes a record (new pin state, sample counter) whenever they change,
+ *  so timestamps do not depend on interrupt latency and edges on different
+ *  pins a few cycles apart get their own records. Like PortSampler, a DMA
+ *  channel drains the RX FIFO into a RAM ring and a second channel re-triggers
+ *  it whenever its transfer count runs out. Records are decoded with
+ *  EdgeCaptureDecoder.
+ */
+class EdgeCapture
+{
+public:
+    using Decoder = EdgeCaptureDecoder<NUM_GPIOS>;
+    using Program = Decoder::Program;
+    static constexpr size_t RING_RECORDS =
+        (1u << INPUT_CAPTURE_RING_BITS) / sizeof(uint32_t);
+
+/**
+ * \brief start capturing edges on the port pins.
+ * \returns false if the PIO or DMA hardware could not be claimed.
+ */
+    bool start();
+
+    void stop();
+
+    bool running() const
+    {return running_;}
+
+/**
+ * \brief the number of records written into the ring since starting.
+ * \note must be called at least once every 2^32 records.
+ */
+    uint64_t records_written();
+
+/**
+ * \brief record \p index, which must be one of the last RING_RECORDS written.
+ */
+    uint32_t record(uint64_t index) const
+    {return ring_[index & (RING_RECORDS - 1)];}
+
+/**
+ * \brief true if records were dropped because the RX FIFO was full since the
+ *  last call.
+ */
+    bool fifo_overflowed();
+
+/**
+ * \brief system time [us] of sample 0.
+ */
+    uint64_t start_time_us() const
+    {return start_time_us_;}
+
+private:
+    static constexpr uint32_t TRANSFER_COUNT = 0xFFFFFFFF;
+    /// Enough reads of the timer to see it tick at any system clock.
+    static constexpr size_t START_TICK_SPINS = 1000;
+
+    alignas(1u << INPUT_CAPTURE_RING_BITS) uint32_t ring_[RING_RECORDS];
+    uint32_t transfer_count_reload_ = TRANSFER_COUNT; /// read by ctrl channel.
+    PIO pio_ = pio0;
+    int sm_ = -1;
+    int program_offset_ = -1;
+    int data_chan_ = -1;
+    int ctrl_chan_ = -1;
+    bool running_ = false;
+    uint32_t last_transfer_count_;
+    uint64_t records_written_;
+    uint64_t start_time_us_;
+};
+
+#endif // EDGE_CAPTURE_H
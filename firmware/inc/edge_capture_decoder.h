@@ -0,0 +1,195 @@
+#ifndef EDGE_CAPTURE_DECODER_H
+#define EDGE_CAPTURE_DECODER_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief PIO program that samples NUM_CHANNELS pins every CYCLES_PER_SAMPLE
+ *  cycles and pushes a record whenever they change.
+ * \details x counts samples down from 0xFFFFFFFF and y holds the last state.
+ *  Both paths through the loop take CYCLES_PER_SAMPLE cycles, so a sample's
+ *  index is also its time. Records are pushed without blocking so that a full
+ *  RX FIFO costs records instead of timing.
+ *
+ *  changed:
+ *      mov y, x                ; x holds the new state.
+ *      in osr, INDEX_BITS      ; record = state << INDEX_BITS | counter.
+ *      push noblock
+ *      mov x, osr
+ *      jmp x-- sample
+ *  .wrap_target
+ *  sample:
+ *      mov osr, x              ; Park the counter.
+ *      mov isr, null
+ *      in pins, NUM_CHANNELS
+ *      mov x, isr
+ *      jmp x!=y changed
+ *      mov x, osr [3]          ; Pad to the length of the other path.
+ *      jmp x-- sample
+ *  .wrap
+ *
+ *  Start the state machine at SAMPLE_OFFSET after executing INIT_X and
+ *  INIT_Y. y starts out impossible, so sample 0 always pushes the initial
+ *  state. Input shifts left, without autopush.
+ * \tparam NUM_CHANNELS number of pins. At most 24, which leaves 8 bits of
+ *  the sample counter in each record.
+ */
+template <size_t NUM_CHANNELS>
+struct EdgeCaptureProgram
+{
+    static_assert((NUM_CHANNELS > 0) && (NUM_CHANNELS <= 24),
+                  "Records need at least 8 bits of the sample counter.");
+
+    static constexpr uint32_t INDEX_BITS = 32 - NUM_CHANNELS;
+    static constexpr uint32_t CYCLES_PER_SAMPLE = 10;
+    static constexpr uint8_t SAMPLE_OFFSET = 5;
+    static constexpr uint8_t LENGTH = 12;
+    static constexpr uint8_t WRAP_TARGET = SAMPLE_OFFSET;
+    static constexpr uint8_t WRAP = LENGTH - 1;
+    /// Jump targets are relative to the start of the program.
+    static constexpr uint16_t INSTRUCTIONS[LENGTH] =
+    {
+        0xA041,                         // mov y, x
+        uint16_t(0x40E0 | (INDEX_BITS & 0x1F)), // in osr, INDEX_BITS
+        0x8000,                         // push noblock
+        0xA027,                         // mov x, osr
+        0x0045,                         // jmp x-- 5
+        0xA0E1,                         // mov osr, x
+        0xA0C3,                         // mov isr, null
+        uint16_t(0x4000 | (NUM_CHANNELS & 0x1F)), // in pins, NUM_CHANNELS
+        0xA026,                         // mov x, isr
+        0x00A0,                         // jmp x!=y 0
+        0xA327,                         // mov x, osr [3]
+        0x0045,                         // jmp x-- 5
+    };
+    static constexpr uint16_t INIT_X = 0xA02B; // mov x, ~null
+    static constexpr uint16_t INIT_Y = 0xA04B; // mov y, ~null
+};
+
+/**
+ * \brief an input edge decoded from a capture record.
+ */
+struct captured_edge_t
+{
+    uint64_t time_ns; /// system time of the first sample that saw the edge.
+    uint32_t rise_pins;
+    uint32_t fall_pins;
+};
+
+/**
+ * \brief turn the records of EdgeCaptureProgram into timestamped edges.
+ * \details Records only hold the low INDEX_BITS bits of their sample index.
+ *  The full index is recovered from a hint (the index of a recent sample,
+ *  from the system timer), so records must be decoded within half the
+ *  counter period: 2^(INDEX_BITS - 1) samples, 0.67s for 8 channels at
+ *  125MHz. Times are offset from the true edge by the same amount for every
+ *  record (input synchronizer and when the start time was read), and are
+ *  quantized to one sample period.
+ */
+template <size_t NUM_CHANNELS>
+class EdgeCaptureDecoder
+{
+public:
+    using Program = EdgeCaptureProgram<NUM_CHANNELS>;
+    static constexpr uint32_t INDEX_BITS = Program::INDEX_BITS;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+/**
+ * \brief start decoding a new capture.
+ * \param clock_hz state machine clock.
+ * \param start_time_us system time of sample 0.
+ */
+    void reset(uint32_t clock_hz, uint64_t start_time_us)
+    {
+        clock_hz_ = clock_hz;
+        start_time_us_ = start_time_us;
+        state_ = 0;
+        last_index_ = 0;
+        started_ = false;
+    }
+
+/**
+ * \brief decode \p record, taken at or before sample \p hint_index.
+ * \returns true if \p edge holds an edge. The first record is the initial
+ *  state of the pins and holds none.
+ */
+    bool decode(uint32_t record, uint64_t hint_index, captured_edge_t& edge)
+    {
+        uint32_t state = record >> INDEX_BITS;
+        uint64_t index = extend_index(INDEX_MASK - (record & INDEX_MASK),
+                                      hint_index);
+        if (started_ && (index < last_index_))
+            index = last_index_; // Hint was too far ahead of a stale record.
+        bool first = !started_;
+        uint32_t changed = state ^ state_;
+        state_ = state;
+        last_index_ = index;
+        started_ = true;
+        if (first || !changed)
+            return false;
+        edge.time_ns = time_ns(index);
+        edge.rise_pins = changed & state;
+        edge.fall_pins = changed & ~state;
+        return true;
+    }
+
+/**
+ * \brief treat the next record as a new initial state, i.e. after records
+ *  were skipped.
+ */
+    void resync()
+    {started_ = false;}
+
+/**
+ * \brief state of the pins as of the last record.
+ */
+    uint32_t state() const
+    {return state_;}
+
+/**
+ * \brief index of the sample taken at (or just before) system time
+ *  \p time_us.
+ */
+    uint64_t sample_index(uint64_t time_us) const
+    {
+        if (time_us < start_time_us_)
+            return 0;
+        uint64_t elapsed_us = time_us - start_time_us_;
+        uint64_t cycles = (elapsed_us / 1'000'000) * clock_hz_
+                          + ((elapsed_us % 1'000'000) * clock_hz_) / 1'000'000;
+        return cycles / Program::CYCLES_PER_SAMPLE;
+    }
+
+/**
+ * \brief system time [ns] of sample \p index.
+ */
+    uint64_t time_ns(uint64_t index) const
+    {
+        uint64_t cycles = index * Program::CYCLES_PER_SAMPLE;
+        return start_time_us_ * 1000
+               + (cycles / clock_hz_) * 1'000'000'000
+               + ((cycles % clock_hz_) * 1'000'000'000) / clock_hz_;
+    }
+
+/**
+ * \brief the index within half a counter period of \p hint_index whose low
+ *  bits are \p index_bits.
+ */
+    static uint64_t extend_index(uint32_t index_bits, uint64_t hint_index)
+    {
+        uint32_t delta = (index_bits - uint32_t(hint_index)) & INDEX_MASK;
+        uint64_t index = hint_index + delta;
+        if ((delta > (INDEX_MASK >> 1)) && (index > INDEX_MASK))
+            index -= uint64_t(INDEX_MASK) + 1;
+        return index;
+    }
+
+private:
+    uint32_t clock_hz_ = 125'000'000;
+    uint64_t start_time_us_ = 0;
+    uint32_t state_ = 0;
+    uint64_t last_index_ = 0;
+    bool started_ = false;
+};
+
+#endif // EDGE_CAPTURE_DECODER_H
@@ -0,0 +1,75 @@
+#ifndef HARP_TX_BATCH_H
+#define HARP_TX_BATCH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <config.h>
+#include <harp_message.h>
+
+/**
+ * \brief Harp messages from core0, queued and sent back-to-back.
+ * \details Each message keeps its own timestamp. The batch goes out once
+ *  HARP_TX_FLUSH_US have passed since its first message (about one USB
+ *  frame) or once it holds HARP_TX_FLUSH_BYTES, so that bursts of events
+ *  reach the USB CDC driver together and share its packets. core.pico
+ *  encodes each message. A message goes out only once the driver has room
+ *  for its whole frame, so that replies sent directly never land inside
+ *  one. The rest stay queued for the next flush.
+ */
+class HarpTxBatch
+{
+public:
+/**
+ * \brief queue a message with \p num_bytes of payload from \p data.
+ * \returns false if the message was dropped because the driver has not
+ *  taken enough of the batch to make room for it.
+ */
+    bool add(msg_type_t type, uint8_t address, const volatile uint8_t* data,
+             uint8_t num_bytes, reg_type_t payload_type,
+             uint64_t harp_time_us);
+
+/**
+ * \brief queue a message with the contents of app register \p address.
+ */
+    bool add(msg_type_t type, uint8_t address, uint64_t harp_time_us);
+
+/**
+ * \brief queue a message with the contents of app register \p address,
+ *  timestamped now.
+ */
+    bool add(msg_type_t type, uint8_t address);
+
+/**
+ * \brief flush if the batch is due. Call every pass of the main loop.
+ */
+    void service();
+
+/**
+ * \brief hand the queued messages that fit to the USB CDC driver now.
+ */
+    void flush();
+
+/**
+ * \brief drop the queued messages.
+ */
+    void clear()
+    {size_ = 0;}
+
+    size_t size() const
+    {return size_;}
+
+/**
+ * \brief number of messages dropped for lack of room.
+ */
+    uint32_t dropped() const
+    {return dropped_;}
+
+private:
+    uint8_t buffer_[HARP_TX_BATCH_BYTES];
+    size_t size_ = 0;
+    uint32_t first_time_us_ = 0; /// when the oldest queued message was added.
+    uint32_t dropped_ = 0;
+};
+
+extern HarpTxBatch harp_tx_batch;
+
+#endif // HARP_TX_BATCH_H
@@ -0,0 +1,84 @@
+#ifndef ISR_LATENCY_PROBE_H
+#define ISR_LATENCY_PROBE_H
+#include <stdint.h>
+#include <hardware/structs/systick.h>
+#include <hardware/timer.h>
+#include <hardware/clocks.h>
+
+/**
+ * \brief measure how long after its alarm time an alarm ISR starts, in system
+ *  clock cycles, with the SysTick of the core that takes the interrupt.
+ * \details The timer and the system clock both run off the crystal, so every
+ *  timer tick lands on a fixed SysTick count once the two are aligned.
+ *  start() aligns them on a tick, and record() compares SysTick at ISR entry
+ *  with the count of the alarm's tick. Results include the constant cost of
+ *  reading the registers. SysTick wraps every 2^24 cycles (134ms at 125MHz),
+ *  which bounds the latency that can be measured but not how long the probe
+ *  runs.
+ * \note for PROFILE_CPU builds. SysTick is otherwise unused.
+ */
+class IsrLatencyProbe
+{
+public:
+    static constexpr uint32_t SYSTICK_MASK = 0x00FFFFFF;
+
+/**
+ * \brief start SysTick, align it with the timer, and clear the statistics.
+ * \note blocks for up to 1us.
+ */
+    void start()
+    {
+        systick_hw->rvr = SYSTICK_MASK;
+        systick_hw->cvr = 0;
+        systick_hw->csr = 0x5; // Enable. Count processor clock cycles.
+        cycles_per_us_ = clock_get_hz(clk_sys) / 1'000'000;
+        uint32_t time_us = timer_hw->timerawl;
+        while (timer_hw->timerawl == time_us) {}
+        sync_count_ = systick_hw->cvr;
+        sync_time_us_ = time_us + 1;
+        worst_cycles_ = 0;
+        alarms_ = 0;
+    }
+
+/**
+ * \brief call first thing in the ISR of an alarm set for \p alarm_time_us.
+ */
+    inline void record(uint32_t alarm_time_us)
+    {
+        uint32_t cycles = latency_cycles(systick_hw->cvr, alarm_time_us);
+        if (cycles > worst_cycles_)
+            worst_cycles_ = cycles;
+        alarms_ = alarms_ + 1;
+    }
+
+/**
+ * \brief cycles from the tick of \p alarm_time_us to SysTick count \p count.
+ */
+    inline uint32_t latency_cycles(uint32_t count, uint32_t alarm_time_us) const
+    {
+        // SysTick counts down. Both sides wrap at a multiple of 2^24.
+        uint32_t alarm_count = sync_count_
+                               - (alarm_time_us - sync_time_us_) * cycles_per_us_;
+        return (alarm_count - count) & SYSTICK_MASK;
+    }
+
+    inline uint32_t worst_cycles() const
+    {return worst_cycles_;}
+
+    inline uint32_t alarms() const
+    {return alarms_;}
+
+    inline uint32_t cycles_per_us() const
+    {return cycles_per_us_;}
+
+private:
+    uint32_t cycles_per_us_ = 125;
+    uint32_t sync_count_ = 0; /// SysTick count at the tick of sync_time_us_.
+    uint32_t sync_time_us_ = 0;
+    volatile uint32_t worst_cycles_ = 0;
+    volatile uint32_t alarms_ = 0;
+};
+
+extern IsrLatencyProbe isr_latency_probe;
+
+#endif // ISR_LATENCY_PROBE_H
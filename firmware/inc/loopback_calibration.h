@@ -0,0 +1,353 @@
+#ifndef LOOPBACK_CALIBRATION_H
+#define LOOPBACK_CALIBRATION_H
+#include <stdint.h>
+#include <stddef.h>
+
+// Registers are read and written as raw bytes, so they are packed.
+#pragma pack(push, 1)
+/**
+ * \brief starts a loopback calibration from \p output_channel to
+ *  \p input_channel, which a jumper connects.
+ */
+struct loopback_calibration_t
+{
+    uint8_t run; /// 1 = running. 0 = idle or stopped.
+    uint8_t output_channel;
+    uint8_t input_channel;
+};
+
+/**
+ * \brief per-board constants that put outputs and input timestamps on time.
+ */
+struct latency_compensation_t
+{
+    uint32_t alarm_lead_us;    /// the scheduler fires alarms this early.
+    uint32_t input_latency_us; /// subtracted from interrupt timestamps.
+};
+
+/**
+ * \brief latency distributions measured by a loopback calibration.
+ */
+struct latency_stats_t
+{
+    uint32_t output_edges;  /// scheduled edges that the capture saw.
+    int32_t output_mean_ns; /// captured time - scheduled time.
+    uint32_t output_sd_ns;
+    int32_t output_min_ns;
+    int32_t output_max_ns;
+    uint32_t input_edges;   /// captured edges that the interrupt also saw.
+    int32_t input_mean_ns;  /// interrupt timestamp - captured time.
+    uint32_t input_sd_ns;
+    int32_t input_min_ns;
+    int32_t input_max_ns;
+};
+#pragma pack(pop)
+
+/**
+ * \brief running count, mean, standard deviation, and range of latencies.
+ * \details Sums are taken relative to the first latency, so that they stay
+ *  small whatever the offset of the distribution.
+ */
+class LatencyDistribution
+{
+public:
+    inline void reset()
+    {
+        count_ = 0;
+        sum_ns_ = 0;
+        sum_squares_ns2_ = 0;
+    }
+
+    inline void add(int32_t latency_ns)
+    {
+        if (!count_)
+        {
+            first_ns_ = latency_ns;
+            min_ns_ = latency_ns;
+            max_ns_ = latency_ns;
+        }
+        int64_t offset_ns = int64_t(latency_ns) - first_ns_;
+        sum_ns_ += offset_ns;
+        sum_squares_ns2_ += uint64_t(offset_ns * offset_ns);
+        if (latency_ns < min_ns_)
+            min_ns_ = latency_ns;
+        if (latency_ns > max_ns_)
+            max_ns_ = latency_ns;
+        ++count_;
+    }
+
+    inline uint32_t count() const
+    {return count_;}
+
+/**
+ * \brief mean latency, rounded to the nearest ns. 0 if there are none.
+ */
+    inline int32_t mean_ns() const
+    {
+        if (!count_)
+            return 0;
+        return first_ns_ + int32_t(rounded_quotient(sum_ns_, count_));
+    }
+
+    inline uint32_t sd_ns() const
+    {
+        if (!count_)
+            return 0;
+        int64_t mean_offset_ns = rounded_quotient(sum_ns_, count_);
+        uint64_t mean_square = sum_squares_ns2_ / count_;
+        uint64_t square_mean = uint64_t(mean_offset_ns * mean_offset_ns);
+        return (mean_square > square_mean)?
+            integer_sqrt(mean_square - square_mean): 0;
+    }
+
+    inline int32_t min_ns() const
+    {return count_? min_ns_: 0;}
+
+    inline int32_t max_ns() const
+    {return count_? max_ns_: 0;}
+
+private:
+    static inline int64_t rounded_quotient(int64_t dividend, uint32_t divisor)
+    {
+        return (dividend >= 0)? (dividend + divisor / 2) / int64_t(divisor)
+                              : -((-dividend + divisor / 2) / int64_t(divisor));
+    }
+
+    static inline uint32_t integer_sqrt(uint64_t value)
+    {
+        uint64_t root = 0;
+        uint64_t bit = uint64_t(1) << 62;
+        while (bit > value)
+            bit >>= 2;
+        for (; bit; bit >>= 2)
+        {
+            if (value >= root + bit)
+            {
+                value -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+                root >>= 1;
+        }
+        return uint32_t(root);
+    }
+
+    uint32_t count_ = 0;
+    int32_t first_ns_ = 0;
+    int64_t sum_ns_ = 0;
+    uint64_t sum_squares_ns2_ = 0;
+    int32_t min_ns_ = 0;
+    int32_t max_ns_ = 0;
+};
+
+/**
+ * \brief measures output and input latency from edges looped back from an
+ *  output to an input by a jumper.
+ * \details The output toggles at a known spacing, starting from a known
+ *  time. The input's edge capture timestamps each edge to a system clock
+ *  cycle, so it is the reference for both latencies:
+ *  - output latency = captured time - scheduled time, i.e: how late the
+ *    alarm interrupt drives the output.
+ *  - input latency = interrupt timestamp - captured time, i.e: how late the
+ *    GPIO interrupt timestamps the edge.
+ *  Edges are matched to their scheduled index by time, so a missed edge
+ *  does not shift the ones after it. Rising edges have even indices.
+ */
+class LoopbackCalibration
+{
+public:
+    /// Edges held while waiting for their other timestamp. Power of 2.
+    static constexpr uint32_t PENDING_EDGES = 32;
+
+/**
+ * \brief expect \p num_edges edges \p spacing_us apart on the input pins
+ *  in \p pin_mask, the first one rising at \p first_edge_us.
+ */
+    inline void start(uint64_t first_edge_us, uint32_t spacing_us,
+                      uint32_t num_edges, uint32_t pin_mask)
+    {
+        reset();
+        first_edge_ns_ = first_edge_us * 1000;
+        spacing_ns_ = uint64_t(spacing_us) * 1000;
+        num_edges_ = num_edges;
+        pin_mask_ = pin_mask;
+        running_ = true;
+    }
+
+    inline void stop()
+    {running_ = false;}
+
+/**
+ * \brief stop and forget the measurements.
+ */
+    inline void reset()
+    {
+        running_ = false;
+        output_.reset();
+        input_.reset();
+        input_timer_lag_us_ = 0;
+        for (auto& edge: pending_)
+            edge = pending_edge_t();
+    }
+
+    inline bool running() const
+    {return running_;}
+
+    inline uint32_t pin_mask() const
+    {return pin_mask_;}
+
+/**
+ * \brief account for an edge from the input's edge capture at \p time_ns.
+ */
+    inline void add_captured_edge(uint64_t time_ns, uint32_t rise_pins,
+                                  uint32_t fall_pins)
+    {
+        uint32_t index;
+        if (!edge_index(time_ns, rise_pins, fall_pins, index))
+            return;
+        output_.add(int32_t(time_ns - scheduled_time_ns(index)));
+        pending_edge_t* edge = pending(index);
+        if (!edge)
+            return;
+        edge->captured_ns = time_ns;
+        edge->captured = true;
+        match(*edge);
+    }
+
+/**
+ * \brief account for an edge timestamped by the input's GPIO interrupt at
+ *  \p time_us.
+ */
+    inline void add_interrupt_edge(uint64_t time_us, uint32_t rise_pins,
+                                   uint32_t fall_pins)
+    {
+        uint32_t index;
+        if (!edge_index(time_us * 1000, rise_pins, fall_pins, index))
+            return;
+        pending_edge_t* edge = pending(index);
+        if (!edge)
+            return;
+        edge->interrupt_us = time_us;
+        edge->interrupted = true;
+        match(*edge);
+    }
+
+    inline const LatencyDistribution& output_latency() const
+    {return output_;}
+
+    inline const LatencyDistribution& input_latency() const
+    {return input_;}
+
+    inline latency_stats_t stats() const
+    {
+        return {output_.count(), output_.mean_ns(), output_.sd_ns(),
+                output_.min_ns(), output_.max_ns(),
+                input_.count(), input_.mean_ns(), input_.sd_ns(),
+                input_.min_ns(), input_.max_ns()};
+    }
+
+/**
+ * \brief how early to fire the alarm so that outputs change on time,
+ *  rounded to the nearest us and limited to \p max_lead_us.
+ */
+    inline uint32_t alarm_lead_us(uint32_t max_lead_us) const
+    {
+        int32_t lead_us = (output_.mean_ns() + 500) / 1000;
+        if (lead_us < 0)
+            return 0;
+        return (uint32_t(lead_us) > max_lead_us)? max_lead_us: lead_us;
+    }
+
+/**
+ * \brief how much to subtract from interrupt timestamps so that they read
+ *  like the us timer at the edge, rounded to the nearest us.
+ * \details Both read whole us, so this is measured in whole us of the
+ *  timer rather than derived from the mean latency: edges driven by the
+ *  alarm land at a fixed phase of the us, not evenly across it.
+ */
+    inline uint32_t input_latency_us() const
+    {
+        if (!input_.count())
+            return 0;
+        int64_t count = input_.count();
+        int64_t latency_us = (input_timer_lag_us_ >= 0)?
+            (input_timer_lag_us_ + count / 2) / count: 0;
+        return uint32_t(latency_us);
+    }
+
+private:
+    struct pending_edge_t
+    {
+        uint32_t index = 0;
+        bool captured = false;
+        bool interrupted = false;
+        uint64_t captured_ns = 0;
+        uint64_t interrupt_us = 0;
+    };
+
+    inline uint64_t scheduled_time_ns(uint32_t index) const
+    {return first_edge_ns_ + index * spacing_ns_;}
+
+/**
+ * \brief the index of the scheduled edge nearest to \p time_ns.
+ * \returns false if there is none, or if it goes the other way.
+ */
+    inline bool edge_index(uint64_t time_ns, uint32_t rise_pins,
+                           uint32_t fall_pins, uint32_t& index) const
+    {
+        bool rising = rise_pins & pin_mask_;
+        bool falling = fall_pins & pin_mask_;
+        if (!running_ || (rising == falling)
+            || (time_ns + spacing_ns_ / 2 < first_edge_ns_))
+            return false;
+        uint64_t nearest = (time_ns + spacing_ns_ / 2 - first_edge_ns_)
+                           / spacing_ns_;
+        if (nearest >= num_edges_)
+            return false;
+        index = uint32_t(nearest);
+        return rising == !(index & 1);
+    }
+
+/**
+ * \brief the pending entry for edge \p index, starting over if it held an
+ *  older edge that never got both timestamps.
+ * \returns nullptr if a newer edge already took the entry.
+ */
+    inline pending_edge_t* pending(uint32_t index)
+    {
+        pending_edge_t& edge = pending_[index & (PENDING_EDGES - 1)];
+        if (edge.index > index)
+            return nullptr;
+        if (edge.index < index)
+        {
+            edge = pending_edge_t();
+            edge.index = index;
+        }
+        return &edge;
+    }
+
+    inline void match(pending_edge_t& edge)
+    {
+        if (!edge.captured || !edge.interrupted)
+            return;
+        input_.add(int32_t(edge.interrupt_us * 1000 - edge.captured_ns));
+        input_timer_lag_us_ += int64_t(edge.interrupt_us
+                                       - edge.captured_ns / 1000);
+        edge.captured = false;
+        edge.interrupted = false;
+    }
+
+    static_assert((PENDING_EDGES & (PENDING_EDGES - 1)) == 0);
+
+    bool running_ = false;
+    uint64_t first_edge_ns_ = 0;
+    uint64_t spacing_ns_ = 0;
+    uint32_t num_edges_ = 0;
+    uint32_t pin_mask_ = 0;
+    LatencyDistribution output_;
+    LatencyDistribution input_;
+    int64_t input_timer_lag_us_ = 0; /// sum of timer us between the two.
+    pending_edge_t pending_[PENDING_EDGES];
+};
+
+#endif // LOOPBACK_CALIBRATION_H
@@ -0,0 +1,44 @@
+#ifndef OUTPUT_EVENT_LOG_H
+#define OUTPUT_EVENT_LOG_H
+#include <stdint.h>
+#include <hardware/timer.h>
+#include <config.h>
+#include <spsc_ring.h>
+
+/**
+ * \brief record of a port write issued by the alarm ISR.
+ */
+struct OutputEvent
+{
+    uint32_t time_us;   /// (32-bit) system time right after the port write.
+    uint32_t mask;      /// pins that were written.
+    uint32_t state;     /// values written to those pins.
+};
+
+/**
+ * \brief Ring of port writes filled by the alarm ISR and drained by core0.
+ */
+extern SPSCRing<OutputEvent, OUTPUT_EVENT_LOG_DEPTH> output_event_log;
+
+/**
+ * \brief true if the alarm ISR should record port writes.
+ */
+extern volatile bool output_event_log_enabled;
+
+/**
+ * \brief number of records dropped because the log was full.
+ */
+extern volatile uint32_t output_event_log_drops;
+
+/**
+ * \brief record a port write if logging is enabled. ISR-safe.
+ */
+inline void log_output_event(uint32_t mask, uint32_t state)
+{
+    if (!output_event_log_enabled)
+        return;
+    if (!output_event_log.push({timer_hw->timerawl, mask, state}))
+        output_event_log_drops = output_event_log_drops + 1;
+}
+
+#endif // OUTPUT_EVENT_LOG_H
@@ -0,0 +1,53 @@
+#ifndef OUTPUT_GATE_H
+#define OUTPUT_GATE_H
+#include <stdint.h>
+
+/**
+ * \brief an input pin that enables (opens) or masks (closes) a PWM output.
+ * \details While closed, the output idles. The underlying waveform either
+ *  keeps running (CONTINUE) or pauses and picks up where it left off once the
+ *  gate opens again (FREEZE).
+ */
+class OutputGate
+{
+public:
+    enum mode_t: uint8_t
+    {
+        NONE = 0,
+        CONTINUE = 1,
+        FREEZE = 2,
+    };
+
+/**
+ * \param mode NONE disables the gate.
+ * \param pin GPIO pin that gates the output.
+ * \param active_low if true, the gate is open while the pin is low.
+ */
+    inline void configure(mode_t mode, uint32_t pin, bool active_low)
+    {
+        mode_ = mode;
+        pin_mask_ = (mode == NONE)? 0: (1u << pin);
+        active_low_ = active_low;
+    }
+
+    inline bool enabled() const
+    {return mode_ != NONE;}
+
+    inline mode_t mode() const
+    {return mode_;}
+
+    inline uint32_t pin_mask() const
+    {return pin_mask_;}
+
+/**
+ * \brief true if the gate is open given the levels of all GPIO pins.
+ */
+    inline bool open(uint32_t gpio_levels) const
+    {return bool(gpio_levels & pin_mask_) != active_low_;}
+
+private:
+    mode_t mode_ = NONE;
+    uint32_t pin_mask_ = 0;
+    bool active_low_ = false;
+};
+#endif // OUTPUT_GATE_H
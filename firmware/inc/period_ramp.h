@@ -0,0 +1,105 @@
+#ifndef PERIOD_RAMP_H
+#define PERIOD_RAMP_H
+#include <stdint.h>
+
+/**
+ * \brief per-cycle period and duty cycle of a frequency/duty sweep.
+ * \details The ramp is precomputed into a cycle count and a per-cycle step
+ *  when configured. Advancing it by one cycle is then a constant-time
+ *  fixed-point update, and once the ramp is done the end values are held.
+ */
+class PeriodRamp
+{
+public:
+    enum profile_t: uint8_t
+    {
+        NONE = 0,        /// disabled.
+        LINEAR = 1,      /// period changes by a fixed step each cycle.
+        EXPONENTIAL = 2, /// period changes by a fixed ratio each cycle.
+    };
+
+    static constexpr uint32_t DUTY_SCALE = 10000; /// duty units: 0.01%.
+    static constexpr uint32_t MIN_RATIO_BITS = 8;
+
+/**
+ * \brief the part of a PeriodRamp that changes as it runs.
+ */
+    struct checkpoint_t
+    {
+        uint64_t period_q32;
+        int64_t duty_q32;
+        uint32_t cycle;
+    };
+
+/**
+ * \brief compute the cycle count and per-cycle steps that sweep from the
+ *  start to the end values in approximately \p ramp_duration_us.
+ * \note duty cycles are in units of 1/DUTY_SCALE.
+ * \returns false if the exponential per-cycle ratio cannot be held to
+ *  MIN_RATIO_BITS significant bits in Q32, i.e: the sweep is too flat for
+ *  its length (use LINEAR instead).
+ */
+    bool configure(profile_t profile, uint32_t start_period_us,
+                   uint32_t end_period_us, uint32_t start_duty,
+                   uint32_t end_duty, uint32_t ramp_duration_us);
+
+/**
+ * \brief go back to the start values.
+ */
+    void restart();
+
+/**
+ * \brief step to the next cycle.
+ */
+    void advance();
+
+    inline bool enabled() const
+    {return profile_ != NONE;}
+
+    inline uint32_t on_time_us() const
+    {return on_time_us_;}
+
+    inline uint32_t off_time_us() const
+    {return off_time_us_;}
+
+    inline uint32_t ramp_cycles() const
+    {return ramp_cycles_;}
+
+    inline checkpoint_t checkpoint() const
+    {return {period_q32_, duty_q32_, cycle_};}
+
+    inline void restore(const checkpoint_t& checkpoint)
+    {
+        period_q32_ = checkpoint.period_q32;
+        duty_q32_ = checkpoint.duty_q32;
+        cycle_ = checkpoint.cycle;
+        set_cycle_times();
+    }
+
+/**
+ * \brief shortest on and off times over the whole ramp.
+ * \details period and duty are both monotonic, so these occur at either end.
+ */
+    uint32_t min_on_time_us() const;
+    uint32_t min_off_time_us() const;
+
+private:
+    void set_cycle_times();
+
+    profile_t profile_ = NONE;
+    uint32_t ramp_cycles_ = 0;      /// cycles from start to end values.
+    uint32_t cycle_ = 0;            /// current cycle in the ramp.
+    uint64_t start_period_q32_ = 0;
+    uint64_t end_period_q32_ = 0;
+    int64_t start_duty_q32_ = 0;
+    int64_t end_duty_q32_ = 0;
+    uint64_t period_step_q32_ = 0;  /// LINEAR: added each cycle (mod 2^64).
+    int64_t period_ratio_q32_ = 0;  /// EXPONENTIAL: (ratio - 1) each cycle.
+    int64_t duty_step_q32_ = 0;     /// added each cycle.
+
+    uint64_t period_q32_ = 0;       /// current period.
+    int64_t duty_q32_ = 0;          /// current duty cycle.
+    uint32_t on_time_us_ = 0;       /// current on time.
+    uint32_t off_time_us_ = 0;      /// current off time.
+};
+#endif // PERIOD_RAMP_H
@@ -0,0 +1,224 @@
+#ifndef PHASE_LOCK_H
+#define PHASE_LOCK_H
+#include <stdint.h>
+
+/**
+ * \brief phase-lock statistics of all phase-locked outputs since the
+ *  schedule started. Also the payload of the PwmPhaseLockStatistics register,
+ *  so it is packed.
+ */
+#pragma pack(push, 1)
+struct phase_lock_stats_t
+{
+    uint32_t reference_edges;     /// reference edges that re-anchored outputs.
+    uint32_t reference_period_us; /// time between the last two of them.
+    int32_t last_error_us;        /// > 0: the output was ahead of the reference.
+    int32_t min_error_us;
+    int32_t max_error_us;
+    uint32_t mean_abs_error_us;
+};
+#pragma pack(pop)
+
+/**
+ * \brief ties the cycles of a PWM output to the edges of a reference input.
+ * \details Every reference edge re-anchors the output so that a cycle starts
+ *  a fixed delay after it, whatever the output's own clock drifted to. The
+ *  output free-runs in between. In TRACK mode, the output's period also
+ *  follows the reference period divided by the (rounded) number of output
+ *  cycles per reference period, through a first-order loop, so that less
+ *  phase error builds up between reference edges.
+ */
+class PhaseLock
+{
+public:
+    enum mode_t: uint8_t
+    {
+        NONE = 0,
+        ANCHOR = 1, /// re-anchor the phase on every reference edge.
+        TRACK = 2,  /// re-anchor and track the reference frequency.
+    };
+
+    /// Locked after this many consecutive edges within the tolerance.
+    static constexpr uint32_t LOCK_EDGES = 4;
+    static constexpr uint32_t LOCK_TOLERANCE_US = 5;
+    /// Tracking loop gain is 1/2^TRACKING_GAIN_SHIFT.
+    static constexpr uint32_t TRACKING_GAIN_SHIFT = 2;
+    /// Tracked periods stay within 1/2^TRACKING_RANGE_SHIFT of the nominal.
+    static constexpr uint32_t TRACKING_RANGE_SHIFT = 3;
+
+/**
+ * \param mode NONE disables the lock.
+ * \param pin GPIO pin of the reference input.
+ * \param falling_edge if true, anchor on falling instead of rising edges.
+ * \param delay_us time from a reference edge to the start of an output
+ *  cycle.
+ */
+    inline void configure(mode_t mode, uint32_t pin, bool falling_edge,
+                          uint32_t delay_us)
+    {
+        mode_ = mode;
+        pin_mask_ = (mode == NONE)? 0: (1u << pin);
+        falling_edge_ = falling_edge;
+        delay_us_ = delay_us;
+    }
+
+    inline bool enabled() const
+    {return mode_ != NONE;}
+
+    inline mode_t mode() const
+    {return mode_;}
+
+    inline uint32_t pin_mask() const
+    {return pin_mask_;}
+
+    inline uint32_t delay_us() const
+    {return delay_us_;}
+
+/**
+ * \brief true if the edges given by \p rise_pins and \p fall_pins include a
+ *  reference edge.
+ */
+    inline bool reference_edge(uint32_t rise_pins, uint32_t fall_pins) const
+    {return (falling_edge_? fall_pins: rise_pins) & pin_mask_;}
+
+/**
+ * \brief forget the reference and go back to the output's own timing.
+ */
+    inline void restart(uint32_t on_time_us, uint32_t period_us)
+    {
+        nominal_on_time_us_ = on_time_us;
+        nominal_period_us_ = period_us;
+        period_q8_ = uint64_t(period_us) << 8;
+        on_time_us_ = on_time_us;
+        period_us_ = period_us;
+        reference_period_us_ = 0;
+        has_reference_ = false;
+        good_edges_ = 0;
+        locked_ = false;
+    }
+
+/**
+ * \brief measure the reference period with an edge at \p time_us and, in
+ *  TRACK mode, update the output timing.
+ */
+    inline void add_reference_edge(uint32_t time_us)
+    {
+        if (has_reference_)
+            reference_period_us_ = time_us - last_edge_us_;
+        last_edge_us_ = time_us;
+        has_reference_ = true;
+        if ((mode_ != TRACK) || (reference_period_us_ == 0))
+            return;
+        // Output cycles per reference period.
+        uint32_t ratio = (reference_period_us_ + nominal_period_us_ / 2)
+                         / nominal_period_us_;
+        if (ratio == 0)
+            ratio = 1;
+        int64_t target_q8 = (int64_t(reference_period_us_) << 8) / ratio;
+        int64_t range_q8 = (int64_t(nominal_period_us_) << 8)
+                           >> TRACKING_RANGE_SHIFT;
+        int64_t nominal_q8 = int64_t(nominal_period_us_) << 8;
+        if (target_q8 < nominal_q8 - range_q8)
+            target_q8 = nominal_q8 - range_q8;
+        if (target_q8 > nominal_q8 + range_q8)
+            target_q8 = nominal_q8 + range_q8;
+        period_q8_ += (target_q8 - period_q8_) >> TRACKING_GAIN_SHIFT;
+        period_us_ = uint32_t((period_q8_ + 128) >> 8);
+        // Keep the duty cycle.
+        on_time_us_ = uint32_t((uint64_t(nominal_on_time_us_) * period_us_
+                                + nominal_period_us_ / 2) / nominal_period_us_);
+        if (on_time_us_ < 1)
+            on_time_us_ = 1;
+        if (on_time_us_ > period_us_ - 1)
+            on_time_us_ = period_us_ - 1;
+    }
+
+/**
+ * \brief account for the phase error measured at the last reference edge.
+ * \returns true if the lock was gained or lost.
+ */
+    inline bool add_phase_error(int32_t error_us)
+    {
+        bool was_locked = locked_;
+        uint32_t abs_error_us = (error_us < 0)? -error_us: error_us;
+        if (abs_error_us > LOCK_TOLERANCE_US)
+            good_edges_ = 0;
+        else if (good_edges_ < LOCK_EDGES)
+            ++good_edges_;
+        locked_ = (good_edges_ >= LOCK_EDGES);
+        return locked_ != was_locked;
+    }
+
+/**
+ * \brief drop the lock if the reference has been silent for two of its
+ *  periods at time \p now_us.
+ * \returns true if the lock was lost.
+ */
+    inline bool check_reference(uint32_t now_us)
+    {
+        if (!locked_ || (now_us - last_edge_us_ <= 2 * reference_period_us_))
+            return false;
+        locked_ = false;
+        good_edges_ = 0;
+        return true;
+    }
+
+    inline bool locked() const
+    {return locked_;}
+
+/**
+ * \brief output timing to use now.
+ */
+    inline uint32_t on_time_us() const
+    {return on_time_us_;}
+
+    inline uint32_t period_us() const
+    {return period_us_;}
+
+/**
+ * \brief output timing before tracking.
+ */
+    inline uint32_t nominal_on_time_us() const
+    {return nominal_on_time_us_;}
+
+    inline uint32_t nominal_period_us() const
+    {return nominal_period_us_;}
+
+    inline uint32_t reference_period_us() const
+    {return reference_period_us_;}
+
+/**
+ * \brief signed offset, within half a period, from a cycle that starts at
+ *  \p cycle_start_us to the closest cycle that starts at \p anchor_us.
+ */
+    static inline int32_t phase_error_us(uint32_t anchor_us,
+                                         uint32_t cycle_start_us,
+                                         uint32_t period_us)
+    {
+        int32_t error_us = int32_t(anchor_us - cycle_start_us)
+                           % int32_t(period_us);
+        if (error_us >= int32_t((period_us + 1) / 2))
+            error_us -= period_us;
+        else if (error_us < -int32_t(period_us / 2))
+            error_us += period_us;
+        return error_us;
+    }
+
+private:
+    mode_t mode_ = NONE;
+    uint32_t pin_mask_ = 0;
+    bool falling_edge_ = false;
+    uint32_t delay_us_ = 0;
+
+    uint32_t nominal_on_time_us_ = 0;
+    uint32_t nominal_period_us_ = 0;
+    int64_t period_q8_ = 0; /// tracked period in 1/256[us].
+    uint32_t on_time_us_ = 0;
+    uint32_t period_us_ = 0;
+    uint32_t last_edge_us_ = 0;
+    uint32_t reference_period_us_ = 0;
+    bool has_reference_ = false;
+    uint32_t good_edges_ = 0;
+    bool locked_ = false;
+};
+#endif // PHASE_LOCK_H
@@ -0,0 +1,43 @@
+#ifndef PICO_FLASH_H
+#define PICO_FLASH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <hardware/flash.h>
+#include <hardware/regs/addressmap.h>
+
+/**
+ * \brief ConfigStore backend for a region of the RP2040's onboard flash.
+ * \details Erasing and programming stall execute-in-place, so both lock out
+ *  core1 (which must have called multicore_lockout_victim_init()) and disable
+ *  interrupts on core0 until they finish.
+ */
+class PicoFlash
+{
+public:
+    static constexpr size_t PAGE_SIZE = FLASH_PAGE_SIZE;
+    static constexpr size_t SECTOR_SIZE = FLASH_SECTOR_SIZE;
+
+/**
+ * \brief constructor.
+ * \param offset sector-aligned offset of the region from the start of flash.
+ * \param size sector-aligned size of the region.
+ */
+    constexpr PicoFlash(uint32_t offset, size_t size)
+    : offset_{offset}, size_{size}{}
+
+    size_t region_size() const
+    {return size_;}
+
+    const uint8_t* read(size_t offset) const
+    {return (const uint8_t*)(XIP_BASE + offset_ + offset);}
+
+    void erase(size_t offset, size_t size);
+
+    void program(size_t offset, const uint8_t* data, size_t size);
+
+private:
+    const uint32_t offset_;
+    const size_t size_;
+};
+
+#endif // PICO_FLASH_H
@@ -0,0 +1,190 @@
+#ifndef PIO_EDGE_ENCODER_H
+#define PIO_EDGE_ENCODER_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief encode timed port writes into the words of a PIO program that
+ *  writes all NUM_CHANNELS pins of the port at once.
+ * \details Each word holds a delay count in its low DELAY_BITS bits and the
+ *  state of the whole port above them. The program (see PioOutput) pulls a
+ *  word, counts the delay down one cycle per loop, and then writes the state:
+ *
+ *      out x, DELAY_BITS
+ *  loop:
+ *      jmp x-- loop
+ *      out pins, NUM_CHANNELS
+ *
+ *  so consecutive pin writes are `x + OVERHEAD_CYCLES` cycles apart. Edge
+ *  times are converted to cycles from a common origin rather than from the
+ *  previous edge, so rounding never accumulates. Gaps that are too long for
+ *  one word are bridged with words that rewrite the current state.
+ * \tparam NUM_CHANNELS number of port pins. At most 24, which leaves 8 bits
+ *  for the delay. Narrower ports need fewer bridging words.
+ */
+template <size_t NUM_CHANNELS>
+class PioEdgeEncoder
+{
+public:
+    static_assert((NUM_CHANNELS > 0) && (NUM_CHANNELS <= 24),
+                  "PIO words need at least 8 bits for the delay.");
+
+    static constexpr uint32_t DELAY_BITS = 32 - NUM_CHANNELS;
+    static constexpr uint32_t STATE_MASK = (1u << NUM_CHANNELS) - 1;
+    /// Cycles of `out x`, the last `jmp`, and `out pins`.
+    static constexpr uint32_t OVERHEAD_CYCLES = 3;
+    static constexpr uint32_t MIN_DELAY_CYCLES = OVERHEAD_CYCLES;
+    static constexpr uint32_t MAX_DELAY_CYCLES =
+        ((1u << DELAY_BITS) - 1) + OVERHEAD_CYCLES;
+
+/**
+ * \brief start a new stream.
+ * \param clock_hz state machine clock.
+ * \param origin_us system time of cycle 0, i.e. when the state machine
+ *  pulls the first word.
+ * \param port_state state of the port pins before the first word.
+ */
+    void reset(uint32_t clock_hz, uint32_t origin_us, uint32_t port_state)
+    {
+        clock_hz_ = clock_hz;
+        origin_us_ = origin_us;
+        last_time_us_ = origin_us;
+        elapsed_us_ = 0;
+        cycle_ = 0;
+        target_cycle_ = 0;
+        port_state_ = port_state & STATE_MASK;
+        next_state_ = port_state_;
+        pending_ = false;
+        late_edges_ = 0;
+    }
+
+/**
+ * \brief queue a write of \p state to the port pins in \p mask at
+ *  \p time_us.
+ * \returns false if the words of the previous write have not all been
+ *  popped yet.
+ * \note times must not decrease. A write that is due before the words
+ *  already popped end, e.g. before the origin, happens as soon as possible
+ *  and counts as late.
+ */
+    bool push(uint32_t mask, uint32_t state, uint32_t time_us)
+    {
+        if (pending_)
+            return false;
+        int32_t delta_us = int32_t(time_us - last_time_us_);
+        if (delta_us > 0)
+        {
+            elapsed_us_ += uint32_t(delta_us);
+            last_time_us_ = time_us;
+        }
+        target_cycle_ = to_cycles(elapsed_us_);
+        next_state_ = ((port_state_ & ~mask) | (state & mask)) & STATE_MASK;
+        pending_ = true;
+        return true;
+    }
+
+/**
+ * \brief the next word of the queued write.
+ * \returns false once all of its words have been popped.
+ */
+    bool pop(uint32_t& word)
+    {
+        if (!pending_)
+            return false;
+        uint64_t delay = (target_cycle_ > cycle_)? target_cycle_ - cycle_: 0;
+        if (delay > MAX_DELAY_CYCLES)
+        {
+            // Bridge the gap, but leave room for the write itself.
+            delay -= MIN_DELAY_CYCLES;
+            if (delay > MAX_DELAY_CYCLES)
+                delay = MAX_DELAY_CYCLES;
+            word = encode(uint32_t(delay), port_state_);
+            cycle_ += delay;
+            return true;
+        }
+        if (delay < MIN_DELAY_CYCLES)
+        {
+            delay = MIN_DELAY_CYCLES;
+            ++late_edges_;
+        }
+        word = encode(uint32_t(delay), next_state_);
+        cycle_ += delay;
+        port_state_ = next_state_;
+        pending_ = false;
+        return true;
+    }
+
+/**
+ * \brief true if the queued write still has words to pop.
+ */
+    bool pending() const
+    {return pending_;}
+
+/**
+ * \brief state of the port pins after the last popped word.
+ */
+    uint32_t port_state() const
+    {return port_state_;}
+
+/**
+ * \brief cycle (since the origin) of the pin write of the last popped word.
+ */
+    uint64_t cycle() const
+    {return cycle_;}
+
+/**
+ * \brief system time of the pin write of the last popped word, rounded
+ *  down to the microsecond.
+ */
+    uint32_t time_us() const
+    {
+        uint64_t seconds = cycle_ / clock_hz_;
+        uint64_t remainder = cycle_ % clock_hz_;
+        return origin_us_ + uint32_t(seconds * 1'000'000
+                                     + (remainder * 1'000'000) / clock_hz_);
+    }
+
+/**
+ * \brief number of writes that were due too early to happen on time.
+ */
+    uint32_t late_edges() const
+    {return late_edges_;}
+
+    static constexpr uint32_t encode(uint32_t delay_cycles, uint32_t state)
+    {return (delay_cycles - OVERHEAD_CYCLES) | (state << DELAY_BITS);}
+
+/**
+ * \brief cycles from the previous pin write to the one of \p word.
+ */
+    static constexpr uint32_t word_delay_cycles(uint32_t word)
+    {return (word & ((1u << DELAY_BITS) - 1)) + OVERHEAD_CYCLES;}
+
+/**
+ * \brief state of the port pins that \p word writes.
+ */
+    static constexpr uint32_t word_state(uint32_t word)
+    {return word >> DELAY_BITS;}
+
+private:
+/**
+ * \brief cycles in \p time_us, without overflowing for long schedules.
+ */
+    uint64_t to_cycles(uint64_t time_us) const
+    {
+        return (time_us / 1'000'000) * clock_hz_
+               + ((time_us % 1'000'000) * clock_hz_) / 1'000'000;
+    }
+
+    uint32_t clock_hz_ = 125'000'000;
+    uint32_t origin_us_ = 0;
+    uint32_t last_time_us_ = 0; /// time of the last write pushed.
+    uint64_t elapsed_us_ = 0; /// from the origin to last_time_us_.
+    uint64_t cycle_ = 0;
+    uint64_t target_cycle_ = 0; /// cycle of the queued write.
+    uint32_t port_state_ = 0;
+    uint32_t next_state_ = 0;
+    bool pending_ = false;
+    uint32_t late_edges_ = 0;
+};
+
+#endif // PIO_EDGE_ENCODER_H
@@ -0,0 +1,121 @@
+#ifndef PIO_OUTPUT_H
+#define PIO_OUTPUT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <config.h>
+#include <pio_edge_encoder.h>
+#include <output_event_log.h>
+#include <spsc_ring.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#include <hardware/clocks.h>
+#include <hardware/timer.h>
+
+/**
+ * \brief what applies the scheduler's port writes.
+ */
+enum class output_engine_t: uint8_t
+{
+    ALARM = 0, /// the alarm ISR. Edges jitter with interrupt latency.
+    PIO = 1, /// a PIO state machine. Edges land on their system clock cycle.
+};
+
+/**
+ * \brief play timed port writes through a PIO state machine instead of the
+ *  alarm ISR.
+ * \details Writes are encoded (see PioEdgeEncoder) into a RAM ring that a DMA
+ *  channel feeds to the state machine's TX FIFO. The state machine times
+ *  every write in system clock cycles and writes all port pins at once, so
+ *  edges do not depend on interrupt latency and the CPU only tops up the
+ *  ring. A DMA transfer cannot be extended while it runs, so service()
+ *  restarts the channel with everything encoded since whenever it finishes.
+ *  The state machine needs the next word before it applies the current one.
+ *  If it runs dry, all later writes are late, which service() reports.
+ */
+class PioOutput
+{
+public:
+    using Encoder = PioEdgeEncoder<NUM_GPIOS>;
+    static constexpr size_t RING_WORDS =
+        (1u << PIO_OUTPUT_RING_BITS) / sizeof(uint32_t);
+
+/**
+ * \brief take over the pins in \p pin_mask and write \p port_state to them
+ *  at \p start_time_us.
+ * \details The pins keep their current levels until then. Pad overrides
+ *  (inverted outputs, closed gates) still apply.
+ * \returns false if the PIO or DMA hardware could not be claimed.
+ */
+    bool start(uint32_t pin_mask, uint32_t port_state, uint32_t start_time_us);
+
+/**
+ * \brief stop writing and hand the pins back to the SIO.
+ */
+    void stop();
+
+    bool running() const
+    {return running_;}
+
+/**
+ * \brief true if push() will take another write.
+ */
+    bool ready()
+    {
+        fill_ring();
+        return !encoder_.pending();
+    }
+
+/**
+ * \brief queue a write of \p state to the pins in \p mask at \p time_us.
+ *  Times must not decrease.
+ * \returns false if the last write is still waiting for room in the ring.
+ */
+    bool push(uint32_t mask, uint32_t state, uint32_t time_us);
+
+/**
+ * \brief move encoded words into the ring, restart the DMA channel if it ran
+ *  out, and log the writes that have happened.
+ * \returns false if the state machine ran out of words since the last call,
+ *  i.e. the writes after that point are late.
+ */
+    bool service();
+
+/**
+ * \brief true once every queued write has happened.
+ */
+    bool idle();
+
+private:
+/**
+ * \brief encode the queued write into the ring as far as it fits.
+ */
+    void fill_ring();
+
+/**
+ * \brief number of ring words that the DMA channel has read.
+ */
+    uint32_t words_read() const
+    {return words_sent_ - dma_hw->ch[dma_chan_].transfer_count;}
+
+    alignas(1u << PIO_OUTPUT_RING_BITS) uint32_t ring_[RING_WORDS];
+    Encoder encoder_;
+    // Writes that were encoded but have not happened yet, for the output
+    // event log. Each write takes at least one ring word.
+    SPSCRing<OutputEvent, RING_WORDS> unlogged_;
+    PIO pio_ = pio1;
+    int sm_ = -1;
+    int program_offset_ = -1;
+    int dma_chan_ = -1;
+    bool running_ = false;
+    uint32_t pin_mask_ = 0;
+    uint32_t words_written_ = 0; /// into the ring.
+    uint32_t words_sent_ = 0; /// handed to the DMA channel.
+    uint32_t written_until_us_ = 0; /// time of the last write in the ring.
+    uint32_t sent_until_us_ = 0; /// time of the last write handed to DMA.
+    uint16_t program_instr_[3];
+};
+
+extern PioOutput pio_output;
+
+#endif // PIO_OUTPUT_H
@@ -0,0 +1,97 @@
+#ifndef PORT_LAYOUT_H
+#define PORT_LAYOUT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include <static_for.h>
+
+/**
+ * \brief compile-time description of a port of contiguous GPIO pins.
+ * \tparam NUM_CHANNELS number of pins in the port.
+ * \tparam PIN_BASE first GPIO pin of the port.
+ */
+template <size_t NUM_CHANNELS_, size_t PIN_BASE_>
+struct PortLayout
+{
+    static_assert(NUM_CHANNELS_ > 0, "Port must have at least one channel.");
+    static_assert(NUM_CHANNELS_ <= 32, "Port must fit in one register.");
+    static_assert(NUM_CHANNELS_ + PIN_BASE_ <= 30, "RP2040 has 30 GPIO pins.");
+
+    static constexpr size_t NUM_CHANNELS = NUM_CHANNELS_;
+    static constexpr size_t PIN_BASE = PIN_BASE_;
+    static constexpr uint32_t MASK =
+        uint32_t((uint64_t(1) << NUM_CHANNELS) - 1) << PIN_BASE;
+
+/**
+ * \brief smallest unsigned type that holds one bit per channel. Harp port
+ *  registers use this type.
+ */
+    using port_t = std::conditional_t<(NUM_CHANNELS <= 8), uint8_t,
+                   std::conditional_t<(NUM_CHANNELS <= 16), uint16_t,
+                                      uint32_t>>;
+
+    // Raw GPIO interrupt state is split across 4 INTR registers with 8 GPIOs
+    // (4 flags each) per register.
+    static constexpr size_t PINS_PER_INTR_REG = 8;
+    static constexpr size_t FIRST_INTR_REG = PIN_BASE / PINS_PER_INTR_REG;
+    static constexpr size_t LAST_INTR_REG =
+        (PIN_BASE + NUM_CHANNELS - 1) / PINS_PER_INTR_REG;
+    static constexpr size_t NUM_INTR_REGS = LAST_INTR_REG - FIRST_INTR_REG + 1;
+
+/**
+ * \brief edge flags that belong to port pins in INTR register \p reg.
+ * \note for the 8-channel port on GPIO 8-15 this is a single full register.
+ */
+    static constexpr uint32_t intr_edge_mask(size_t reg)
+    {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < PINS_PER_INTR_REG; ++i)
+        {
+            size_t pin = reg * PINS_PER_INTR_REG + i;
+            if ((pin >= PIN_BASE) && (pin < PIN_BASE + NUM_CHANNELS))
+                mask |= 0b1100u << (i * 4); // EDGE_HIGH, EDGE_LOW flags.
+        }
+        return mask;
+    }
+
+    static inline port_t to_port(uint32_t gpio_mask)
+    {return port_t(gpio_mask >> PIN_BASE);}
+
+    static inline uint32_t to_gpio(port_t port_mask)
+    {return uint32_t(port_mask) << PIN_BASE;}
+
+/**
+ * \brief split the raw edge interrupt state of the port into rising and
+ *  falling edge masks (in GPIO bit positions) and clear it.
+ * \param intr the (io_bank0_hw) INTR register array.
+ * \details Registers and pins are walked with compile-time indices, so this
+ *  compiles down to one read, a fixed set of shift/mask/or ops, and one
+ *  clearing write per INTR register that the port touches.
+ */
+    static inline void read_and_clear_edges(volatile uint32_t* intr,
+                                            uint32_t& rise_pins,
+                                            uint32_t& fall_pins)
+    {
+        rise_pins = 0;
+        fall_pins = 0;
+        static_for<NUM_INTR_REGS>([&](auto r)
+        {
+            constexpr size_t reg = FIRST_INTR_REG + r;
+            constexpr uint32_t edge_mask = intr_edge_mask(reg);
+            uint32_t intr_state = intr[reg];
+            static_for<PINS_PER_INTR_REG>([&](auto i)
+            {
+                if constexpr (((edge_mask >> (i * 4)) & 0b1100u) != 0)
+                {
+                    constexpr size_t pin = reg * PINS_PER_INTR_REG + i;
+                    rise_pins |= ((intr_state >> (i * 4 + 3)) & 1u) << pin;
+                    fall_pins |= ((intr_state >> (i * 4 + 2)) & 1u) << pin;
+                }
+            });
+            // Clear by "writing a 1" to the set bits.
+            intr[reg] = edge_mask;
+        });
+    }
+};
+
+#endif // PORT_LAYOUT_H
@@ -0,0 +1,81 @@
+#ifndef PORT_SAMPLER_H
+#define PORT_SAMPLER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <config.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/clocks.h>
+#include <hardware/timer.h>
+
+/**
+ * \brief sample a group of consecutive pins at a fixed rate into a RAM ring.
+ * \details The SIO is not reachable by DMA, so a single-instruction PIO
+ *  program paces the sampling (one `in pins` per clock divider period) and a
+ *  DMA channel drains its RX FIFO into the ring. A second DMA channel
+ *  re-triggers the first one whenever its transfer count runs out, so sampling
+ *  never stops on its own. Each sample is one word with pin_base in bit 0.
+ */
+class PortSampler
+{
+public:
+    static constexpr size_t RING_SAMPLES =
+        (1u << LOGIC_ANALYZER_RING_BITS) / sizeof(uint32_t);
+
+/**
+ * \brief start sampling \p num_pins pins from \p pin_base at (close to)
+ *  \p rate_hz.
+ * \returns the sample rate in use [Hz], or 0 if sampling could not start.
+ */
+    uint32_t start(uint32_t pin_base, uint32_t num_pins, uint32_t rate_hz);
+
+    void stop();
+
+    bool running() const
+    {return running_;}
+
+/**
+ * \brief the number of samples written into the ring since starting.
+ * \note must be called at least once every 2^32 samples.
+ */
+    uint64_t samples_written();
+
+/**
+ * \brief sample \p index, which must be one of the last RING_SAMPLES written.
+ */
+    const uint32_t* sample(uint64_t index) const
+    {return &ring_[index & (RING_SAMPLES - 1)];}
+
+/**
+ * \brief the number of samples from \p index to the end of the ring buffer
+ *  (before wrapping around to its start).
+ */
+    static size_t contiguous_samples(uint64_t index)
+    {return RING_SAMPLES - (index & (RING_SAMPLES - 1));}
+
+/**
+ * \brief system time [us] when sample \p index was taken.
+ */
+    uint64_t sample_time_us(uint64_t index) const
+    {return start_time_us_ + (index * clkdiv_q8_) / cycles_per_us_q8_;}
+
+private:
+    static constexpr uint32_t TRANSFER_COUNT = 0xFFFFFFFF;
+
+    alignas(1u << LOGIC_ANALYZER_RING_BITS) uint32_t ring_[RING_SAMPLES];
+    uint32_t transfer_count_reload_ = TRANSFER_COUNT; /// read by ctrl channel.
+    PIO pio_ = pio0;
+    int sm_ = -1;
+    int program_offset_ = -1;
+    int data_chan_ = -1;
+    int ctrl_chan_ = -1;
+    bool running_ = false;
+    uint32_t last_transfer_count_;
+    uint64_t samples_written_;
+    uint64_t start_time_us_;
+    uint32_t clkdiv_q8_; /// sample period in 1/256ths of a system clock cycle.
+    uint32_t cycles_per_us_q8_;
+    uint16_t program_instr_;
+};
+
+#endif // PORT_SAMPLER_H
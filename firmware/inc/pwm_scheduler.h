@@ -4,19 +4,47 @@
 #include <pico/stdlib.h>
 #include <hardware/irq.h>
 #include <pwm_task.h>
+#include <schedule_feasibility.h>
+#include <output_event_log.h>
+#include <waveform_stream.h>
+#include <pio_output.h>
+#include <static_for.h>
 #include <etl/priority_queue.h>
 #include <etl/deque.h>
+#include <etl/vector.h>
 #include <hardware/timer.h>
 #ifdef DEBUG
     #include <cstdio> // for printf
 #endif
+#ifdef PROFILE_CPU
+    #include <isr_latency_probe.h>
+#endif
 
-#define NUM_ENTRIES (64)
-#define NUM_TTL_IOS (8)
-
+// Declare friend function prototypes.
+void handle_missed_deadline();
+void sync_schedule();
 
+/**
+ * \brief schedules PWMTasks on a port and applies their combined output
+ *  through a hardware alarm, or through the PIO output engine.
+ * \details An output can be driven by several tasks: its own task and the
+ *  overlays that follow it in pwm_tasks_. Their levels are folded in that
+ *  order with each overlay's combine_op_t as PortEvents are computed, so the
+ *  ISR still applies a single port write. Tasks with the same fixed timing
+ *  are coalesced as the schedule starts: the first of them drives all of
+ *  their pins, so each of their edges costs one task update.
+ * \tparam NUM_CHANNELS maximum number of PWMTasks (1 per output channel, plus
+ *  overlays).
+ * \tparam LOOKAHEAD_DEPTH number of PortEvents that can be precomputed ahead
+ *  of the alarm ISR.
+ * \note the scheduler claims a single hardware alarm shared by all
+ *  instances of the same template, so only one instance should exist.
+ */
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH = NUM_CHANNELS>
 class PWMScheduler
 {
+    static_assert(NUM_CHANNELS <= 32,
+                  "update() tracks the tasks in a PortEvent with a 32-bit mask.");
 public:
 
 /**
@@ -38,6 +66,23 @@ public:
                            uint32_t t_period_us, uint32_t pin_mask,
                            uint32_t count, bool invert);
     void schedule_pwm_task(PWMTask& task);
+    void schedule_pwm_task(const pwm_task_spec_t& spec);
+
+/**
+ * \brief remove an uploaded PWMTask that is an overlay.
+ * \note only while stopped. References to other PWMTasks are invalidated.
+ */
+    void remove_pwm_task(PWMTask& task);
+
+/**
+ * \brief copy the settings of all uploaded PWMTasks into \p specs.
+ */
+    void save_tasks(etl::ivector<pwm_task_spec_t>& specs) const;
+
+/**
+ * \brief replace all uploaded PWMTasks with tasks created from \p specs.
+ */
+    void load_tasks(const etl::ivector<pwm_task_spec_t>& specs);
 /**
  * \brief cancel any active alarms and clear the queue.
  */
@@ -60,12 +105,78 @@ public:
  *  needs to be updated.
  */
     bool finished()
-    {return port_event_queue_.empty() && !alarm_queued_;}
+    {
+        return port_event_queue_.empty() && !alarm_queued_ && !stream_late_
+               && !suspended_outputs_
+               && (!pio_running_ || (pq_.empty() && pio_output.idle()));
+    }
+
+/**
+ * \brief play records from the waveform_stream ring instead of the
+ *  PWMTasks. The alarm ISR pops records directly; update() only checks that
+ *  the stream is keeping up. Only change this while stopped.
+ */
+    inline void set_stream_mode(bool enabled)
+    {streaming_ = enabled;}
+
+    inline bool stream_mode() const
+    {return streaming_;}
+
+/**
+ * \brief apply PortEvents through the alarm ISR or the PIO output engine.
+ *  Only change this while stopped.
+ * \details Schedules that the PIO engine cannot play (see pio_compatible())
+ *  and streams fall back to the alarm ISR.
+ */
+    inline void set_output_engine(output_engine_t engine)
+    {output_engine_ = engine;}
+
+    inline output_engine_t output_engine() const
+    {return output_engine_;}
+
+/**
+ * \brief true if the PIO engine can play the uploaded PWMTasks. Words that
+ *  it was given cannot be taken back, which FREEZE gates and phase locks
+ *  rely on.
+ */
+    bool pio_compatible() const;
+
+/**
+ * \brief time from the call to start() to the start of the schedule.
+ * \details The PIO engine starts PIO_OUTPUT_START_LEAD_US late so that its
+ *  first words are queued before the state machine needs them.
+ */
+    inline uint32_t start_delay_us() const
+    {return pio_running_? PIO_OUTPUT_START_LEAD_US: 0;}
+
+/**
+ * \brief the hardware alarm that the scheduler claimed. -1 until the first
+ *  scheduler of this size is constructed.
+ */
+    static inline int32_t alarm_num()
+    {return alarm_num_;}
+
+/**
+ * \brief timer value when start() was last called.
+ */
+    inline uint32_t start_time_us() const
+    {return start_time_us_;}
+
+/**
+ * \brief fire the alarm \p lead_us early so that outputs change when they
+ *  are scheduled rather than one ISR entry later. Only change this while
+ *  stopped.
+ * \details The PIO engine times its own outputs, so it ignores this.
+ */
+    inline void set_alarm_lead_us(uint32_t lead_us)
+    {alarm_lead_us_ = lead_us;}
+
+    inline uint32_t alarm_lead_us() const
+    {return alarm_lead_us_;}
 
     inline void clear()
     {reset();}
 
-    friend void set_new_ttl_pin_state(void);
     friend void handle_missed_deadline();
     friend void sync_schedule();
 
@@ -77,15 +188,203 @@ public:
 
     void cancel_alarm();
 
+/**
+ * \brief alarm ISR. Applies the pending port state and re-arms itself with
+ *  the next queued PortEvent.
+ */
+    static void set_new_ttl_pin_state();
+
+/**
+ * \brief (alarm ISR) take the next records off the stream and arm the alarm
+ *  for the first one. Records due sooner than the ISR could fire again (i.e:
+ *  deltas below its latency) are applied here and now instead of being
+ *  reported late.
+ */
+    static void play_stream_records();
+
+/**
+ * \brief fire task updates that fall within \p tolerance_us of each other as
+ *  a single PortEvent (at the earliest of their times). Tasks keep their own
+ *  time base, so merging does not accumulate drift.
+ */
+    inline void set_merge_tolerance_us(uint32_t tolerance_us)
+    {merge_tolerance_us_ = tolerance_us;}
+
+    inline uint32_t merge_tolerance_us() const
+    {return merge_tolerance_us_;}
+
+/**
+ * \brief apply changes of the gate inputs to gated PWMTasks. Outputs behind
+ *  a closed gate are held idle at the pad right away. FREEZE gates also pause
+ *  (or resume) their task, which recomputes the queued PortEvents.
+ * \returns true if any gated output opened or closed.
+ * \note call often while running. The time between calls adds to the gate
+ *  latency. Gates do not apply to streamed records.
+ */
+    bool update_gates();
+
+/**
+ * \brief pin mask of the outputs that are gated in the running schedule.
+ */
+    inline uint32_t gated_outputs() const
+    {return gated_outputs_;}
+
+/**
+ * \brief pin mask of the gated outputs whose gate is open.
+ */
+    inline uint32_t open_gated_outputs() const
+    {return gates_open_;}
+
+/**
+ * \brief re-anchor the phase-locked PWMTasks whose reference input changed
+ *  at \p time_us (in the direction given by \p rise_pins and \p fall_pins).
+ * \details Tasks that drifted away from the reference shift their remaining
+ *  edges, which recomputes the queued PortEvents. An edge that would have to
+ *  move into the past moves a whole cycle later instead. Tracking tasks also
+ *  adjust their period.
+ * \note Phase locks do not apply to streamed records.
+ */
+    void lock_phase(uint32_t rise_pins, uint32_t fall_pins, uint32_t time_us);
+
+/**
+ * \brief drop the lock of phase-locked outputs whose reference stopped.
+ *  Call often while running.
+ */
+    void check_phase_locks();
+
+/**
+ * \brief pin mask of the outputs that are phase-locked in the running
+ *  schedule.
+ */
+    inline uint32_t phase_locked_outputs() const
+    {return phase_locked_outputs_;}
+
+/**
+ * \brief pin mask of the phase-locked outputs that have acquired the lock.
+ */
+    inline uint32_t locked_outputs() const
+    {return locked_outputs_;}
+
+    inline const phase_lock_stats_t& phase_lock_stats() const
+    {return phase_lock_stats_;}
+
+/**
+ * \brief pin mask of the outputs that another PWMTask drives in the running
+ *  schedule because their timing is the same.
+ */
+    inline uint32_t coalesced_outputs() const
+    {return coalesced_outputs_;}
+
+/**
+ * \brief check that the uploaded PWMTasks can be executed on time.
+ * \param params limits to check against. The lookahead depth and merge
+ *  tolerance are filled in by the scheduler, and the per-edge cost is raised
+ *  to the worst cost of update() measured so far.
+ */
+    feasibility_report_t analyze(feasibility_params_t params);
+
 /**
  * \brief absolute time before which the priority queue needs to be updated.
  */
     uint64_t next_update_time_us_;
 
 private:
-    etl::vector<PWMTask, NUM_TTL_IOS> pwm_tasks_; // Container to hold PWMTasks.
-                                                  // We will access them
-                                                  // (usually) through the pq_;
+/**
+ * \brief rebuild the pq_ and the starting port state from the PWMTasks, e.g:
+ *  after their settings change.
+ */
+    void requeue_tasks();
+
+/**
+ * \brief levels of the outputs in \p pin_mask, with the levels of overlaid
+ *  tasks combined.
+ */
+    uint32_t combined_state(uint32_t pin_mask) const;
+
+/**
+ * \brief let the first of each set of tasks with the same fixed timing drive
+ *  the pins of the others, and leave the others out of the pq_.
+ * \details Pads of inverted outputs invert through their override, so tasks
+ *  coalesce regardless of inversion.
+ */
+    void coalesce_tasks();
+
+/**
+ * \brief true if \p task may drive, or be driven by, another task with the
+ *  same timing. Gates, phase locks, and overlays act on a task's own pins, and
+ *  random, ramped, or burst timing is not compared.
+ */
+    inline bool coalescible(const PWMTask& task) const
+    {
+        return !(task.pin_mask_ & overlaid_outputs_)
+               && !task.gate_.enabled() && !task.phase_lock_.enabled()
+               && !task.random_off_time_.enabled() && !task.ramp_.enabled()
+               && !task.burst_.enabled();
+    }
+
+/**
+ * \brief put every task that is neither done, paused by a gate, nor
+ *  coalesced into the pq_.
+ */
+    void queue_runnable_tasks();
+
+/**
+ * \brief read the gates of all tasks as the schedule starts. Outputs behind
+ *  closed gates are masked and tasks behind closed FREEZE gates are paused.
+ */
+    void start_gates(uint32_t start_time_us);
+
+/**
+ * \brief let all gated outputs follow their tasks again and forget the gate
+ *  state.
+ */
+    void stop_gates();
+
+/**
+ * \brief remember the nominal timing of phase-locked tasks and clear the
+ *  lock state and statistics as the schedule starts.
+ */
+    void start_phase_locks();
+
+/**
+ * \brief put phase-locked tasks back on their nominal timing.
+ */
+    void stop_phase_locks();
+
+/**
+ * \brief start time of the cycle that \p task is in or about to start.
+ */
+    static inline uint32_t cycle_start_us(const PWMTask& task)
+    {
+        return task.next_update_time_us_
+               - ((task.state_ == PWMTask::HIGH)? task.on_time_us_: 0);
+    }
+
+/**
+ * \brief drop the checkpoints of PortEvents that have been applied.
+ */
+    void trim_checkpoints(size_t unplayed_events);
+
+/**
+ * \brief discard the PortEvents that have not been applied yet and undo the
+ *  task updates that produced them.
+ * \details Tasks then resume from the first edge that was not applied.
+ */
+    void rewind();
+
+/**
+ * \brief the state of one task before an update that produced a queued
+ *  PortEvent.
+ */
+    struct task_checkpoint_t
+    {
+        uint8_t task; /// index into pwm_tasks_.
+        PWMTask::checkpoint_t state;
+    };
+
+    etl::vector<PWMTask, NUM_CHANNELS> pwm_tasks_; // Container to hold PWMTasks.
+                                                   // We will access them
+                                                   // (usually) through the pq_;
 /**
  * \brief the priority queue
  * \details We need to use references wrappers to access mutable versions of
@@ -93,15 +392,939 @@ private:
  *      implementation which returns const references to top().
  */
     etl::priority_queue<std::reference_wrapper<PWMTask>,
-                        NUM_ENTRIES,
-                        etl::vector<std::reference_wrapper<PWMTask>, NUM_ENTRIES>,
+                        NUM_CHANNELS,
+                        etl::vector<std::reference_wrapper<PWMTask>, NUM_CHANNELS>,
                         etl::greater<std::reference_wrapper<PWMTask>>> pq_;
 
+    uint32_t merge_tolerance_us_ = 0;
+    uint32_t max_edge_cost_us_ = 0; /// worst measured update() duration.
+    uint32_t overlaid_outputs_ = 0; /// pin mask of outputs with overlays.
+    uint32_t coalesced_outputs_ = 0;
+
+    // Gates. Pin masks unless noted otherwise.
+    uint32_t gate_input_mask_ = 0; /// gate inputs of all gated tasks.
+    uint32_t gate_levels_ = 0; /// last seen levels of the gate inputs.
+    uint32_t gated_outputs_ = 0;
+    uint32_t gates_open_ = 0;
+    uint32_t suspended_outputs_ = 0; /// tasks paused by a closed FREEZE gate.
+    uint32_t suspend_time_us_[NUM_CHANNELS]; /// per task, when it was paused.
+    bool track_checkpoints_ = false; /// true if any task has a FREEZE gate.
+    // Undo log for rewind(). Each PortEvent updates each task at most once.
+    etl::deque<task_checkpoint_t, (LOOKAHEAD_DEPTH + 1) * NUM_CHANNELS>
+        checkpoints_;
+    etl::deque<uint8_t, LOOKAHEAD_DEPTH + 1> checkpoints_per_event_;
+
+    // Phase locks. Pin masks unless noted otherwise.
+    uint32_t phase_locked_outputs_ = 0;
+    uint32_t locked_outputs_ = 0;
+    phase_lock_stats_t phase_lock_stats_{};
+    uint32_t phase_errors_ = 0; /// errors included in the statistics.
+    uint64_t abs_phase_error_sum_us_ = 0;
+
+    output_engine_t output_engine_ = output_engine_t::ALARM;
+    bool pio_running_ = false; /// true if the PIO engine plays this run.
+    uint32_t start_time_us_ = 0;
+
 private:
     static volatile int32_t alarm_num_;
-    static etl::deque<PortEvent, NUM_TTL_IOS> port_event_queue_;
+    static etl::deque<PortEvent, LOOKAHEAD_DEPTH> port_event_queue_;
     static volatile uint32_t next_gpio_port_state_;
     static volatile uint32_t next_gpio_port_mask_;
     static volatile bool alarm_queued_;
+    static volatile bool streaming_;
+    static volatile bool stream_late_; /// a record was overdue when popped.
+    static uint32_t stream_time_us_; /// time of the pending stream record.
+    static volatile uint32_t alarm_lead_us_;
+    static volatile uint32_t closed_gated_outputs_; /// held idle at the pad.
+
+/**
+ * \brief log the PortEvent just written, minus the outputs that a closed gate
+ *  holds idle at the pad.
+ */
+    static inline void log_port_event()
+    {
+        uint32_t mask = next_gpio_port_mask_ & ~closed_gated_outputs_;
+        if (mask)
+            log_output_event(mask, next_gpio_port_state_);
+    }
+
+/**
+ * \brief alarm time for a PortEvent at \p time_us, \p now_us being the
+ *  timer's time: alarm_lead_us_ early, unless that has already passed.
+ */
+    static inline uint32_t alarm_time_with_lead_us(uint32_t time_us,
+                                                   uint32_t now_us)
+    {
+        uint32_t lead_us = alarm_lead_us_;
+        int32_t slack_us = int32_t(time_us - now_us);
+        if (int32_t(lead_us) >= slack_us)
+            lead_us = (slack_us > 1)? slack_us - 1: 0;
+        return time_us - lead_us;
+    }
 };
+
+// Define static variables. The ISR reads them, but like all writable data
+// they are in SRAM already, so they need no section attribute.
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile int32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::alarm_num_ = -1;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile bool
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::alarm_queued_ = false;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile uint32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::next_gpio_port_mask_ = 0;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile uint32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::next_gpio_port_state_ = 0;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile bool
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::streaming_ = false;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile bool
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::stream_late_ = false;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+uint32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::stream_time_us_ = 0;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile uint32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::alarm_lead_us_ = 0;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+volatile uint32_t
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::closed_gated_outputs_ = 0;
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+etl::deque<typename PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::PortEvent,
+           LOOKAHEAD_DEPTH>
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::port_event_queue_;
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::PWMScheduler()
+{
+    // Claim alarm via this function call so the pico sdk doesn't use it.
+    // Don't claim if it has already been claimed.
+    if (alarm_num_ < 0)
+        alarm_num_ = hardware_alarm_claim_unused(true); // required = true;
+    uint32_t irq_num = TIMER_IRQ_0 + alarm_num_; //hardware_alarm_irq_number(alarm_num_);
+    // Attach interrupt to function and enable interrupt.
+    irq_set_exclusive_handler(irq_num, set_new_ttl_pin_state);
+    irq_set_enabled(irq_num, true);
+    timer_hw->inte |= (1u << alarm_num_); // enable Alarm to trigger interrupt.
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::~PWMScheduler()
+{reset();}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::reset()
+{
+#if defined(DEBUG)
+        printf("Resetting PWMScheduler... (pq_ size: %d | pwm_tasks_ size: %d)\r\n",
+                pq_.size(), pwm_tasks_.size());
+#endif
+    cancel_alarm(); // Cancel any upcoming alarms.
+    pio_output.stop();
+    pio_running_ = false;
+    // Core0 (the ring's producer) drops unplayed stream records once it
+    // hears that we stopped.
+    stream_late_ = false;
+    stop_gates();
+    stop_phase_locks();
+    pq_.clear(); // Remove all tasks in the priority queue.
+    for (auto& task: pwm_tasks_)
+        task.release_pins();
+    pwm_tasks_.clear(); // Remove all scheduler tasks
+    port_event_queue_.clear(); // Remove all queued PortEvents
+    next_gpio_port_mask_ = 0;
+    next_gpio_port_state_ = 0;
+    overlaid_outputs_ = 0;
+    coalesced_outputs_ = 0;
+#if defined(DEBUG)
+        printf("Done resetting PWMScheduler.\r\n");
+#endif
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::schedule_pwm_task(PWMTask& task)
+{
+    schedule_pwm_task(task.delay_us_, task.on_time_us_, task.period_us_,
+                      task.pin_mask_, task.count_, task.invert_);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::schedule_pwm_task(
+    uint32_t delay_us, uint32_t t_on_us, uint32_t t_period_us,
+    uint32_t pin_mask, uint32_t count, bool invert)
+{
+    schedule_pwm_task(pwm_task_spec_t{delay_us, t_on_us, t_period_us,
+                                      pin_mask, count, invert});
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::schedule_pwm_task(
+    const pwm_task_spec_t& spec)
+{
+    // Create PWMTask and push into the vector.
+    pwm_tasks_.emplace_back(spec);
+    PWMTask& task = pwm_tasks_.back();
+    // Aggreggate initial pin state vector.
+    next_gpio_port_mask_ |= task.pin_mask_;
+    if (task.overlay_)
+        overlaid_outputs_ |= task.pin_mask_;
+    next_gpio_port_state_ = combined_state(next_gpio_port_mask_);
+    pq_.push(task); // PWMTasks are *sorted* since comparison is based on an
+                    // unspecified (and therefore relative) t=0 start time.
+#ifdef DEBUG
+    printf("Pushed PWMTask: (%d, %d, %d, 0x%08x)\r\n", task.delay_us_,
+           task.on_time_us_, task.period_us_, task.pin_mask_);
+#endif
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::remove_pwm_task(PWMTask& task)
+{
+    if (!task.overlay_)
+        return;
+    // The output's own task keeps driving the pins.
+    pwm_tasks_.erase(pwm_tasks_.begin() + (&task - pwm_tasks_.data()));
+    requeue_tasks();
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::save_tasks(
+    etl::ivector<pwm_task_spec_t>& specs) const
+{
+    specs.clear();
+    for (const auto& task: pwm_tasks_)
+        specs.push_back(task.spec());
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::load_tasks(
+    const etl::ivector<pwm_task_spec_t>& specs)
+{
+    reset();
+    for (const auto& spec: specs)
+        schedule_pwm_task(spec);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::start()
+{
+    // Note: schedule is pre-sorted and first GPIO state is pre-set.
+    // Save schedule start time.
+    uint32_t start_time_us = timer_hw->timerawl;
+    start_time_us_ = start_time_us;
+    // Drop an interrupt that a cancelled alarm may have left pending, so that
+    // only the alarms armed from here on can fire.
+    timer_hw->intr = (1u << alarm_num_);
+    irq_clear(TIMER_IRQ_0 + alarm_num_);
+    if (streaming_)
+    {
+        stream_late_ = false;
+        waveform_stream_underrun = false;
+        waveform_stream_played = 0;
+        StreamRecord record;
+        if (!waveform_stream.pop(record))
+        {
+            waveform_stream_underrun = true;
+            return; // Nothing to play. We are already finished().
+        }
+        // Leave the ISR enough time to arm the first record.
+        stream_time_us_ = start_time_us
+            + ((record.delta_us < MIN_EDGE_SPACING_US)? MIN_EDGE_SPACING_US
+                                                      : record.delta_us);
+        next_gpio_port_mask_ = record.mask;
+        next_gpio_port_state_ = record.state;
+        alarm_queued_ = true;
+        timer_hw->alarm[alarm_num_] =
+            alarm_time_with_lead_us(stream_time_us_, timer_hw->timerawl);
+        return;
+    }
+    coalesce_tasks();
+    // Hold outputs behind closed gates idle before they are driven.
+    start_gates(start_time_us);
+    start_phase_locks();
+    pio_running_ = (output_engine_ == output_engine_t::PIO)
+                   && pio_compatible();
+    if (pio_running_)
+    {
+        // The PIO engine applies the initial GPIO state when the schedule
+        // starts, after its first words are queued.
+        start_time_us += PIO_OUTPUT_START_LEAD_US;
+        pio_running_ = pio_output.start(next_gpio_port_mask_,
+                                        next_gpio_port_state_, start_time_us);
+    }
+    if (!pio_running_)
+    {
+        // Apply initial pending GPIO change immediately so the schedule
+        // starts now.
+        // Note: starting GPIO state was aggregated when we add each PWMTask.
+        gpio_put_masked(next_gpio_port_mask_,
+                        next_gpio_port_state_ );
+#if defined(DEBUG)
+        printf("GPIO Put: 0x%08x (mask), 0x%08x (val)\r\n",
+               next_gpio_port_mask_, next_gpio_port_state_);
+#endif
+    }
+    // Set starting time of all PWMTasks.
+    // Note that tasks are pre-sorted at this point bc they are sorted upon
+    //  being stored.
+    for (auto& task: pwm_tasks_)
+    {
+        task.reset(true); // Reset to starting state but do not drive pin output.
+        task.set_time_started(start_time_us);
+    }
+#if defined(DEBUG)
+    printf("Recording schedule start at : %lu\r\n", start_time_us);
+#endif
+    // Precompute a few updates back-to-back to populate the port event queue.
+    static_for<LOOKAHEAD_DEPTH>([&](auto){update();});
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::update()
+{
+    // The ISR feeds itself from the stream. Only report if it fell behind.
+    if (streaming_)
+    {
+        if (stream_late_)
+        {
+            stream_late_ = false;
+            handle_missed_deadline();
+        }
+        return;
+    }
+    // The PIO engine must be fed before it runs out of words.
+    if (pio_running_ && !pio_output.service())
+        handle_missed_deadline();
+    // Prevent queuing additional PortEvents until the queue has space.
+    // Bail early if there are no tasks in the first place.
+    if ((pio_running_? !pio_output.ready(): port_event_queue_.full())
+        || (pq_.size() == 0))
+        return;
+    uint32_t start_time_us = timer_hw->timerawl;
+#if defined(DEBUG)
+    printf("Updating schedule at : %lu\r\n", start_time_us);
+#endif
+    if (track_checkpoints_)
+        trim_checkpoints(port_event_queue_.size() + (alarm_queued_? 1: 0));
+    uint8_t num_updates = 0;
+    uint32_t updated_tasks = 0; /// mask of indices into pwm_tasks_.
+    uint32_t next_gpio_port_mask = 0;
+    uint32_t next_gpio_port_state = 0;
+    uint32_t next_task_update_time_us = pq_.top().get().next_update_time_us_;
+    for (size_t i = 0; i < NUM_CHANNELS; ++i)
+    {
+        // Pop the highest priority (must update soonest) PWM task.
+        PWMTask& pwm = pq_.top().get();
+        pq_.pop();
+        uint8_t task_index = uint8_t(&pwm - pwm_tasks_.data());
+        updated_tasks |= 1u << task_index;
+        // Keep what is needed to undo this update if a gate pauses a task.
+        if (track_checkpoints_)
+            checkpoints_.push_back({task_index, pwm.checkpoint()});
+        ++num_updates;
+        // Update this PWM state and the next time that it needs to be called.
+        // Skip gpio action since we will fire all pins of all PWMTasks at once.
+        pwm.update(true, true); // force = true; skip_output_action = true.
+        // Update the queued gpio port state;
+        next_gpio_port_mask |= pwm.drive_mask_;
+        if (pwm.state_ == PWMTask::update_state_t::HIGH)
+            next_gpio_port_state |= pwm.drive_mask_;
+        // Put this task back in the pq if it must be updated later.
+        if (pwm.requires_future_update())
+            pq_.push(pwm);
+        if (pq_.size() == 0)
+            break;
+        // Continue scheduling all PWM tasks that will fire simultaneously
+        // (or within the merge tolerance), but never the same task twice.
+        PWMTask& next_pwm = pq_.top().get();
+        if ((next_pwm.next_update_time_us_ - next_task_update_time_us
+             > merge_tolerance_us_)
+            || ((updated_tasks >> (&next_pwm - pwm_tasks_.data())) & 1u))
+            break;
+    }
+    // Overlaid outputs take the combined level of all of their tasks.
+    if (next_gpio_port_mask & overlaid_outputs_)
+        next_gpio_port_state = (next_gpio_port_state & ~overlaid_outputs_)
+            | combined_state(next_gpio_port_mask & overlaid_outputs_);
+    if (track_checkpoints_)
+        checkpoints_per_event_.push_back(num_updates);
+    // Hand the PortEvent to the PIO engine, or push into the queue if the ISR
+    // has been armed; after it will re-arm itself
+    if (pio_running_)
+        pio_output.push(next_gpio_port_mask, next_gpio_port_state,
+                        next_task_update_time_us);
+    else if (alarm_queued_)
+        port_event_queue_.emplace_front(next_gpio_port_mask, next_gpio_port_state,
+                                        next_task_update_time_us);
+    uint32_t& alarm_time_us = next_task_update_time_us; // alias for clarity.
+#if defined(DEBUG)
+    printf("Updating done at %lu. ISR set for %lu | Next update at : %lu\r\n",
+            timer_hw->timerawl, alarm_time_us, alarm_time_us);
+#endif
+    // Edge case: detect if we have fallen behind.
+    // Note: we can't really recover after falling behind once.
+    uint32_t timer_raw = timer_hw->timerawl;
+    // Keep track of the worst-case cost of computing one PortEvent.
+    if (timer_raw - start_time_us > max_edge_cost_us_)
+        max_edge_cost_us_ = timer_raw - start_time_us;
+    if (int32_t(timer_raw - alarm_time_us) > 0)
+    {
+#if defined(DEBUG)
+        printf("Deadline missed! Curr time: %lu | scheduled time: %lu | delta: %lu\r\n",
+               timer_raw, alarm_time_us, int32_t(timer_raw - alarm_time_us));
+#endif
+        handle_missed_deadline();
+    }
+    // If the ISR is working off of queued values, it will re-arm itself.
+    if (alarm_queued_ || pio_running_)
+        return;
+    // FIXME: make the ISR strictly work off values in the deque.
+    next_gpio_port_mask_ = next_gpio_port_mask;
+    next_gpio_port_state_ = next_gpio_port_state;
+    // Normal case: arm the alarm and let the interrupt apply the state change.
+    alarm_queued_ = true; // Do this first in case alarm fires immediately.
+    // Write time (also arms alarm), early by the alarm lead.
+    timer_hw->alarm[alarm_num_] = alarm_time_with_lead_us(alarm_time_us,
+                                                          timer_raw);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::stop()
+{
+    cancel_alarm(); // Cancel any upcoming alarms.
+    // Unplayed records belong to the stopped stream. Core0 (the ring's
+    // producer) drops them once it hears that we stopped, so that it never
+    // races with us over records for the next stream.
+    stream_late_ = false;
+    port_event_queue_.clear(); // Remove all queued PortEvents
+    pio_output.stop(); // Hand the pins back to the SIO.
+    pio_running_ = false;
+    for (auto& task: pwm_tasks_)
+        task.stop(); // Kill GPIO output.
+    stop_gates();
+    stop_phase_locks();
+    requeue_tasks();
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::requeue_tasks()
+{
+    pq_.clear();
+    next_gpio_port_mask_ = 0;
+    overlaid_outputs_ = 0;
+    coalesced_outputs_ = 0;
+    // Reset all pwm tasks and reinsert them into the pq_ as if we were
+    // inserting them for the first time.
+    for (auto& task: pwm_tasks_)
+    {
+        task.reset(true); // Clear internal counters. Do not drive GPIO.
+        task.drive_mask_ = task.pin_mask_;
+        next_gpio_port_mask_ |= task.pin_mask_;
+        if (task.overlay_)
+            overlaid_outputs_ |= task.pin_mask_;
+        pq_.push(task); // pushes task with unset "t=0" time.
+    }
+    next_gpio_port_state_ = combined_state(next_gpio_port_mask_);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+uint32_t PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::combined_state(
+    uint32_t pin_mask) const
+{
+    uint32_t state = 0;
+    for (const auto& task: pwm_tasks_)
+    {
+        uint32_t pins = task.pin_mask_ & pin_mask;
+        if (!pins)
+            continue;
+        uint32_t high = (task.state_ == PWMTask::HIGH)? pins: 0;
+        switch (task.combine_)
+        {
+            case combine_op_t::OR:
+                state |= high;
+                break;
+            case combine_op_t::AND:
+                state &= high | ~pins;
+                break;
+            case combine_op_t::XOR:
+                state ^= high;
+                break;
+            default:
+                state = (state & ~pins) | high;
+                break;
+        }
+    }
+    return state;
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::coalesce_tasks()
+{
+    coalesced_outputs_ = 0;
+    for (size_t i = 1; i < pwm_tasks_.size(); ++i)
+    {
+        PWMTask& task = pwm_tasks_[i];
+        if (!coalescible(task))
+            continue;
+        for (size_t j = 0; j < i; ++j)
+        {
+            PWMTask& driver = pwm_tasks_[j];
+            if (!driver.drive_mask_ || !coalescible(driver)
+                || (driver.delay_us_ != task.delay_us_)
+                || (driver.on_time_us_ != task.on_time_us_)
+                || (driver.period_us_ != task.period_us_)
+                || (driver.count_ != task.count_))
+                continue;
+            driver.drive_mask_ |= task.pin_mask_;
+            task.drive_mask_ = 0;
+            coalesced_outputs_ |= task.pin_mask_;
+            break;
+        }
+    }
+    if (coalesced_outputs_)
+        queue_runnable_tasks();
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::queue_runnable_tasks()
+{
+    pq_.clear();
+    for (auto& task: pwm_tasks_)
+    {
+        if (task.drive_mask_ && task.requires_future_update()
+            && !(task.pin_mask_ & suspended_outputs_))
+            pq_.push(task);
+    }
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::start_gates(
+    uint32_t start_time_us)
+{
+    stop_gates();
+    for (auto& task: pwm_tasks_)
+    {
+        if (!task.gate_.enabled())
+            continue;
+        gate_input_mask_ |= task.gate_.pin_mask();
+        gated_outputs_ |= task.pin_mask_;
+        track_checkpoints_ |= (task.gate_.mode() == OutputGate::FREEZE);
+    }
+    if (!gated_outputs_)
+        return;
+    gate_levels_ = gpio_get_all() & gate_input_mask_;
+    for (auto& task: pwm_tasks_)
+    {
+        if (!task.gate_.enabled())
+            continue;
+        bool open = task.gate_.open(gate_levels_);
+        task.set_gate_override(open);
+        if (open)
+            gates_open_ |= task.pin_mask_;
+        else if (task.gate_.mode() == OutputGate::FREEZE)
+            suspended_outputs_ |= task.pin_mask_;
+    }
+    closed_gated_outputs_ = gated_outputs_ & ~gates_open_;
+    if (!suspended_outputs_)
+        return;
+    // A closed FREEZE gate pauses the overlays of its output too.
+    for (size_t i = 0; i < pwm_tasks_.size(); ++i)
+    {
+        if (pwm_tasks_[i].pin_mask_ & suspended_outputs_)
+            suspend_time_us_[i] = start_time_us;
+    }
+    queue_runnable_tasks();
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::stop_gates()
+{
+    for (auto& task: pwm_tasks_)
+    {
+        if (task.pin_mask_ & gated_outputs_)
+            task.set_gate_override(true);
+    }
+    gate_input_mask_ = 0;
+    gate_levels_ = 0;
+    gated_outputs_ = 0;
+    gates_open_ = 0;
+    closed_gated_outputs_ = 0;
+    suspended_outputs_ = 0;
+    track_checkpoints_ = false;
+    checkpoints_.clear();
+    checkpoints_per_event_.clear();
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+bool PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::update_gates()
+{
+    if (!gated_outputs_)
+        return false;
+    uint32_t gate_levels = gpio_get_all() & gate_input_mask_;
+    if (gate_levels == gate_levels_)
+        return false;
+    uint32_t now_us = timer_hw->timerawl;
+    gate_levels_ = gate_levels;
+    uint32_t gates_open = 0;
+    uint32_t frozen_changes = 0;
+    for (auto& task: pwm_tasks_)
+    {
+        if (!task.gate_.enabled())
+            continue;
+        bool open = task.gate_.open(gate_levels);
+        if (open)
+            gates_open |= task.pin_mask_;
+        if (open == bool(gates_open_ & task.pin_mask_))
+            continue;
+        // Mask (or unmask) the pads first. Pausing the task can follow.
+        task.set_gate_override(open);
+        if (task.gate_.mode() == OutputGate::FREEZE)
+            frozen_changes |= task.pin_mask_;
+    }
+    bool changed = (gates_open != gates_open_);
+    gates_open_ = gates_open;
+    closed_gated_outputs_ = gated_outputs_ & ~gates_open;
+    if (!frozen_changes)
+        return changed;
+    // Paused tasks must not keep the edges they computed ahead of time.
+    rewind();
+    for (size_t i = 0; i < pwm_tasks_.size(); ++i)
+    {
+        PWMTask& task = pwm_tasks_[i];
+        if (!(task.pin_mask_ & frozen_changes))
+            continue;
+        if (gates_open & task.pin_mask_)
+        {
+            // Resume from the same phase.
+            if (suspended_outputs_ & task.pin_mask_)
+                task.postpone(now_us - suspend_time_us_[i]);
+            suspended_outputs_ &= ~task.pin_mask_;
+        }
+        else if (task.requires_future_update())
+        {
+            suspended_outputs_ |= task.pin_mask_;
+            suspend_time_us_[i] = now_us;
+        }
+    }
+    queue_runnable_tasks();
+    // Precompute a few updates back-to-back again, as start() does.
+    static_for<LOOKAHEAD_DEPTH>([&](auto){update();});
+    return changed;
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::start_phase_locks()
+{
+    phase_locked_outputs_ = 0;
+    locked_outputs_ = 0;
+    phase_lock_stats_ = phase_lock_stats_t();
+    phase_errors_ = 0;
+    abs_phase_error_sum_us_ = 0;
+    for (auto& task: pwm_tasks_)
+    {
+        if (!task.phase_lock_.enabled())
+            continue;
+        task.phase_lock_.restart(task.on_time_us_, task.period_us_);
+        phase_locked_outputs_ |= task.pin_mask_;
+    }
+    // Re-anchoring rewinds queued PortEvents like a FREEZE gate does.
+    track_checkpoints_ |= bool(phase_locked_outputs_);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::stop_phase_locks()
+{
+    for (auto& task: pwm_tasks_)
+    {
+        if (!(task.pin_mask_ & phase_locked_outputs_))
+            continue;
+        task.on_time_us_ = task.phase_lock_.nominal_on_time_us();
+        task.period_us_ = task.phase_lock_.nominal_period_us();
+    }
+    phase_locked_outputs_ = 0;
+    locked_outputs_ = 0;
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::lock_phase(
+    uint32_t rise_pins, uint32_t fall_pins, uint32_t time_us)
+{
+    if (!phase_locked_outputs_)
+        return;
+    uint32_t now_us = timer_hw->timerawl;
+    bool reference_edge = false;
+    bool rewound = false;
+    for (auto& task: pwm_tasks_)
+    {
+        PhaseLock& lock = task.phase_lock_;
+        if (!lock.enabled() || !lock.reference_edge(rise_pins, fall_pins))
+            continue;
+        reference_edge = true;
+        uint32_t period_us = task.period_us_;
+        lock.add_reference_edge(time_us);
+        // Paused and finished tasks only keep measuring the reference.
+        if (!task.requires_future_update()
+            || (task.pin_mask_ & suspended_outputs_))
+            continue;
+        // Edges computed ahead of time are on the same grid as the first
+        // unapplied one, so the error can be measured before rewinding.
+        uint32_t anchor_us = time_us + lock.delay_us();
+        int32_t error_us = PhaseLock::phase_error_us(anchor_us,
+                                                     cycle_start_us(task),
+                                                     period_us);
+        if (lock.add_phase_error(error_us))
+            locked_outputs_ ^= task.pin_mask_;
+        phase_lock_stats_.last_error_us = error_us;
+        if ((phase_errors_ == 0) || (error_us < phase_lock_stats_.min_error_us))
+            phase_lock_stats_.min_error_us = error_us;
+        if ((phase_errors_ == 0) || (error_us > phase_lock_stats_.max_error_us))
+            phase_lock_stats_.max_error_us = error_us;
+        ++phase_errors_;
+        abs_phase_error_sum_us_ += (error_us < 0)? -error_us: error_us;
+        if ((error_us == 0) && (lock.period_us() == period_us))
+            continue;
+        if (!rewound)
+        {
+            rewind();
+            rewound = true;
+        }
+        // Move the cycle of the first unapplied edge onto the new grid.
+        uint32_t cycle_us = cycle_start_us(task);
+        task.on_time_us_ = lock.on_time_us();
+        task.period_us_ = lock.period_us();
+        cycle_us += PhaseLock::phase_error_us(anchor_us, cycle_us,
+                                              task.period_us_);
+        uint32_t next_update_time_us = cycle_us
+            + ((task.state_ == PWMTask::HIGH)? task.on_time_us_: 0);
+        if (int32_t(next_update_time_us - now_us) < int32_t(MIN_EDGE_SPACING_US))
+            next_update_time_us += task.period_us_;
+        task.postpone(next_update_time_us - task.next_update_time_us_);
+    }
+    if (reference_edge)
+    {
+        ++phase_lock_stats_.reference_edges;
+        phase_lock_stats_.mean_abs_error_us = phase_errors_?
+            uint32_t(abs_phase_error_sum_us_ / phase_errors_): 0;
+    }
+    for (const auto& task: pwm_tasks_)
+    {
+        if (task.pin_mask_ & phase_locked_outputs_)
+        {
+            phase_lock_stats_.reference_period_us =
+                task.phase_lock_.reference_period_us();
+            break;
+        }
+    }
+    if (!rewound)
+        return;
+    queue_runnable_tasks();
+    // Precompute a few updates back-to-back again, as start() does.
+    static_for<LOOKAHEAD_DEPTH>([&](auto){update();});
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::check_phase_locks()
+{
+    if (!locked_outputs_)
+        return;
+    uint32_t now_us = timer_hw->timerawl;
+    for (auto& task: pwm_tasks_)
+    {
+        if ((task.pin_mask_ & locked_outputs_)
+            && task.phase_lock_.check_reference(now_us))
+            locked_outputs_ &= ~task.pin_mask_;
+    }
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::trim_checkpoints(
+    size_t unplayed_events)
+{
+    while (checkpoints_per_event_.size() > unplayed_events)
+    {
+        for (size_t i = checkpoints_per_event_.front(); i > 0; --i)
+            checkpoints_.pop_front();
+        checkpoints_per_event_.pop_front();
+    }
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::rewind()
+{
+    uint32_t interrupts = save_and_disable_interrupts();
+    bool armed = alarm_queued_;
+    cancel_alarm();
+    // Apply the armed PortEvent ourselves if it is due, since its interrupt
+    // may be pending.
+    if (armed && (int32_t(timer_hw->timerawl - timer_hw->alarm[alarm_num_])
+                  >= 0))
+    {
+        gpio_put_masked(next_gpio_port_mask_, next_gpio_port_state_);
+        log_port_event();
+        timer_hw->intr = (1u << alarm_num_);
+        irq_clear(TIMER_IRQ_0 + alarm_num_);
+        armed = false;
+    }
+    trim_checkpoints(port_event_queue_.size() + (armed? 1: 0));
+    port_event_queue_.clear();
+    // Undo the updates behind the discarded PortEvents, newest first.
+    while (!checkpoints_.empty())
+    {
+        const task_checkpoint_t& checkpoint = checkpoints_.back();
+        pwm_tasks_[checkpoint.task].restore(checkpoint.state);
+        checkpoints_.pop_back();
+    }
+    checkpoints_per_event_.clear();
+    restore_interrupts(interrupts);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+feasibility_report_t PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::analyze(
+    feasibility_params_t params)
+{
+    task_timing_t timings[NUM_CHANNELS];
+    size_t num_tasks = 0;
+    // Streamed records are timed by the PC. Uploaded PWMTasks are not played.
+    if (streaming_)
+    {
+        feasibility_report_t report{};
+        report.edge_cost_us = params.edge_cost_us;
+        return report;
+    }
+    for (const auto& task: pwm_tasks_)
+        // Check random and ramped timing at its shortest.
+        timings[num_tasks++] = {task.delay_us_, task.min_on_time_us(),
+                                task.min_on_time_us() + task.min_off_time_us(),
+                                task.total_cycles()};
+    params.lookahead_depth = LOOKAHEAD_DEPTH;
+    // The PIO engine re-arms itself within cycles and queues a ring of words.
+    if ((output_engine_ == output_engine_t::PIO) && pio_compatible())
+    {
+        params.min_edge_spacing_us = 1;
+        params.lookahead_depth = PioOutput::RING_WORDS;
+    }
+    params.merge_tolerance_us = merge_tolerance_us_;
+    if (max_edge_cost_us_ > params.edge_cost_us)
+        params.edge_cost_us = max_edge_cost_us_;
+    return analyze_schedule(timings, num_tasks, params);
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+bool PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::pio_compatible() const
+{
+    for (const auto& task: pwm_tasks_)
+    {
+        if ((task.gate_.mode() == OutputGate::FREEZE)
+            || task.phase_lock_.enabled())
+            return false;
+    }
+    return true;
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::cancel_alarm()
+{
+    timer_hw->armed |= (1u << alarm_num_);
+    alarm_queued_ = false;
+}
+
+// Put the ISR in RAM so as to avoid (slow) flash access.
+// Note: GCC ignores section attributes on template instantiations, so only
+// CUTTLEFISH_RAM_PROFILE, which runs the whole program from RAM, does that.
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void __not_in_flash("set_new_ttl_pin_state")
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::set_new_ttl_pin_state()
+{
+#if defined(PROFILE_CPU)
+    isr_latency_probe.record(timer_hw->alarm[alarm_num_]);
+#endif
+    // Apply the next GPIO state.
+    gpio_put_masked(next_gpio_port_mask_, next_gpio_port_state_);
+    // Record what we just wrote (and when) if requested.
+    log_port_event();
+    // Clear the latched hardware interrupt.
+    timer_hw->intr |= (1u << alarm_num_);
+
+    if (streaming_)
+    {
+        play_stream_records();
+        return;
+    }
+
+    // While the queue is non-empty, pop the next item and assign it to next_*
+    // values. Re-arm alarm.
+    while (!port_event_queue_.empty())
+    {
+        PortEvent& next_port_event = port_event_queue_.back();
+        next_gpio_port_mask_ = next_port_event.mask;
+        next_gpio_port_state_ = next_port_event.state;
+        uint32_t alarm_time_us =
+            alarm_time_with_lead_us(next_port_event.time_us,
+                                    timer_hw->timerawl);
+        // Remove the next port event from the queue.
+        port_event_queue_.pop_back();
+        // Re-arm alarm with the next time. An alarm time that has already
+        // passed would only match once the timer wraps.
+        timer_hw->alarm[alarm_num_] = alarm_time_us;
+        if (int32_t(timer_hw->timerawl - alarm_time_us) < 0)
+            return;
+        // We were held up past the alarm time, so its interrupt may be
+        // pending. Clear it and apply the PortEvent here.
+        timer_hw->armed = (1u << alarm_num_);
+        timer_hw->intr = (1u << alarm_num_);
+        irq_clear(TIMER_IRQ_0 + alarm_num_);
+        gpio_put_masked(next_gpio_port_mask_, next_gpio_port_state_);
+        log_port_event();
+    }
+    // main loop must re-arm alarm and populate next port state
+    alarm_queued_ = false;
+}
+
+template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
+void __not_in_flash("play_stream_records")
+    PWMScheduler<NUM_CHANNELS, LOOKAHEAD_DEPTH>::play_stream_records()
+{
+    while (true)
+    {
+        waveform_stream_played = waveform_stream_played + 1;
+        StreamRecord record;
+        if (!waveform_stream.pop(record))
+        {
+            alarm_queued_ = false;
+            waveform_stream_underrun = true;
+            return;
+        }
+        next_gpio_port_mask_ = record.mask;
+        next_gpio_port_state_ = record.state;
+        stream_time_us_ += record.delta_us;
+        int32_t slack_us = int32_t(stream_time_us_ - timer_hw->timerawl);
+        // The ISR itself was held up. Stop rather than play the stream late.
+        if (slack_us < -int32_t(MIN_EDGE_SPACING_US))
+        {
+            alarm_queued_ = false;
+            stream_late_ = true;
+            return;
+        }
+        if (slack_us >= int32_t(MIN_EDGE_SPACING_US))
+        {
+            uint32_t alarm_time_us =
+                alarm_time_with_lead_us(stream_time_us_, timer_hw->timerawl);
+            timer_hw->alarm[alarm_num_] = alarm_time_us;
+            if (int32_t(timer_hw->timerawl - alarm_time_us) < 0)
+                return;
+            // We were held up past the alarm time while arming it, so its
+            // interrupt may be pending. Clear it and apply the record here.
+            timer_hw->armed = (1u << alarm_num_);
+            timer_hw->intr = (1u << alarm_num_);
+            irq_clear(TIMER_IRQ_0 + alarm_num_);
+        }
+        // Fire now, at most MIN_EDGE_SPACING_US early, like an alarm that
+        // fires alarm_lead_us_ early.
+        gpio_put_masked(next_gpio_port_mask_, next_gpio_port_state_);
+        log_port_event();
+    }
+}
 #endif // PWM_SCHEDULER_H
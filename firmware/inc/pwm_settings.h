@@ -14,6 +14,103 @@ struct pwm_settings_t
     uint32_t period_us() const
     {return on_duration_us + off_duration_us;}
 };
+
+/**
+ * \brief random off times for the PWM output given by `channel`.
+ */
+struct pwm_random_settings_t
+{
+    uint8_t channel;
+    uint8_t distribution; // RandomInterval::distribution_t. 0 = fixed timing.
+    uint32_t seed; // 0 = pick a seed.
+    uint32_t mean_us;
+    uint32_t min_us;
+    uint32_t max_us;
+};
+
+/**
+ * \brief period and duty cycle sweep for the PWM output given by `channel`.
+ */
+struct pwm_ramp_settings_t
+{
+    uint8_t channel;
+    uint8_t profile; // PeriodRamp::profile_t. 0 = fixed timing.
+    uint32_t start_period_us;
+    uint32_t end_period_us;
+    uint16_t start_duty; // 0.01% units.
+    uint16_t end_duty; // 0.01% units.
+    uint32_t ramp_duration_us;
+};
+
+/**
+ * \brief groups the pulses of the PWM output given by `channel` into bursts
+ *  and the bursts into trains.
+ */
+struct pwm_burst_settings_t
+{
+    uint8_t channel;
+    uint32_t pulses_per_burst; // 0 = no bursts.
+    uint32_t burst_gap_us;
+    uint32_t bursts_per_train;
+    uint32_t train_gap_us;
+    uint32_t trains; // 0 = forever.
+};
+
+/**
+ * \brief gates the PWM output given by `channel` with the input given by
+ *  `gate_channel`.
+ */
+struct pwm_gate_settings_t
+{
+    uint8_t channel;
+    uint8_t gate_channel;
+    uint8_t mode; // OutputGate::mode_t. 0 = no gate.
+    uint8_t active_low; // 1 = the gate is open while the input is low.
+};
+
+/**
+ * \brief locks the phase of the PWM output given by `channel` to the edges of
+ *  the input given by `reference_channel`.
+ */
+struct pwm_phase_lock_settings_t
+{
+    uint8_t channel;
+    uint8_t reference_channel;
+    uint8_t mode; // PhaseLock::mode_t. 0 = no lock.
+    uint8_t falling_edge; // 1 = anchor on falling edges of the reference.
+    uint32_t delay_us; // from a reference edge to the start of a cycle.
+};
+
+/**
+ * \brief an extra pulse train whose level combines with the PWM output given
+ *  by `channel`. Overlays combine in the order they were added.
+ */
+struct pwm_overlay_settings_t
+{
+    uint8_t channel;
+    uint8_t overlay; // which of the channel's overlays.
+    uint8_t combine; // combine_op_t. 0 = remove the overlay.
+    uint32_t offset_us;
+    uint32_t on_duration_us;
+    uint32_t off_duration_us;
+    uint32_t cycles;
+};
+
+/**
+ * \brief repeats a finite PWM schedule as a series of trials.
+ */
+struct pwm_trial_settings_t
+{
+    uint8_t repeat; // 1 = repeat the schedule. 0 = run it once.
+    uint32_t trials; // including the first. 0 = until stopped.
+    uint8_t distribution; // RandomInterval::distribution_t of the ITI. 0 = fixed.
+    uint32_t seed; // 0 = pick a seed.
+    uint32_t mean_us;
+    uint32_t min_us; // ITI from the end of a trial. The fixed ITI.
+    uint32_t max_us;
+    uint8_t trigger; // TrialRepeat::trigger_t. 0 = no trigger input.
+    uint8_t trigger_channel;
+};
 #pragma pack(pop)
 
 
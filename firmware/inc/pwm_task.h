@@ -3,10 +3,49 @@
 #include <stdint.h>
 #include <pico/stdlib.h>
 #include <hardware/gpio.h>
+#include <config.h>
+#include <random_interval.h>
+#include <period_ramp.h>
+#include <burst_structure.h>
+#include <output_gate.h>
+#include <phase_lock.h>
 #ifdef DEBUG
     #include <cstdio> // for printf
 #endif
 
+/**
+ * \brief how the level of a PWMTask combines with the levels of the tasks
+ *  before it on the same output.
+ */
+enum class combine_op_t: uint8_t
+{
+    NONE = 0, /// the task drives the output by itself.
+    OR = 1,
+    AND = 2,
+    XOR = 3,
+};
+
+/**
+ * \brief everything needed to (re)create a PWMTask, including any
+ *  precomputed alternative timing.
+ */
+struct pwm_task_spec_t
+{
+    uint32_t delay_us;
+    uint32_t on_time_us;
+    uint32_t period_us;
+    uint32_t pin_mask;
+    uint32_t count;
+    bool invert;
+    uint8_t overlay; /// 0 = the output's own task. n = its overlay n - 1.
+    combine_op_t combine;
+    RandomInterval random_off_time;
+    PeriodRamp ramp;
+    BurstStructure burst;
+    OutputGate gate;
+    PhaseLock phase_lock;
+};
+
 /**
  * \brief container for bookkeeping update times/states of a PWM task.
  */
@@ -16,6 +55,12 @@ public:
     PWMTask(uint32_t t_delay_us, uint32_t t_on_us, uint32_t t_period_us,
             uint32_t pin_mask, uint32_t count = 0, bool invert = false);
 
+    explicit PWMTask(const pwm_task_spec_t& spec);
+
+/**
+ * \brief does not touch the pins, since PWMTasks are also destroyed when
+ *  they are moved around in a container. See release_pins().
+ */
     ~PWMTask();
 
 /**
@@ -31,6 +76,21 @@ public:
         DONE = 2,
     };
 
+/**
+ * \brief the part of a PWMTask that changes as it runs. Only the mutable
+ *  fields are kept; the settings do not change while running.
+ */
+    struct checkpoint_t
+    {
+        PeriodRamp::checkpoint_t ramp;
+        BurstStructure::checkpoint_t burst;
+        uint32_t cycles;
+        uint32_t start_time_us;
+        uint32_t next_update_time_us;
+        uint32_t random_off_time;
+        update_state_t state;
+    };
+
 /**
  * \brief should be called in a loop.
  * \param[force] if true, the pwm state change will forcibly iterate, which is
@@ -55,6 +115,12 @@ public:
 
     void reset(bool skip_output_action = false);
 
+/**
+ * \brief un-reserve the pins: drive them low, configure them as inputs, and
+ *  undo the inversion. Overlays leave the pins to the output's own task.
+ */
+    void release_pins();
+
     inline void start(bool skip_output_action = false)
     {
         reset(skip_output_action);
@@ -66,7 +132,7 @@ public:
         start_time_us_ = start_time_us;
         next_update_time_us_ = start_time_us_ + delay_us_;
         if (starting_state() == HIGH)
-            next_update_time_us_ += on_time_us_;
+            next_update_time_us_ += current_on_time_us();
     }
 
 /**
@@ -84,27 +150,205 @@ public:
     inline update_state_t starting_state()
     {return (delay_us_ == 0)? HIGH : LOW;}
 
+/**
+ * \brief draw each off time from \p off_time instead of using the fixed
+ *  period. The on time stays fixed.
+ */
+    inline void set_random_off_time(const RandomInterval& off_time)
+    {
+        random_off_time_ = off_time;
+        ramp_ = PeriodRamp(); // Only one alternative timing at a time.
+    }
+
+/**
+ * \brief sweep the period and duty cycle with \p ramp instead of using the
+ *  fixed on time and period.
+ */
+    inline void set_ramp(const PeriodRamp& ramp)
+    {
+        ramp_ = ramp;
+        random_off_time_ = RandomInterval();
+    }
+
+/**
+ * \brief group pulses into bursts and bursts into trains. The burst
+ *  structure then decides when the task is done instead of the count.
+ * \note combines with random and ramped timing.
+ */
+    inline void set_burst(const BurstStructure& burst)
+    {burst_ = burst;}
+
+/**
+ * \brief mask the output with \p gate. The scheduler applies the gate while
+ *  the task runs.
+ */
+    inline void set_gate(const OutputGate& gate)
+    {gate_ = gate;}
+
+/**
+ * \brief re-anchor the task to the edges of a reference input with
+ *  \p phase_lock. The scheduler applies the reference edges while the task
+ *  runs.
+ * \note only for fixed timing.
+ */
+    inline void set_phase_lock(const PhaseLock& phase_lock)
+    {phase_lock_ = phase_lock;}
+
+/**
+ * \brief force the output pads to their idle level (\p open = false) or let
+ *  them follow the task again.
+ */
+    void set_gate_override(bool open);
+
+/**
+ * \brief copy of the running state, i.e: to undo updates that were computed
+ *  ahead of time but never applied.
+ */
+    inline checkpoint_t checkpoint() const
+    {
+        return {ramp_.checkpoint(), burst_.checkpoint(), cycles_,
+                start_time_us_, next_update_time_us_,
+                random_off_time_.checkpoint(), state_};
+    }
+
+    inline void restore(const checkpoint_t& checkpoint)
+    {
+        state_ = checkpoint.state;
+        cycles_ = checkpoint.cycles;
+        start_time_us_ = checkpoint.start_time_us;
+        next_update_time_us_ = checkpoint.next_update_time_us;
+        random_off_time_.restore(checkpoint.random_off_time);
+        ramp_.restore(checkpoint.ramp);
+        burst_.restore(checkpoint.burst);
+    }
+
+/**
+ * \brief delay all remaining updates by \p delay_us.
+ */
+    inline void postpone(uint32_t delay_us)
+    {
+        start_time_us_ += delay_us;
+        next_update_time_us_ += delay_us;
+    }
+
+/**
+ * \brief shortest on and off times this task can produce.
+ */
+    inline uint32_t min_on_time_us() const
+    {return ramp_.enabled()? ramp_.min_on_time_us(): on_time_us_;}
+
+    inline uint32_t min_off_time_us() const
+    {
+        uint32_t off_time_us;
+        if (ramp_.enabled())
+            off_time_us = ramp_.min_off_time_us();
+        else
+            off_time_us = random_off_time_.enabled()? random_min_off_time_us()
+                                                    : period_us_ - on_time_us_;
+        if (burst_.enabled() && (burst_.min_gap_us() < off_time_us))
+            off_time_us = burst_.min_gap_us();
+        return off_time_us;
+    }
+
+/**
+ * \brief snapshot of this task's settings.
+ */
+    inline pwm_task_spec_t spec() const
+    {
+        return {delay_us_, on_time_us_, period_us_, pin_mask_, count_, invert_,
+                overlay_, combine_, random_off_time_, ramp_, burst_, gate_,
+                phase_lock_};
+    }
+
+/**
+ * \brief how many pulses the task issues. 0: pulse forever.
+ */
+    inline uint32_t total_cycles() const
+    {return burst_.enabled()? burst_.total_pulses(): count_;}
+
 private:
+    inline uint32_t current_on_time_us() const
+    {return ramp_.enabled()? ramp_.on_time_us(): on_time_us_;}
+
+/**
+ * \brief off time that ends the current cycle.
+ */
+    inline uint32_t next_off_time_us()
+    {
+        uint32_t off_time_us;
+        if (ramp_.enabled())
+        {
+            off_time_us = ramp_.off_time_us();
+            ramp_.advance();
+        }
+        else
+            off_time_us = random_off_time_.enabled()? random_next_off_time_us()
+                                                    : period_us_ - on_time_us_;
+        return burst_.enabled()? burst_.end_pulse(off_time_us): off_time_us;
+    }
+
+/**
+ * \brief random off times are at least MIN_EDGE_SPACING_US, so that a draw
+ *  near 0 (i.e: from min + Exp(mean) with min = 0) still lets the output fall
+ *  and rise again.
+ */
+    inline uint32_t random_min_off_time_us() const
+    {
+        uint32_t min_us = random_off_time_.min_us();
+        return (min_us < MIN_EDGE_SPACING_US)? MIN_EDGE_SPACING_US: min_us;
+    }
+
+    inline uint32_t random_next_off_time_us()
+    {
+        uint32_t off_time_us = random_off_time_.next();
+        return (off_time_us < MIN_EDGE_SPACING_US)? MIN_EDGE_SPACING_US
+                                                  : off_time_us;
+    }
+
+/**
+ * \brief true if the task has issued all of its pulses.
+ */
+    inline bool all_cycles_done() const
+    {
+        if (burst_.enabled())
+            return burst_.finished();
+        return (cycles_ == count_) && (count_ > 0);
+    }
+
+    template <size_t NUM_CHANNELS, size_t LOOKAHEAD_DEPTH>
     friend class PWMScheduler;
     friend void sync_schedule();
 
-    uint32_t delay_us_; /// pulse train delay (phase offset) in microseconds.
+    // Hot: read by every update() and every pq_ comparison. These come first
+    // so that their offsets do not depend on the size of the cold state.
+/**
+ * \brief absolute time that the state machine needs to update.
+ */
+    uint32_t next_update_time_us_;
+    uint32_t pin_mask_; /// active channels.
+    /// pins that the scheduler drives with this task's level: pin_mask_ and
+    /// the pins of tasks coalesced into it. 0 if it was coalesced itself.
+    uint32_t drive_mask_;
     uint32_t on_time_us_; /// pulse train duty cycle in microseconds
     uint32_t period_us_; /// pulse train period in microseconds
-
-    uint32_t pin_mask_; /// active channels.
-    update_state_t state_; /// current state of pulse waveform.
+    uint32_t cycles_; /// how many times we have pulsed.
     uint32_t count_; /// How many pulses to issue.
                      ///  0: pulse forever. >0: execute N times.
+    update_state_t state_; /// current state of pulse waveform.
     bool invert_;   /// Whether the waveform is inverted. Used externally.
-    uint32_t loops_; /// how many iterations of the state machine we have been
-                     ///    through.
-    uint32_t cycles_; /// how many times we have pulsed.
-    uint32_t start_time_us_; /// What (32-bit) time the pulse started.
+    /// 0: the output's own task. n: overlay n - 1, which shares the pins of
+    /// the output's own task and does not set them up or release them.
+    uint8_t overlay_;
+    combine_op_t combine_; /// how the scheduler combines overlaid tasks.
 
-/**
- * \brief absolute time that the state machine needs to update.
- */
-    uint32_t next_update_time_us_;
+    // Cold: only read when the task starts, is rescheduled, or uses an
+    // alternative timing.
+    uint32_t delay_us_; /// pulse train delay (phase offset) in microseconds.
+    uint32_t start_time_us_; /// What (32-bit) time the pulse started.
+    RandomInterval random_off_time_; /// Off time source if enabled.
+    PeriodRamp ramp_; /// On and off time source if enabled.
+    BurstStructure burst_; /// Pulse grouping if enabled.
+    OutputGate gate_; /// Output mask if enabled.
+    PhaseLock phase_lock_; /// Reference input if enabled.
 };
 #endif // PWM_TASK_H
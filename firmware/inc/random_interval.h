@@ -0,0 +1,82 @@
+#ifndef RANDOM_INTERVAL_H
+#define RANDOM_INTERVAL_H
+#include <stdint.h>
+
+/**
+ * \brief seedable source of random intervals (in [us]) for jittered pulse
+ *  trains.
+ * \details Draws use a xorshift32 generator and fixed-point math only, so
+ *  each draw takes a constant, small amount of time on a core without an FPU.
+ *  Reseeding replays the exact same sequence.
+ */
+class RandomInterval
+{
+public:
+    enum distribution_t: uint8_t
+    {
+        NONE = 0,                   /// disabled.
+        UNIFORM = 1,                /// uniform in [min, max].
+        EXPONENTIAL = 2,            /// min + Exp(mean), clipped to max.
+        TRUNCATED_EXPONENTIAL = 3,  /// min + Exp(mean), conditioned to <= max.
+    };
+
+/**
+ * \brief set the distribution and seed, then reseed.
+ * \note a \p seed of 0 is replaced with 1 since xorshift cannot leave 0.
+ */
+    void configure(distribution_t distribution, uint32_t seed,
+                   uint32_t mean_us, uint32_t min_us, uint32_t max_us);
+
+/**
+ * \brief restart the sequence from the seed.
+ */
+    inline void reseed()
+    {state_ = seed_;}
+
+/**
+ * \brief draw the next interval.
+ */
+    uint32_t next();
+
+    inline bool enabled() const
+    {return distribution_ != NONE;}
+
+    inline uint32_t min_us() const
+    {return min_us_;}
+
+    inline uint32_t seed() const
+    {return seed_;}
+
+/**
+ * \brief position in the sequence, i.e: to rewind draws that were never
+ *  used.
+ */
+    inline uint32_t checkpoint() const
+    {return state_;}
+
+    inline void restore(uint32_t checkpoint)
+    {state_ = checkpoint;}
+
+/**
+ * \brief -ln(x / 2^32) in Q16 fixed point for x in [1, 2^32).
+ */
+    static uint32_t neg_log_q16(uint32_t x);
+
+private:
+    inline uint32_t next_u32()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    distribution_t distribution_ = NONE;
+    uint32_t seed_ = 1;
+    uint32_t state_ = 1;
+    uint32_t mean_us_ = 0;
+    uint32_t min_us_ = 0;
+    uint32_t max_us_ = 0;
+    uint32_t tail_q32_ = 0; /// exp(-(max - min)/mean) in Q32 for truncation.
+};
+#endif // RANDOM_INTERVAL_H
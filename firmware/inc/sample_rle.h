@@ -0,0 +1,169 @@
+#ifndef SAMPLE_RLE_H
+#define SAMPLE_RLE_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief a port state held for \p length consecutive samples.
+ */
+struct sample_run_t
+{
+    uint32_t state;
+    uint32_t length;
+};
+
+/**
+ * \brief run-length encode a stream of port samples into batches of up to
+ *  BATCH_RUNS runs.
+ * \details A batch is ready when it is full, when it spans flush_samples
+ *  samples (so that a quiet port still reports in time), or when samples are
+ *  skipped. Each batch starts at a known sample index, so the time of every
+ *  sample in it follows from the sample rate.
+ */
+template <size_t BATCH_RUNS>
+class SampleRleEncoder
+{
+public:
+    SampleRleEncoder()
+    {reset(0);}
+
+/**
+ * \brief discard all runs and continue from sample \p next_index.
+ */
+    void reset(uint64_t next_index)
+    {
+        next_index_ = next_index;
+        batch_start_index_ = next_index;
+        run_length_ = 0;
+        num_runs_ = 0;
+        ready_ = false;
+    }
+
+/**
+ * \brief make a batch ready once it spans \p flush_samples samples.
+ */
+    void set_flush_samples(uint32_t flush_samples)
+    {flush_samples_ = (flush_samples > 0)? flush_samples: 1;}
+
+/**
+ * \brief encode up to \p count samples.
+ * \returns the number of samples consumed. Stops early when a batch becomes
+ *  ready, which must be popped before pushing more.
+ */
+    size_t push(const uint32_t* samples, size_t count);
+
+/**
+ * \brief account for \p count samples that were lost. Closes the current
+ *  batch so the next one starts after the gap.
+ * \returns false (and does nothing) if a batch is waiting to be popped.
+ */
+    bool skip(uint64_t count);
+
+/**
+ * \brief close the current run and batch (if not empty) now.
+ */
+    void flush()
+    {
+        if (ready_)
+            return;
+        close_run();
+        ready_ = (num_runs_ > 0);
+    }
+
+    bool batch_ready() const
+    {return ready_;}
+
+    const sample_run_t* batch() const
+    {return runs_;}
+
+    size_t batch_size() const
+    {return num_runs_;}
+
+/**
+ * \brief index of the first sample in the batch.
+ */
+    uint64_t batch_start_index() const
+    {return batch_start_index_;}
+
+/**
+ * \brief index of the next sample to be pushed.
+ */
+    uint64_t next_index() const
+    {return next_index_;}
+
+    void pop_batch()
+    {
+        num_runs_ = 0;
+        ready_ = false;
+        batch_start_index_ = next_index_ - run_length_;
+    }
+
+private:
+    void close_run()
+    {
+        if (!run_length_)
+            return;
+        runs_[num_runs_++] = {run_state_, run_length_};
+        run_length_ = 0;
+    }
+
+    sample_run_t runs_[BATCH_RUNS];
+    size_t num_runs_; /// Invariant: < BATCH_RUNS unless the batch is ready.
+    bool ready_;
+    uint32_t run_state_;
+    uint32_t run_length_; /// 0 = no open run.
+    uint64_t next_index_;
+    uint64_t batch_start_index_;
+    uint32_t flush_samples_ = UINT32_MAX;
+};
+
+
+template <size_t BATCH_RUNS>
+size_t SampleRleEncoder<BATCH_RUNS>::push(const uint32_t* samples,
+                                          size_t count)
+{
+    if (ready_)
+        return 0;
+    size_t i = 0;
+    while (i < count)
+    {
+        uint32_t sample = samples[i];
+        if (run_length_ && ((sample != run_state_) || (run_length_ == UINT32_MAX)))
+        {
+            close_run();
+            if (num_runs_ == BATCH_RUNS)
+            {
+                ready_ = true; // This sample starts the next batch.
+                break;
+            }
+        }
+        if (!run_length_)
+            run_state_ = sample;
+        ++run_length_;
+        ++next_index_;
+        ++i;
+        if (next_index_ - batch_start_index_ >= flush_samples_)
+        {
+            close_run();
+            ready_ = true;
+            break;
+        }
+    }
+    return i;
+}
+
+
+template <size_t BATCH_RUNS>
+bool SampleRleEncoder<BATCH_RUNS>::skip(uint64_t count)
+{
+    if (ready_)
+        return false;
+    close_run();
+    ready_ = (num_runs_ > 0);
+    next_index_ += count;
+    if (!ready_)
+        batch_start_index_ = next_index_;
+    return true;
+}
+
+#endif // SAMPLE_RLE_H
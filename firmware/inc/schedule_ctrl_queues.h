@@ -1,7 +1,10 @@
 #ifndef SCHEDULE_CTRL_QUEUES_H
 #define SCHEDULE_CTRL_QUEUES_H
 #include <pico/util/queue.h>
+#include <config.h>
 #include <pwm_settings.h>
+#include <pwm_task.h>
+#include <trial_state_machine.h>
 #ifdef DEBUG
     #include <stdio.h>
     #include <cstdio> // for printf
@@ -10,7 +13,9 @@
 enum class pwm_ctrl_msg_t
 {
     START,
-    STOP
+    STOP,
+    START_STATE_MACHINE,
+    STOP_STATE_MACHINE,
 };
 
 enum class core1_state_t: uint32_t
@@ -21,6 +26,26 @@ enum class core1_state_t: uint32_t
 };
 
 
+/**
+ * \brief schedule-wide parameters that core0 can forward to core1.
+ */
+enum class schedule_param_t: uint32_t
+{
+    EDGE_MERGE_TOLERANCE_US,
+    STREAM_MODE, /// 0 = play PwmSettings, 1 = play the waveform stream.
+    SAVE_SLOT, /// copy the current schedule into a slot. Acked.
+    LOAD_SLOT, /// replace the current schedule with a slot. Acked.
+    CLEAR_SCHEDULE, /// remove all PWMTasks from the current schedule. Acked.
+    OUTPUT_ENGINE, /// output_engine_t that applies the PortEvents.
+    ALARM_LEAD_US, /// how early the alarm fires to drive outputs on time.
+};
+
+struct schedule_config_msg_t
+{
+    schedule_param_t param;
+    uint32_t value;
+};
+
 /**
  * \brief Container to unpack pwm task specs from a received harp message.
  * \details this container is packed because it will be received packed and
@@ -31,17 +56,82 @@ struct pwm_specs_core_msg_t
 {
     size_t pin; // Limit 1 pin per PWMTask.
     pwm_settings_t specs;
+    uint8_t overlay = 0; // 0 = the pin's own task. n = its overlay n - 1.
+    uint8_t combine = 0; // combine_op_t. 0 on an overlay removes it.
 
     // Custom constructor that works off of references.
     pwm_specs_core_msg_t(size_t& pin, pwm_settings_t& specs)
     :pin(pin), specs(specs) {}
 
+    pwm_specs_core_msg_t(size_t pin, const pwm_overlay_settings_t& settings)
+    :pin(pin),
+     specs{settings.offset_us, settings.on_duration_us,
+           settings.off_duration_us, settings.cycles, 0},
+     overlay(uint8_t(settings.overlay + 1)), combine(settings.combine) {}
+
     // Enable default constructor.
     pwm_specs_core_msg_t() = default;
+
+/**
+ * \brief copy the settings into the aligned form that core1 schedules from.
+ * \details The Cortex-M0+ reads fields of packed structs a byte at a time,
+ *  so they are read once here instead of by the scheduler.
+ * \returns false if the settings do not drive a port output. \p spec is
+ *  left unchanged then. Timing is checked by the schedule analysis.
+ * \note an overlay with no combine_op_t is a request to remove it.
+ */
+    bool to_task_spec(pwm_task_spec_t& spec) const
+    {
+        size_t pin_num = pin;
+        pwm_settings_t settings = specs;
+        // Only overlays combine, and the pin's own task inverts them.
+        if ((pin_num >= 32) || !((1u << pin_num) & PORT_MASK)
+            || (combine > uint8_t(combine_op_t::XOR))
+            || (!overlay && combine) || (overlay && settings.invert))
+            return false;
+        spec = pwm_task_spec_t{settings.offset_us, settings.on_duration_us,
+                               settings.period_us(), 1u << pin_num,
+                               settings.cycles, bool(settings.invert),
+                               overlay, combine_op_t(combine)};
+        return true;
+    }
 };
 #pragma pack(pop)
 
 
+/**
+ * \brief which alternative timing a pwm_timing_core_msg_t applies to a
+ *  PWMTask.
+ */
+enum class pwm_timing_mode_t: uint32_t
+{
+    RANDOM_OFF_TIME,
+    RAMP,
+    BURST,
+    GATE,
+    PHASE_LOCK,
+};
+
+/**
+ * \brief Container to forward alternative timing settings for the PWMTask
+ *  that drives `pin`.
+ */
+struct pwm_timing_core_msg_t
+{
+    size_t pin;
+    pwm_timing_mode_t mode;
+    union
+    {
+        pwm_random_settings_t random;
+        pwm_ramp_settings_t ramp;
+        pwm_burst_settings_t burst;
+        pwm_gate_settings_t gate; /// gate_channel is a GPIO pin here.
+        /// reference_channel is a GPIO pin here.
+        pwm_phase_lock_settings_t phase_lock;
+    };
+};
+
+
 /**
  * \brief For core1 to communicate timstamped state changes to core0.
  *  Necessary for core0 to dispatch Harp messages.
@@ -52,9 +142,79 @@ struct core1_next_state_msg_t
     uint64_t timestamp_us;
 };
 
+/**
+ * \brief For core1 to report gated outputs opening or closing while the
+ *  schedule runs.
+ */
+struct gate_event_msg_t
+{
+    uint32_t open_pins; /// gated outputs whose gate is open.
+    uint64_t timestamp_us;
+};
+
+/**
+ * \brief For core0's edge interrupt to forward edges of phase-lock reference
+ *  inputs to core1.
+ */
+struct reference_edge_msg_t
+{
+    uint32_t rise_pins;
+    uint32_t fall_pins;
+    uint32_t time_us; /// lower 32 bits of the timer.
+};
+
+/**
+ * \brief For core1 to report phase-locked outputs gaining or losing their
+ *  lock while the schedule runs.
+ */
+struct phase_lock_event_msg_t
+{
+    uint32_t locked_pins; /// phase-locked outputs that are locked.
+    uint64_t timestamp_us;
+};
+
+/**
+ * \brief For core1 to report the start of each trial of a repeated
+ *  schedule.
+ */
+struct trial_event_msg_t
+{
+    uint32_t trial; /// index of the trial. The first one is 0.
+    uint64_t timestamp_us;
+};
+
+/**
+ * \brief For core0 to upload a trial state machine program to core1.
+ * \details Outputs and inputs are GPIO pins here.
+ */
+struct state_machine_program_msg_t
+{
+    sm_state_t states[STATE_MACHINE_MAX_STATES];
+    uint8_t num_states;
+};
+
+/**
+ * \brief For core1 to report the state changes of the trial state machine.
+ */
+struct state_machine_event_msg_t
+{
+    sm_event_t event;
+    uint64_t timestamp_us;
+};
+
 extern queue_t pwm_settings_queue;
+extern queue_t pwm_timing_queue;
+extern queue_t schedule_config_queue;
 extern queue_t core1_ctrl_queue;
 extern queue_t core1_next_state_queue;
 extern queue_t schedule_error_queue;
+extern queue_t schedule_slot_ack_queue;
+extern queue_t gate_event_queue;
+extern queue_t reference_edge_queue;
+extern queue_t phase_lock_event_queue;
+extern queue_t trial_settings_queue; /// trigger_channel is a GPIO pin here.
+extern queue_t trial_event_queue;
+extern queue_t state_machine_program_queue;
+extern queue_t state_machine_event_queue;
 
 #endif // SCHEDULE_CTRL_QUEUES_H
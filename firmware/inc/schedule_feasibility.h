@@ -0,0 +1,74 @@
+#ifndef SCHEDULE_FEASIBILITY_H
+#define SCHEDULE_FEASIBILITY_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief reasons why a schedule may be rejected (or fail) on core1.
+ */
+enum class schedule_error_t: uint8_t
+{
+    NONE = 0,
+    INVALID_SETTINGS = 1,   /// on-time longer than the period or zero period.
+    EDGES_TOO_CLOSE = 2,    /// distinct edges closer than the alarm ISR allows.
+    LOOKAHEAD_OVERRUN = 3,  /// scheduler cannot compute edges fast enough.
+    MISSED_DEADLINE = 4,    /// schedule fell behind while running.
+    ANALYSIS_INCOMPLETE = 5, /// CPU time ran out before the analysis did.
+};
+
+/**
+ * \brief timing parameters of one PWMTask, relative to schedule start.
+ */
+struct task_timing_t
+{
+    uint32_t delay_us;
+    uint32_t on_time_us;
+    uint32_t period_us;
+    uint32_t count; /// 0 = forever.
+};
+
+/**
+ * \brief limits the schedule is checked against.
+ */
+struct feasibility_params_t
+{
+    uint32_t edge_cost_us;        /// time for the scheduler to compute 1 PortEvent.
+    uint32_t min_edge_spacing_us; /// minimum time between distinct alarms.
+    uint32_t merge_tolerance_us;  /// edges within this window fire together.
+    size_t lookahead_depth;       /// PortEvents that can be queued ahead.
+    size_t max_edges;             /// analysis stops after this many PortEvents.
+    uint32_t max_span_us;         /// analysis stops after this much time.
+    uint32_t max_time_us;         /// ...or this much CPU time. 0 = no limit.
+                                  /// Running out of it is an error.
+};
+
+/**
+ * \brief outcome of the analysis. Also the payload of the ScheduleDiagnostics
+ *  register, so it is packed.
+ */
+#pragma pack(push, 1)
+struct feasibility_report_t
+{
+    uint8_t error;                /// schedule_error_t
+    uint32_t min_edge_spacing_us; /// smallest gap between distinct edge times.
+    uint32_t peak_edge_rate_hz;   /// densest rate over a lookahead window.
+    uint32_t edge_cost_us;        /// per-edge cost used in the analysis.
+    uint32_t violation_time_us;   /// edge time (since start) of first failure.
+    uint32_t analyzed_span_us;    /// how much of the schedule was analyzed.
+};
+#pragma pack(pop)
+
+/**
+ * \brief Replay the edge times of the tasks over their hyperperiod (bounded
+ *  by \p params) and check that every edge can be computed and fired on time.
+ * \details Edges are grouped into PortEvents exactly like
+ *  PWMScheduler::update() does (including the merge tolerance), and the
+ *  lookahead queue is modeled as a producer (the scheduler, which needs
+ *  `edge_cost_us` per PortEvent and may run at most `lookahead_depth` events
+ *  ahead) racing a consumer (the alarm ISR).
+ */
+feasibility_report_t analyze_schedule(const task_timing_t* tasks,
+                                      size_t num_tasks,
+                                      const feasibility_params_t& params);
+
+#endif // SCHEDULE_FEASIBILITY_H
@@ -0,0 +1,98 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+#include <stdint.h>
+#include <stddef.h>
+#include <hardware/sync.h>
+
+/**
+ * \brief lock-free ring buffer for exactly one producer and one consumer,
+ *  which may run in different contexts (ISR vs main loop) or on different
+ *  cores.
+ * \details Unlike the pico-sdk queue_t, neither side takes a spin lock, so
+ *  pushing from a timing-critical ISR costs a few loads and stores. The
+ *  producer only writes `head_` and the consumer only writes `tail_`.
+ * \tparam N capacity. Must be a power of 2.
+ */
+template <typename T, size_t N>
+class SPSCRing
+{
+public:
+    static_assert((N > 0) && ((N & (N - 1)) == 0),
+                  "Ring capacity must be a power of 2.");
+
+/**
+ * \brief (producer) add an item.
+ * \return false if the ring is full.
+ */
+    inline bool push(const T& item)
+    {
+        uint32_t head = head_;
+        if (head - tail_ == N)
+            return false;
+        buffer_[head & (N - 1)] = item;
+        __dmb(); // Publish the item before publishing the index.
+        head_ = head + 1;
+        return true;
+    }
+
+/**
+ * \brief (consumer) remove the oldest item.
+ * \return false if the ring is empty.
+ */
+    inline bool pop(T& item)
+    {
+        uint32_t tail = tail_;
+        if (head_ == tail)
+            return false;
+        __dmb(); // Read the index before reading the item.
+        item = buffer_[tail & (N - 1)];
+        __dmb(); // Finish reading the item before releasing its slot.
+        tail_ = tail + 1;
+        return true;
+    }
+
+/**
+ * \brief (consumer) oldest item without removing it or nullptr if empty.
+ */
+    inline const T* peek() const
+    {
+        uint32_t tail = tail_;
+        if (head_ == tail)
+            return nullptr;
+        __dmb();
+        return &buffer_[tail & (N - 1)];
+    }
+
+    inline size_t size() const
+    {return head_ - tail_;}
+
+    inline bool empty() const
+    {return head_ == tail_;}
+
+    inline bool full() const
+    {return size() == N;}
+
+    static constexpr size_t capacity()
+    {return N;}
+
+/**
+ * \brief (consumer) drop all items.
+ * \warning only safe while the producer is not pushing.
+ */
+    inline void clear()
+    {tail_ = head_;}
+
+/**
+ * \brief (producer) take back all items that were not consumed.
+ * \warning only safe while the consumer is not popping.
+ */
+    inline void discard()
+    {head_ = tail_;}
+
+private:
+    volatile uint32_t head_ = 0; /// next slot to write. Owned by producer.
+    volatile uint32_t tail_ = 0; /// next slot to read. Owned by consumer.
+    T buffer_[N];
+};
+
+#endif // SPSC_RING_H
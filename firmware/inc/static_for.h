@@ -0,0 +1,21 @@
+#ifndef STATIC_FOR_H
+#define STATIC_FOR_H
+#include <stddef.h>
+#include <utility>
+#include <type_traits>
+
+/**
+ * \brief call `f(std::integral_constant<size_t, I>{})` for I in [0, N).
+ * \details the loop is unrolled at compile time, so each call sees I as a
+ *  constant expression and can be folded into shifts/masks with no loop
+ *  bookkeeping.
+ */
+template <size_t N, typename F>
+inline void static_for(F&& f)
+{
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {(f(std::integral_constant<size_t, I>{}), ...);}
+    (std::make_index_sequence<N>{});
+}
+
+#endif // STATIC_FOR_H
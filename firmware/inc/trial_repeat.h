@@ -0,0 +1,127 @@
+#ifndef TRIAL_REPEAT_H
+#define TRIAL_REPEAT_H
+#include <stdint.h>
+#include <random_interval.h>
+
+/**
+ * \brief re-run a finite schedule as a series of trials.
+ * \details Trials are separated by a fixed or random inter-trial interval
+ *  (ITI) that counts from the end of the previous trial. With a trigger, the
+ *  next trial waits for the first trigger edge after the ITI instead.
+ *  Trigger edges are found by polling the pin, so trigger pulses must last
+ *  longer than one pass of core1's loop.
+ */
+class TrialRepeat
+{
+public:
+    enum trigger_t: uint8_t
+    {
+        NONE = 0,
+        RISING = 1,
+        FALLING = 2,
+    };
+
+/**
+ * \param trials number of trials, including the first. 0 repeats until the
+ *  schedule is stopped.
+ * \param iti draws the ITIs [us]. Without a distribution, every ITI is its
+ *  min_us().
+ * \param trigger NONE starts trials as soon as their ITI is over.
+ * \param pin GPIO pin of the trigger input.
+ */
+    inline void configure(uint32_t trials, const RandomInterval& iti,
+                          trigger_t trigger, uint32_t pin)
+    {
+        enabled_ = true;
+        trials_ = trials;
+        iti_ = iti;
+        trigger_ = trigger;
+        trigger_mask_ = (trigger == NONE)? 0: (1u << pin);
+        waiting_ = false;
+    }
+
+/**
+ * \brief run schedules once.
+ */
+    inline void disable()
+    {
+        enabled_ = false;
+        waiting_ = false;
+    }
+
+    inline bool enabled() const
+    {return enabled_;}
+
+/**
+ * \brief start the first trial. Every run replays the same ITIs.
+ */
+    inline void start()
+    {
+        trial_ = 0;
+        waiting_ = false;
+        iti_.reseed();
+    }
+
+/**
+ * \brief end the current trial at \p time_us.
+ * \returns true if another trial follows. Poll ready() to start it.
+ */
+    inline bool end_trial(uint32_t time_us)
+    {
+        if (!enabled_ || ((trials_ != 0) && (trial_ + 1 >= trials_)))
+            return false;
+        next_start_us_ = time_us + iti_.next();
+        armed_ = false;
+        waiting_ = true;
+        return true;
+    }
+
+/**
+ * \brief true (once) when the next trial should start.
+ * \param gpio_levels levels of all GPIO pins.
+ */
+    inline bool ready(uint32_t time_us, uint32_t gpio_levels)
+    {
+        if (!waiting_ || (int32_t(time_us - next_start_us_) < 0))
+            return false;
+        if (trigger_ != NONE)
+        {
+            // Only edges after the ITI count, so the first sample just arms.
+            bool active = bool(gpio_levels & trigger_mask_)
+                          == (trigger_ == RISING);
+            bool edge = armed_ && active && !was_active_;
+            armed_ = true;
+            was_active_ = active;
+            if (!edge)
+                return false;
+        }
+        ++trial_;
+        waiting_ = false;
+        return true;
+    }
+
+/**
+ * \brief true between trials.
+ */
+    inline bool waiting() const
+    {return waiting_;}
+
+/**
+ * \brief index of the current (or last) trial. The first one is 0.
+ */
+    inline uint32_t trial() const
+    {return trial_;}
+
+private:
+    RandomInterval iti_;
+    uint32_t trials_ = 0;
+    uint32_t trial_ = 0;
+    uint32_t next_start_us_ = 0; /// earliest start of the next trial.
+    uint32_t trigger_mask_ = 0;
+    trigger_t trigger_ = NONE;
+    bool enabled_ = false;
+    bool waiting_ = false;
+    bool armed_ = false; /// the trigger was sampled since the ITI ended.
+    bool was_active_ = false;
+};
+#endif // TRIAL_REPEAT_H
@@ -0,0 +1,222 @@
+#ifndef TRIAL_STATE_MACHINE_H
+#define TRIAL_STATE_MACHINE_H
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief what leaves a state (besides its timeout).
+ */
+enum class sm_condition_t: uint8_t
+{
+    NONE = 0,
+    RISING = 1, /// rising edge of an input.
+    FALLING = 2, /// falling edge of an input.
+    SCHEDULE_DONE = 3, /// the PWM schedule is not running.
+};
+
+/**
+ * \brief why the state machine changed state.
+ */
+enum class sm_cause_t: uint8_t
+{
+    START = 0,
+    TIMEOUT = 1,
+    TRANSITION_0 = 2,
+    TRANSITION_1 = 3,
+    STOP = 4, /// stopped by the PC or by a schedule failure.
+};
+
+#pragma pack(push, 1)
+/**
+ * \brief a way out of a state.
+ */
+struct sm_transition_t
+{
+    uint8_t condition; // sm_condition_t.
+    uint8_t channel; // input of RISING and FALLING.
+    uint8_t next; // state to enter. 0xFF ends the program.
+};
+
+/**
+ * \brief one state of a trial state machine program.
+ * \details Entering a state first drives its outputs, then applies its
+ *  schedule action.
+ */
+struct sm_state_t
+{
+    uint32_t set_channels; // outputs driven high on entry.
+    uint32_t clear_channels; // outputs driven low on entry.
+    uint8_t schedule; // 0 = none, 1 = stop, 2 = start, 0x80 | slot = start slot.
+    uint32_t timeout_us; // from entry. 0 = no timeout.
+    uint8_t timeout_next; // state to enter on timeout. 0xFF ends the program.
+    sm_transition_t transitions[2]; // checked in order, before the timeout.
+};
+
+/**
+ * \brief a state change of a trial state machine.
+ */
+struct sm_event_t
+{
+    uint8_t state; // 0xFF once the program ended.
+    uint8_t previous; // 0xFF on START.
+    uint8_t cause; // sm_cause_t.
+};
+#pragma pack(pop)
+
+/**
+ * \brief table-driven state machine that runs behavioral trials on the
+ *  device, i.e: wait for an input, play a cue, wait for a response within a
+ *  window, and reward or time out.
+ * \details The machine only decides when to change state. Its owner applies
+ *  the entry actions of current() after every change. Edges are found by
+ *  comparing the levels of successive update() calls, so inputs must hold
+ *  their level for longer than the time between calls. At most one
+ *  transition is taken per call, so a loop of states that leave immediately
+ *  cannot stall the caller. Times are 32-bit [us], so timeouts must stay
+ *  below 2^31us.
+ * \tparam MAX_STATES program size.
+ */
+template <size_t MAX_STATES>
+class TrialStateMachine
+{
+public:
+    static constexpr uint8_t END = 0xFF;
+    static constexpr uint8_t SCHEDULE_NONE = 0;
+    static constexpr uint8_t SCHEDULE_STOP = 1;
+    static constexpr uint8_t SCHEDULE_START = 2;
+    static constexpr uint8_t SCHEDULE_SLOT = 0x80;
+
+/**
+ * \brief replace the program with the first \p num_states of \p states.
+ * \note only while stopped. States must only lead to states < num_states
+ *  or to END.
+ */
+    void load(const sm_state_t* states, size_t num_states)
+    {
+        num_states_ = (num_states > MAX_STATES)? MAX_STATES: num_states;
+        for (size_t i = 0; i < num_states_; ++i)
+            states_[i] = states[i];
+    }
+
+    inline size_t num_states() const
+    {return num_states_;}
+
+/**
+ * \brief enter state 0.
+ * \returns false if there is no program.
+ */
+    bool start(uint32_t time_us, uint32_t gpio_levels, sm_event_t& event)
+    {
+        if (!num_states_)
+            return false;
+        event = {0, END, uint8_t(sm_cause_t::START)};
+        enter(0, time_us, gpio_levels);
+        return true;
+    }
+
+/**
+ * \brief end the program where it is.
+ * \returns false if it was not running.
+ */
+    bool stop(sm_event_t& event)
+    {
+        if (!running())
+            return false;
+        event = {END, state_, uint8_t(sm_cause_t::STOP)};
+        state_ = END;
+        return true;
+    }
+
+    inline bool running() const
+    {return state_ != END;}
+
+    inline uint8_t state() const
+    {return state_;}
+
+/**
+ * \brief the state that was entered last.
+ * \note only while running.
+ */
+    inline const sm_state_t& current() const
+    {return states_[state_];}
+
+/**
+ * \brief take the first transition (or the timeout) of the current state
+ *  that is due.
+ * \param gpio_levels levels of all GPIO pins.
+ * \param schedule_running whether the PWM schedule is running.
+ * \returns true if the state changed. \p event describes the change.
+ */
+    bool update(uint32_t time_us, uint32_t gpio_levels, bool schedule_running,
+                sm_event_t& event)
+    {
+        if (!running())
+            return false;
+        const sm_state_t& state = states_[state_];
+        uint32_t rising = gpio_levels & ~levels_;
+        uint32_t falling = ~gpio_levels & levels_;
+        levels_ = gpio_levels;
+        uint8_t next = END;
+        sm_cause_t cause = sm_cause_t::STOP;
+        bool due = false;
+        for (size_t i = 0; i < 2; ++i)
+        {
+            const sm_transition_t& transition = state.transitions[i];
+            bool taken = false;
+            switch (sm_condition_t(transition.condition))
+            {
+                case sm_condition_t::RISING:
+                    taken = (rising >> transition.channel) & 1u;
+                    break;
+                case sm_condition_t::FALLING:
+                    taken = (falling >> transition.channel) & 1u;
+                    break;
+                case sm_condition_t::SCHEDULE_DONE:
+                    taken = !schedule_running;
+                    break;
+                default:
+                    break;
+            }
+            if (taken)
+            {
+                next = transition.next;
+                cause = sm_cause_t(uint8_t(sm_cause_t::TRANSITION_0) + i);
+                due = true;
+                break;
+            }
+        }
+        if (!due && state.timeout_us
+            && (int32_t(time_us - entry_time_us_) >= int32_t(state.timeout_us)))
+        {
+            next = state.timeout_next;
+            cause = sm_cause_t::TIMEOUT;
+            due = true;
+        }
+        if (!due)
+            return false;
+        if (next >= num_states_)
+            next = END;
+        event = {next, state_, uint8_t(cause)};
+        if (next == END)
+            state_ = END;
+        else
+            enter(next, time_us, gpio_levels);
+        return true;
+    }
+
+private:
+    inline void enter(uint8_t state, uint32_t time_us, uint32_t gpio_levels)
+    {
+        state_ = state;
+        entry_time_us_ = time_us;
+        levels_ = gpio_levels; // Only edges after entering count.
+    }
+
+    sm_state_t states_[MAX_STATES];
+    size_t num_states_ = 0;
+    uint8_t state_ = END;
+    uint32_t entry_time_us_ = 0;
+    uint32_t levels_ = 0; /// GPIO levels as of the last update.
+};
+
+#endif // TRIAL_STATE_MACHINE_H
@@ -0,0 +1,35 @@
+#ifndef WAVEFORM_STREAM_H
+#define WAVEFORM_STREAM_H
+#include <stdint.h>
+#include <stddef.h>
+#include <config.h>
+#include <spsc_ring.h>
+
+/**
+ * \brief one port write of a host-streamed waveform.
+ */
+struct StreamRecord
+{
+    uint32_t delta_us;  /// time since the previous record (or schedule start).
+    uint32_t mask;      /// pins to write.
+    uint32_t state;     /// values to write to those pins.
+};
+
+/**
+ * \brief Ring of waveform records filled by core0 (from the PC) and consumed
+ *  directly by the alarm ISR.
+ */
+extern SPSCRing<StreamRecord, STREAM_RING_DEPTH> waveform_stream;
+
+/**
+ * \brief set by the alarm ISR when it ran out of records while streaming.
+ */
+extern volatile bool waveform_stream_underrun;
+
+/**
+ * \brief number of records the alarm ISR has applied since the stream
+ *  started.
+ */
+extern volatile uint32_t waveform_stream_played;
+
+#endif // WAVEFORM_STREAM_H
@@ -0,0 +1,14 @@
+#include <config_store.h>
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+    // Bitwise (table-free) since this only runs when saving or loading.
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc ^= data[i];
+        for (size_t bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
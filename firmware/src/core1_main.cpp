@@ -1,8 +1,26 @@
 #include <core1_main.h>
 
-__not_in_flash("core1_next_state") core1_state_t state;
-__not_in_flash("schedule_failed") bool schedule_failed;
-__not_in_flash("scheduler")PWMScheduler scheduler;
+// Core1's own state lives in its scratch bank (with its stack), away from
+// core0's and USB's traffic to the main SRAM.
+__scratch_x("core1_next_state") core1_state_t state;
+__scratch_x("schedule_failed") bool schedule_failed;
+// The scheduler is core1's hottest data, but it cannot join the rest in
+// scratch_x: it is several KB, and the 4KB bank also holds core1's stack. Its
+// ISR's data are template statics, whose section attributes GCC ignores.
+__not_in_flash("scheduler") CuttlefishScheduler scheduler;
+__scratch_x("trial_repeat") TrialRepeat trial_repeat;
+CuttlefishStateMachine state_machine;
+feasibility_report_t schedule_report;
+bool schedule_changed; /// true if the schedule must be re-analyzed.
+ScheduleSlot schedule_slots[SCHEDULE_SLOT_COUNT];
+#if defined(PROFILE_CPU)
+__scratch_x("isr_latency_probe") IsrLatencyProbe isr_latency_probe;
+// SysTick cycles spent in scheduler.update() since the schedule started,
+// including any alarm ISRs that preempt it.
+uint64_t update_cycles;
+uint32_t worst_update_cycles;
+uint32_t update_calls;
+#endif
 
 
 /// Do not call this func inside and outside an ISR context on either core.
@@ -20,7 +38,19 @@ void handle_missed_deadline()
     gpio_set_dir(LED1, 1); // output
     gpio_put(LED1, 1); // turn on auxilary LED.
     schedule_failed = true;
-    // TODO: push an error message back to core0.
+    // Tell core0 why the schedule is about to be reset.
+    schedule_report.error = uint8_t(schedule_error_t::MISSED_DEADLINE);
+    uint8_t error = schedule_report.error;
+    queue_try_add(&schedule_error_queue, &error);
+}
+
+
+void load_schedule_slot(size_t slot)
+{
+    // Already analyzed when it was saved.
+    scheduler.load_tasks(schedule_slots[slot].tasks);
+    scheduler.set_merge_tolerance_us(schedule_slots[slot].merge_tolerance_us);
+    schedule_report = schedule_slots[slot].report;
 }
 
 
@@ -28,65 +58,354 @@ void sync_schedule()
 {
     /// friend function to PWMScheduler and PWMTask.
     /// Should only be called before running the schedule.
+    schedule_config_msg_t config;
+    schedule_config_msg_t slot_request{};
+    bool new_slot_request = false;
+    while (queue_try_remove(&schedule_config_queue, &config))
+    {
+        switch (config.param)
+        {
+            case schedule_param_t::SAVE_SLOT:
+            case schedule_param_t::LOAD_SLOT:
+            case schedule_param_t::CLEAR_SCHEDULE:
+                // Act after applying the settings that were sent before it.
+                slot_request = config;
+                new_slot_request = true;
+                continue;
+            case schedule_param_t::EDGE_MERGE_TOLERANCE_US:
+                scheduler.set_merge_tolerance_us(config.value);
+                break;
+            case schedule_param_t::STREAM_MODE:
+                scheduler.set_stream_mode(bool(config.value));
+                break;
+            case schedule_param_t::OUTPUT_ENGINE:
+                scheduler.set_output_engine(output_engine_t(config.value));
+                break;
+            case schedule_param_t::ALARM_LEAD_US:
+                scheduler.set_alarm_lead_us(config.value);
+                break;
+            default:
+                break;
+        }
+        schedule_changed = true;
+    }
     pwm_specs_core_msg_t settings;
+    bool tasks_changed = false;
     while (queue_try_remove(&pwm_settings_queue, &settings))
     {
-        // If the pin is already assigned to a specific set of settings in the
-        // schedule, update them. Otherwise, create a new PWMTask and
-        // push it into the schedule.
-        //
-        // Note that since the schedule is presorted, we need to pop out
-        // all tasks until we find the right one, update it, and then push
-        // them all back--gross.
+        pwm_task_spec_t spec;
+        if (!settings.to_task_spec(spec))
+        {
+            uint8_t error = uint8_t(schedule_error_t::INVALID_SETTINGS);
+            queue_try_add(&schedule_error_queue, &error);
+            continue;
+        }
+        schedule_changed = true;
+        tasks_changed = true;
+        // If the pin (or this overlay of it) is already assigned to a specific
+        // set of settings in the schedule, update them. Otherwise, create a
+        // new PWMTask and push it into the schedule.
         bool updated_existing_task = false;
-        etl::vector<std::reference_wrapper<PWMTask>, NUM_TTL_IOS> tmp_tasks;
-        while (!scheduler.pq_.empty())
+        bool pin_has_task = false;
+        for (auto& task: scheduler.pwm_tasks_)
         {
-            PWMTask& task = scheduler.pq_.top().get();
-            if (task.pin_mask_ != (1u << settings.pin))
-            {
-                scheduler.pq_.pop();
-                tmp_tasks.push_back(task);
+            if (task.pin_mask_ != spec.pin_mask)
+                continue;
+            pin_has_task = true;
+            if (task.overlay_ != spec.overlay)
                 continue;
+            updated_existing_task = true;
+            if (spec.overlay && (spec.combine == combine_op_t::NONE))
+            {
+                scheduler.remove_pwm_task(task);
+                break;
             }
             // Update existing task specs.
-            task.delay_us_ = settings.specs.offset_us;
-            task.on_time_us_ = settings.specs.on_duration_us;
-            task.period_us_ = settings.specs.period_us();
-            task.count_ = settings.specs.cycles;
-            task.invert_ = bool(settings.specs.invert);
-            updated_existing_task = true;
+            task.delay_us_ = spec.delay_us;
+            task.on_time_us_ = spec.on_time_us;
+            task.period_us_ = spec.period_us;
+            task.count_ = spec.count;
+            task.combine_ = spec.combine;
+            if (task.overlay_)
+                break;
+            task.invert_ = spec.invert;
+            // The PWMTask only inverts its output when it is created.
+            gpio_set_outover(settings.pin, task.invert_? GPIO_OVERRIDE_INVERT
+                                                       : GPIO_OVERRIDE_NORMAL);
             break;
         }
-        while (!tmp_tasks.empty())
+        // Overlays need a free task and combine after the pin's own task.
+        if (updated_existing_task
+            || (spec.overlay && (spec.combine == combine_op_t::NONE)))
+            continue;
+        if (scheduler.pwm_tasks_.full() || (spec.overlay && !pin_has_task))
         {
-            PWMTask& task = tmp_tasks.back();
-            scheduler.pq_.push(task);
-            tmp_tasks.pop_back();
+            uint8_t error = uint8_t(schedule_error_t::INVALID_SETTINGS);
+            queue_try_add(&schedule_error_queue, &error);
+            continue;
         }
-        if (!updated_existing_task)
+        scheduler.schedule_pwm_task(spec);
+    }
+    // Apply alternative timing to tasks that already exist.
+    pwm_timing_core_msg_t timing;
+    while (queue_try_remove(&pwm_timing_queue, &timing))
+    {
+        schedule_changed = true;
+        tasks_changed = true;
+        for (auto& task: scheduler.pwm_tasks_)
         {
-            scheduler.schedule_pwm_task(settings.specs.offset_us,
-                                        settings.specs.on_duration_us,
-                                        settings.specs.period_us(),
-                                        1u << settings.pin,
-                                        settings.specs.cycles,
-                                        bool(settings.specs.invert));
+            // Overlays keep fixed timing.
+            if ((task.pin_mask_ != (1u << timing.pin)) || task.overlay_)
+                continue;
+            switch (timing.mode)
+            {
+                case pwm_timing_mode_t::RANDOM_OFF_TIME:
+                {
+                    RandomInterval off_time;
+                    off_time.configure(
+                        RandomInterval::distribution_t(timing.random.distribution),
+                        timing.random.seed, timing.random.mean_us,
+                        timing.random.min_us, timing.random.max_us);
+                    task.set_random_off_time(off_time);
+                    break;
+                }
+                case pwm_timing_mode_t::RAMP:
+                {
+                    PeriodRamp ramp;
+                    ramp.configure(
+                        PeriodRamp::profile_t(timing.ramp.profile),
+                        timing.ramp.start_period_us, timing.ramp.end_period_us,
+                        timing.ramp.start_duty, timing.ramp.end_duty,
+                        timing.ramp.ramp_duration_us);
+                    task.set_ramp(ramp);
+                    break;
+                }
+                case pwm_timing_mode_t::BURST:
+                {
+                    BurstStructure burst;
+                    burst.configure(timing.burst.pulses_per_burst,
+                                    timing.burst.burst_gap_us,
+                                    timing.burst.bursts_per_train,
+                                    timing.burst.train_gap_us,
+                                    timing.burst.trains);
+                    task.set_burst(burst);
+                    break;
+                }
+                case pwm_timing_mode_t::GATE:
+                {
+                    OutputGate gate;
+                    gate.configure(OutputGate::mode_t(timing.gate.mode),
+                                   timing.gate.gate_channel,
+                                   bool(timing.gate.active_low));
+                    task.set_gate(gate);
+                    break;
+                }
+                case pwm_timing_mode_t::PHASE_LOCK:
+                {
+                    PhaseLock phase_lock;
+                    phase_lock.configure(
+                        PhaseLock::mode_t(timing.phase_lock.mode),
+                        timing.phase_lock.reference_channel,
+                        bool(timing.phase_lock.falling_edge),
+                        timing.phase_lock.delay_us);
+                    task.set_phase_lock(phase_lock);
+                    break;
+                }
+                default:
+                    break;
+            }
         }
     }
+    // Trial settings do not change the schedule itself.
+    pwm_trial_settings_t trial_settings;
+    while (queue_try_remove(&trial_settings_queue, &trial_settings))
+    {
+        if (!trial_settings.repeat)
+        {
+            trial_repeat.disable();
+            continue;
+        }
+        RandomInterval iti;
+        iti.configure(RandomInterval::distribution_t(trial_settings.distribution),
+                      trial_settings.seed, trial_settings.mean_us,
+                      trial_settings.min_us, trial_settings.max_us);
+        trial_repeat.configure(trial_settings.trials, iti,
+                               TrialRepeat::trigger_t(trial_settings.trigger),
+                               trial_settings.trigger_channel);
+    }
+    // New offsets and ramps change tasks' first edges and starting states, so
+    // re-sort the pq_ and recompute the port state that start() applies.
+    if (tasks_changed)
+        scheduler.requeue_tasks();
+    // Admission control: (re)analyze the schedule whenever it changes so that
+    // starting it does not have to wait for the analysis.
+    if (schedule_changed)
+    {
+        schedule_report = scheduler.analyze({DEFAULT_EDGE_COST_US,
+                                             MIN_EDGE_SPACING_US, 0, 0,
+                                             FEASIBILITY_MAX_EDGES,
+                                             FEASIBILITY_MAX_SPAN_US,
+                                             FEASIBILITY_MAX_TIME_US});
+        schedule_changed = false;
+    }
+    if (!new_slot_request)
+        return;
+    if (slot_request.param == schedule_param_t::CLEAR_SCHEDULE)
+    {
+        scheduler.reset();
+        schedule_changed = true;
+        bool success = true;
+        queue_try_add(&schedule_slot_ack_queue, &success);
+        return;
+    }
+    // Slots hold PWMTask schedules only. Streams are timed by the PC.
+    bool success = (slot_request.value < SCHEDULE_SLOT_COUNT)
+                   && !scheduler.stream_mode();
+    if (success)
+    {
+        ScheduleSlot& slot = schedule_slots[slot_request.value];
+        if (slot_request.param == schedule_param_t::SAVE_SLOT)
+        {
+            scheduler.save_tasks(slot.tasks);
+            slot.merge_tolerance_us = scheduler.merge_tolerance_us();
+            slot.report = schedule_report;
+        }
+        else
+            load_schedule_slot(slot_request.value);
+    }
+    queue_try_add(&schedule_slot_ack_queue, &success);
 }
 
 
-void __not_in_flash_func(run_task_loop)()
+uint64_t __not_in_flash_func(start_schedule)()
+{
+    // Reference edges from before the start are stale.
+    reference_edge_msg_t edge;
+    while (queue_try_remove(&reference_edge_queue, &edge)) {}
+    uint64_t start_time_us = time_us_64_unsafe();
+    scheduler.start(); // Start ASAP to maximize timestamp accuracy.
+    // Extend the time that the scheduler started at to 64 bits.
+    start_time_us += uint32_t(scheduler.start_time_us()
+                              - uint32_t(start_time_us));
+    start_time_us += scheduler.start_delay_us();
+    // Tell core0 which gated outputs start out open.
+    if (scheduler.gated_outputs())
+    {
+        gate_event_msg_t gate_msg{scheduler.open_gated_outputs(),
+                                  start_time_us};
+        queue_try_add(&gate_event_queue, &gate_msg);
+    }
+    // Tell core0 that no phase-locked output is locked yet.
+    if (scheduler.phase_locked_outputs())
+    {
+        phase_lock_event_msg_t lock_msg{0, start_time_us};
+        queue_try_add(&phase_lock_event_queue, &lock_msg);
+    }
+    if (trial_repeat.enabled() && !scheduler.stream_mode())
+    {
+        trial_event_msg_t trial_msg{trial_repeat.trial(), start_time_us};
+        queue_try_add(&trial_event_queue, &trial_msg);
+    }
+    return start_time_us;
+}
+
+
+void __not_in_flash_func(run_state_machine)(bool start, bool stop)
 {
     using enum core1_state_t;
+    using SM = CuttlefishStateMachine;
 
-    core1_state_t next_state = state;
-    pwm_specs_core_msg_t msg;
+    // Programs are only replaced while stopped.
+    if (!state_machine.running())
+    {
+        state_machine_program_msg_t program;
+        if (queue_try_remove(&state_machine_program_queue, &program))
+            state_machine.load(program.states, program.num_states);
+    }
+    uint64_t time_us = time_us_64_unsafe();
+    sm_event_t event;
+    bool changed;
+    if (stop)
+        changed = state_machine.stop(event);
+    else if (start && !state_machine.running())
+        changed = state_machine.start(uint32_t(time_us), gpio_get_all(), event);
+    else
+        changed = state_machine.update(uint32_t(time_us), gpio_get_all(),
+                                       state == RUNNING, event);
+    if (!changed)
+        return;
+    state_machine_event_msg_t event_msg{event, time_us};
+    queue_try_add(&state_machine_event_queue, &event_msg);
+    if (!state_machine.running())
+        return;
+    // Entry actions.
+    const sm_state_t& entered = state_machine.current();
+    uint32_t set_pins = entered.set_channels;
+    uint32_t clear_pins = entered.clear_channels;
+    gpio_put_masked(set_pins | clear_pins, set_pins);
+    uint8_t action = entered.schedule;
+    if (action == SM::SCHEDULE_NONE)
+        return;
+    if (state == RUNNING)
+    {
+        // Stop (or restart) the schedule as if core0 had stopped it.
+        scheduler.stop();
+        schedule_changed = true;
+        state = READY;
+        core1_next_state_msg_t msg{READY, time_us_64_unsafe()};
+        queue_try_add(&core1_next_state_queue, &msg);
+    }
+    if (action == SM::SCHEDULE_STOP)
+        return;
+    if (action & SM::SCHEDULE_SLOT)
+        load_schedule_slot(action & ~SM::SCHEDULE_SLOT);
+    // Refuse to start schedules that cannot be executed on time.
+    if (schedule_report.error != uint8_t(schedule_error_t::NONE))
+    {
+        uint8_t error = schedule_report.error;
+        queue_try_add(&schedule_error_queue, &error);
+        return;
+    }
+    trial_repeat.start();
+    core1_next_state_msg_t msg{RUNNING, start_schedule()};
+    queue_try_add(&core1_next_state_queue, &msg);
+    state = RUNNING;
+}
+
+
+bool start_cancelled()
+{
+    pwm_ctrl_msg_t ctrl_msg;
+    if (!queue_try_peek(&core1_ctrl_queue, &ctrl_msg)
+        || (ctrl_msg != pwm_ctrl_msg_t::STOP))
+        return false;
+    queue_try_remove(&core1_ctrl_queue, &ctrl_msg);
+    return true;
+}
+
+
+void __not_in_flash_func(run_task_loop)()
+{
+    using enum core1_state_t;
 
     //Get input from core0 control queue.
     pwm_ctrl_msg_t ctrl_msg;
     bool new_ctrl_msg = queue_try_remove(&core1_ctrl_queue, &ctrl_msg);
+    // The trial state machine runs next to the schedule and may start or
+    // stop it.
+    if (state != RESET)
+    {
+        bool start_sm = new_ctrl_msg
+                        && (ctrl_msg == pwm_ctrl_msg_t::START_STATE_MACHINE);
+        bool stop_sm = new_ctrl_msg
+                       && (ctrl_msg == pwm_ctrl_msg_t::STOP_STATE_MACHINE);
+        run_state_machine(start_sm, stop_sm);
+        if (start_sm || stop_sm)
+            new_ctrl_msg = false;
+    }
+    bool stop_requested = new_ctrl_msg && (ctrl_msg == pwm_ctrl_msg_t::STOP);
+
+    core1_state_t next_state = state;
 
     // state-transition logic and calculate next-state.
     switch (state)
@@ -101,8 +420,8 @@ void __not_in_flash_func(run_task_loop)()
         case RUNNING:
             if (schedule_failed)
                 next_state = RESET;
-            else if (scheduler.finished() ||
-                    ((new_ctrl_msg) && (ctrl_msg == pwm_ctrl_msg_t::STOP)))
+            else if ((scheduler.finished() && !trial_repeat.waiting())
+                     || stop_requested)
                 next_state = READY;
             break;
         default:
@@ -113,30 +432,123 @@ void __not_in_flash_func(run_task_loop)()
     switch (state)
     {
         case RESET:
+        {
             schedule_failed = false;
+            schedule_changed = true;
             scheduler.reset();
+            // The state machine's schedules are gone.
+            state_machine_event_msg_t event_msg{{}, time_us_64_unsafe()};
+            if (state_machine.stop(event_msg.event))
+                queue_try_add(&state_machine_event_queue, &event_msg);
             break;
+        }
         case READY:
             sync_schedule();
+            // Refuse to start schedules that cannot be executed on time, or
+            // whose start core0 already gave up on (i.e: while we analyzed
+            // the schedule) and cancelled.
+            if ((next_state == RUNNING)
+                && ((schedule_report.error != uint8_t(schedule_error_t::NONE))
+                    || start_cancelled()))
+            {
+                next_state = READY;
+                core1_next_state_msg_t msg{next_state, time_us_64_unsafe()};
+                queue_try_add(&core1_next_state_queue, &msg);
+            }
             if (next_state == RUNNING)
             {
+#if defined(PROFILE_CPU)
+                isr_latency_probe.start();
+                update_cycles = 0;
+                worst_update_cycles = 0;
+                update_calls = 0;
+#endif
+                trial_repeat.start();
                 // Tell core0 we started.
-                core1_next_state_msg_t msg{next_state, time_us_64_unsafe()};
-                scheduler.start(); // Start ASAP to maximize timestamp accuracy.
+                core1_next_state_msg_t msg{next_state, start_schedule()};
                 queue_try_add(&core1_next_state_queue, &msg);
             }
             break;
         case RUNNING:
-            scheduler.update();
+        {
+            if (trial_repeat.waiting())
+            {
+                // The schedule is stopped between trials.
+                if ((next_state == RUNNING)
+                    && trial_repeat.ready(timer_hw->timerawl, gpio_get_all()))
+                    start_schedule();
+            }
+            else
+            {
+                if (scheduler.gated_outputs())
+                {
+                    uint64_t gate_time_us = time_us_64_unsafe();
+                    if (scheduler.update_gates())
+                    {
+                        gate_event_msg_t gate_msg{
+                            scheduler.open_gated_outputs(), gate_time_us};
+                        queue_try_add(&gate_event_queue, &gate_msg);
+                    }
+                }
+                uint32_t locked_outputs = scheduler.locked_outputs();
+                reference_edge_msg_t edge;
+                while (queue_try_remove(&reference_edge_queue, &edge))
+                    scheduler.lock_phase(edge.rise_pins, edge.fall_pins,
+                                         edge.time_us);
+                scheduler.check_phase_locks();
+                if (scheduler.locked_outputs() != locked_outputs)
+                {
+                    phase_lock_event_msg_t lock_msg{scheduler.locked_outputs(),
+                                                    time_us_64_unsafe()};
+                    queue_try_add(&phase_lock_event_queue, &lock_msg);
+                }
+#if defined(PROFILE_CPU)
+                uint32_t update_start = systick_hw->cvr;
+#endif
+                scheduler.update();
+#if defined(PROFILE_CPU)
+                // SysTick counts down.
+                uint32_t cycles = (update_start - systick_hw->cvr)
+                                  & IsrLatencyProbe::SYSTICK_MASK;
+                update_cycles += cycles;
+                if (cycles > worst_update_cycles)
+                    worst_update_cycles = cycles;
+                ++update_calls;
+#endif
+            }
+            // Re-arm a repeated schedule when a trial ends instead of
+            // stopping.
+            if ((next_state == READY) && !stop_requested
+                && !scheduler.stream_mode()
+                && trial_repeat.end_trial(timer_hw->timerawl))
+            {
+                scheduler.stop(); // Re-setup all tasks for the next trial.
+                next_state = RUNNING;
+            }
             if (next_state == READY)
+            {
                 scheduler.stop(); // Must call stop to re-setup all tasks.
+                schedule_changed = true; // Measured edge cost may have changed.
+            }
             if ((next_state == RESET) || (next_state == READY))
             {
                 // Tell core0 we stopped or got reset.
                 core1_next_state_msg_t msg{next_state, time_us_64_unsafe()};
                 queue_try_add(&core1_next_state_queue, &msg);
+#if defined(PROFILE_CPU)
+                printf("Alarm ISR latency: worst %lu cycles (%lu ns) over %lu "
+                       "alarms.\r\n", isr_latency_probe.worst_cycles(),
+                       (isr_latency_probe.worst_cycles() * 1000)
+                           / isr_latency_probe.cycles_per_us(),
+                       isr_latency_probe.alarms());
+                printf("update(): mean %lu cycles, worst %lu cycles over %lu "
+                       "calls.\r\n",
+                       update_calls? uint32_t(update_cycles / update_calls): 0,
+                       worst_update_cycles, update_calls);
+#endif
             }
             break;
+        }
     }
 
     // Update state.
@@ -147,6 +559,8 @@ void __not_in_flash_func(run_task_loop)()
 // Core1 main.
 void __not_in_flash_func(core1_main)()
 {
+    // Park this core (from RAM) while core0 writes the stored configuration.
+    multicore_lockout_victim_init();
     state = core1_state_t::RESET;
     while (true)
         run_task_loop();
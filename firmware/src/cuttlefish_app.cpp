@@ -1,54 +1,254 @@
 #include <cuttlefish_app.h>
 
 app_regs_t app_regs;
+bool stream_low_watermark_armed; /// send an EVENT on the next crossing.
 
-// Define "specs" per-register
-RegSpec app_reg_specs[]
-{
-    RegSpec::U8(&app_regs.port_dir,
-        Harp::read_reg_generic, write_port_dir),
-    RegSpec::U8(&app_regs.port_state,
-        read_port_state, write_port_state),
-    RegSpec::U8(&app_regs.port_set,
-        Harp::read_reg_error, write_port_set),
-    RegSpec::U8(&app_regs.port_clear,
-        Harp::read_reg_error, write_port_clear),
-    RegSpec::U8(&app_regs.enable_rising_edge_events,
-        Harp::read_reg_generic, write_enable_rising_edge_events),
-    RegSpec::U8(&app_regs.rising_edge_events,
-        Harp::read_reg_error, Harp::write_reg_error),
-    RegSpec::U8(&app_regs.enable_falling_edge_events,
-        Harp::read_reg_generic, write_enable_falling_edge_events),
-    RegSpec::U8(&app_regs.falling_edge_events,
-        Harp::read_reg_error, Harp::write_reg_error),
-    RegSpec::U8(&app_regs.pwm_state,
-        Harp::read_reg_generic, write_pwm_state),
-    RegSpec::U8Array(&app_regs.pwm_settings[0], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[1], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[2], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[3], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[4], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[5], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[6], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings),
-    RegSpec::U8Array(&app_regs.pwm_settings[7], sizeof(pwm_settings_t),
-        Harp::read_reg_generic, write_any_pwm_settings)
+/**
+ * \brief core0's copy of the alternative timing written to one PWM output.
+ */
+struct channel_timing_t
+{
+    pwm_random_settings_t random;
+    pwm_ramp_settings_t ramp;
+    pwm_burst_settings_t burst;
+    pwm_gate_settings_t gate;
+    pwm_phase_lock_settings_t phase_lock;
+};
+channel_timing_t channel_timing[NUM_GPIOS];
+// core0's copy of the overlays, in the order that core1 combines them. Used
+// entries (combine != 0) come first.
+pwm_overlay_settings_t pwm_overlays[PWM_OVERLAY_TASKS];
+// Pins whose edges re-anchor phase-locked outputs. Read by the edge ISR.
+volatile uint32_t reference_rise_pins;
+volatile uint32_t reference_fall_pins;
+
+/**
+ * \brief core0's copy of the registers that describe a PWM schedule.
+ * \details Used to restore the registers when a schedule slot is loaded and
+ *  to rebuild schedules from the stored configuration.
+ */
+struct schedule_regs_t
+{
+    port_t pwm_ready; /// 0 = empty schedule.
+    pwm_settings_t pwm_settings[NUM_GPIOS];
+    channel_timing_t timing[NUM_GPIOS];
+    pwm_overlay_settings_t overlays[PWM_OVERLAY_TASKS];
+    uint32_t edge_merge_tolerance_us;
+};
+schedule_regs_t slot_regs[SCHEDULE_SLOT_COUNT];
+
+/**
+ * \brief a ScheduleSlot or SaveScheduleSlot write that core1 has not answered
+ *  yet.
+ * \details The schedule cannot change until core1 answers, so that the
+ *  registers still describe it when they are mirrored into (or from) a slot.
+ */
+struct slot_request_t
+{
+    bool pending;
+    bool timed_out; /// already answered with WRITE_ERROR.
+    bool start; /// start the schedule once the slot is loaded.
+    schedule_param_t param; /// SAVE_SLOT or LOAD_SLOT.
+    uint8_t slot;
+    uint32_t request_time_us;
+};
+slot_request_t slot_request;
+
+/**
+ * \brief the configuration that is kept in flash.
+ */
+struct stored_config_t
+{
+    port_t port_dir;
+    port_t enable_rising_edge_events;
+    port_t enable_falling_edge_events;
+    port_t enable_output_edge_events;
+    uint32_t stream_low_watermark;
+    uint8_t boot_action;
+    pwm_trial_settings_t trial;
+    latency_compensation_t latency_compensation;
+    schedule_regs_t schedule;
+    schedule_regs_t slots[SCHEDULE_SLOT_COUNT];
 };
+stored_config_t stored_config; // Too big for the stack.
+
+// Reserve the last flash sectors for the stored configuration.
+inline constexpr size_t CONFIG_FLASH_SIZE =
+    ((sizeof(config_store_header_t) + sizeof(stored_config_t)
+      + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE) * FLASH_SECTOR_SIZE;
+PicoFlash config_flash(PICO_FLASH_SIZE_BYTES - CONFIG_FLASH_SIZE,
+                       CONFIG_FLASH_SIZE);
+ConfigStore<PicoFlash> config_store(config_flash, CONFIG_STORE_VERSION);
+
+PortSampler port_sampler;
+SampleRleEncoder<LOGIC_ANALYZER_BATCH_RUNS> sample_encoder;
+
+uint8_t state_machine_states; /// in the uploaded program. 0 = none.
+
+LoopbackCalibration loopback_calibration;
+// What a loopback calibration sets aside and puts back when it finishes.
+schedule_regs_t calibration_schedule;
+port_t calibration_port_dir;
+latency_compensation_t calibration_compensation;
+uint64_t calibration_end_us; /// when the calibration's results are taken.
+// Subtracted from edge interrupt timestamps. Read by the edge ISR.
+volatile uint32_t input_latency_us;
+
+EdgeCapture edge_capture;
+EdgeCapture::Decoder capture_decoder;
+uint64_t capture_next_record; /// index of the next record to decode.
+size_t capture_batch_size; /// edges in app_regs.input_capture_events.
+uint64_t capture_batch_time_us; /// time of the first edge in the batch.
+
+/**
+ * \brief RegSpec for a port register, sized to fit one bit per channel.
+ */
+template <typename T>
+RegSpec port_reg_spec(volatile T* reg, void (*read_fn)(uint8_t),
+                      void (*write_fn)(msg_t&))
+{
+    if constexpr (sizeof(T) == sizeof(uint8_t))
+        return RegSpec::U8(reg, read_fn, write_fn);
+    else if constexpr (sizeof(T) == sizeof(uint16_t))
+        return RegSpec::U16(reg, read_fn, write_fn);
+    else
+        return RegSpec::U32(reg, read_fn, write_fn);
+}
+
+/**
+ * \brief Define "specs" per-register.
+ * \details Registers with one instance per channel are expanded for however
+ *  many channels the board has.
+ */
+template <size_t... CH>
+auto make_app_reg_specs(std::index_sequence<CH...>)
+{
+    return std::array
+    {
+        port_reg_spec(&app_regs.port_dir,
+            Harp::read_reg_generic, write_port_dir),
+        port_reg_spec(&app_regs.port_state,
+            read_port_state, write_port_state),
+        port_reg_spec(&app_regs.port_set,
+            Harp::read_reg_error, write_port_set),
+        port_reg_spec(&app_regs.port_clear,
+            Harp::read_reg_error, write_port_clear),
+        port_reg_spec(&app_regs.enable_rising_edge_events,
+            Harp::read_reg_generic, write_enable_rising_edge_events),
+        port_reg_spec(&app_regs.rising_edge_events,
+            Harp::read_reg_error, Harp::write_reg_error),
+        port_reg_spec(&app_regs.enable_falling_edge_events,
+            Harp::read_reg_generic, write_enable_falling_edge_events),
+        port_reg_spec(&app_regs.falling_edge_events,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U8(&app_regs.pwm_state,
+            Harp::read_reg_generic, write_pwm_state),
+        RegSpec::U8Array(&app_regs.pwm_settings[CH], sizeof(pwm_settings_t),
+            Harp::read_reg_generic, write_any_pwm_settings)...,
+        RegSpec::U8Array(&app_regs.schedule_diagnostics,
+            sizeof(feasibility_report_t),
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U32(&app_regs.edge_merge_tolerance_us,
+            Harp::read_reg_generic, write_edge_merge_tolerance_us),
+        port_reg_spec(&app_regs.enable_output_edge_events,
+            Harp::read_reg_generic, write_enable_output_edge_events),
+        RegSpec::U32Array(&app_regs.output_edge_events,
+            3 * OUTPUT_EVENT_BATCH_SIZE,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U32(&app_regs.output_edge_events_dropped,
+            read_output_edge_events_dropped, Harp::write_reg_error),
+        RegSpec::U8(&app_regs.stream_mode,
+            Harp::read_reg_generic, write_stream_mode),
+        RegSpec::U32Array(&app_regs.stream_records, 3 * STREAM_BLOCK_RECORDS,
+            Harp::read_reg_error, write_stream_records),
+        RegSpec::U32(&app_regs.stream_low_watermark,
+            Harp::read_reg_generic, Harp::write_reg_generic),
+        RegSpec::U32(&app_regs.stream_low_watermark_reached,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U32(&app_regs.stream_underrun,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.pwm_random_settings,
+            sizeof(pwm_random_settings_t),
+            Harp::read_reg_generic, write_pwm_random_settings),
+        RegSpec::U8Array(&app_regs.pwm_ramp_settings,
+            sizeof(pwm_ramp_settings_t),
+            Harp::read_reg_generic, write_pwm_ramp_settings),
+        RegSpec::U8Array(&app_regs.pwm_burst_settings,
+            sizeof(pwm_burst_settings_t),
+            Harp::read_reg_generic, write_pwm_burst_settings),
+        RegSpec::U8(&app_regs.schedule_slot,
+            Harp::read_reg_generic, write_schedule_slot),
+        RegSpec::U8(&app_regs.save_schedule_slot,
+            Harp::read_reg_generic, write_save_schedule_slot),
+        RegSpec::U8(&app_regs.stored_configuration,
+            read_stored_configuration, write_stored_configuration),
+        RegSpec::U8(&app_regs.boot_action,
+            Harp::read_reg_generic, write_boot_action),
+        RegSpec::U32(&app_regs.logic_analyzer_rate_hz,
+            Harp::read_reg_generic, write_logic_analyzer_rate_hz),
+        RegSpec::U32Array(&app_regs.logic_analyzer_samples,
+            2 * LOGIC_ANALYZER_BATCH_RUNS,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U32(&app_regs.logic_analyzer_overflow,
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.pwm_gate_settings,
+            sizeof(pwm_gate_settings_t),
+            Harp::read_reg_generic, write_pwm_gate_settings),
+        port_reg_spec(&app_regs.pwm_gate_state,
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.pwm_phase_lock_settings,
+            sizeof(pwm_phase_lock_settings_t),
+            Harp::read_reg_generic, write_pwm_phase_lock_settings),
+        port_reg_spec(&app_regs.pwm_phase_lock_state,
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.pwm_phase_lock_statistics,
+            sizeof(phase_lock_stats_t),
+            read_pwm_phase_lock_statistics, Harp::write_reg_error),
+        RegSpec::U8(&app_regs.output_engine,
+            Harp::read_reg_generic, write_output_engine),
+        RegSpec::U8(&app_regs.input_capture,
+            Harp::read_reg_generic, write_input_capture),
+        RegSpec::U32Array(&app_regs.input_capture_events,
+            3 * INPUT_CAPTURE_BATCH_SIZE,
+            Harp::read_reg_error, Harp::write_reg_error),
+        RegSpec::U32(&app_regs.input_capture_overflow,
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.pwm_overlay_settings,
+            sizeof(pwm_overlay_settings_t),
+            Harp::read_reg_generic, write_pwm_overlay_settings),
+        RegSpec::U8Array(&app_regs.pwm_trial_settings,
+            sizeof(pwm_trial_settings_t),
+            Harp::read_reg_generic, write_pwm_trial_settings),
+        RegSpec::U32(&app_regs.pwm_trial_start,
+            Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.state_machine_program,
+            sizeof(app_regs.state_machine_program),
+            Harp::read_reg_generic, write_state_machine_program),
+        RegSpec::U8(&app_regs.state_machine_control,
+            Harp::read_reg_generic, write_state_machine_control),
+        RegSpec::U8Array(&app_regs.state_machine_transition,
+            sizeof(sm_event_t), Harp::read_reg_generic, Harp::write_reg_error),
+        RegSpec::U8Array(&app_regs.loopback_calibration,
+            sizeof(loopback_calibration_t),
+            Harp::read_reg_generic, write_loopback_calibration),
+        RegSpec::U32Array(&app_regs.latency_compensation, 2,
+            Harp::read_reg_generic, write_latency_compensation),
+        RegSpec::U8Array(&app_regs.latency_statistics,
+            sizeof(latency_stats_t),
+            Harp::read_reg_generic, Harp::write_reg_error)
+    };
+}
 
-const size_t APP_REG_COUNT = sizeof(app_reg_specs) / sizeof(RegSpec);
+auto app_reg_spec_table = make_app_reg_specs(std::make_index_sequence<NUM_GPIOS>{});
+RegSpec* const app_reg_specs = app_reg_spec_table.data();
+const size_t APP_REG_COUNT = std::tuple_size_v<decltype(app_reg_spec_table)>;
 
-inline void set_io_port_dir(uint8_t port_dir)
+inline void set_io_port_dir(port_t port_dir)
 {
     // Set both buffer ctrl pins and corresponding IO pins to match.
     // Omit setting direction of pins used by existing PWM Tasks.
     gpio_put_masked(PORT_DIR_MASK, uint32_t(port_dir) << PORT_DIR_BASE);
-    gpio_set_dir_masked(PORT_MASK, uint32_t(port_dir) << PORT_BASE);
+    gpio_set_dir_masked(PORT_MASK, Port::to_gpio(port_dir));
 }
 
 void write_port_dir(msg_t& msg)
@@ -63,7 +263,7 @@ void write_port_dir(msg_t& msg)
 void read_port_state(uint8_t reg_address)
 {
     // Include the state of pins driven by PWMTasks.
-    app_regs.port_state = uint8_t(gpio_get_all() >> PORT_BASE);
+    app_regs.port_state = Port::to_port(gpio_get_all());
     if (!Harp::is_muted())
         Harp::send_harp_reply(READ, reg_address);
 }
@@ -73,12 +273,12 @@ void write_port_state(msg_t& msg)
 {
     Harp::copy_msg_payload_to_register(msg);
     // write to output pins
-    gpio_put_masked(uint32_t(app_regs.port_dir) << PORT_BASE,
-                    uint32_t(app_regs.port_state) << PORT_BASE);
+    gpio_put_masked(Port::to_gpio(app_regs.port_dir),
+                    Port::to_gpio(app_regs.port_state));
     // Read back what we just wrote since it's fast.
     // Add delay for change to take effect. (May be related to slew rate).
     asm volatile("nop \n nop \n nop");
-    app_regs.port_state = uint8_t(gpio_get_all() >> PORT_BASE);
+    app_regs.port_state = Port::to_port(gpio_get_all());
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
@@ -87,8 +287,8 @@ void write_port_state(msg_t& msg)
 void write_port_set(msg_t& msg)
 {
     Harp::copy_msg_payload_to_register(msg);
-    gpio_put_masked(uint32_t(app_regs.port_set) << PORT_BASE,
-                    uint32_t(app_regs.port_set) << PORT_BASE);
+    gpio_put_masked(Port::to_gpio(app_regs.port_set),
+                    Port::to_gpio(app_regs.port_set));
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
@@ -97,20 +297,57 @@ void write_port_set(msg_t& msg)
 void write_port_clear(msg_t& msg)
 {
     Harp::copy_msg_payload_to_register(msg);
-    gpio_put_masked(uint32_t(app_regs.port_clear) << PORT_BASE, 0);
+    gpio_put_masked(Port::to_gpio(app_regs.port_clear), 0);
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
 
 
-void write_enable_rising_edge_events(msg_t& msg)
+void apply_edge_event_enables()
 {
-    Harp::copy_msg_payload_to_register(msg);
+    // Reference inputs interrupt whether or not their edges are reported.
+    uint32_t rise_pins = 0;
+    uint32_t fall_pins = 0;
+    for (const auto& timing: channel_timing)
+    {
+        if (!timing.phase_lock.mode)
+            continue;
+        uint32_t pin_mask = 1u << (timing.phase_lock.reference_channel
+                                   + PORT_BASE);
+        if (timing.phase_lock.falling_edge)
+            fall_pins |= pin_mask;
+        else
+            rise_pins |= pin_mask;
+    }
+    reference_rise_pins = rise_pins;
+    reference_fall_pins = fall_pins;
+    // Captured edges are reported by the PIO state machine instead.
+    port_t rise_events = app_regs.input_capture?
+        0: app_regs.enable_rising_edge_events;
+    port_t fall_events = app_regs.input_capture?
+        0: app_regs.enable_falling_edge_events;
+    // A loopback calibration times its input's edges both ways.
+    if (loopback_calibration.running())
+    {
+        rise_events |= port_t(loopback_calibration.pin_mask());
+        fall_events |= port_t(loopback_calibration.pin_mask());
+    }
     for (size_t i = 0; i < NUM_GPIOS; ++i)
     {
-        bool enabled = ((app_regs.enable_rising_edge_events >> i) & 1u);
-        gpio_set_irq_enabled(i + PORT_BASE, GPIO_IRQ_EDGE_RISE, enabled);
+        bool rise_enabled = ((rise_events >> i) & 1u)
+                            || ((rise_pins >> (i + PORT_BASE)) & 1u);
+        bool fall_enabled = ((fall_events >> i) & 1u)
+                            || ((fall_pins >> (i + PORT_BASE)) & 1u);
+        gpio_set_irq_enabled(i + PORT_BASE, GPIO_IRQ_EDGE_RISE, rise_enabled);
+        gpio_set_irq_enabled(i + PORT_BASE, GPIO_IRQ_EDGE_FALL, fall_enabled);
     }
+}
+
+
+void write_enable_rising_edge_events(msg_t& msg)
+{
+    Harp::copy_msg_payload_to_register(msg);
+    apply_edge_event_enables();
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
@@ -121,19 +358,80 @@ void write_enable_rising_edge_events(msg_t& msg)
 void write_enable_falling_edge_events(msg_t& msg)
 {
     Harp::copy_msg_payload_to_register(msg);
-    for (size_t i = 0; i < NUM_GPIOS; ++i)
-    {
-        bool enabled = ((app_regs.enable_falling_edge_events >> i) & 1u);
-        gpio_set_irq_enabled(i + PORT_BASE, GPIO_IRQ_EDGE_FALL, enabled);
-    }
+    apply_edge_event_enables();
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void write_enable_output_edge_events(msg_t& msg)
+{
+    Harp::copy_msg_payload_to_register(msg);
+    output_event_log_enabled = (app_regs.enable_output_edge_events != 0);
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
 
 
+void read_output_edge_events_dropped(uint8_t reg_address)
+{
+    app_regs.output_edge_events_dropped = output_event_log_drops;
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(READ, reg_address);
+}
+
+
+void send_output_edge_events()
+{
+    // Wait until we have a full batch or the oldest record is getting stale.
+    const OutputEvent* oldest = output_event_log.peek();
+    if (oldest == nullptr)
+        return;
+    if ((output_event_log.size() < OUTPUT_EVENT_BATCH_SIZE) &&
+        (time_us_32_fast() - oldest->time_us < OUTPUT_EVENT_FLUSH_US))
+        return;
+    uint32_t batch_time_us = oldest->time_us;
+    size_t num_records = 0;
+    OutputEvent event;
+    while ((num_records < OUTPUT_EVENT_BATCH_SIZE)
+           && output_event_log.pop(event))
+    {
+        // Filter for enabled channels.
+        port_t mask = Port::to_port(event.mask)
+                      & app_regs.enable_output_edge_events;
+        if (!mask)
+            continue;
+        // Index the (packed) register directly: it may be unaligned.
+        size_t record = 3 * num_records;
+        app_regs.output_edge_events[record] = event.time_us - batch_time_us;
+        app_regs.output_edge_events[record + 1] = mask;
+        app_regs.output_edge_events[record + 2] =
+            Port::to_port(event.state) & mask;
+        ++num_records;
+    }
+    if ((num_records == 0) || Harp::is_muted())
+        return;
+    uint64_t harp_time_us =
+        Harp::system_to_harp_us_64(extend_time_us_32(batch_time_us));
+    harp_tx_batch.add(EVENT, OUTPUT_EDGE_EVENTS_ADDRESS,
+                      (volatile uint8_t*)app_regs.output_edge_events,
+                      num_records * 3 * sizeof(uint32_t), U32,
+                      harp_time_us);
+}
+
+
 void write_pwm_state(msg_t& msg)
 {
     using enum pwm_ctrl_msg_t;
+    // Error if the trial state machine or a calibration owns the schedule,
+    // or a slot is being loaded.
+    if (app_regs.state_machine_control || app_regs.loopback_calibration.run
+        || slot_request.pending)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
     uint8_t old_state = app_regs.pwm_state;
     Harp::copy_msg_payload_to_register(msg);
     uint8_t& new_state = app_regs.pwm_state;
@@ -151,13 +449,35 @@ void write_pwm_state(msg_t& msg)
             Harp::send_harp_reply(WRITE, msg.header.address);
         return;
     }
-    // Error if we have never specified any PWM Settings
-    if (!app_regs.pwm_ready)
+    // Error if we have never specified any PWM Settings (or stream records).
+    if (!app_regs.pwm_ready && !app_regs.stream_mode)
     {
         if (!Harp::is_muted())
             Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
+    uint64_t timestamp_us;
+    msg_type_t harp_reply_type = request_pwm_state(old_state, new_state,
+                                                   timestamp_us);
+    if (Harp::is_muted())
+        return;
+    // Error if core1 timed out. Core1 unresponsive?
+    if (timestamp_us == 0)
+    {
+        Harp::send_harp_reply(harp_reply_type, msg.header.address);
+        return;
+    }
+    Harp::send_harp_reply(harp_reply_type, msg.header.address,
+                          Harp::system_to_harp_us_64(timestamp_us));
+}
+
+
+msg_type_t request_pwm_state(uint8_t old_state, uint8_t new_state,
+                             uint64_t& timestamp_us)
+{
+    using enum pwm_ctrl_msg_t;
+    timestamp_us = 0;
+    app_regs.pwm_state = old_state; // Until core1 says otherwise.
     // Send Core1 message to start the schedule.
     pwm_ctrl_msg_t ctrl_msg = (new_state > 0) ? START: STOP;
     queue_try_add(&core1_ctrl_queue, &ctrl_msg);
@@ -168,8 +488,7 @@ void write_pwm_state(msg_t& msg)
     {
         if (!queue_try_remove(&core1_next_state_queue, &state_change_msg))
             continue;
-        if (Harp::is_muted())
-            return;
+        timestamp_us = state_change_msg.timestamp_us;
         // Deduce outcome success / failure.
         // Cmd stop & result stop (ready) ? --> success
         // Cmd start & result running ? --> success
@@ -178,17 +497,272 @@ void write_pwm_state(msg_t& msg)
             harp_reply_type = WRITE;
         if (new_state == 0 && state_change_msg.next_state == core1_state_t::READY)
             harp_reply_type = WRITE;
-        Harp::send_harp_reply(harp_reply_type, msg.header.address,
-            Harp::system_to_harp_us_64(state_change_msg.timestamp_us));
+        // Expose the admission control verdict. Core1 rejects schedules that
+        // it cannot execute on time.
+        if (new_state > 0)
+            app_regs.schedule_diagnostics = schedule_report;
+        // Core1 stopped playing the stream, so we (the ring's producer) can
+        // drop the records that it never played. A refused start keeps them.
+        if ((new_state == 0)
+            && (state_change_msg.next_state != core1_state_t::RUNNING))
+            waveform_stream.discard();
+        if (harp_reply_type == WRITE)
+        {
+            app_regs.pwm_state = new_state;
+            if (new_state > 0)
+                stream_low_watermark_armed = true; // Report a short prefill too.
+        }
+        return harp_reply_type;
+    }
+    // Cancel a start that core1 has not acted on yet, so that it cannot start
+    // after we reported that it did not. A late answer arrives in
+    // update_app_state().
+    if (new_state > 0)
+    {
+        ctrl_msg = STOP;
+        queue_try_add(&core1_ctrl_queue, &ctrl_msg);
+    }
+    return WRITE_ERROR;
+}
+
+
+bool request_schedule_slot(schedule_param_t request, uint8_t slot)
+{
+    // Error if the answer would be taken from a pending slot write.
+    if (slot_request.pending)
+        return false;
+    // Drop a late answer to an earlier request.
+    bool success = false;
+    while (queue_try_remove(&schedule_slot_ack_queue, &success)) {}
+    schedule_config_msg_t config{request, slot};
+    if (!queue_try_add(&schedule_config_queue, &config))
+        return false;
+    uint32_t start_time_us = time_us_32_fast();
+    while (time_us_32_fast() - start_time_us < SCHEDULE_SLOT_TIMEOUT_US)
+    {
+        if (queue_try_remove(&schedule_slot_ack_queue, &success))
+            return success;
+    }
+    return false;
+}
+
+
+bool send_slot_request(schedule_param_t request, uint8_t slot, bool start)
+{
+    // Drop a late answer to an earlier request.
+    bool success;
+    while (queue_try_remove(&schedule_slot_ack_queue, &success)) {}
+    schedule_config_msg_t config{request, slot};
+    if (!queue_try_add(&schedule_config_queue, &config))
+        return false;
+    slot_request = {true, false, start, request, slot, time_us_32_fast()};
+    return true;
+}
+
+
+void finish_slot_request()
+{
+    if (!slot_request.pending)
+        return;
+    uint8_t address = (slot_request.param == schedule_param_t::LOAD_SLOT)
+                      ? SCHEDULE_SLOT_ADDRESS: SAVE_SCHEDULE_SLOT_ADDRESS;
+    bool success;
+    if (!queue_try_remove(&schedule_slot_ack_queue, &success))
+    {
+        // Answer the write in time, but keep waiting for core1, which may
+        // still act on the request.
+        if (!slot_request.timed_out && (time_us_32_fast()
+            - slot_request.request_time_us >= SCHEDULE_SLOT_TIMEOUT_US))
+        {
+            slot_request.timed_out = true;
+            if (!Harp::is_muted())
+                Harp::send_harp_reply(WRITE_ERROR, address);
+        }
+        return;
+    }
+    slot_request.pending = false;
+    // Mirror what core1 did in the registers.
+    uint8_t slot = slot_request.slot;
+    if (success && (slot_request.param == schedule_param_t::LOAD_SLOT))
+    {
+        app_regs.schedule_slot = slot;
+        load_schedule_regs(slot_regs[slot]);
+    }
+    else if (success)
+        save_schedule_regs(slot_regs[slot]);
+    // Report a late success that the error reply denied. It does not start.
+    if (slot_request.timed_out)
+    {
+        if (success && !Harp::is_muted())
+            harp_tx_batch.add(EVENT, address);
+        return;
+    }
+    if (!success || !slot_request.start)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(success? WRITE: WRITE_ERROR, address);
+        return;
+    }
+    uint64_t timestamp_us;
+    msg_type_t harp_reply_type = request_pwm_state(0, 1, timestamp_us);
+    if (Harp::is_muted())
+        return;
+    if (timestamp_us == 0)
+    {
+        Harp::send_harp_reply(harp_reply_type, address);
+        return;
+    }
+    Harp::send_harp_reply(harp_reply_type, address,
+                          Harp::system_to_harp_us_64(timestamp_us));
+}
+
+
+bool schedule_busy()
+{
+    return app_regs.pwm_state || slot_request.pending
+           || app_regs.loopback_calibration.run
+           || app_regs.state_machine_control;
+}
+
+
+void save_schedule_regs(schedule_regs_t& regs)
+{
+    regs.pwm_ready = app_regs.pwm_ready;
+    for (size_t i = 0; i < NUM_GPIOS; ++i)
+    {
+        regs.pwm_settings[i] = app_regs.pwm_settings[i];
+        regs.timing[i] = channel_timing[i];
+    }
+    for (size_t i = 0; i < PWM_OVERLAY_TASKS; ++i)
+        regs.overlays[i] = pwm_overlays[i];
+    regs.edge_merge_tolerance_us = app_regs.edge_merge_tolerance_us;
+}
+
+
+void load_schedule_regs(const schedule_regs_t& regs)
+{
+    app_regs.pwm_ready = regs.pwm_ready;
+    for (size_t i = 0; i < NUM_GPIOS; ++i)
+    {
+        app_regs.pwm_settings[i] = regs.pwm_settings[i];
+        channel_timing[i] = regs.timing[i];
+    }
+    for (size_t i = 0; i < PWM_OVERLAY_TASKS; ++i)
+        pwm_overlays[i] = regs.overlays[i];
+    app_regs.edge_merge_tolerance_us = regs.edge_merge_tolerance_us;
+    app_regs.port_dir |= regs.pwm_ready;
+    set_io_port_dir(app_regs.port_dir);
+    apply_edge_event_enables(); // Reference inputs may have changed.
+}
+
+
+bool restore_schedule(const schedule_regs_t& regs)
+{
+    if (!request_schedule_slot(schedule_param_t::CLEAR_SCHEDULE, 0))
+        return false;
+    app_regs.pwm_ready = 0;
+    for (auto& overlay: pwm_overlays)
+        overlay = pwm_overlay_settings_t();
+    bool success = true;
+    for (size_t i = 0; i < NUM_GPIOS; ++i)
+    {
+        app_regs.pwm_settings[i] = regs.pwm_settings[i];
+        channel_timing[i] = channel_timing_t();
+        if (!((regs.pwm_ready >> i) & 1u))
+            continue;
+        success &= apply_pwm_settings(i);
+        // Replay only the timing that is enabled. Random and ramped timing
+        // are never both enabled.
+        channel_timing_t timing = regs.timing[i];
+        if (timing.random.distribution)
+            success &= apply_pwm_random_settings(timing.random);
+        if (timing.ramp.profile)
+            success &= apply_pwm_ramp_settings(timing.ramp);
+        if (timing.burst.pulses_per_burst)
+            success &= apply_pwm_burst_settings(timing.burst);
+        if (timing.gate.mode)
+            success &= apply_pwm_gate_settings(timing.gate);
+        if (timing.phase_lock.mode)
+            success &= apply_pwm_phase_lock_settings(timing.phase_lock);
+    }
+    // Overlays combine in the order they were added.
+    for (const auto& overlay: regs.overlays)
+    {
+        if (overlay.combine)
+            success &= apply_pwm_overlay_settings(overlay);
+    }
+    app_regs.edge_merge_tolerance_us = regs.edge_merge_tolerance_us;
+    success &= apply_edge_merge_tolerance_us();
+    return success;
+}
+
+
+void write_schedule_slot(msg_t& msg)
+{
+    uint8_t old_slot = app_regs.schedule_slot;
+    Harp::copy_msg_payload_to_register(msg);
+    uint8_t slot = app_regs.schedule_slot & ~SCHEDULE_SLOT_START;
+    bool start = app_regs.schedule_slot & SCHEDULE_SLOT_START;
+    app_regs.schedule_slot = old_slot;
+    // Error if core1 is busy or the slot is empty. Otherwise the reply
+    // follows once core1 has loaded the slot.
+    if (schedule_busy() || app_regs.stream_mode
+        || (slot >= SCHEDULE_SLOT_COUNT) || !slot_regs[slot].pwm_ready
+        || !send_slot_request(schedule_param_t::LOAD_SLOT, slot, start))
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+    }
+}
+
+
+void write_save_schedule_slot(msg_t& msg)
+{
+    Harp::copy_msg_payload_to_register(msg);
+    uint8_t slot = app_regs.save_schedule_slot;
+    // Error if core1 is busy or there is nothing to save. Otherwise the reply
+    // follows once core1 has saved the slot.
+    if (schedule_busy() || app_regs.stream_mode || !app_regs.pwm_ready
+        || (slot >= SCHEDULE_SLOT_COUNT)
+        || !send_slot_request(schedule_param_t::SAVE_SLOT, slot, false))
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+    }
+}
+
+
+void write_stream_mode(msg_t& msg)
+{
+    // Error if core1 is busy.
+    if (schedule_busy())
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    uint8_t old_stream_mode = app_regs.stream_mode;
+    Harp::copy_msg_payload_to_register(msg);
+    schedule_config_msg_t config{schedule_param_t::STREAM_MODE,
+                                 app_regs.stream_mode};
+    // Error if the PIO output engine would have to play the stream.
+    if ((app_regs.stream_mode && app_regs.output_engine)
+        || !queue_try_add(&schedule_config_queue, &config))
+    {
+        app_regs.stream_mode = old_stream_mode;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
-    // Error if made it this far (timed out). Core1 unresponsive?
+    // Core1 is stopped, so we (the ring's producer) can drop the records left
+    // from an earlier stream.
+    waveform_stream.discard();
     if (!Harp::is_muted())
-        Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        Harp::send_harp_reply(WRITE, msg.header.address);
 }
 
 
-void write_any_pwm_settings(msg_t& msg)
+void write_output_engine(msg_t& msg)
 {
     // Error if core1 is busy.
     if (app_regs.pwm_state)
@@ -197,119 +771,1342 @@ void write_any_pwm_settings(msg_t& msg)
             Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
+    uint8_t old_output_engine = app_regs.output_engine;
     Harp::copy_msg_payload_to_register(msg);
-    // Backtrack both data and index in the corresponding array it belongs to.
-    const RegSpec& spec = Harp::reg_address_to_spec(msg.header.address);
-    pwm_settings_t& pwm_settings = *((pwm_settings_t*)spec.base_ptr);
-    size_t pwm_index = &pwm_settings - app_regs.pwm_settings; // subtract ptrs.
-    // Record that this pwm pin is now armed.
-    app_regs.pwm_ready |= 1u << pwm_index;
-    // Mark pin as OUTPUT in app registers and update buffer ctrl pin to match.
-    app_regs.port_dir |= 1u << pwm_index;
-    set_io_port_dir(app_regs.port_dir);
-    // Push new pwm settings to core1.
-    size_t pwm_pin = pwm_index + PORT_BASE;
-    pwm_specs_core_msg_t pwm_msg(pwm_pin, pwm_settings);
-    if (!queue_try_add(&pwm_settings_queue, &pwm_msg))
+    // The PIO engine cannot take back words it has queued, so it cannot play
+    // streams, freezing gates, or phase locks.
+    bool pio_compatible = !app_regs.stream_mode;
+    for (const auto& timing: channel_timing)
     {
+        if ((timing.gate.mode == OutputGate::FREEZE) || timing.phase_lock.mode)
+            pio_compatible = false;
+    }
+    schedule_config_msg_t config{schedule_param_t::OUTPUT_ENGINE,
+                                 app_regs.output_engine};
+    if ((app_regs.output_engine > uint8_t(output_engine_t::PIO))
+        || ((app_regs.output_engine == uint8_t(output_engine_t::PIO))
+            && !pio_compatible)
+        || !queue_try_add(&schedule_config_queue, &config))
+    {
+        app_regs.output_engine = old_output_engine;
         if (!Harp::is_muted())
             Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
         return;
     }
-    // Set buffer ctrl pins to drive an output to passthrough PWM signal.
-    uint32_t buffer_mask = 1u << (PORT_DIR_BASE + pwm_index);
-    gpio_put_masked(buffer_mask, 0xFFFFFFFF);
-    // Finish write transaction successfully.
     if (!Harp::is_muted())
         Harp::send_harp_reply(WRITE, msg.header.address);
 }
 
 
-void handle_edge_event_callback(void)
+void write_stream_records(msg_t& msg)
 {
-    // FYI raw interrupt state for all 30 GPIOs is split across 4 registers
-    // (INTR0, ..., INTR3).
-    // Since Cuttlefish only has 8 consecutive GPIOS offset by a multiple of 8,
-    // we can get away with doing a single register read to access the entire
-    // interrupt state (rising, falling, high low) for the 8 pins of interest.
-    EdgeEvent event;
-    event.timestamp_us = time_us_64(); // ISR safe.
-    event.rise_pins = 0;
-    event.fall_pins = 0;
-    uint32_t intr_state = io_bank0_hw->intr[PORT_BASE >> 3];
-    uint32_t gpio_flags;
-    // Split up rising/falling edge events.
-    for (size_t i = 0; i < NUM_GPIOS; ++i)
+    // Records may be sent in partial blocks.
+    size_t num_bytes = msg.payload_length();
+    if (num_bytes > sizeof(app_regs.stream_records))
+        num_bytes = sizeof(app_regs.stream_records);
+    size_t num_records = num_bytes / (3 * sizeof(uint32_t));
+    size_t free_records = waveform_stream.capacity() - waveform_stream.size();
+    if (!app_regs.stream_mode || (num_records > free_records))
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    memcpy((void*)app_regs.stream_records, msg.payload, num_bytes);
+    // Only drive pins that are outputs.
+    uint32_t output_mask = Port::to_gpio(app_regs.port_dir);
+    for (size_t i = 0; i < num_records; ++i)
     {
-        gpio_flags = intr_state >> (i * 4); // 4 flags per gpio pin.
-        event.rise_pins |= (((gpio_flags >> 3) & 1u) << i + PORT_BASE);
-        event.fall_pins |= (((gpio_flags >> 2) & 1u) << i + PORT_BASE);
+        // Index the (packed) register directly: it may be unaligned.
+        uint32_t delta_us = app_regs.stream_records[3 * i];
+        uint32_t record_mask = app_regs.stream_records[3 * i + 1];
+        uint32_t record_state = app_regs.stream_records[3 * i + 2];
+        if (!(delta_us | record_mask | record_state))
+            continue; // padding
+        uint32_t mask = Port::to_gpio(port_t(record_mask)) & output_mask;
+        waveform_stream.push({delta_us, mask,
+                              Port::to_gpio(port_t(record_state)) & mask});
     }
-    // Push the event
-    queue_try_add(&edge_event_queue, &event);
-    // Clear the INTR[n] state since we dealt with all pin changes.
-    // Clear by "writing a 1" to the set bits.
-    io_bank0_hw->intr[PORT_BASE >> 3] = 0xFFFFFFFF; // >> 3: floor-divide by 8
+    if (waveform_stream.size() > app_regs.stream_low_watermark)
+        stream_low_watermark_armed = true;
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
 }
 
 
-void update_app_state()
+void send_stream_events()
 {
-    // Check for pin state changes pushed to edge event queue.
-    // Drain queue. Warn if pin change rate is too fast.
-    EdgeEvent event;
-    while (queue_try_remove(&edge_event_queue, &event))
+    if (!app_regs.stream_mode)
+        return;
+    if (waveform_stream_underrun)
     {
-        if (Harp::is_muted())
-            continue;
-        // Copy to EVENT-only register and filter for enabled pins.
-        app_regs.rising_edge_events = uint8_t(event.rise_pins >> PORT_BASE) &
-                                       app_regs.enable_rising_edge_events;
-        app_regs.falling_edge_events = uint8_t(event.fall_pins >> PORT_BASE) &
-                                        app_regs.enable_falling_edge_events;
-        // Push queued messages from rising or falling edge events register.
-        if (app_regs.rising_edge_events)
-        {
-            uint64_t harp_time_us = Harp::system_to_harp_us_64(event.timestamp_us);
-            Harp::send_harp_reply(EVENT, RISING_EDGE_EVENTS_ADDRESS, harp_time_us);
-        }
-        if (app_regs.falling_edge_events) // filter
-        {
-            uint64_t harp_time_us = Harp::system_to_harp_us_64(event.timestamp_us);
-            Harp::send_harp_reply(EVENT, FALLING_EDGE_EVENTS_ADDRESS, harp_time_us);
-        }
+        waveform_stream_underrun = false;
+        app_regs.stream_underrun = waveform_stream_played;
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, STREAM_UNDERRUN_ADDRESS);
     }
-    // Update local state if core1 finished and send EVENT message.
-    core1_next_state_msg_t state_change_msg;
-    if (!queue_try_remove(&core1_next_state_queue, &state_change_msg))
+    // Only flag the low watermark while playing.
+    size_t queued_records = waveform_stream.size();
+    if (!app_regs.pwm_state || !stream_low_watermark_armed
+        || (queued_records > app_regs.stream_low_watermark))
         return;
-    // Clear local pwm registers and send back a reply if the schedule finishes
-    // without being stopped via external Harp command.
-    if (state_change_msg.next_state == core1_state_t::RESET)
+    stream_low_watermark_armed = false;
+    app_regs.stream_low_watermark_reached = queued_records;
+    if (!Harp::is_muted())
+        harp_tx_batch.add(EVENT, STREAM_LOW_WATERMARK_REACHED_ADDRESS);
+}
+
+
+/**
+ * \brief shared body of the handlers that change the schedule: error if
+ *  core1 is busy, else copy the payload to its register and \p apply it.
+ * \param apply returns false if it rejects the new register contents.
+ */
+template <typename Apply>
+void write_schedule_register(msg_t& msg, Apply apply)
+{
+    bool success = !schedule_busy();
+    if (success)
     {
-        app_regs.pwm_ready = 0;
-        app_regs.pwm_state = 0; // "finished"
+        Harp::copy_msg_payload_to_register(msg);
+        success = apply();
     }
-    else if (state_change_msg.next_state == core1_state_t::READY)
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(success? WRITE: WRITE_ERROR, msg.header.address);
+}
+
+
+bool apply_edge_merge_tolerance_us()
+{
+    schedule_config_msg_t config{schedule_param_t::EDGE_MERGE_TOLERANCE_US,
+                                 app_regs.edge_merge_tolerance_us};
+    return queue_try_add(&schedule_config_queue, &config);
+}
+
+
+void write_edge_merge_tolerance_us(msg_t& msg)
+{
+    write_schedule_register(msg, []()
     {
-        app_regs.pwm_state = 0; // "finished"
-        Harp::send_harp_reply(EVENT, PWM_STATE_ADDRESS,
-                              state_change_msg.timestamp_us);
-    }
+        return apply_edge_merge_tolerance_us();
+    });
 }
 
-void reset_app()
+
+bool apply_pwm_random_settings(pwm_random_settings_t& settings)
 {
-    // TODO: send core1 signal to stop?
-    // TODO: reset core1 before resetting GPIO state.
+    using enum RandomInterval::distribution_t;
+    bool exponential = (settings.distribution == EXPONENTIAL)
+                       || (settings.distribution == TRUNCATED_EXPONENTIAL);
+    // Error if the output has no PwmSettings yet or the bounds are unusable.
+    // A uniform off time needs a floor, but min + Exp(mean) may start at 0.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u)
+        || (settings.distribution > TRUNCATED_EXPONENTIAL)
+        || (settings.distribution != NONE
+            && ((!exponential && (settings.min_us == 0))
+                || (settings.min_us > settings.max_us)
+                || (exponential && (settings.mean_us == 0))
+                || channel_timing[settings.channel].phase_lock.mode)))
+        return false;
+    // Pick a seed from the (free-running) timer if none was given.
+    if (settings.seed == 0)
+    {
+        uint64_t entropy = time_us_64() * 0x9E3779B97F4A7C15ull;
+        settings.seed = uint32_t(entropy >> 32) | 1u;
+    }
+    pwm_timing_core_msg_t timing_msg;
+    timing_msg.pin = settings.channel + PORT_BASE;
+    timing_msg.mode = pwm_timing_mode_t::RANDOM_OFF_TIME;
+    timing_msg.random = settings;
+    if (!queue_try_add(&pwm_timing_queue, &timing_msg))
+        return false;
+    // Core1 also drops the ramp.
+    channel_timing[settings.channel].random = settings;
+    channel_timing[settings.channel].ramp = pwm_ramp_settings_t();
+    return true;
+}
 
-    // Drain all inter-core communication queues.
-    core1_next_state_msg_t  dummy_next_state_msg;
-    while (queue_try_remove(&core1_next_state_queue, &dummy_next_state_msg)) {}
-    pwm_ctrl_msg_t dummy_ctrl_msg;
-    while (queue_try_remove(&core1_ctrl_queue, &dummy_ctrl_msg)) {}
-    pwm_specs_core_msg_t dummy_pwm_settings;
-    while (queue_try_remove(&pwm_settings_queue, &dummy_pwm_settings)) {}
+
+void write_pwm_random_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_random_settings(app_regs.pwm_random_settings);
+    });
+}
+
+
+bool apply_pwm_ramp_settings(const pwm_ramp_settings_t& settings)
+{
+    using enum PeriodRamp::profile_t;
+    // Error if the output has no PwmSettings yet or the ramp cannot produce
+    // a nonzero on and off time.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u)
+        || (settings.profile > EXPONENTIAL)
+        || (settings.profile != NONE
+            && ((settings.start_period_us < 2) || (settings.end_period_us < 2)
+                || (settings.start_duty == 0) || (settings.end_duty == 0)
+                || (settings.start_duty >= PeriodRamp::DUTY_SCALE)
+                || (settings.end_duty >= PeriodRamp::DUTY_SCALE)
+                || channel_timing[settings.channel].phase_lock.mode)))
+        return false;
+    // Error if an exponential sweep is too flat for its length to step by a
+    // fixed ratio.
+    PeriodRamp ramp;
+    if (!ramp.configure(PeriodRamp::profile_t(settings.profile),
+                        settings.start_period_us, settings.end_period_us,
+                        settings.start_duty, settings.end_duty,
+                        settings.ramp_duration_us))
+        return false;
+    pwm_timing_core_msg_t timing_msg;
+    timing_msg.pin = settings.channel + PORT_BASE;
+    timing_msg.mode = pwm_timing_mode_t::RAMP;
+    timing_msg.ramp = settings;
+    if (!queue_try_add(&pwm_timing_queue, &timing_msg))
+        return false;
+    // Core1 also drops the random off time.
+    channel_timing[settings.channel].ramp = settings;
+    channel_timing[settings.channel].random = pwm_random_settings_t();
+    return true;
+}
+
+
+void write_pwm_ramp_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_ramp_settings(app_regs.pwm_ramp_settings);
+    });
+}
+
+
+bool apply_pwm_burst_settings(const pwm_burst_settings_t& settings)
+{
+    // Error if the output has no PwmSettings yet or a gap that is used would
+    // merge the edges around it.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u)
+        || (settings.pulses_per_burst
+            && ((BurstStructure::needs_burst_gap(settings.bursts_per_train)
+                 && (settings.burst_gap_us == 0))
+                || (BurstStructure::needs_train_gap(settings.trains)
+                    && (settings.train_gap_us == 0))
+                || channel_timing[settings.channel].phase_lock.mode)))
+        return false;
+    pwm_timing_core_msg_t timing_msg;
+    timing_msg.pin = settings.channel + PORT_BASE;
+    timing_msg.mode = pwm_timing_mode_t::BURST;
+    timing_msg.burst = settings;
+    if (!queue_try_add(&pwm_timing_queue, &timing_msg))
+        return false;
+    channel_timing[settings.channel].burst = settings;
+    return true;
+}
+
+
+void write_pwm_burst_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_burst_settings(app_regs.pwm_burst_settings);
+    });
+}
+
+
+bool apply_pwm_gate_settings(const pwm_gate_settings_t& settings)
+{
+    // Error if the output has no PwmSettings yet, the gate input is not an
+    // input, or the PIO output engine would have to freeze.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u)
+        || (settings.mode > OutputGate::FREEZE) || (settings.active_low > 1)
+        || ((settings.mode == OutputGate::FREEZE) && app_regs.output_engine)
+        || (settings.mode != OutputGate::NONE
+            && ((settings.gate_channel >= NUM_GPIOS)
+                || (settings.gate_channel == settings.channel)
+                || ((app_regs.port_dir >> settings.gate_channel) & 1u))))
+        return false;
+    pwm_timing_core_msg_t timing_msg;
+    timing_msg.pin = settings.channel + PORT_BASE;
+    timing_msg.mode = pwm_timing_mode_t::GATE;
+    timing_msg.gate = settings;
+    timing_msg.gate.gate_channel = settings.gate_channel + PORT_BASE;
+    if (!queue_try_add(&pwm_timing_queue, &timing_msg))
+        return false;
+    channel_timing[settings.channel].gate = settings;
+    return true;
+}
+
+
+void write_pwm_gate_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_gate_settings(app_regs.pwm_gate_settings);
+    });
+}
+
+
+void send_gate_events()
+{
+    gate_event_msg_t msg;
+    while (queue_try_remove(&gate_event_queue, &msg))
+    {
+        app_regs.pwm_gate_state = Port::to_port(msg.open_pins);
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, PWM_GATE_STATE_ADDRESS,
+                              Harp::system_to_harp_us_64(msg.timestamp_us));
+    }
+}
+
+
+bool apply_pwm_phase_lock_settings(const pwm_phase_lock_settings_t& settings)
+{
+    // Error if the output has no PwmSettings yet, does not have fixed timing,
+    // the reference is not an input, or the PIO output engine is selected.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u))
+        return false;
+    const channel_timing_t& timing = channel_timing[settings.channel];
+    if ((settings.mode > PhaseLock::TRACK) || (settings.falling_edge > 1)
+        || (settings.mode != PhaseLock::NONE
+            && ((settings.reference_channel >= NUM_GPIOS)
+                || (settings.reference_channel == settings.channel)
+                || ((app_regs.port_dir >> settings.reference_channel) & 1u)
+                || (settings.delay_us > INT32_MAX) || app_regs.output_engine
+                || timing.random.distribution || timing.ramp.profile
+                || timing.burst.pulses_per_burst)))
+        return false;
+    pwm_timing_core_msg_t timing_msg;
+    timing_msg.pin = settings.channel + PORT_BASE;
+    timing_msg.mode = pwm_timing_mode_t::PHASE_LOCK;
+    timing_msg.phase_lock = settings;
+    timing_msg.phase_lock.reference_channel = settings.reference_channel
+                                              + PORT_BASE;
+    if (!queue_try_add(&pwm_timing_queue, &timing_msg))
+        return false;
+    channel_timing[settings.channel].phase_lock = settings;
+    apply_edge_event_enables();
+    return true;
+}
+
+
+void write_pwm_phase_lock_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_phase_lock_settings(app_regs.pwm_phase_lock_settings);
+    });
+}
+
+
+void read_pwm_phase_lock_statistics(uint8_t reg_address)
+{
+    app_regs.pwm_phase_lock_statistics = scheduler.phase_lock_stats();
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(READ, reg_address);
+}
+
+
+void send_phase_lock_events()
+{
+    phase_lock_event_msg_t msg;
+    while (queue_try_remove(&phase_lock_event_queue, &msg))
+    {
+        app_regs.pwm_phase_lock_state = Port::to_port(msg.locked_pins);
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, PWM_PHASE_LOCK_STATE_ADDRESS,
+                              Harp::system_to_harp_us_64(msg.timestamp_us));
+    }
+}
+
+
+bool apply_pwm_overlay_settings(const pwm_overlay_settings_t& settings)
+{
+    // Error if the output has no PwmSettings yet or the overlay is unusable.
+    if ((settings.channel >= NUM_GPIOS)
+        || !((app_regs.pwm_ready >> settings.channel) & 1u)
+        || (settings.overlay >= PWM_OVERLAY_TASKS)
+        || (settings.combine > uint8_t(combine_op_t::XOR)))
+        return false;
+    size_t used = 0;
+    size_t index = PWM_OVERLAY_TASKS; // of this overlay in pwm_overlays.
+    while ((used < PWM_OVERLAY_TASKS) && pwm_overlays[used].combine)
+    {
+        if ((pwm_overlays[used].channel == settings.channel)
+            && (pwm_overlays[used].overlay == settings.overlay))
+            index = used;
+        ++used;
+    }
+    // Removing an overlay that does not exist changes nothing. Adding one
+    // needs a free task.
+    if (!settings.combine && (index == PWM_OVERLAY_TASKS))
+        return true;
+    if (settings.combine && (index == PWM_OVERLAY_TASKS)
+        && (used == PWM_OVERLAY_TASKS))
+        return false;
+    pwm_specs_core_msg_t pwm_msg(settings.channel + PORT_BASE, settings);
+    if (!queue_try_add(&pwm_settings_queue, &pwm_msg))
+        return false;
+    // Mirror core1, which appends new overlays and closes the gap of removed
+    // ones.
+    if (!settings.combine)
+    {
+        for (size_t i = index; i + 1 < used; ++i)
+            pwm_overlays[i] = pwm_overlays[i + 1];
+        pwm_overlays[used - 1] = pwm_overlay_settings_t();
+    }
+    else
+        pwm_overlays[(index == PWM_OVERLAY_TASKS)? used: index] = settings;
+    return true;
+}
+
+
+void write_pwm_overlay_settings(msg_t& msg)
+{
+    write_schedule_register(msg, []()
+    {
+        return apply_pwm_overlay_settings(app_regs.pwm_overlay_settings);
+    });
+}
+
+
+bool apply_pwm_trial_settings(pwm_trial_settings_t& settings)
+{
+    using enum RandomInterval::distribution_t;
+    bool exponential = (settings.distribution == EXPONENTIAL)
+                       || (settings.distribution == TRUNCATED_EXPONENTIAL);
+    // Error if the ITIs are unusable or the trigger is not an input. Core1
+    // compares times within half the timer's range.
+    if ((settings.repeat > 1)
+        || (settings.repeat
+            && ((settings.distribution > TRUNCATED_EXPONENTIAL)
+                || (settings.min_us > INT32_MAX)
+                || (settings.distribution != NONE
+                    && ((settings.min_us > settings.max_us)
+                        || (settings.max_us > INT32_MAX)
+                        || (exponential && (settings.mean_us == 0))))
+                || (settings.trigger > TrialRepeat::FALLING)
+                || (settings.trigger != TrialRepeat::NONE
+                    && ((settings.trigger_channel >= NUM_GPIOS)
+                        || ((app_regs.port_dir >> settings.trigger_channel)
+                            & 1u))))))
+        return false;
+    // Pick a seed from the (free-running) timer if none was given.
+    if (settings.repeat && settings.distribution && (settings.seed == 0))
+    {
+        uint64_t entropy = time_us_64() * 0x9E3779B97F4A7C15ull;
+        settings.seed = uint32_t(entropy >> 32) | 1u;
+    }
+    pwm_trial_settings_t trial_msg = settings;
+    trial_msg.trigger_channel = settings.trigger_channel + PORT_BASE;
+    return queue_try_add(&trial_settings_queue, &trial_msg);
+}
+
+
+void write_pwm_trial_settings(msg_t& msg)
+{
+    pwm_trial_settings_t old_settings = app_regs.pwm_trial_settings;
+    write_schedule_register(msg, [&old_settings]()
+    {
+        if (apply_pwm_trial_settings(app_regs.pwm_trial_settings))
+            return true;
+        app_regs.pwm_trial_settings = old_settings;
+        return false;
+    });
+}
+
+
+void send_trial_events()
+{
+    trial_event_msg_t msg;
+    while (queue_try_remove(&trial_event_queue, &msg))
+    {
+        app_regs.pwm_trial_start = msg.trial;
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, PWM_TRIAL_START_ADDRESS,
+                              Harp::system_to_harp_us_64(msg.timestamp_us));
+    }
+}
+
+
+void write_state_machine_program(msg_t& msg)
+{
+    using SM = CuttlefishStateMachine;
+    size_t num_bytes = msg.payload_length();
+    size_t num_states = num_bytes / sizeof(sm_state_t);
+    // Error if the state machine is running or the payload is not a program.
+    bool valid = !app_regs.state_machine_control && num_states
+                 && (num_states * sizeof(sm_state_t) == num_bytes)
+                 && (num_states <= STATE_MACHINE_MAX_STATES);
+    state_machine_program_msg_t program{};
+    if (valid)
+        memcpy((void*)program.states, msg.payload, num_bytes);
+    // Error if a state leads outside the program or uses missing hardware.
+    auto leads_to_state = [num_states](uint8_t next)
+        {return (next < num_states) || (next == SM::END);};
+    for (size_t i = 0; valid && (i < num_states); ++i)
+    {
+        sm_state_t& state = program.states[i];
+        uint8_t action = state.schedule;
+        valid = !((state.set_channels | state.clear_channels) >> NUM_GPIOS)
+                && ((action <= SM::SCHEDULE_START)
+                    || ((action & SM::SCHEDULE_SLOT)
+                        && ((action & ~SM::SCHEDULE_SLOT)
+                            < SCHEDULE_SLOT_COUNT)))
+                && (state.timeout_us <= INT32_MAX)
+                && (!state.timeout_us || leads_to_state(state.timeout_next));
+        for (auto& transition: state.transitions)
+        {
+            auto condition = sm_condition_t(transition.condition);
+            bool edge = (condition == sm_condition_t::RISING)
+                        || (condition == sm_condition_t::FALLING);
+            valid &= (condition <= sm_condition_t::SCHEDULE_DONE)
+                     && (!edge || (transition.channel < NUM_GPIOS))
+                     && ((condition == sm_condition_t::NONE)
+                         || leads_to_state(transition.next));
+            if (edge)
+                transition.channel += PORT_BASE;
+        }
+        state.set_channels = Port::to_gpio(port_t(state.set_channels));
+        state.clear_channels = Port::to_gpio(port_t(state.clear_channels));
+    }
+    program.num_states = num_states;
+    if (!valid || !queue_try_add(&state_machine_program_queue, &program))
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    memset((void*)app_regs.state_machine_program, 0,
+           sizeof(app_regs.state_machine_program));
+    memcpy((void*)app_regs.state_machine_program, msg.payload, num_bytes);
+    state_machine_states = num_states;
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void write_state_machine_control(msg_t& msg)
+{
+    using SM = CuttlefishStateMachine;
+    uint8_t old_control = app_regs.state_machine_control;
+    Harp::copy_msg_payload_to_register(msg);
+    uint8_t run = app_regs.state_machine_control;
+    app_regs.state_machine_control = old_control;
+    pwm_ctrl_msg_t ctrl_msg = run? pwm_ctrl_msg_t::START_STATE_MACHINE
+                                 : pwm_ctrl_msg_t::STOP_STATE_MACHINE;
+    // Stopping reports the state it stopped in, which clears the register.
+    if (!run)
+    {
+        bool success = !old_control || queue_try_add(&core1_ctrl_queue,
+                                                     &ctrl_msg);
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(success? WRITE: WRITE_ERROR,
+                                  msg.header.address);
+        return;
+    }
+    // Error if it already runs, there is no program, or the schedule runs.
+    bool valid = (run == 1) && !old_control && state_machine_states
+                 && !schedule_busy();
+    port_t outputs = 0;
+    port_t inputs = 0;
+    port_t pwm_outputs = app_regs.pwm_ready;
+    for (size_t i = 0; valid && (i < state_machine_states); ++i)
+    {
+        const sm_state_t& state = app_regs.state_machine_program[i];
+        outputs |= state.set_channels | state.clear_channels;
+        for (const auto& transition: state.transitions)
+        {
+            auto condition = sm_condition_t(transition.condition);
+            if ((condition == sm_condition_t::RISING)
+                || (condition == sm_condition_t::FALLING))
+                inputs |= 1u << transition.channel;
+        }
+        // Slots hold PWMTask schedules only.
+        uint8_t action = state.schedule;
+        if (!(action & SM::SCHEDULE_SLOT))
+            continue;
+        const schedule_regs_t& regs = slot_regs[action & ~SM::SCHEDULE_SLOT];
+        valid = regs.pwm_ready && !app_regs.stream_mode;
+        pwm_outputs |= regs.pwm_ready;
+    }
+    valid = valid && !(outputs & ~app_regs.port_dir) && !(outputs & pwm_outputs)
+            && !(inputs & (app_regs.port_dir | pwm_outputs))
+            && queue_try_add(&core1_ctrl_queue, &ctrl_msg);
+    if (!valid)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    // The slots' outputs must be outputs before core1 starts them.
+    app_regs.port_dir |= pwm_outputs;
+    set_io_port_dir(app_regs.port_dir);
+    app_regs.state_machine_control = 1;
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void send_state_machine_events()
+{
+    using SM = CuttlefishStateMachine;
+    state_machine_event_msg_t msg;
+    while (queue_try_remove(&state_machine_event_queue, &msg))
+    {
+        app_regs.state_machine_transition = msg.event;
+        if (msg.event.state == SM::END)
+            app_regs.state_machine_control = 0;
+        else
+        {
+            // Mirror the slot that core1 loaded in the registers.
+            uint8_t action =
+                app_regs.state_machine_program[msg.event.state].schedule;
+            if (action & SM::SCHEDULE_SLOT)
+            {
+                app_regs.schedule_slot = action & ~SM::SCHEDULE_SLOT;
+                load_schedule_regs(slot_regs[app_regs.schedule_slot]);
+            }
+        }
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, STATE_MACHINE_TRANSITION_ADDRESS,
+                              Harp::system_to_harp_us_64(msg.timestamp_us));
+    }
+}
+
+
+void write_loopback_calibration(msg_t& msg)
+{
+    loopback_calibration_t old_settings = app_regs.loopback_calibration;
+    bool busy = schedule_busy(); // Before the write says that we run.
+    Harp::copy_msg_payload_to_register(msg);
+    const loopback_calibration_t& settings = app_regs.loopback_calibration;
+    // Stopping early keeps the previous compensation.
+    if (!settings.run)
+    {
+        if (old_settings.run)
+            finish_loopback_calibration(false);
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE, msg.header.address);
+        return;
+    }
+    // Error if anything else uses the schedule or the edge capture, or if
+    // the input would be driven.
+    bool valid = (settings.run == 1) && !busy && !app_regs.stream_mode
+        && !app_regs.pwm_trial_settings.repeat
+        && (app_regs.output_engine == uint8_t(output_engine_t::ALARM))
+        && !app_regs.input_capture && !edge_capture.running()
+        && (settings.output_channel < NUM_GPIOS)
+        && (settings.input_channel < NUM_GPIOS)
+        && (settings.output_channel != settings.input_channel)
+        && !((app_regs.port_dir >> settings.input_channel) & 1u);
+    if (!valid || !start_loopback_calibration())
+    {
+        app_regs.loopback_calibration = old_settings;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+bool start_loopback_calibration()
+{
+    const loopback_calibration_t& settings = app_regs.loopback_calibration;
+    loopback_calibration.reset();
+    // Set the schedule and compensation aside, and measure without the
+    // compensation.
+    save_schedule_regs(calibration_schedule);
+    calibration_port_dir = app_regs.port_dir;
+    calibration_compensation = app_regs.latency_compensation;
+    app_regs.latency_compensation = latency_compensation_t();
+    apply_latency_compensation();
+    // Toggle the output every LOOPBACK_CALIBRATION_SPACING_US on its own.
+    if (!request_schedule_slot(schedule_param_t::CLEAR_SCHEDULE, 0))
+    {
+        finish_loopback_calibration(false);
+        return false;
+    }
+    app_regs.pwm_ready = 0;
+    for (auto& overlay: pwm_overlays)
+        overlay = pwm_overlay_settings_t();
+    for (auto& timing: channel_timing)
+        timing = channel_timing_t();
+    app_regs.edge_merge_tolerance_us = 0;
+    constexpr uint32_t SPACING_US = LOOPBACK_CALIBRATION_SPACING_US;
+    app_regs.pwm_settings[settings.output_channel] =
+        {SPACING_US, SPACING_US, SPACING_US, LOOPBACK_CALIBRATION_EDGES / 2, 0};
+    uint64_t start_time_us;
+    if (!apply_edge_merge_tolerance_us()
+        || !apply_pwm_settings(settings.output_channel)
+        || !start_edge_capture()
+        || (request_pwm_state(0, 1, start_time_us) != WRITE))
+    {
+        finish_loopback_calibration(false);
+        return false;
+    }
+    // The first edge rises one spacing after the start.
+    loopback_calibration.start(start_time_us + SPACING_US, SPACING_US,
+                               LOOPBACK_CALIBRATION_EDGES,
+                               1u << settings.input_channel);
+    apply_edge_event_enables();
+    calibration_end_us = start_time_us
+        + uint64_t(LOOPBACK_CALIBRATION_EDGES + 1) * SPACING_US
+        + LOOPBACK_CALIBRATION_SETTLE_US;
+    return true;
+}
+
+
+void finish_loopback_calibration(bool measured)
+{
+    // Stop the schedule if the calibration was stopped early.
+    uint64_t stop_time_us;
+    if (app_regs.pwm_state)
+        request_pwm_state(app_regs.pwm_state, 0, stop_time_us);
+    loopback_calibration.stop();
+    edge_capture.stop();
+    capture_next_record = edge_capture.records_written(); // Drop the tail.
+    app_regs.loopback_calibration.run = 0;
+    apply_edge_event_enables();
+    // Keep the new compensation only if enough edges were seen both ways.
+    latency_stats_t stats = loopback_calibration.stats();
+    app_regs.latency_statistics = stats;
+    app_regs.latency_compensation = calibration_compensation;
+    if (measured && (stats.output_edges >= LOOPBACK_CALIBRATION_MIN_EDGES)
+        && (stats.input_edges >= LOOPBACK_CALIBRATION_MIN_EDGES))
+    {
+        app_regs.latency_compensation.alarm_lead_us =
+            loopback_calibration.alarm_lead_us(MAX_ALARM_LEAD_US);
+        app_regs.latency_compensation.input_latency_us =
+            std::min(loopback_calibration.input_latency_us(),
+                     MAX_INPUT_LATENCY_US);
+    }
+    apply_latency_compensation();
+    // Put the schedule back.
+    restore_schedule(calibration_schedule);
+    app_regs.port_dir = calibration_port_dir | app_regs.pwm_ready;
+    set_io_port_dir(app_regs.port_dir);
+    if (!Harp::is_muted())
+        harp_tx_batch.add(EVENT, LATENCY_STATISTICS_ADDRESS,
+                          Harp::system_to_harp_us_64(time_us_64()));
+}
+
+
+void write_latency_compensation(msg_t& msg)
+{
+    // Error if core1 is busy or a calibration is measuring.
+    if (app_regs.pwm_state || app_regs.loopback_calibration.run)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    latency_compensation_t old_compensation = app_regs.latency_compensation;
+    Harp::copy_msg_payload_to_register(msg);
+    if (!apply_latency_compensation())
+    {
+        app_regs.latency_compensation = old_compensation;
+        apply_latency_compensation();
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+bool apply_latency_compensation()
+{
+    const latency_compensation_t& compensation = app_regs.latency_compensation;
+    if ((compensation.alarm_lead_us > MAX_ALARM_LEAD_US)
+        || (compensation.input_latency_us > MAX_INPUT_LATENCY_US))
+        return false;
+    schedule_config_msg_t config{schedule_param_t::ALARM_LEAD_US,
+                                 compensation.alarm_lead_us};
+    if (!queue_try_add(&schedule_config_queue, &config))
+        return false;
+    input_latency_us = compensation.input_latency_us;
+    return true;
+}
+
+
+bool apply_pwm_settings(size_t channel)
+{
+    // Record that this pwm pin is now armed.
+    app_regs.pwm_ready |= 1u << channel;
+    // Mark pin as OUTPUT in app registers and update buffer ctrl pin to match.
+    app_regs.port_dir |= 1u << channel;
+    set_io_port_dir(app_regs.port_dir);
+    // Push new pwm settings to core1.
+    size_t pwm_pin = channel + PORT_BASE;
+    pwm_specs_core_msg_t pwm_msg(pwm_pin, app_regs.pwm_settings[channel]);
+    if (!queue_try_add(&pwm_settings_queue, &pwm_msg))
+        return false;
+    // Set buffer ctrl pins to drive an output to passthrough PWM signal.
+    uint32_t buffer_mask = (1u << (PORT_DIR_BASE + channel)) & PORT_DIR_MASK;
+    gpio_put_masked(buffer_mask, 0xFFFFFFFF);
+    return true;
+}
+
+
+void write_any_pwm_settings(msg_t& msg)
+{
+    // Backtrack both data and index in the corresponding array it belongs to.
+    const RegSpec& spec = Harp::reg_address_to_spec(msg.header.address);
+    pwm_settings_t& pwm_settings = *((pwm_settings_t*)spec.base_ptr);
+    size_t pwm_index = &pwm_settings - app_regs.pwm_settings; // subtract ptrs.
+    write_schedule_register(msg, [pwm_index]()
+                            {return apply_pwm_settings(pwm_index);});
+}
+
+
+bool save_configuration()
+{
+    stored_config.port_dir = app_regs.port_dir;
+    stored_config.enable_rising_edge_events =
+        app_regs.enable_rising_edge_events;
+    stored_config.enable_falling_edge_events =
+        app_regs.enable_falling_edge_events;
+    stored_config.enable_output_edge_events =
+        app_regs.enable_output_edge_events;
+    stored_config.stream_low_watermark = app_regs.stream_low_watermark;
+    stored_config.boot_action = app_regs.boot_action;
+    stored_config.trial = app_regs.pwm_trial_settings;
+    stored_config.latency_compensation = app_regs.latency_compensation;
+    save_schedule_regs(stored_config.schedule);
+    for (size_t slot = 0; slot < SCHEDULE_SLOT_COUNT; ++slot)
+        stored_config.slots[slot] = slot_regs[slot];
+    return config_store.save(&stored_config, sizeof(stored_config));
+}
+
+
+bool load_configuration()
+{
+    if (!config_store.load(&stored_config, sizeof(stored_config)))
+        return false;
+    bool success = true;
+    // Compile each slot on core1 as the current schedule, then save it.
+    for (size_t slot = 0; slot < SCHEDULE_SLOT_COUNT; ++slot)
+    {
+        const schedule_regs_t& regs = stored_config.slots[slot];
+        slot_regs[slot].pwm_ready = 0;
+        if (!regs.pwm_ready)
+            continue;
+        if (!restore_schedule(regs)
+            || !request_schedule_slot(schedule_param_t::SAVE_SLOT, slot))
+        {
+            success = false;
+            continue;
+        }
+        slot_regs[slot] = regs;
+    }
+    success &= restore_schedule(stored_config.schedule);
+    // Slots may have claimed other outputs along the way.
+    app_regs.port_dir = stored_config.port_dir | app_regs.pwm_ready;
+    set_io_port_dir(app_regs.port_dir);
+    // The trigger input must be an input by now.
+    app_regs.pwm_trial_settings = stored_config.trial;
+    if (!apply_pwm_trial_settings(app_regs.pwm_trial_settings))
+    {
+        app_regs.pwm_trial_settings = pwm_trial_settings_t();
+        success = false;
+    }
+    app_regs.enable_rising_edge_events =
+        stored_config.enable_rising_edge_events;
+    app_regs.enable_falling_edge_events =
+        stored_config.enable_falling_edge_events;
+    apply_edge_event_enables();
+    app_regs.enable_output_edge_events =
+        stored_config.enable_output_edge_events;
+    output_event_log_enabled = (app_regs.enable_output_edge_events != 0);
+    app_regs.stream_low_watermark = stored_config.stream_low_watermark;
+    app_regs.boot_action = stored_config.boot_action;
+    app_regs.latency_compensation = stored_config.latency_compensation;
+    if (!apply_latency_compensation())
+    {
+        app_regs.latency_compensation = latency_compensation_t();
+        apply_latency_compensation();
+        success = false;
+    }
+    return success;
+}
+
+
+void read_stored_configuration(uint8_t reg_address)
+{
+    app_regs.stored_configuration =
+        config_store.valid(sizeof(stored_config_t));
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(READ, reg_address);
+}
+
+
+void write_stored_configuration(msg_t& msg)
+{
+    using enum stored_config_cmd_t;
+    Harp::copy_msg_payload_to_register(msg);
+    auto cmd = stored_config_cmd_t(app_regs.stored_configuration);
+    bool success = false;
+    // Error if core1 is busy. Flash writes would also stall it.
+    if (!schedule_busy())
+    {
+        switch (cmd)
+        {
+            case SAVE:
+                success = save_configuration();
+                break;
+            case LOAD:
+                success = !app_regs.stream_mode && load_configuration();
+                break;
+            case ERASE:
+                config_store.erase();
+                success = true;
+                break;
+            default:
+                break;
+        }
+    }
+    app_regs.stored_configuration =
+        config_store.valid(sizeof(stored_config_t));
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(success? WRITE: WRITE_ERROR, msg.header.address);
+}
+
+
+void write_boot_action(msg_t& msg)
+{
+    uint8_t old_boot_action = app_regs.boot_action;
+    Harp::copy_msg_payload_to_register(msg);
+    if (app_regs.boot_action > uint8_t(boot_action_t::RESTORE_AND_START))
+    {
+        app_regs.boot_action = old_boot_action;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void boot_from_stored_configuration()
+{
+    using enum boot_action_t;
+    // reset_app() already read the boot action.
+    if ((app_regs.boot_action == uint8_t(NONE)) || !load_configuration())
+        return;
+    if ((app_regs.boot_action != uint8_t(RESTORE_AND_START))
+        || !app_regs.pwm_ready)
+        return;
+    uint64_t timestamp_us;
+    request_pwm_state(0, 1, timestamp_us);
+}
+
+
+void write_logic_analyzer_rate_hz(msg_t& msg)
+{
+    uint32_t old_rate_hz = app_regs.logic_analyzer_rate_hz;
+    Harp::copy_msg_payload_to_register(msg);
+    uint32_t rate_hz = app_regs.logic_analyzer_rate_hz;
+    if (rate_hz > LOGIC_ANALYZER_MAX_RATE_HZ)
+    {
+        app_regs.logic_analyzer_rate_hz = old_rate_hz;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    // Samples taken so far are still sent.
+    port_sampler.stop();
+    if (rate_hz == 0)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE, msg.header.address);
+        return;
+    }
+    // Drop the unsent tail of an earlier capture.
+    sample_encoder.reset(0);
+    app_regs.logic_analyzer_overflow = 0;
+    rate_hz = port_sampler.start(PORT_BASE, NUM_GPIOS, rate_hz);
+    app_regs.logic_analyzer_rate_hz = rate_hz;
+    if (rate_hz == 0)
+    {
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    sample_encoder.set_flush_samples(
+        (uint64_t(rate_hz) * LOGIC_ANALYZER_FLUSH_US) / 1'000'000);
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void send_logic_analyzer_events()
+{
+    uint64_t available = port_sampler.samples_written()
+                         - sample_encoder.next_index();
+    // Leave a quarter of the ring as margin for samples that arrive while
+    // encoding. Skip ahead to the newest half if that margin is used up.
+    if (available > (3 * PortSampler::RING_SAMPLES) / 4)
+    {
+        if (sample_encoder.batch_ready())
+            send_logic_analyzer_batch();
+        uint64_t dropped = available - PortSampler::RING_SAMPLES / 2;
+        uint64_t drop_time_us =
+            port_sampler.sample_time_us(sample_encoder.next_index());
+        sample_encoder.skip(dropped);
+        available -= dropped;
+        app_regs.logic_analyzer_overflow += dropped;
+        if (!Harp::is_muted())
+            harp_tx_batch.add(EVENT, LOGIC_ANALYZER_OVERFLOW_ADDRESS,
+                              Harp::system_to_harp_us_64(drop_time_us));
+    }
+    // Bound the time spent here so Harp messages are still handled promptly.
+    size_t budget = LOGIC_ANALYZER_SAMPLES_PER_UPDATE;
+    while (available && budget)
+    {
+        if (sample_encoder.batch_ready())
+            send_logic_analyzer_batch();
+        uint64_t next_index = sample_encoder.next_index();
+        size_t count = std::min({available, uint64_t(budget),
+                                 uint64_t(PortSampler::contiguous_samples(
+                                     next_index))});
+        size_t consumed = sample_encoder.push(port_sampler.sample(next_index),
+                                              count);
+        available -= consumed;
+        budget -= consumed;
+    }
+    // Send the tail once a stopped capture is fully encoded.
+    if (!port_sampler.running() && !available)
+        sample_encoder.flush();
+    if (sample_encoder.batch_ready())
+        send_logic_analyzer_batch();
+}
+
+
+void send_logic_analyzer_batch()
+{
+    const sample_run_t* runs = sample_encoder.batch();
+    size_t num_runs = sample_encoder.batch_size();
+    for (size_t i = 0; i < num_runs; ++i)
+    {
+        app_regs.logic_analyzer_samples[2 * i] = runs[i].state;
+        app_regs.logic_analyzer_samples[2 * i + 1] = runs[i].length;
+    }
+    uint64_t batch_time_us =
+        port_sampler.sample_time_us(sample_encoder.batch_start_index());
+    sample_encoder.pop_batch();
+    if (Harp::is_muted())
+        return;
+    harp_tx_batch.add(EVENT, LOGIC_ANALYZER_SAMPLES_ADDRESS,
+                      (volatile uint8_t*)app_regs.logic_analyzer_samples,
+                      num_runs * 2 * sizeof(uint32_t), U32,
+                      Harp::system_to_harp_us_64(batch_time_us));
+}
+
+
+void write_input_capture(msg_t& msg)
+{
+    uint8_t old_input_capture = app_regs.input_capture;
+    Harp::copy_msg_payload_to_register(msg);
+    if (app_regs.input_capture > 1)
+    {
+        app_regs.input_capture = old_input_capture;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    // A loopback calibration is using the edge capture.
+    if (app_regs.loopback_calibration.run)
+    {
+        app_regs.input_capture = old_input_capture;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    if (app_regs.input_capture && !edge_capture.running()
+        && !start_edge_capture())
+    {
+        app_regs.input_capture = 0;
+        if (!Harp::is_muted())
+            Harp::send_harp_reply(WRITE_ERROR, msg.header.address);
+        return;
+    }
+    else if (!app_regs.input_capture)
+    {
+        // Edges captured so far are still sent.
+        edge_capture.stop();
+    }
+    apply_edge_event_enables();
+    if (!Harp::is_muted())
+        Harp::send_harp_reply(WRITE, msg.header.address);
+}
+
+
+bool start_edge_capture()
+{
+    capture_batch_size = 0;
+    capture_next_record = 0;
+    app_regs.input_capture_overflow = 0;
+    if (!edge_capture.start())
+        return false;
+    capture_decoder.reset(clock_get_hz(clk_sys), edge_capture.start_time_us());
+    return true;
+}
+
+
+void send_input_capture_events()
+{
+    uint64_t available = edge_capture.records_written() - capture_next_record;
+    bool overflowed = edge_capture.fifo_overflowed();
+    if (overflowed)
+        app_regs.input_capture_overflow += 1; // At least one.
+    // Leave a quarter of the ring as margin for records that arrive while
+    // decoding. Skip ahead to the newest half if that margin is used up.
+    if (available > (3 * EdgeCapture::RING_RECORDS) / 4)
+    {
+        uint64_t dropped = available - EdgeCapture::RING_RECORDS / 2;
+        capture_next_record += dropped;
+        available -= dropped;
+        app_regs.input_capture_overflow += dropped;
+        capture_decoder.resync(); // Edges in between are lost.
+        overflowed = true;
+    }
+    if (overflowed && !Harp::is_muted())
+        harp_tx_batch.add(EVENT, INPUT_CAPTURE_OVERFLOW_ADDRESS);
+    // Records are at most one counter period older than now.
+    uint64_t hint_index = capture_decoder.sample_index(time_us_64());
+    // Bound the time spent here so Harp messages are still handled promptly.
+    size_t budget = INPUT_CAPTURE_RECORDS_PER_UPDATE;
+    for (; available && budget; --available, --budget)
+    {
+        captured_edge_t edge;
+        if (!capture_decoder.decode(edge_capture.record(capture_next_record++),
+                                    hint_index, edge))
+            continue;
+        // Edges captured for a loopback calibration are not reported.
+        if (loopback_calibration.running())
+        {
+            loopback_calibration.add_captured_edge(edge.time_ns,
+                                                   edge.rise_pins,
+                                                   edge.fall_pins);
+            continue;
+        }
+        // Filter for enabled pins.
+        port_t rise = port_t(edge.rise_pins)
+                      & app_regs.enable_rising_edge_events;
+        port_t fall = port_t(edge.fall_pins)
+                      & app_regs.enable_falling_edge_events;
+        if (!(rise | fall))
+            continue;
+        // Keep offsets within the flush period of the batch time.
+        if (capture_batch_size
+            && ((edge.time_ns / 1000 - capture_batch_time_us
+                 >= INPUT_CAPTURE_FLUSH_US)
+                || (capture_batch_size == INPUT_CAPTURE_BATCH_SIZE)))
+            send_input_capture_batch();
+        if (!capture_batch_size)
+            capture_batch_time_us = edge.time_ns / 1000;
+        // Index the (packed) register directly: it may be unaligned.
+        size_t record = 3 * capture_batch_size;
+        app_regs.input_capture_events[record] =
+            uint32_t(edge.time_ns - capture_batch_time_us * 1000);
+        app_regs.input_capture_events[record + 1] = rise;
+        app_regs.input_capture_events[record + 2] = fall;
+        ++capture_batch_size;
+    }
+    // Send a full batch, or one whose oldest edge is getting stale.
+    if ((capture_batch_size == INPUT_CAPTURE_BATCH_SIZE)
+        || (capture_batch_size
+            && (int64_t(time_us_64() - capture_batch_time_us)
+                >= INPUT_CAPTURE_FLUSH_US)))
+        send_input_capture_batch();
+}
+
+
+void send_input_capture_batch()
+{
+    size_t num_edges = capture_batch_size;
+    capture_batch_size = 0;
+    if (Harp::is_muted())
+        return;
+    harp_tx_batch.add(EVENT, INPUT_CAPTURE_EVENTS_ADDRESS,
+                      (volatile uint8_t*)app_regs.input_capture_events,
+                      num_edges * 3 * sizeof(uint32_t), U32,
+                      Harp::system_to_harp_us_64(capture_batch_time_us));
+}
+
+
+void handle_edge_event_callback(void)
+{
+    // FYI raw interrupt state for all 30 GPIOs is split across 4 registers
+    // (INTR0, ..., INTR3).
+    // Only the registers that hold port pins are read (a single register for
+    // 8 consecutive GPIOS offset by a multiple of 8), and the per-pin
+    // unpacking is unrolled at compile time for the port size.
+    EdgeEvent event;
+    // ISR safe. Corrected for the interrupt latency of this board.
+    event.timestamp_us = time_us_64() - input_latency_us;
+    // Split up rising/falling edge events and clear the INTR[n] state since
+    // we dealt with all pin changes.
+    Port::read_and_clear_edges(io_bank0_hw->intr, event.rise_pins,
+                               event.fall_pins);
+    // Forward edges of phase-lock reference inputs to core1.
+    uint32_t reference_rise = event.rise_pins & reference_rise_pins;
+    uint32_t reference_fall = event.fall_pins & reference_fall_pins;
+    if (reference_rise | reference_fall)
+    {
+        reference_edge_msg_t reference_edge{reference_rise, reference_fall,
+                                            uint32_t(event.timestamp_us)};
+        queue_try_add(&reference_edge_queue, &reference_edge);
+    }
+    // Push the event
+    queue_try_add(&edge_event_queue, &event);
+}
+
+
+void update_app_state()
+{
+    // Hand queued events to USB once per frame.
+    harp_tx_batch.service();
+    // Check for pin state changes pushed to edge event queue.
+    // Drain queue. Warn if pin change rate is too fast.
+    EdgeEvent event;
+    while (queue_try_remove(&edge_event_queue, &event))
+    {
+        // Edges of a loopback calibration's input are not reported.
+        port_t calibration_pins = 0;
+        if (loopback_calibration.running())
+        {
+            calibration_pins = port_t(loopback_calibration.pin_mask());
+            loopback_calibration.add_interrupt_edge(event.timestamp_us,
+                Port::to_port(event.rise_pins), Port::to_port(event.fall_pins));
+        }
+        if (Harp::is_muted())
+            continue;
+        // Copy to EVENT-only register and filter for enabled pins.
+        app_regs.rising_edge_events = Port::to_port(event.rise_pins) &
+                                       app_regs.enable_rising_edge_events &
+                                       ~calibration_pins;
+        app_regs.falling_edge_events = Port::to_port(event.fall_pins) &
+                                        app_regs.enable_falling_edge_events &
+                                        ~calibration_pins;
+        // Push queued messages from rising or falling edge events register.
+        if (app_regs.rising_edge_events)
+        {
+            uint64_t harp_time_us = Harp::system_to_harp_us_64(event.timestamp_us);
+            harp_tx_batch.add(EVENT, RISING_EDGE_EVENTS_ADDRESS, harp_time_us);
+        }
+        if (app_regs.falling_edge_events) // filter
+        {
+            uint64_t harp_time_us = Harp::system_to_harp_us_64(event.timestamp_us);
+            harp_tx_batch.add(EVENT, FALLING_EDGE_EVENTS_ADDRESS, harp_time_us);
+        }
+    }
+    // Stream port writes issued by the PWM schedule.
+    send_output_edge_events();
+    // Ask the PC for more waveform records or tell it we ran out.
+    send_stream_events();
+    // Send sampled port states.
+    send_logic_analyzer_events();
+    // Send input edges timestamped by the PIO state machine.
+    send_input_capture_events();
+    // Report gated outputs opening and closing.
+    send_gate_events();
+    // Report phase-locked outputs gaining and losing their lock.
+    send_phase_lock_events();
+    // Report the start of each trial of a repeated schedule.
+    send_trial_events();
+    // Report the trial state machine's state changes.
+    send_state_machine_events();
+    // Answer a ScheduleSlot or SaveScheduleSlot write once core1 has.
+    finish_slot_request();
+    // Latch runtime schedule failures (i.e: missed deadlines).
+    uint8_t schedule_error;
+    while (queue_try_remove(&schedule_error_queue, &schedule_error))
+        app_regs.schedule_diagnostics.error = schedule_error;
+    // Update local state if core1 finished and send EVENT message.
+    // The trial state machine also starts and stops the schedule.
+    core1_next_state_msg_t state_change_msg;
+    while (queue_try_remove(&core1_next_state_queue, &state_change_msg))
+    {
+        // Clear local pwm registers and send back a reply if the schedule
+        // finishes without being stopped via external Harp command.
+        uint64_t harp_time_us =
+            Harp::system_to_harp_us_64(state_change_msg.timestamp_us);
+        // Core1 stopped playing the stream, so we (the ring's producer) can
+        // drop the records that it never played.
+        if (state_change_msg.next_state != core1_state_t::RUNNING)
+            waveform_stream.discard();
+        if (state_change_msg.next_state == core1_state_t::RESET)
+        {
+            app_regs.pwm_ready = 0;
+            for (auto& overlay: pwm_overlays)
+                overlay = pwm_overlay_settings_t();
+            app_regs.pwm_state = 0; // "finished"
+        }
+        else if (state_change_msg.next_state == core1_state_t::READY)
+        {
+            // Only report a schedule that was running (not a cancelled start).
+            // A calibration's schedule is reported as LatencyStatistics.
+            if (app_regs.pwm_state && !app_regs.loopback_calibration.run)
+                harp_tx_batch.add(EVENT, PWM_STATE_ADDRESS, harp_time_us);
+            app_regs.pwm_state = 0; // "finished"
+        }
+        else if (state_change_msg.next_state == core1_state_t::RUNNING)
+        {
+            app_regs.pwm_state = 1;
+            harp_tx_batch.add(EVENT, PWM_STATE_ADDRESS, harp_time_us);
+        }
+    }
+    // Take the loopback calibration's results once its last edge is in.
+    if (app_regs.loopback_calibration.run && !app_regs.pwm_state
+        && (int64_t(time_us_64() - calibration_end_us) >= 0))
+        finish_loopback_calibration(true);
+}
+
+void reset_app()
+{
+    // TODO: send core1 signal to stop?
+    // TODO: reset core1 before resetting GPIO state.
+
+    // Drain all inter-core communication queues.
+    core1_next_state_msg_t  dummy_next_state_msg;
+    while (queue_try_remove(&core1_next_state_queue, &dummy_next_state_msg)) {}
+    pwm_ctrl_msg_t dummy_ctrl_msg;
+    while (queue_try_remove(&core1_ctrl_queue, &dummy_ctrl_msg)) {}
+    pwm_specs_core_msg_t dummy_pwm_settings;
+    while (queue_try_remove(&pwm_settings_queue, &dummy_pwm_settings)) {}
+    pwm_timing_core_msg_t dummy_pwm_timing;
+    while (queue_try_remove(&pwm_timing_queue, &dummy_pwm_timing)) {}
+    schedule_config_msg_t dummy_config;
+    while (queue_try_remove(&schedule_config_queue, &dummy_config)) {}
+    uint8_t dummy_error;
+    while (queue_try_remove(&schedule_error_queue, &dummy_error)) {}
+    bool dummy_ack;
+    while (queue_try_remove(&schedule_slot_ack_queue, &dummy_ack)) {}
+    slot_request = slot_request_t();
+    gate_event_msg_t dummy_gate_event;
+    while (queue_try_remove(&gate_event_queue, &dummy_gate_event)) {}
+    reference_edge_msg_t dummy_reference_edge;
+    while (queue_try_remove(&reference_edge_queue, &dummy_reference_edge)) {}
+    phase_lock_event_msg_t dummy_lock_event;
+    while (queue_try_remove(&phase_lock_event_queue, &dummy_lock_event)) {}
+    pwm_trial_settings_t dummy_trial_settings;
+    while (queue_try_remove(&trial_settings_queue, &dummy_trial_settings)) {}
+    trial_event_msg_t dummy_trial_event;
+    while (queue_try_remove(&trial_event_queue, &dummy_trial_event)) {}
+    state_machine_event_msg_t dummy_sm_event;
+    while (queue_try_remove(&state_machine_event_queue, &dummy_sm_event)) {}
+    state_machine_program_msg_t dummy_program;
+    while (queue_try_remove(&state_machine_program_queue, &dummy_program)) {}
+    harp_tx_batch.clear();
 
     // init all pins used as GPIOs.
     gpio_init_mask(PORT_MASK | PORT_DIR_MASK);
@@ -320,11 +2117,87 @@ void reset_app()
     gpio_put_masked(PORT_DIR_MASK, 0);
     // Reset Harp register struct elements.
     app_regs.port_dir = 0x00; // all inputs
-    app_regs.port_state = uint8_t(gpio_get_all() >> PORT_BASE);
+    app_regs.port_state = Port::to_port(gpio_get_all());
     app_regs.pwm_state = 0;
     app_regs.pwm_ready = 0;
     for (size_t i = 0; i < NUM_GPIOS; ++i)
         app_regs.pwm_settings[i] = pwm_settings_t();
+    app_regs.schedule_diagnostics = feasibility_report_t();
+    app_regs.pwm_random_settings = pwm_random_settings_t();
+    app_regs.pwm_ramp_settings = pwm_ramp_settings_t();
+    app_regs.pwm_burst_settings = pwm_burst_settings_t();
+    app_regs.pwm_gate_settings = pwm_gate_settings_t();
+    app_regs.pwm_gate_state = 0;
+    app_regs.pwm_phase_lock_settings = pwm_phase_lock_settings_t();
+    app_regs.pwm_phase_lock_state = 0;
+    app_regs.pwm_phase_lock_statistics = phase_lock_stats_t();
+    reference_rise_pins = 0;
+    reference_fall_pins = 0;
+    app_regs.schedule_slot = 0;
+    app_regs.save_schedule_slot = 0;
+    for (auto& regs: slot_regs)
+        regs.pwm_ready = 0;
+    for (auto& timing: channel_timing)
+        timing = channel_timing_t();
+    app_regs.pwm_overlay_settings = pwm_overlay_settings_t();
+    for (auto& overlay: pwm_overlays)
+        overlay = pwm_overlay_settings_t();
+    // Keep the stored boot action so that saving again does not drop it.
+    app_regs.stored_configuration =
+        config_store.load(&stored_config, sizeof(stored_config));
+    app_regs.boot_action = app_regs.stored_configuration?
+        stored_config.boot_action: uint8_t(boot_action_t::NONE);
+    app_regs.enable_output_edge_events = 0;
+    output_event_log_enabled = false;
+    output_event_log.clear();
+    output_event_log_drops = 0;
+    app_regs.edge_merge_tolerance_us = 0;
+    schedule_config_msg_t config{schedule_param_t::EDGE_MERGE_TOLERANCE_US, 0};
+    queue_try_add(&schedule_config_queue, &config);
+    app_regs.stream_mode = 0;
+    config = {schedule_param_t::STREAM_MODE, 0};
+    queue_try_add(&schedule_config_queue, &config);
+    app_regs.output_engine = uint8_t(output_engine_t::ALARM);
+    config = {schedule_param_t::OUTPUT_ENGINE,
+              uint8_t(output_engine_t::ALARM)};
+    queue_try_add(&schedule_config_queue, &config);
+    app_regs.pwm_trial_settings = pwm_trial_settings_t();
+    app_regs.pwm_trial_start = 0;
+    apply_pwm_trial_settings(app_regs.pwm_trial_settings);
+    // Core1 keeps its last program, but it cannot be started again.
+    for (auto& state: app_regs.state_machine_program)
+        state = sm_state_t();
+    state_machine_states = 0;
+    app_regs.state_machine_control = 0;
+    app_regs.state_machine_transition = sm_event_t();
+    pwm_ctrl_msg_t stop_msg = pwm_ctrl_msg_t::STOP_STATE_MACHINE;
+    queue_try_add(&core1_ctrl_queue, &stop_msg);
+    app_regs.stream_low_watermark = STREAM_DEFAULT_LOW_WATERMARK;
+    app_regs.stream_low_watermark_reached = 0;
+    app_regs.stream_underrun = 0;
+    stream_low_watermark_armed = false;
+    waveform_stream_underrun = false;
+    port_sampler.stop();
+    sample_encoder.reset(port_sampler.samples_written()); // Drop the tail.
+    app_regs.logic_analyzer_rate_hz = 0;
+    app_regs.logic_analyzer_overflow = 0;
+    edge_capture.stop();
+    capture_next_record = edge_capture.records_written(); // Drop the tail.
+    capture_batch_size = 0;
+    app_regs.input_capture = 0;
+    app_regs.input_capture_overflow = 0;
+    // The schedule that a calibration set aside was reset with the others.
+    loopback_calibration.reset();
+    app_regs.loopback_calibration = loopback_calibration_t();
+    app_regs.latency_statistics = latency_stats_t();
+    // Keep the stored latency compensation, which belongs to the board.
+    app_regs.latency_compensation = app_regs.stored_configuration?
+        stored_config.latency_compensation: latency_compensation_t();
+    if (!apply_latency_compensation())
+    {
+        app_regs.latency_compensation = latency_compensation_t();
+        apply_latency_compensation();
+    }
 
     // Drain the EdgeEvent queue.
     EdgeEvent dummy_event;
@@ -0,0 +1,116 @@
+#include <edge_capture.h>
+
+bool EdgeCapture::start()
+{
+    stop();
+    // Claim the hardware and load the program on first use.
+    if (sm_ < 0)
+        sm_ = pio_claim_unused_sm(pio_, false);
+    if (data_chan_ < 0)
+        data_chan_ = dma_claim_unused_channel(false);
+    if (ctrl_chan_ < 0)
+        ctrl_chan_ = dma_claim_unused_channel(false);
+    if ((sm_ < 0) || (data_chan_ < 0) || (ctrl_chan_ < 0))
+        return false;
+    if (program_offset_ < 0)
+    {
+        pio_program_t program{Program::INSTRUCTIONS, Program::LENGTH, -1};
+        if (!pio_can_add_program(pio_, &program))
+            return false;
+        program_offset_ = pio_add_program(pio_, &program);
+    }
+    pio_sm_config sm_config = pio_get_default_sm_config();
+    sm_config_set_wrap(&sm_config, program_offset_ + Program::WRAP_TARGET,
+                       program_offset_ + Program::WRAP);
+    sm_config_set_in_pins(&sm_config, PORT_BASE);
+    sm_config_set_in_shift(&sm_config, false, false, 32);
+    sm_config_set_fifo_join(&sm_config, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv_int_frac(&sm_config, 1, 0);
+    pio_sm_init(pio_, sm_, program_offset_ + Program::SAMPLE_OFFSET,
+                &sm_config);
+    pio_sm_exec(pio_, sm_, Program::INIT_X);
+    pio_sm_exec(pio_, sm_, Program::INIT_Y);
+
+    // The ctrl channel restarts the data channel each time it finishes.
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_chan_);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, false);
+    channel_config_set_write_increment(&ctrl_config, false);
+    dma_channel_configure(ctrl_chan_, &ctrl_config,
+                          &dma_hw->ch[data_chan_].al1_transfer_count_trig,
+                          &transfer_count_reload_, 1, false);
+    dma_channel_config data_config = dma_channel_get_default_config(data_chan_);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, false);
+    channel_config_set_write_increment(&data_config, true);
+    channel_config_set_ring(&data_config, true, INPUT_CAPTURE_RING_BITS);
+    channel_config_set_dreq(&data_config, pio_get_dreq(pio_, sm_, false));
+    channel_config_set_chain_to(&data_config, ctrl_chan_);
+    dma_channel_configure(data_chan_, &data_config, ring_, &pio_->rxf[sm_],
+                          TRANSFER_COUNT, true);
+
+    last_transfer_count_ = TRANSFER_COUNT;
+    records_written_ = 0;
+    pio_->fdebug = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm_); // Write 1 to clear.
+    // Start sampling on a tick of the us timer so that sample 0 lines up with
+    // the timer to within a few cycles rather than up to 1us. The wait is
+    // bounded in case the timer is stopped (i.e: by a debugger).
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint32_t last_tick_us = timer_hw->timerawl;
+    for (size_t i = 0; (i < START_TICK_SPINS)
+                       && (timer_hw->timerawl == last_tick_us); ++i) {}
+    pio_sm_set_enabled(pio_, sm_, true);
+    uint32_t tick_us = timer_hw->timerawl;
+    restore_interrupts(interrupts);
+    start_time_us_ = time_us_64();
+    start_time_us_ -= uint32_t(start_time_us_) - tick_us;
+    running_ = true;
+    return true;
+}
+
+
+void EdgeCapture::stop()
+{
+    if (!running_)
+        return;
+    records_written();
+    pio_sm_set_enabled(pio_, sm_, false);
+    // Aborting a chained channel triggers its chain (RP2040-E13), so point
+    // the data channel's chain at itself first.
+    hw_write_masked(&dma_hw->ch[data_chan_].al1_ctrl,
+                    uint32_t(data_chan_) << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB,
+                    DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS);
+    dma_channel_abort(data_chan_);
+    dma_channel_abort(ctrl_chan_);
+    pio_sm_clear_fifos(pio_, sm_);
+    running_ = false;
+}
+
+
+uint64_t EdgeCapture::records_written()
+{
+    if (!running_)
+        return records_written_;
+    uint32_t transfer_count = dma_hw->ch[data_chan_].transfer_count;
+    // The count runs down and is reloaded (at most once between calls).
+    if (transfer_count <= last_transfer_count_)
+        records_written_ += last_transfer_count_ - transfer_count;
+    else
+        records_written_ += last_transfer_count_
+                            + (TRANSFER_COUNT - transfer_count);
+    last_transfer_count_ = transfer_count;
+    return records_written_;
+}
+
+
+bool EdgeCapture::fifo_overflowed()
+{
+    if (!running_)
+        return false;
+    // A non-blocking push to a full FIFO sets the stall flag.
+    uint32_t stall_flag = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm_);
+    if (!(pio_->fdebug & stall_flag))
+        return false;
+    pio_->fdebug = stall_flag;
+    return true;
+}
@@ -0,0 +1,90 @@
+#include <harp_tx_batch.h>
+#include <harp_core.h>
+#include <pico/stdlib.h>
+#include <tusb.h>
+#include <cstring>
+
+HarpTxBatch harp_tx_batch;
+
+namespace
+{
+/**
+ * \brief what a queued message needs for HarpCore::send_harp_reply(). Its
+ *  payload follows it in the buffer.
+ */
+struct record_t
+{
+    uint64_t harp_time_us;
+    msg_type_t type;
+    uint8_t address;
+    reg_type_t payload_type;
+    uint8_t num_bytes;
+};
+
+/// Header, timestamp (seconds and 32[us] ticks), and checksum of a frame.
+constexpr size_t FRAME_OVERHEAD = 5 + 6 + 1;
+}
+
+bool HarpTxBatch::add(msg_type_t type, uint8_t address,
+                      const volatile uint8_t* data, uint8_t num_bytes,
+                      reg_type_t payload_type, uint64_t harp_time_us)
+{
+    size_t record_size = sizeof(record_t) + num_bytes;
+    if (size_ + record_size > HARP_TX_BATCH_BYTES)
+        flush();
+    if (size_ + record_size > HARP_TX_BATCH_BYTES)
+    {
+        ++dropped_;
+        return false;
+    }
+    if (size_ == 0)
+        first_time_us_ = time_us_32();
+    record_t record{harp_time_us, type, address, payload_type, num_bytes};
+    memcpy(buffer_ + size_, &record, sizeof(record));
+    for (size_t i = 0; i < num_bytes; ++i)
+        buffer_[size_ + sizeof(record) + i] = data[i];
+    size_ += record_size;
+    if (size_ >= HARP_TX_FLUSH_BYTES)
+        flush();
+    return true;
+}
+
+bool HarpTxBatch::add(msg_type_t type, uint8_t address, uint64_t harp_time_us)
+{
+    const RegSpec& spec = HarpCore::reg_address_to_spec(address);
+    return add(type, address, spec.base_ptr, spec.num_bytes, spec.payload_type,
+               harp_time_us);
+}
+
+bool HarpTxBatch::add(msg_type_t type, uint8_t address)
+{return add(type, address, HarpCore::harp_time_us_64());}
+
+void HarpTxBatch::service()
+{
+    if (size_ && (time_us_32() - first_time_us_ >= HARP_TX_FLUSH_US))
+        flush();
+}
+
+void HarpTxBatch::flush()
+{
+    if (!size_)
+        return;
+    size_t sent = 0;
+    while (sent < size_)
+    {
+        record_t record;
+        memcpy(&record, buffer_ + sent, sizeof(record));
+        if (tud_cdc_write_available() < FRAME_OVERHEAD + record.num_bytes)
+            break;
+        HarpCore::send_harp_reply(record.type, record.address,
+                                  buffer_ + sent + sizeof(record),
+                                  record.num_bytes, record.payload_type,
+                                  record.harp_time_us);
+        sent += sizeof(record) + record.num_bytes;
+    }
+    // Keep what the driver could not take, and give it another frame.
+    size_ -= sent;
+    if (size_)
+        memmove(buffer_, buffer_ + sent, size_);
+    first_time_us_ = time_us_32();
+}
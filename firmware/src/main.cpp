@@ -11,12 +11,22 @@
 #include <core1_main.h>
 
 queue_t pwm_settings_queue;
+queue_t pwm_timing_queue;
+queue_t schedule_config_queue;
 // Keep timing critical core0 to ISR data structures in RAM.
 __not_in_flash("edge_event_queue") queue_t edge_event_queue;
 // Keep timing critical core-to-core communication data structures in RAM.
 __not_in_flash("core1_ctrl_queue") queue_t core1_ctrl_queue;
 __not_in_flash("core1_next_state_queue") queue_t core1_next_state_queue;
 __not_in_flash("schedule_error_queue") queue_t schedule_error_queue;
+queue_t schedule_slot_ack_queue;
+__not_in_flash("gate_event_queue") queue_t gate_event_queue;
+__not_in_flash("reference_edge_queue") queue_t reference_edge_queue;
+__not_in_flash("phase_lock_event_queue") queue_t phase_lock_event_queue;
+queue_t trial_settings_queue;
+__not_in_flash("trial_event_queue") queue_t trial_event_queue;
+queue_t state_machine_program_queue;
+__not_in_flash("state_machine_event_queue") queue_t state_machine_event_queue;
 
 // Create Core.
 HarpCApp& app = HarpCApp::init(HARP_DEVICE_ID,
@@ -37,12 +47,25 @@ int main()
     // Configure core1 to have high priority on the bus.
     bus_ctrl_hw->priority = 0x00000010;
     // Initialize queue for edge event message handling
-    queue_init(&edge_event_queue, sizeof(EdgeEvent), 32);
+    queue_init(&edge_event_queue, sizeof(EdgeEvent), EDGE_EVENT_QUEUE_DEPTH);
     // Initialize queues for multicore communication.
     queue_init(&core1_ctrl_queue, sizeof(pwm_ctrl_msg_t), 8);
     queue_init(&core1_next_state_queue, sizeof(core1_next_state_msg_t), 8);
     queue_init(&pwm_settings_queue, sizeof(pwm_specs_core_msg_t), 32);
+    // Fits every kind of timing for every channel when restoring a schedule.
+    queue_init(&pwm_timing_queue, sizeof(pwm_timing_core_msg_t), 5 * NUM_GPIOS);
+    queue_init(&schedule_config_queue, sizeof(schedule_config_msg_t), 8);
     queue_init(&schedule_error_queue, sizeof(uint8_t), 2);
+    queue_init(&schedule_slot_ack_queue, sizeof(bool), 1);
+    queue_init(&gate_event_queue, sizeof(gate_event_msg_t), 16);
+    queue_init(&reference_edge_queue, sizeof(reference_edge_msg_t), 8);
+    queue_init(&phase_lock_event_queue, sizeof(phase_lock_event_msg_t), 16);
+    queue_init(&trial_settings_queue, sizeof(pwm_trial_settings_t), 2);
+    queue_init(&trial_event_queue, sizeof(trial_event_msg_t), 16);
+    queue_init(&state_machine_program_queue,
+               sizeof(state_machine_program_msg_t), 1);
+    queue_init(&state_machine_event_queue, sizeof(state_machine_event_msg_t),
+               16);
 #if defined(DEBUG) || defined(PROFILE_CPU)
 #warning "Initializing printf from UART will slow down core1 main loop."
     stdio_uart_init_full(DEBUG_UART, 921600, DEBUG_UART_TX_PIN, -1);
@@ -51,6 +74,7 @@ int main()
     (void)multicore_fifo_pop_blocking(); // Wait until core1 is ready.
     multicore_launch_core1(core1_main);
     reset_app(); // Setup GPIO states. Get scheduler ready.
+    boot_from_stored_configuration();
     // Loop forever.
     while(true)
         app.run();
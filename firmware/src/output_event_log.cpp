@@ -0,0 +1,7 @@
+#include <output_event_log.h>
+
+// Written from the alarm ISR. Keep in RAM.
+__not_in_flash("output_event_log")
+    SPSCRing<OutputEvent, OUTPUT_EVENT_LOG_DEPTH> output_event_log;
+__not_in_flash("output_event_log_enabled") volatile bool output_event_log_enabled;
+__not_in_flash("output_event_log_drops") volatile uint32_t output_event_log_drops;
@@ -0,0 +1,142 @@
+#include <period_ramp.h>
+#include <math.h>
+
+namespace
+{
+/**
+ * \brief on time for a period and duty cycle, leaving at least 1us on and 1us
+ *  off.
+ */
+uint32_t rounded_period_us(uint64_t period_q32)
+{return uint32_t((period_q32 + (1u << 31)) >> 32);}
+
+uint32_t duty_on_time_us(uint64_t period_q32, int64_t duty_q32)
+{
+    uint32_t period_us = rounded_period_us(period_q32);
+    uint32_t on_us = uint32_t((uint64_t(period_us) * uint64_t(duty_q32)
+                               + (1ull << 31)) >> 32);
+    if (on_us < 1)
+        on_us = 1;
+    if (on_us > period_us - 1)
+        on_us = period_us - 1;
+    return on_us;
+}
+}
+
+bool PeriodRamp::configure(profile_t profile, uint32_t start_period_us,
+                           uint32_t end_period_us, uint32_t start_duty,
+                           uint32_t end_duty, uint32_t ramp_duration_us)
+{
+    profile_ = profile;
+    start_period_q32_ = uint64_t(start_period_us) << 32;
+    end_period_q32_ = uint64_t(end_period_us) << 32;
+    start_duty_q32_ = (int64_t(start_duty) << 32) / DUTY_SCALE;
+    end_duty_q32_ = (int64_t(end_duty) << 32) / DUTY_SCALE;
+    period_step_q32_ = 0;
+    period_ratio_q32_ = 0;
+    duty_step_q32_ = 0;
+    ramp_cycles_ = 1;
+    // Only computed once per upload, so floating point is fine here.
+    double p0 = start_period_us;
+    double p1 = end_period_us;
+    double cycles = (profile_ == EXPONENTIAL) && (p0 != p1)?
+        // Sum of a geometric series from p0 to p1 (continuous approximation).
+        1.0 + ramp_duration_us * log(p1 / p0) / (p1 - p0)
+        // Sum of an arithmetic series from p0 to p1.
+        : 2.0 * ramp_duration_us / (p0 + p1);
+    if (cycles >= double(UINT32_MAX))
+        ramp_cycles_ = UINT32_MAX;
+    else if (cycles >= 1.5)
+        ramp_cycles_ = uint32_t(cycles + 0.5);
+    if (ramp_cycles_ > 1)
+    {
+        int64_t steps = ramp_cycles_ - 1;
+        duty_step_q32_ = (end_duty_q32_ - start_duty_q32_) / steps;
+        if (profile_ == EXPONENTIAL)
+        {
+            // p1 / p0 < 2^31, so (ratio - 1) < 2^31 always fits in Q32. A
+            // ratio too close to 1 would lose its precision (or round to 0)
+            // and drift over a long ramp instead.
+            double ratio_q32 = (pow(p1 / p0, 1.0 / steps) - 1.0)
+                               * 4294967296.0;
+            if ((fabs(ratio_q32) < double(1u << MIN_RATIO_BITS))
+                || (ratio_q32 >= 9223372036854775807.0))
+            {
+                profile_ = NONE;
+                ramp_cycles_ = 1;
+                duty_step_q32_ = 0;
+                restart();
+                return false;
+            }
+            period_ratio_q32_ = int64_t(llround(ratio_q32));
+        }
+        else if (end_period_q32_ >= start_period_q32_)
+            period_step_q32_ = (end_period_q32_ - start_period_q32_) / steps;
+        else // Added modulo 2^64, i.e: subtracted.
+            period_step_q32_ = -((start_period_q32_ - end_period_q32_) / steps);
+    }
+    restart();
+    return true;
+}
+
+void PeriodRamp::restart()
+{
+    cycle_ = 0;
+    period_q32_ = start_period_q32_;
+    duty_q32_ = start_duty_q32_;
+    set_cycle_times();
+}
+
+void PeriodRamp::advance()
+{
+    if (cycle_ + 1 >= ramp_cycles_)
+        return; // Hold the end values.
+    ++cycle_;
+    if (cycle_ + 1 == ramp_cycles_)
+    {
+        // Land exactly on the end values despite accumulated rounding.
+        period_q32_ = end_period_q32_;
+        duty_q32_ = end_duty_q32_;
+    }
+    else
+    {
+        if (profile_ == EXPONENTIAL)
+        {
+            // period += period * ratio. The ratio is split into its integer
+            // (floor) and fractional parts, and the period into 32-bit halves,
+            // so that every partial product fits in 64 bits. The sum is taken
+            // modulo 2^64; only the result (the next period) must fit.
+            uint64_t ratio_int = uint64_t(period_ratio_q32_ >> 32);
+            uint64_t ratio_frac = uint64_t(period_ratio_q32_) & 0xFFFFFFFFu;
+            uint64_t frac = (period_q32_ >> 32) * ratio_frac
+                + (((period_q32_ & 0xFFFFFFFFu) * ratio_frac) >> 32);
+            period_q32_ += period_q32_ * ratio_int + frac;
+        }
+        else
+            period_q32_ += period_step_q32_;
+        duty_q32_ += duty_step_q32_;
+    }
+    set_cycle_times();
+}
+
+void PeriodRamp::set_cycle_times()
+{
+    on_time_us_ = duty_on_time_us(period_q32_, duty_q32_);
+    off_time_us_ = rounded_period_us(period_q32_) - on_time_us_;
+}
+
+uint32_t PeriodRamp::min_on_time_us() const
+{
+    uint32_t start_on_us = duty_on_time_us(start_period_q32_, start_duty_q32_);
+    uint32_t end_on_us = duty_on_time_us(end_period_q32_, end_duty_q32_);
+    return (start_on_us < end_on_us)? start_on_us: end_on_us;
+}
+
+uint32_t PeriodRamp::min_off_time_us() const
+{
+    uint32_t start_off_us = rounded_period_us(start_period_q32_)
+                            - duty_on_time_us(start_period_q32_, start_duty_q32_);
+    uint32_t end_off_us = rounded_period_us(end_period_q32_)
+                          - duty_on_time_us(end_period_q32_, end_duty_q32_);
+    return (start_off_us < end_off_us)? start_off_us: end_off_us;
+}
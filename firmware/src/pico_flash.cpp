@@ -0,0 +1,22 @@
+#include <pico_flash.h>
+#include <hardware/sync.h>
+#include <pico/multicore.h>
+
+void PicoFlash::erase(size_t offset, size_t size)
+{
+    multicore_lockout_start_blocking();
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(offset_ + offset, size);
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+}
+
+
+void PicoFlash::program(size_t offset, const uint8_t* data, size_t size)
+{
+    multicore_lockout_start_blocking();
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(offset_ + offset, data, size);
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+}
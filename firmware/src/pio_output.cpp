@@ -0,0 +1,175 @@
+#include <pio_output.h>
+#include <hardware/pio_instructions.h>
+
+PioOutput pio_output;
+
+
+bool PioOutput::start(uint32_t pin_mask, uint32_t port_state,
+                      uint32_t start_time_us)
+{
+    stop();
+    // Claim the hardware and load the program on first use.
+    if (sm_ < 0)
+        sm_ = pio_claim_unused_sm(pio_, false);
+    if (dma_chan_ < 0)
+        dma_chan_ = dma_claim_unused_channel(false);
+    if ((sm_ < 0) || (dma_chan_ < 0))
+        return false;
+    if (program_offset_ < 0)
+    {
+        // See PioEdgeEncoder. The SDK relocates the jmp target.
+        program_instr_[0] = pio_encode_out(pio_x, Encoder::DELAY_BITS);
+        program_instr_[1] = pio_encode_jmp_x_dec(1);
+        program_instr_[2] = pio_encode_out(pio_pins, NUM_GPIOS);
+        pio_program_t program{program_instr_, 3, -1};
+        if (!pio_can_add_program(pio_, &program))
+            return false;
+        program_offset_ = pio_add_program(pio_, &program);
+    }
+    pio_sm_config sm_config = pio_get_default_sm_config();
+    sm_config_set_wrap(&sm_config, program_offset_, program_offset_ + 2);
+    sm_config_set_out_pins(&sm_config, PORT_BASE, NUM_GPIOS);
+    // Delay in the low bits first, then the port state. Autopull a new word
+    // once both have been shifted out.
+    sm_config_set_out_shift(&sm_config, true, true, 32);
+    sm_config_set_fifo_join(&sm_config, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&sm_config, 1, 0);
+    pio_sm_init(pio_, sm_, program_offset_, &sm_config);
+
+    dma_channel_config dma_config = dma_channel_get_default_config(dma_chan_);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    channel_config_set_ring(&dma_config, false, PIO_OUTPUT_RING_BITS);
+    channel_config_set_dreq(&dma_config, pio_get_dreq(pio_, sm_, true));
+    dma_channel_configure(dma_chan_, &dma_config, &pio_->txf[sm_], ring_, 0,
+                          false);
+
+    // Take the pins over at their current levels. Only switch the function
+    // select: gpio_set_function() would also clear the pad overrides.
+    pin_mask_ = pin_mask;
+    uint32_t levels = 0;
+    for (uint pin = PORT_BASE; pin < PORT_BASE + NUM_GPIOS; ++pin)
+    {
+        if (gpio_get_out_level(pin))
+            levels |= 1u << pin;
+    }
+    pio_sm_set_pins_with_mask(pio_, sm_, levels, pin_mask_);
+    pio_sm_set_pindirs_with_mask(pio_, sm_, pin_mask_, pin_mask_);
+    for (uint pin = PORT_BASE; pin < PORT_BASE + NUM_GPIOS; ++pin)
+    {
+        if (pin_mask_ & (1u << pin))
+            hw_write_masked(&io_bank0_hw->io[pin].ctrl,
+                            GPIO_FUNC_PIO1 << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB,
+                            IO_BANK0_GPIO0_CTRL_FUNCSEL_BITS);
+    }
+    pio_sm_set_enabled(pio_, sm_, true); // Stalls until the first word.
+
+    words_written_ = 0;
+    words_sent_ = 0;
+    running_ = true;
+    // Cycle 0 is when the first word goes out, right after this.
+    uint32_t now_us = timer_hw->timerawl;
+    encoder_.reset(clock_get_hz(clk_sys), now_us, levels >> PORT_BASE);
+    written_until_us_ = now_us;
+    sent_until_us_ = now_us;
+    encoder_.push(PORT_MASK >> PORT_BASE, port_state >> PORT_BASE,
+                  start_time_us);
+    fill_ring();
+    service();
+    return true;
+}
+
+
+void PioOutput::stop()
+{
+    if (!running_)
+        return;
+    pio_sm_set_enabled(pio_, sm_, false);
+    dma_channel_abort(dma_chan_);
+    pio_sm_clear_fifos(pio_, sm_);
+    for (uint pin = PORT_BASE; pin < PORT_BASE + NUM_GPIOS; ++pin)
+    {
+        if (pin_mask_ & (1u << pin))
+            hw_write_masked(&io_bank0_hw->io[pin].ctrl,
+                            GPIO_FUNC_SIO << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB,
+                            IO_BANK0_GPIO0_CTRL_FUNCSEL_BITS);
+    }
+    OutputEvent event;
+    while (unlogged_.pop(event)) {} // These never happened.
+    running_ = false;
+}
+
+
+bool PioOutput::push(uint32_t mask, uint32_t state, uint32_t time_us)
+{
+    if (!ready())
+        return false;
+    encoder_.push(mask >> PORT_BASE, state >> PORT_BASE, time_us);
+    if (output_event_log_enabled && !unlogged_.push({time_us, mask, state}))
+        output_event_log_drops = output_event_log_drops + 1;
+    fill_ring();
+    return true;
+}
+
+
+void PioOutput::fill_ring()
+{
+    if (!running_ || !encoder_.pending())
+        return;
+    uint32_t free_words = RING_WORDS - (words_written_ - words_read());
+    uint32_t word;
+    while ((free_words > 0) && encoder_.pop(word))
+    {
+        ring_[words_written_ & (RING_WORDS - 1)] = word;
+        ++words_written_;
+        --free_words;
+    }
+    written_until_us_ = encoder_.time_us();
+}
+
+
+bool PioOutput::service()
+{
+    if (!running_)
+        return true;
+    fill_ring();
+    bool on_time = true;
+    if ((words_sent_ != words_written_) && !dma_channel_is_busy(dma_chan_))
+    {
+        // The state machine must still be busy with the words it has.
+        uint32_t now_us = timer_hw->timerawl;
+        if ((words_sent_ != 0) && (int32_t(now_us - sent_until_us_) >= 0))
+            on_time = false;
+        uint32_t count = words_written_ - words_sent_;
+        __dmb(); // Finish writing the words before the DMA reads them.
+        dma_channel_transfer_from_buffer_now(
+            dma_chan_, &ring_[words_sent_ & (RING_WORDS - 1)], count);
+        words_sent_ = words_written_;
+        sent_until_us_ = written_until_us_;
+    }
+    // Log the writes that have happened.
+    uint32_t now_us = timer_hw->timerawl;
+    const OutputEvent* event;
+    while ((event = unlogged_.peek())
+           && (int32_t(now_us - event->time_us) >= 0))
+    {
+        if (!output_event_log.push(*event))
+            output_event_log_drops = output_event_log_drops + 1;
+        OutputEvent logged;
+        unlogged_.pop(logged);
+    }
+    return on_time;
+}
+
+
+bool PioOutput::idle()
+{
+    if (!running_)
+        return true;
+    service();
+    return !encoder_.pending() && (words_sent_ == words_written_)
+           && !dma_channel_is_busy(dma_chan_)
+           && (int32_t(timer_hw->timerawl - sent_until_us_) > 0)
+           && unlogged_.empty();
+}
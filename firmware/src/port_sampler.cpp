@@ -0,0 +1,108 @@
+#include <port_sampler.h>
+#include <hardware/pio_instructions.h>
+
+uint32_t PortSampler::start(uint32_t pin_base, uint32_t num_pins,
+                            uint32_t rate_hz)
+{
+    stop();
+    if ((rate_hz == 0) || (num_pins == 0) || (num_pins > 32))
+        return 0;
+    // Claim the hardware on first use.
+    if (sm_ < 0)
+        sm_ = pio_claim_unused_sm(pio_, false);
+    if (data_chan_ < 0)
+        data_chan_ = dma_claim_unused_channel(false);
+    if (ctrl_chan_ < 0)
+        ctrl_chan_ = dma_claim_unused_channel(false);
+    if ((sm_ < 0) || (data_chan_ < 0) || (ctrl_chan_ < 0))
+        return 0;
+    // Program: sample all pins once per clock divider period. Autopush hands
+    // every sample to the DMA as its own word.
+    pio_program_t program{&program_instr_, 1, -1};
+    if (program_offset_ >= 0)
+        pio_remove_program(pio_, &program, program_offset_);
+    program_instr_ = pio_encode_in(pio_pins, num_pins);
+    if (!pio_can_add_program(pio_, &program))
+    {
+        program_offset_ = -1;
+        return 0;
+    }
+    program_offset_ = pio_add_program(pio_, &program);
+    // Sample period in 1/256ths of a system clock cycle (PIO's 16.8 divider).
+    uint32_t sys_clk_hz = clock_get_hz(clk_sys);
+    uint64_t clkdiv_q8 = ((uint64_t(sys_clk_hz) << 8) + rate_hz / 2) / rate_hz;
+    if (clkdiv_q8 < (1u << 8))
+        clkdiv_q8 = 1u << 8;
+    if (clkdiv_q8 > 0xFFFFFF)
+        clkdiv_q8 = 0xFFFFFF;
+    clkdiv_q8_ = uint32_t(clkdiv_q8);
+    cycles_per_us_q8_ = uint32_t((uint64_t(sys_clk_hz) << 8) / 1'000'000);
+
+    pio_sm_config sm_config = pio_get_default_sm_config();
+    sm_config_set_wrap(&sm_config, program_offset_, program_offset_);
+    sm_config_set_in_pins(&sm_config, pin_base);
+    sm_config_set_in_shift(&sm_config, false, true, num_pins); // pin_base in bit 0.
+    sm_config_set_fifo_join(&sm_config, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv_int_frac(&sm_config, clkdiv_q8_ >> 8,
+                                  clkdiv_q8_ & 0xFF);
+    pio_sm_init(pio_, sm_, program_offset_, &sm_config);
+
+    // The ctrl channel restarts the data channel each time it finishes.
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_chan_);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, false);
+    channel_config_set_write_increment(&ctrl_config, false);
+    dma_channel_configure(ctrl_chan_, &ctrl_config,
+                          &dma_hw->ch[data_chan_].al1_transfer_count_trig,
+                          &transfer_count_reload_, 1, false);
+    dma_channel_config data_config = dma_channel_get_default_config(data_chan_);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, false);
+    channel_config_set_write_increment(&data_config, true);
+    channel_config_set_ring(&data_config, true, LOGIC_ANALYZER_RING_BITS);
+    channel_config_set_dreq(&data_config, pio_get_dreq(pio_, sm_, false));
+    channel_config_set_chain_to(&data_config, ctrl_chan_);
+    dma_channel_configure(data_chan_, &data_config, ring_, &pio_->rxf[sm_],
+                          TRANSFER_COUNT, true);
+
+    last_transfer_count_ = TRANSFER_COUNT;
+    samples_written_ = 0;
+    start_time_us_ = time_us_64();
+    pio_sm_set_enabled(pio_, sm_, true);
+    running_ = true;
+    return uint32_t((uint64_t(sys_clk_hz) << 8) / clkdiv_q8_);
+}
+
+
+void PortSampler::stop()
+{
+    if (!running_)
+        return;
+    samples_written();
+    pio_sm_set_enabled(pio_, sm_, false);
+    // Aborting a chained channel triggers its chain (RP2040-E13), so point
+    // the data channel's chain at itself first.
+    hw_write_masked(&dma_hw->ch[data_chan_].al1_ctrl,
+                    uint32_t(data_chan_) << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB,
+                    DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS);
+    dma_channel_abort(data_chan_);
+    dma_channel_abort(ctrl_chan_);
+    pio_sm_clear_fifos(pio_, sm_);
+    running_ = false;
+}
+
+
+uint64_t PortSampler::samples_written()
+{
+    if (!running_)
+        return samples_written_;
+    uint32_t transfer_count = dma_hw->ch[data_chan_].transfer_count;
+    // The count runs down and is reloaded (at most once between calls).
+    if (transfer_count <= last_transfer_count_)
+        samples_written_ += last_transfer_count_ - transfer_count;
+    else
+        samples_written_ += last_transfer_count_
+                            + (TRANSFER_COUNT - transfer_count);
+    last_transfer_count_ = transfer_count;
+    return samples_written_;
+}
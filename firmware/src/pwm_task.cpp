@@ -2,23 +2,36 @@
 
 PWMTask::PWMTask(uint32_t t_delay_us, uint32_t t_on_us, uint32_t t_period_us,
                  uint32_t pin_mask, uint32_t count, bool invert)
-: delay_us_{t_delay_us}, on_time_us_{t_on_us}, period_us_{t_period_us},
-  pin_mask_{pin_mask}, count_{count}, invert_{invert},
-  loops_{0}, cycles_{0}, start_time_us_{0}, next_update_time_us_{0}
+: PWMTask(pwm_task_spec_t{t_delay_us, t_on_us, t_period_us, pin_mask, count,
+                          invert})
+{}
+
+
+PWMTask::PWMTask(const pwm_task_spec_t& spec)
+: next_update_time_us_{0}, pin_mask_{spec.pin_mask},
+  drive_mask_{spec.pin_mask}, on_time_us_{spec.on_time_us}, period_us_{spec.period_us}, cycles_{0},
+  count_{spec.count}, invert_{spec.invert}, overlay_{spec.overlay},
+  combine_{spec.combine}, delay_us_{spec.delay_us}, start_time_us_{0},
+  random_off_time_{spec.random_off_time}, ramp_{spec.ramp},
+  burst_{spec.burst}, gate_{spec.gate}, phase_lock_{spec.phase_lock}
 {
-    // Initialize this GPIO pin.
-    gpio_init_mask(pin_mask_);
-    // Invert.
-    if (invert)
+    // Overlays leave the pins (and their inversion) to the output's own task.
+    if (!overlay_)
     {
-        for (uint8_t i = 0; i < 30; ++i)
+        // Initialize this GPIO pin.
+        gpio_init_mask(pin_mask_);
+        // Invert.
+        if (invert_)
         {
-            if (0x00000001 & (pin_mask_ >> i))
-                gpio_set_outover(i, GPIO_OVERRIDE_INVERT);
+            for (uint8_t i = 0; i < 30; ++i)
+            {
+                if (0x00000001 & (pin_mask_ >> i))
+                    gpio_set_outover(i, GPIO_OVERRIDE_INVERT);
+            }
         }
+        gpio_set_dir_masked(pin_mask_, pin_mask_); // configure as output.
+        gpio_put_masked(pin_mask_, 0);
     }
-    gpio_set_dir_masked(pin_mask_, pin_mask_); // configure as output.
-    gpio_put_masked(pin_mask_, 0);
     reset(true); // set starting state. skip output action.
 #if defined(DEBUG)
     printf("PWMTask Created!\r\n");
@@ -28,19 +41,32 @@ PWMTask::PWMTask(uint32_t t_delay_us, uint32_t t_on_us, uint32_t t_period_us,
 
 PWMTask::~PWMTask()
 {
-    // Un reserve pins.
 #if defined(DEBUG)
     printf("PWMTask Destroyed!\r\n");
 #endif
+}
+
+void PWMTask::release_pins()
+{
+    if (overlay_)
+        return;
     gpio_put_masked(pin_mask_, 0);
     gpio_set_dir_masked(pin_mask_, 0); // Configure as input so as not to drive
                                        // signals.
+    // Undo the inversion so that the next owner of the pins starts clean.
+    for (uint8_t i = 0; i < 30; ++i)
+    {
+        if (0x00000001 & (pin_mask_ >> i))
+            gpio_set_outover(i, GPIO_OVERRIDE_NORMAL);
+    }
 }
 
 void PWMTask::reset(bool skip_output_action)
 {
-    loops_ = 0;
     cycles_ = 0;
+    random_off_time_.reseed(); // Every run replays the same random sequence.
+    ramp_.restart();
+    burst_.restart();
     state_ = starting_state();
     set_time_started(0); // Clear "start time" to 0 and set next update time
                          // relative to that such that sorting still works.
@@ -50,12 +76,27 @@ void PWMTask::reset(bool skip_output_action)
     gpio_put_masked(pin_mask_, pin_state);
 }
 
+void PWMTask::set_gate_override(bool open)
+{
+    // A closed gate holds the pads at the level of a LOW state.
+    uint32_t override;
+    if (open)
+        override = invert_? GPIO_OVERRIDE_INVERT: GPIO_OVERRIDE_NORMAL;
+    else
+        override = invert_? GPIO_OVERRIDE_HIGH: GPIO_OVERRIDE_LOW;
+    for (uint8_t i = 0; i < 30; ++i)
+    {
+        if (0x00000001 & (pin_mask_ >> i))
+            gpio_set_outover(i, override);
+    }
+}
+
 void PWMTask::update(bool force, bool skip_output_action)
 {
     if ((!force) && (!time_to_update()))
         return;
     update_state_t next_state{state_};
-    if ((cycles_ == count_) && (count_ > 0))
+    if (all_cycles_done())
         next_state = DONE;
     else
     {
@@ -63,11 +104,11 @@ void PWMTask::update(bool force, bool skip_output_action)
         {
             case HIGH:
                 next_state = LOW;
-                next_update_time_us_ += on_time_us_;
+                next_update_time_us_ += next_off_time_us();
                 break;
             case LOW:
                 next_state = HIGH;
-                next_update_time_us_ += period_us_ - on_time_us_;
+                next_update_time_us_ += current_on_time_us();
                 break;
             case DONE:
                 next_state = DONE;
@@ -0,0 +1,75 @@
+#include <random_interval.h>
+#include <math.h>
+
+// log2(1 + i/32) in Q16 for i in [0, 32].
+static constexpr uint32_t LOG2_TABLE_Q16[33] =
+{
+        0,  2909,  5732,  8473, 11136, 13727, 16248, 18704,
+    21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+    38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+    52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+    65536
+};
+static constexpr uint32_t LN2_Q16 = 45426;
+
+void RandomInterval::configure(distribution_t distribution, uint32_t seed,
+                               uint32_t mean_us, uint32_t min_us,
+                               uint32_t max_us)
+{
+    distribution_ = distribution;
+    seed_ = (seed == 0)? 1: seed;
+    mean_us_ = mean_us;
+    min_us_ = min_us;
+    max_us_ = (max_us < min_us)? min_us: max_us;
+    // Only computed once per upload, so floating point is fine here.
+    tail_q32_ = 0;
+    if ((distribution_ == TRUNCATED_EXPONENTIAL) && (mean_us_ > 0))
+    {
+        double tail = exp(-double(max_us_ - min_us_) / double(mean_us_));
+        tail_q32_ = (tail >= 1.0)? UINT32_MAX: uint32_t(tail * 4294967296.0);
+    }
+    reseed();
+}
+
+uint32_t RandomInterval::neg_log_q16(uint32_t x)
+{
+    // Split x into 2^exponent * (1 + fraction).
+    uint32_t exponent = 31 - __builtin_clz(x);
+    uint32_t mantissa_q16 = (exponent >= 16)? (x >> (exponent - 16))
+                                            : (x << (16 - exponent));
+    uint32_t fraction_q16 = mantissa_q16 - (1u << 16);
+    // Interpolate log2(1 + fraction) from the table.
+    uint32_t index = fraction_q16 >> 11;
+    uint32_t remainder = fraction_q16 & 0x7FF;
+    uint32_t log2_mantissa_q16 = LOG2_TABLE_Q16[index]
+        + (((LOG2_TABLE_Q16[index + 1] - LOG2_TABLE_Q16[index]) * remainder)
+           >> 11);
+    // -log2(x / 2^32) = 32 - exponent - log2(1 + fraction)
+    uint32_t neg_log2_q16 = ((32 - exponent) << 16) - log2_mantissa_q16;
+    return uint32_t((uint64_t(neg_log2_q16) * LN2_Q16) >> 16);
+}
+
+uint32_t RandomInterval::next()
+{
+    uint32_t u = next_u32(); // never 0.
+    uint64_t interval_us;
+    switch (distribution_)
+    {
+        case UNIFORM:
+            return min_us_ + uint32_t((uint64_t(u) * (max_us_ - min_us_ + 1ull))
+                                      >> 32);
+        case TRUNCATED_EXPONENTIAL:
+            // Map u onto [tail, 1) so the inverse CDF lands in [min, max].
+            u = tail_q32_ + uint32_t((uint64_t(u) * (UINT32_MAX - tail_q32_))
+                                     >> 32);
+            if (u == 0)
+                u = 1;
+            [[fallthrough]];
+        case EXPONENTIAL:
+            interval_us = min_us_
+                + ((uint64_t(mean_us_) * neg_log_q16(u)) >> 16);
+            return (interval_us > max_us_)? max_us_: uint32_t(interval_us);
+        default:
+            return min_us_;
+    }
+}
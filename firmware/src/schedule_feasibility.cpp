@@ -0,0 +1,192 @@
+#include <schedule_feasibility.h>
+#include <pico/stdlib.h>
+
+// Upper bounds on the analysis' local bookkeeping.
+static constexpr size_t MAX_ANALYZED_TASKS = 32; // 1 per RP2040 GPIO.
+static constexpr size_t MAX_LOOKAHEAD_DEPTH = 64;
+
+namespace
+{
+/**
+ * \brief edge-time-only replica of the PWMTask state machine.
+ */
+struct task_replica_t
+{
+    uint64_t next_update_time_us;
+    uint32_t cycles;
+    bool high;
+    bool done;
+};
+
+// Times are bounded by max_span_us, so 32-bit divides (which the RP2040 does
+// in hardware) are enough.
+uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b)
+    {
+        uint32_t tmp = a % b;
+        a = b;
+        b = tmp;
+    }
+    return a;
+}
+}
+
+feasibility_report_t analyze_schedule(const task_timing_t* tasks,
+                                      size_t num_tasks,
+                                      const feasibility_params_t& params)
+{
+    uint32_t start_time_us = time_us_32();
+    feasibility_report_t report{};
+    report.min_edge_spacing_us = UINT32_MAX;
+    report.edge_cost_us = params.edge_cost_us;
+    if (num_tasks > MAX_ANALYZED_TASKS)
+    {
+        report.error = uint8_t(schedule_error_t::INVALID_SETTINGS);
+        return report;
+    }
+    // Validate settings and compute the analysis horizon: one hyperperiod of
+    // all infinite tasks past the latest offset, or the end of the last finite
+    // task, whichever is longer.
+    task_replica_t replicas[MAX_ANALYZED_TASKS];
+    uint64_t hyperperiod_us = 0;
+    uint64_t horizon_us = 0;
+    for (size_t i = 0; i < num_tasks; ++i)
+    {
+        const task_timing_t& task = tasks[i];
+        // Merging must never fold two edges of the same task together.
+        if ((task.period_us == 0) || (task.on_time_us == 0)
+            || (task.on_time_us >= task.period_us)
+            || (params.merge_tolerance_us >= task.on_time_us)
+            || (params.merge_tolerance_us >= task.period_us - task.on_time_us))
+        {
+            report.error = uint8_t(schedule_error_t::INVALID_SETTINGS);
+            return report;
+        }
+        replicas[i] = {task.delay_us, 0, task.delay_us == 0, false};
+        if (replicas[i].high)
+            replicas[i].next_update_time_us += task.on_time_us;
+        if (task.count == 0)
+        {
+            hyperperiod_us = (hyperperiod_us == 0)? task.period_us
+                : uint64_t(uint32_t(hyperperiod_us)
+                           / gcd(uint32_t(hyperperiod_us), task.period_us))
+                  * task.period_us;
+            if (hyperperiod_us > params.max_span_us)
+                hyperperiod_us = params.max_span_us;
+        }
+        uint64_t end_us = uint64_t(task.delay_us)
+                          + uint64_t(task.count) * task.period_us;
+        if (end_us > horizon_us)
+            horizon_us = end_us;
+    }
+    for (size_t i = 0; i < num_tasks; ++i)
+    {
+        if ((tasks[i].count == 0)
+            && (tasks[i].delay_us + hyperperiod_us > horizon_us))
+            horizon_us = tasks[i].delay_us + hyperperiod_us;
+    }
+    if (horizon_us > params.max_span_us)
+        horizon_us = params.max_span_us;
+    size_t depth = params.lookahead_depth;
+    if (depth > MAX_LOOKAHEAD_DEPTH - 1)
+        depth = MAX_LOOKAHEAD_DEPTH - 1;
+
+    // Ring of recent PortEvent times to model the lookahead queue.
+    // The scheduler may only compute event j once event j-depth-1 has fired.
+    uint64_t event_times_us[MAX_LOOKAHEAD_DEPTH];
+    uint64_t finish_time_us = 0; // when the scheduler finished the last event.
+    uint64_t prev_event_time_us = 0;
+    size_t num_events = 0;
+    while (num_events < params.max_edges)
+    {
+        // Find the earliest pending update.
+        uint64_t event_time_us = UINT64_MAX;
+        for (size_t i = 0; i < num_tasks; ++i)
+        {
+            if (!replicas[i].done
+                && (replicas[i].next_update_time_us < event_time_us))
+                event_time_us = replicas[i].next_update_time_us;
+        }
+        if ((event_time_us == UINT64_MAX) || (event_time_us > horizon_us))
+            break;
+        // Edges from here on are unchecked, so the schedule cannot be
+        // admitted unless it already failed.
+        if ((params.max_time_us != 0)
+            && (time_us_32() - start_time_us >= params.max_time_us))
+        {
+            if (!report.error)
+            {
+                report.error = uint8_t(schedule_error_t::ANALYSIS_INCOMPLETE);
+                report.violation_time_us = uint32_t(event_time_us);
+            }
+            break;
+        }
+        // Apply every task update that falls into this PortEvent.
+        for (size_t i = 0; i < num_tasks; ++i)
+        {
+            task_replica_t& task = replicas[i];
+            if (task.done || (task.next_update_time_us - event_time_us
+                              > params.merge_tolerance_us))
+                continue;
+            if ((tasks[i].count > 0) && (task.cycles == tasks[i].count))
+                task.done = true;
+            else if (task.high)
+            {
+                task.high = false;
+                task.cycles += 1;
+                task.next_update_time_us += tasks[i].period_us
+                                            - tasks[i].on_time_us;
+            }
+            else
+            {
+                task.high = true;
+                task.next_update_time_us += tasks[i].on_time_us;
+            }
+        }
+        // Spacing between consecutive alarms.
+        if (num_events > 0)
+        {
+            uint64_t spacing_us = event_time_us - prev_event_time_us;
+            if (spacing_us < report.min_edge_spacing_us)
+                report.min_edge_spacing_us = uint32_t(spacing_us);
+            if ((spacing_us < params.min_edge_spacing_us) && !report.error)
+            {
+                report.error = uint8_t(schedule_error_t::EDGES_TOO_CLOSE);
+                report.violation_time_us = uint32_t(event_time_us);
+            }
+        }
+        // Peak rate over the last `depth` events.
+        size_t window = (num_events < depth)? num_events: depth;
+        if (window > 0)
+        {
+            uint64_t oldest_us =
+                event_times_us[(num_events - window) % MAX_LOOKAHEAD_DEPTH];
+            uint32_t span_us = uint32_t(event_time_us - oldest_us);
+            if (span_us > 0)
+            {
+                uint32_t rate_hz = uint32_t(window * 1000000) / span_us;
+                if (rate_hz > report.peak_edge_rate_hz)
+                    report.peak_edge_rate_hz = rate_hz;
+            }
+        }
+        // Producer/consumer race against the lookahead queue.
+        uint64_t ready_us = (num_events > depth)?
+            event_times_us[(num_events - depth - 1) % MAX_LOOKAHEAD_DEPTH]: 0;
+        if (ready_us > finish_time_us)
+            finish_time_us = ready_us;
+        finish_time_us += params.edge_cost_us;
+        if ((finish_time_us > event_time_us) && !report.error)
+        {
+            report.error = uint8_t(schedule_error_t::LOOKAHEAD_OVERRUN);
+            report.violation_time_us = uint32_t(event_time_us);
+        }
+        event_times_us[num_events % MAX_LOOKAHEAD_DEPTH] = event_time_us;
+        prev_event_time_us = event_time_us;
+        report.analyzed_span_us = uint32_t(event_time_us);
+        ++num_events;
+    }
+    if (report.min_edge_spacing_us == UINT32_MAX)
+        report.min_edge_spacing_us = 0;
+    return report;
+}
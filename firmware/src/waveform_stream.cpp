@@ -0,0 +1,7 @@
+#include <waveform_stream.h>
+
+// Read from the alarm ISR. Keep in RAM.
+__not_in_flash("waveform_stream")
+    SPSCRing<StreamRecord, STREAM_RING_DEPTH> waveform_stream;
+__not_in_flash("waveform_stream_underrun") volatile bool waveform_stream_underrun;
+__not_in_flash("waveform_stream_played") volatile uint32_t waveform_stream_played;
@@ -0,0 +1,92 @@
+#include <burst_structure.h>
+#include <host_test.h>
+#include <vector>
+
+// Host test of BurstStructure. The off time after each pulse must be the
+// ordinary, inter-burst, or inter-train one at the right counts, and a
+// finite structure must finish on its last pulse.
+
+inline constexpr uint32_t OFF_US = 10;
+inline constexpr uint32_t BURST_GAP_US = 100;
+inline constexpr uint32_t TRAIN_GAP_US = 1000;
+
+/**
+ * \brief off times that follow the first \p num_pulses pulses.
+ */
+std::vector<uint32_t> off_times(BurstStructure& burst, size_t num_pulses)
+{
+    std::vector<uint32_t> off_times_us;
+    for (size_t i = 0; (i < num_pulses) && !burst.finished(); ++i)
+        off_times_us.push_back(burst.end_pulse(OFF_US));
+    return off_times_us;
+}
+
+void structure()
+{
+    BurstStructure burst;
+    burst.configure(2, BURST_GAP_US, 3, TRAIN_GAP_US, 2);
+    std::vector<uint32_t> expected{
+        OFF_US, BURST_GAP_US, OFF_US, BURST_GAP_US, OFF_US, TRAIN_GAP_US,
+        OFF_US, BURST_GAP_US, OFF_US, BURST_GAP_US, OFF_US, OFF_US};
+    check(off_times(burst, 100) == expected,
+          "structure: gaps between bursts and trains");
+    check(burst.finished() && (burst.total_pulses() == 12),
+          "structure: finished after the last pulse");
+    burst.restart();
+    check(!burst.finished() && (off_times(burst, 100) == expected),
+          "structure: restart replays the structure");
+}
+
+void finish_on_last_pulse()
+{
+    BurstStructure burst;
+    // The last pulse of a train or burst that nothing follows is followed by
+    // the ordinary off time, not its gap.
+    burst.configure(3, BURST_GAP_US, 1, TRAIN_GAP_US, 1);
+    check(off_times(burst, 100) == std::vector<uint32_t>{OFF_US, OFF_US, OFF_US},
+          "finish: a single burst ends with the ordinary off time");
+    burst.configure(1, BURST_GAP_US, 2, TRAIN_GAP_US, 1);
+    check(off_times(burst, 100) == std::vector<uint32_t>{BURST_GAP_US, OFF_US},
+          "finish: a single train ends with the ordinary off time");
+}
+
+void endless()
+{
+    BurstStructure burst;
+    burst.configure(1, BURST_GAP_US, 2, TRAIN_GAP_US, 0);
+    std::vector<uint32_t> off_times_us = off_times(burst, 1000);
+    bool alternates = (off_times_us.size() == 1000);
+    for (size_t i = 0; i < off_times_us.size(); ++i)
+        alternates &= (off_times_us[i] == ((i & 1)? TRAIN_GAP_US: BURST_GAP_US));
+    check(alternates && !burst.finished() && (burst.total_pulses() == 0),
+          "endless: trains repeat forever");
+}
+
+void gaps()
+{
+    check(!BurstStructure::needs_burst_gap(0)
+          && !BurstStructure::needs_burst_gap(1)
+          && BurstStructure::needs_burst_gap(2),
+          "gaps: a burst gap needs more than one burst per train");
+    check(!BurstStructure::needs_train_gap(1)
+          && BurstStructure::needs_train_gap(0)
+          && BurstStructure::needs_train_gap(2),
+          "gaps: a train gap needs more than one train");
+    BurstStructure burst;
+    burst.configure(4, 0, 1, 0, 1);
+    check(burst.min_gap_us() == UINT32_MAX, "gaps: unused gaps may be 0");
+    burst.configure(4, BURST_GAP_US, 0, 0, 1);
+    check(off_times(burst, 100) == std::vector<uint32_t>(4, OFF_US),
+          "gaps: 0 bursts per train is 1");
+    burst.configure(4, BURST_GAP_US, 2, TRAIN_GAP_US, 3);
+    check(burst.min_gap_us() == BURST_GAP_US, "gaps: shortest used gap");
+}
+
+int main()
+{
+    structure();
+    finish_on_last_pulse();
+    endless();
+    gaps();
+    return report_failures();
+}
@@ -0,0 +1,121 @@
+#include <config_store.h>
+#include <host_test.h>
+#include <array>
+#include <cstdio>
+
+// Host test of ConfigStore against an in-memory image of NOR flash: erasing
+// sets whole sectors to 0xFF and programming can only clear bits of whole
+// pages, like the RP2040's onboard flash.
+
+class MemoryFlash
+{
+public:
+    static constexpr size_t PAGE_SIZE = 256;
+    static constexpr size_t SECTOR_SIZE = 4096;
+    static constexpr size_t REGION_SIZE = 2 * SECTOR_SIZE;
+
+    MemoryFlash()
+    {image_.fill(0xFF);}
+
+    size_t region_size() const
+    {return REGION_SIZE;}
+
+    const uint8_t* read(size_t offset) const
+    {return &image_[offset];}
+
+    void erase(size_t offset, size_t size)
+    {
+        if ((offset % SECTOR_SIZE) || (size % SECTOR_SIZE)
+            || (offset + size > REGION_SIZE))
+            ++misaligned_ops;
+        for (size_t i = offset; (i < offset + size) && (i < REGION_SIZE); ++i)
+            image_[i] = 0xFF;
+    }
+
+    void program(size_t offset, const uint8_t* data, size_t size)
+    {
+        if ((offset % PAGE_SIZE) || (size % PAGE_SIZE)
+            || (offset + size > REGION_SIZE))
+            ++misaligned_ops;
+        for (size_t i = 0; (i < size) && (offset + i < REGION_SIZE); ++i)
+            image_[offset + i] &= data[i];
+    }
+
+    uint8_t& operator[](size_t offset)
+    {return image_[offset];}
+
+    size_t misaligned_ops = 0;
+
+private:
+    std::array<uint8_t, REGION_SIZE> image_;
+};
+
+// Stand-in for the firmware's stored configuration: spans several pages and
+// does not end on a page boundary.
+struct test_config_t
+{
+    uint8_t port_dir;
+    uint8_t boot_action;
+    uint32_t values[700];
+};
+
+test_config_t make_config(uint32_t seed)
+{
+    test_config_t config{};
+    config.port_dir = uint8_t(seed);
+    config.boot_action = 2;
+    for (size_t i = 0; i < std::size(config.values); ++i)
+        config.values[i] = seed * 2654435761u + i;
+    return config;
+}
+
+bool equal(const test_config_t& a, const test_config_t& b)
+{return memcmp(&a, &b, sizeof(test_config_t)) == 0;}
+
+int main()
+{
+    printf("ConfigStore test.\r\n");
+    check(crc32((const uint8_t*)"123456789", 9) == 0xCBF43926,
+          "crc32 matches the IEEE check value");
+
+    MemoryFlash flash;
+    ConfigStore<MemoryFlash> store(flash, 1);
+    test_config_t loaded = make_config(0);
+    test_config_t untouched = loaded;
+    check(!store.valid(sizeof(test_config_t))
+          && !store.load(&loaded, sizeof(loaded)) && equal(loaded, untouched),
+          "erased flash is not loaded");
+
+    test_config_t saved = make_config(1);
+    check(store.save(&saved, sizeof(saved)), "save succeeds");
+    check(store.load(&loaded, sizeof(loaded)) && equal(loaded, saved),
+          "load returns what was saved");
+
+    // Overwriting must erase first since programming only clears bits.
+    test_config_t resaved = make_config(2);
+    check(store.save(&resaved, sizeof(resaved))
+          && store.load(&loaded, sizeof(loaded)) && equal(loaded, resaved),
+          "save overwrites an earlier save");
+    check(flash.misaligned_ops == 0,
+          "erases and programs are sector and page aligned");
+
+    ConfigStore<MemoryFlash> newer_store(flash, 2);
+    check(!newer_store.load(&loaded, sizeof(loaded)),
+          "a different version is not loaded");
+    check(!store.load(&loaded, sizeof(loaded) - 4),
+          "a different payload size is not loaded");
+
+    flash[sizeof(config_store_header_t) + 100] ^= 0x10;
+    check(!store.load(&loaded, sizeof(loaded)), "corrupt data is not loaded");
+    flash[sizeof(config_store_header_t) + 100] ^= 0x10;
+    check(store.valid(sizeof(test_config_t)), "restored data is valid again");
+
+    store.erase();
+    check(!store.valid(sizeof(test_config_t)), "erase invalidates the store");
+
+    uint8_t too_big[MemoryFlash::REGION_SIZE] = {};
+    check(!store.save(too_big, sizeof(too_big)),
+          "data that does not fit is refused");
+
+    return report_failures();
+}
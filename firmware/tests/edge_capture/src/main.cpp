@@ -0,0 +1,266 @@
+#include <edge_capture_decoder.h>
+#include <host_test.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+
+// Host test of EdgeCaptureProgram and EdgeCaptureDecoder. The program runs
+// on a small emulator of the PIO instructions it uses, against pin waveforms
+// with known edge times. Its records are decoded and every edge must come
+// back within one sample period of where it happened.
+
+inline constexpr size_t NUM_CHANNELS = 8;
+using Decoder = EdgeCaptureDecoder<NUM_CHANNELS>;
+using Program = Decoder::Program;
+inline constexpr uint32_t CLOCK_HZ = 125'000'000;
+
+struct Edge
+{
+    uint64_t cycle; /// first cycle with the new state.
+    uint32_t state; /// of all pins from then on.
+};
+
+struct Record
+{
+    uint32_t word;
+    uint64_t cycle; /// when it was pushed.
+};
+
+/**
+ * \brief one state machine running EdgeCaptureProgram. Only implements the
+ *  instructions, sources, and destinations that the program uses.
+ */
+class PioEmulator
+{
+public:
+    PioEmulator()
+    {
+        exec(Program::INIT_X);
+        exec(Program::INIT_Y);
+        pc_ = Program::SAMPLE_OFFSET;
+    }
+
+/**
+ * \brief run until \p end_cycle with the pins following \p edges.
+ */
+    void run(const std::vector<Edge>& edges, uint64_t end_cycle,
+             std::vector<Record>& records)
+    {
+        size_t next_edge = 0;
+        while (cycle_ < end_cycle)
+        {
+            while ((next_edge < edges.size())
+                   && (edges[next_edge].cycle <= cycle_))
+                pins_ = edges[next_edge++].state;
+            uint16_t instr = Program::INSTRUCTIONS[pc_];
+            pc_ = (pc_ == Program::WRAP)? Program::WRAP_TARGET: pc_ + 1;
+            if ((instr & 0xE0E0) == 0x4000)
+                in_pin_cycles_.push_back(cycle_); // `in pins` samples now.
+            exec(instr, &records);
+            cycle_ += 1 + ((instr >> 8) & 0x1F);
+        }
+    }
+
+    const std::vector<uint64_t>& sample_cycles() const
+    {return in_pin_cycles_;}
+
+private:
+    uint32_t source(uint32_t src) const
+    {
+        switch (src)
+        {
+            case 0: return pins_;
+            case 1: return x_;
+            case 2: return y_;
+            case 3: return 0;
+            case 6: return isr_;
+            case 7: return osr_;
+        }
+        return 0xDEADBEEF;
+    }
+
+    void exec(uint16_t instr, std::vector<Record>* records = nullptr)
+    {
+        uint32_t major = instr >> 13;
+        if (major == 0) // jmp
+        {
+            uint32_t cond = (instr >> 5) & 7;
+            uint8_t addr = instr & 0x1F;
+            bool taken = (cond == 0);
+            if (cond == 2)
+                taken = (x_-- != 0);
+            else if (cond == 5)
+                taken = (x_ != y_);
+            if (taken)
+                pc_ = addr;
+        }
+        else if (major == 2) // in (shift left)
+        {
+            uint32_t count = instr & 0x1F;
+            uint32_t data = source((instr >> 5) & 7) & ((1u << count) - 1);
+            isr_ = (isr_ << count) | data;
+        }
+        else if (major == 4) // push noblock
+        {
+            if (records)
+                records->push_back({isr_, cycle_});
+            isr_ = 0;
+        }
+        else if (major == 5) // mov
+        {
+            uint32_t value = source(instr & 7);
+            if (((instr >> 3) & 3) == 1)
+                value = ~value;
+            switch ((instr >> 5) & 7)
+            {
+                case 1: x_ = value; break;
+                case 2: y_ = value; break;
+                case 6: isr_ = value; break;
+                case 7: osr_ = value; break;
+            }
+        }
+    }
+
+    uint64_t cycle_ = 0;
+    uint8_t pc_ = 0;
+    uint32_t x_ = 0, y_ = 0, isr_ = 0, osr_ = 0;
+    uint32_t pins_ = 0;
+    std::vector<uint64_t> in_pin_cycles_;
+};
+
+/**
+ * \brief random pin changes, including simultaneous changes and changes on
+ *  different pins just over one sample period apart.
+ */
+std::vector<Edge> random_edges(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> gap(12, 400);
+    std::uniform_int_distribution<uint32_t> pins(1, (1u << NUM_CHANNELS) - 1);
+    std::vector<Edge> edges;
+    uint64_t cycle = 100;
+    uint32_t state = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        cycle += gap(gen);
+        state ^= pins(gen);
+        edges.push_back({cycle, state});
+    }
+    return edges;
+}
+
+/**
+ * \brief the record that the program pushes for a change to \p state seen
+ *  by sample \p index.
+ */
+uint32_t make_record(uint64_t index, uint32_t state)
+{
+    return (state << Decoder::INDEX_BITS)
+           | (uint32_t(0xFFFFFFFF - index) & Decoder::INDEX_MASK);
+}
+
+int main()
+{
+    {
+        std::vector<Edge> edges = random_edges(20000, 1);
+        PioEmulator pio;
+        std::vector<Record> records;
+        pio.run(edges, edges.back().cycle + 1000, records);
+        const auto& samples = pio.sample_cycles();
+        bool periodic = (samples.size() > edges.back().cycle
+                                           / Program::CYCLES_PER_SAMPLE);
+        for (size_t i = 1; i < samples.size(); ++i)
+            periodic &= (samples[i] - samples[i - 1]
+                         == Program::CYCLES_PER_SAMPLE);
+        check(periodic, "both paths through the loop take the same time");
+        check((records.size() == edges.size() + 1)
+              && (records[0].cycle < Program::CYCLES_PER_SAMPLE),
+              "one record per change, plus the initial state");
+
+        // The PIO clock runs at CLOCK_HZ, so 1 cycle = 8ns.
+        Decoder decoder;
+        decoder.reset(CLOCK_HZ, 0);
+        size_t matched = 0;
+        size_t misplaced = 0;
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            captured_edge_t edge;
+            uint64_t hint_index = records[i].cycle
+                                  / Program::CYCLES_PER_SAMPLE;
+            if (!decoder.decode(records[i].word, hint_index, edge))
+                continue;
+            const Edge& truth = edges[i - 1];
+            uint32_t before = (i > 1)? edges[i - 2].state: 0;
+            uint32_t changed = before ^ truth.state;
+            int64_t error_ns = int64_t(edge.time_ns) - int64_t(truth.cycle * 8);
+            if ((edge.rise_pins == (changed & truth.state))
+                && (edge.fall_pins == (changed & ~truth.state)))
+                ++matched;
+            if ((error_ns < -int64_t(Program::CYCLES_PER_SAMPLE * 8))
+                || (error_ns > int64_t(Program::CYCLES_PER_SAMPLE * 8)))
+                ++misplaced;
+        }
+        check(matched == edges.size(), "every change decodes to its pins");
+        check(misplaced == 0, "every edge lands within one sample period");
+    }
+    {
+        // Gaps longer than the counter period, decoded shortly after they
+        // happen, past the 32-bit wrap of the program's counter.
+        std::mt19937 gen(2);
+        std::uniform_int_distribution<uint64_t> gap(1, 3ull << 24);
+        std::uniform_int_distribution<uint64_t> lag(0, 1ull << 22);
+        Decoder decoder;
+        decoder.reset(CLOCK_HZ, 1000);
+        captured_edge_t edge;
+        decoder.decode(make_record(0, 0), 0, edge);
+        uint64_t index = 0;
+        uint32_t state = 0;
+        bool exact = true;
+        while (index < (3ull << 32))
+        {
+            index += gap(gen);
+            state ^= 1;
+            exact &= decoder.decode(make_record(index, state),
+                                    index + lag(gen), edge)
+                     && (edge.time_ns == decoder.time_ns(index));
+        }
+        check(exact, "long gaps and counter wrap decode to the exact sample");
+    }
+    {
+        Decoder decoder;
+        decoder.reset(CLOCK_HZ, 0);
+        captured_edge_t edge;
+        check(!decoder.decode(make_record(0, 0x05), 0, edge)
+              && (decoder.state() == 0x05),
+              "the first record is the initial state");
+        check(decoder.decode(make_record(100, 0x06), 120, edge)
+              && (edge.rise_pins == 0x02) && (edge.fall_pins == 0x01)
+              && (edge.time_ns == 100 * Program::CYCLES_PER_SAMPLE * 8),
+              "edges split into rising and falling pins");
+        decoder.resync();
+        check(!decoder.decode(make_record(5000, 0x00), 5000, edge)
+              && (decoder.state() == 0x00),
+              "after a resync the next record is the initial state");
+        check(decoder.decode(make_record(5001, 0x80), 5001, edge)
+              && (edge.rise_pins == 0x80),
+              "records after a resync decode again");
+    }
+    {
+        // 133MHz does not divide evenly into microseconds.
+        Decoder decoder;
+        decoder.reset(133'000'000, 5'000'000);
+        bool consistent = true;
+        for (uint64_t time_us = 5'000'000; time_us < 5'100'000; time_us += 7)
+        {
+            uint64_t index = decoder.sample_index(time_us);
+            consistent &= (decoder.time_ns(index) <= time_us * 1000)
+                          && (decoder.time_ns(index + 1) > time_us * 1000);
+        }
+        check(consistent, "sample_index() is the sample at or before a time");
+        check(decoder.time_ns(133'000'000 / 10) == 5'000'000'000ull
+                                                    + 1'000'000'000,
+              "one second of samples at 133MHz");
+    }
+    return report_failures();
+}
@@ -0,0 +1,43 @@
+#ifndef APP_SIM_H
+#define APP_SIM_H
+#include <stdint.h>
+#include <chrono>
+#include <harp_c_app.h>
+
+/**
+ * \brief Both cores of the app, run on the host in virtual time.
+ * \details core1 is stepped 1[us] at a time, and also whenever core0 polls an
+ *  empty queue while the idle hook is enabled, i.e: while a register handler
+ *  waits for core1.
+ */
+
+extern HarpCApp& app;
+
+/**
+ * \brief host time spent in the simulated core1 so far.
+ */
+extern std::chrono::steady_clock::duration sim_core1_time;
+
+/**
+ * \brief power up: reset peripherals, erase flash, create the queues, reset
+ *  both cores, and let core1 settle.
+ */
+void sim_setup();
+
+/**
+ * \brief run one pass of core1's loop, then let 1[us] of virtual time pass,
+ *  firing any alarm that falls due.
+ */
+void sim_step_core1();
+
+/**
+ * \brief run both cores for \p duration_us of virtual time.
+ */
+void sim_run_for_us(uint32_t duration_us);
+
+/**
+ * \brief step core1 whenever core0 waits on it (or stop doing so).
+ */
+void sim_enable_idle_hook(bool enabled);
+
+#endif // APP_SIM_H
@@ -0,0 +1,46 @@
+#ifndef HARP_HOST_C_APP_H
+#define HARP_HOST_C_APP_H
+// Host stand-in for core.pico's <harp_c_app.h>. Instead of reading USB,
+// dispatch() hands one received frame to its app register handler.
+#include <harp_core.h>
+#include <tusb.h>
+
+class HarpCApp : public HarpCore
+{
+public:
+    static HarpCApp& init(uint16_t who_am_i, uint8_t hw_version_major,
+                          uint8_t hw_version_minor,
+                          uint8_t assembly_version,
+                          uint8_t harp_version_major,
+                          uint8_t harp_version_minor,
+                          uint16_t serial_number, const char name[],
+                          const uint8_t tag[], RegSpec* app_reg_specs,
+                          size_t app_reg_count, void (*update_fn)(),
+                          void (*reset_fn)());
+
+    static HarpCApp& instance();
+
+/**
+ * \brief run the register handler for one Harp frame.
+ * \returns false if the frame is malformed or not an app register command.
+ */
+    bool dispatch(uint8_t* frame);
+
+    void update()
+    {
+        tud_task();
+        update_fn_();
+    }
+
+    void reset()
+    {reset_fn_();}
+
+    RegSpec* app_reg_specs_;
+    size_t app_reg_count_;
+
+private:
+    void (*update_fn_)();
+    void (*reset_fn_)();
+};
+
+#endif // HARP_HOST_C_APP_H
@@ -0,0 +1,105 @@
+#ifndef HARP_HOST_CORE_H
+#define HARP_HOST_CORE_H
+// Host stand-in for core.pico's <harp_core.h>. Only what the app uses.
+// Replies and events are encoded as Harp frames and logged for the host test
+// instead of being sent over USB.
+#include <harp_message.h>
+#include <vector>
+
+struct RegSpec
+{
+    volatile uint8_t* base_ptr;
+    uint8_t num_bytes;
+    reg_type_t payload_type;
+    void (*read_fn_ptr)(uint8_t reg_address);
+    void (*write_fn_ptr)(msg_t& msg);
+
+    static RegSpec U8(volatile void* reg, void (*read_fn)(uint8_t),
+                      void (*write_fn)(msg_t&))
+    {return {(volatile uint8_t*)reg, 1, reg_type_t::U8, read_fn, write_fn};}
+
+    static RegSpec U16(volatile void* reg, void (*read_fn)(uint8_t),
+                       void (*write_fn)(msg_t&))
+    {return {(volatile uint8_t*)reg, 2, reg_type_t::U16, read_fn, write_fn};}
+
+    static RegSpec U32(volatile void* reg, void (*read_fn)(uint8_t),
+                       void (*write_fn)(msg_t&))
+    {return {(volatile uint8_t*)reg, 4, reg_type_t::U32, read_fn, write_fn};}
+
+    static RegSpec U8Array(volatile void* reg, size_t num_elements,
+                           void (*read_fn)(uint8_t), void (*write_fn)(msg_t&))
+    {
+        return {(volatile uint8_t*)reg, uint8_t(num_elements), reg_type_t::U8,
+                read_fn, write_fn};
+    }
+
+    static RegSpec U32Array(volatile void* reg, size_t num_elements,
+                            void (*read_fn)(uint8_t), void (*write_fn)(msg_t&))
+    {
+        return {(volatile uint8_t*)reg, uint8_t(4 * num_elements),
+                reg_type_t::U32, read_fn, write_fn};
+    }
+};
+
+class HarpCore
+{
+public:
+    static constexpr uint8_t APP_REG_START_ADDRESS = 32;
+
+    static void copy_msg_payload_to_register(msg_t& msg);
+
+    static void send_harp_reply(msg_type_t reply_type, uint8_t reg_address);
+    static void send_harp_reply(msg_type_t reply_type, uint8_t reg_address,
+                                uint64_t harp_time_us);
+    static void send_harp_reply(msg_type_t reply_type, uint8_t reg_address,
+                                const volatile uint8_t* data,
+                                uint8_t num_bytes, reg_type_t payload_type,
+                                uint64_t harp_time_us);
+
+    static bool is_muted();
+
+    static const RegSpec& reg_address_to_spec(uint8_t reg_address);
+
+    static uint64_t harp_time_us_64();
+    static uint64_t system_to_harp_us_64(uint64_t system_time_us);
+
+    static void read_reg_generic(uint8_t reg_address);
+    static void write_reg_generic(msg_t& msg);
+    static void read_reg_error(uint8_t reg_address);
+    static void write_reg_error(msg_t& msg);
+};
+
+// Host-side controls.
+
+/**
+ * \brief every frame the app sent, in order.
+ */
+extern std::vector<std::vector<uint8_t>> host_harp_frames;
+
+/**
+ * \brief number of frames whose checksum did not match, i.e: because the
+ *  bytes of two messages were interleaved.
+ */
+extern size_t host_bad_frames;
+
+/**
+ * \brief number of USB IN transfers, each of at most one packet.
+ */
+extern size_t host_usb_transfers;
+
+/**
+ * \brief mute (or unmute) replies and events, like the Harp MUTE_RPL bit.
+ */
+void host_set_harp_muted(bool muted);
+
+/**
+ * \brief encode a Harp frame (with a checksum) from its parts.
+ * \param timestamp_us omitted if negative.
+ */
+std::vector<uint8_t> host_harp_frame(msg_type_t type, uint8_t address,
+                                     reg_type_t payload_type,
+                                     const volatile uint8_t* payload,
+                                     size_t num_bytes,
+                                     int64_t timestamp_us = -1);
+
+#endif // HARP_HOST_CORE_H
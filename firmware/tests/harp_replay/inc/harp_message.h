@@ -0,0 +1,58 @@
+#ifndef HARP_HOST_MESSAGE_H
+#define HARP_HOST_MESSAGE_H
+// Host stand-in for core.pico's <harp_message.h>. Only what the app uses.
+#include <stdint.h>
+#include <stddef.h>
+
+enum msg_type_t: uint8_t
+{
+    READ = 1,
+    WRITE = 2,
+    EVENT = 3,
+    READ_ERROR = 9,
+    WRITE_ERROR = 10,
+};
+
+enum reg_type_t: uint8_t
+{
+    U8 = 1,
+    S8 = 129,
+    U16 = 2,
+    S16 = 130,
+    U32 = 4,
+    S32 = 132,
+    U64 = 8,
+    S64 = 136,
+    Float = 68,
+};
+
+inline constexpr uint8_t HAS_TIMESTAMP = 0x10; // payload_type flag.
+
+#pragma pack(push, 1)
+struct msg_header_t
+{
+    msg_type_t type;
+    uint8_t raw_length; // bytes after this one, including the checksum.
+    uint8_t address;
+    uint8_t port;
+    reg_type_t payload_type;
+
+    bool has_timestamp() const
+    {return payload_type & HAS_TIMESTAMP;}
+
+    uint8_t payload_length() const
+    {return raw_length - (has_timestamp()? 10: 4);}
+};
+#pragma pack(pop)
+
+struct msg_t
+{
+    msg_header_t& header;
+    void* payload;
+    uint8_t& checksum;
+
+    uint8_t payload_length() const
+    {return header.payload_length();}
+};
+
+#endif // HARP_HOST_MESSAGE_H
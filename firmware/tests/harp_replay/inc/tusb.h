@@ -0,0 +1,28 @@
+#ifndef HARP_HOST_TUSB_H
+#define HARP_HOST_TUSB_H
+// Host stand-in for TinyUSB's <tusb.h>. Only the CDC writes that the app and
+// core.pico use. Written bytes wait in a TX FIFO until the IN endpoint is free
+// to carry up to one packet of them. The host splits what it reads back into
+// Harp frames and logs them with the replies.
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t tud_cdc_write(const void* buffer, uint32_t num_bytes);
+uint32_t tud_cdc_write_flush();
+uint32_t tud_cdc_write_available();
+void tud_task();
+
+// Host-side controls.
+
+/**
+ * \brief bytes that the TX FIFO holds before the host reads them. The default
+ *  is unlimited.
+ */
+void host_set_cdc_tx_space(size_t num_bytes);
+
+/**
+ * \brief drop unsent and partly read bytes and free the IN endpoint.
+ */
+void host_reset_usb();
+
+#endif // HARP_HOST_TUSB_H
@@ -0,0 +1,112 @@
+#include <app_sim.h>
+#include <pico/stdlib.h>
+#include <pico_host.h>
+#include <cuttlefish_app.h>
+#include <tusb.h>
+
+queue_t pwm_settings_queue;
+queue_t pwm_timing_queue;
+queue_t schedule_config_queue;
+queue_t edge_event_queue;
+queue_t core1_ctrl_queue;
+queue_t core1_next_state_queue;
+queue_t schedule_error_queue;
+queue_t schedule_slot_ack_queue;
+queue_t gate_event_queue;
+queue_t reference_edge_queue;
+queue_t phase_lock_event_queue;
+queue_t trial_settings_queue;
+queue_t trial_event_queue;
+queue_t state_machine_program_queue;
+queue_t state_machine_event_queue;
+
+HarpCApp& app = HarpCApp::init(HARP_DEVICE_ID,
+                               HW_VERSION_MAJOR, HW_VERSION_MINOR,
+                               HW_ASSEMBLY_VERSION,
+                               FW_VERSION_MAJOR, FW_VERSION_MINOR,
+                               UNUSED_SERIAL_NUMBER, "Cuttlefish",
+                               (uint8_t*)GIT_HASH,
+                               app_reg_specs, APP_REG_COUNT, update_app_state,
+                               reset_app);
+
+std::chrono::steady_clock::duration sim_core1_time{0};
+
+inline constexpr uint32_t NUM_ALARMS = 4;
+inline constexpr uint32_t SETTLE_TIME_US = 100;
+
+
+void sim_setup()
+{
+    host_reset();
+    host_erase_flash();
+    host_set_harp_muted(false);
+    host_reset_usb();
+    host_harp_frames.clear();
+    host_bad_frames = 0;
+    host_usb_transfers = 0;
+    host_set_cdc_tx_space(SIZE_MAX);
+    // Same depths as main.cpp.
+    for (queue_t* queue: {&edge_event_queue, &core1_ctrl_queue,
+                          &core1_next_state_queue, &pwm_settings_queue,
+                          &pwm_timing_queue, &schedule_config_queue,
+                          &schedule_error_queue, &schedule_slot_ack_queue,
+                          &gate_event_queue, &reference_edge_queue,
+                          &phase_lock_event_queue, &trial_settings_queue,
+                          &trial_event_queue, &state_machine_program_queue,
+                          &state_machine_event_queue})
+        queue_free(queue);
+    queue_init(&edge_event_queue, sizeof(EdgeEvent), EDGE_EVENT_QUEUE_DEPTH);
+    queue_init(&core1_ctrl_queue, sizeof(pwm_ctrl_msg_t), 8);
+    queue_init(&core1_next_state_queue, sizeof(core1_next_state_msg_t), 8);
+    queue_init(&pwm_settings_queue, sizeof(pwm_specs_core_msg_t), 32);
+    queue_init(&pwm_timing_queue, sizeof(pwm_timing_core_msg_t), 5 * NUM_GPIOS);
+    queue_init(&schedule_config_queue, sizeof(schedule_config_msg_t), 8);
+    queue_init(&schedule_error_queue, sizeof(uint8_t), 2);
+    queue_init(&schedule_slot_ack_queue, sizeof(bool), 1);
+    queue_init(&gate_event_queue, sizeof(gate_event_msg_t), 16);
+    queue_init(&reference_edge_queue, sizeof(reference_edge_msg_t), 8);
+    queue_init(&phase_lock_event_queue, sizeof(phase_lock_event_msg_t), 16);
+    queue_init(&trial_settings_queue, sizeof(pwm_trial_settings_t), 2);
+    queue_init(&trial_event_queue, sizeof(trial_event_msg_t), 16);
+    queue_init(&state_machine_program_queue,
+               sizeof(state_machine_program_msg_t), 1);
+    queue_init(&state_machine_event_queue, sizeof(state_machine_event_msg_t),
+               16);
+    state = core1_state_t::RESET;
+    for (ScheduleSlot& slot: schedule_slots)
+        slot = ScheduleSlot{};
+    app.reset();
+    sim_run_for_us(SETTLE_TIME_US); // Let core1 settle into READY.
+}
+
+
+void sim_step_core1()
+{
+    auto start = std::chrono::steady_clock::now();
+    run_task_loop();
+    uint32_t next_time_us = time_us_32() + 1;
+    uint32_t alarm_time_us;
+    for (uint32_t alarm = 0; alarm < NUM_ALARMS; ++alarm)
+    {
+        if (host_alarm_armed(alarm, alarm_time_us)
+            && (int32_t(alarm_time_us - next_time_us) <= 0))
+            host_fire_alarm(alarm);
+    }
+    if (int32_t(next_time_us - time_us_32()) > 0)
+        host_advance_time_us(next_time_us - time_us_32());
+    sim_core1_time += std::chrono::steady_clock::now() - start;
+}
+
+
+void sim_run_for_us(uint32_t duration_us)
+{
+    for (uint32_t i = 0; i < duration_us; ++i)
+    {
+        sim_step_core1();
+        app.update();
+    }
+}
+
+
+void sim_enable_idle_hook(bool enabled)
+{host_set_queue_idle_hook(enabled? sim_step_core1: nullptr);}
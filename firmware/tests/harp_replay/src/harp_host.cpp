@@ -0,0 +1,275 @@
+#include <harp_c_app.h>
+#include <tusb.h>
+#include <pico/stdlib.h>
+#include <algorithm>
+#include <cstring>
+
+std::vector<std::vector<uint8_t>> host_harp_frames;
+size_t host_bad_frames = 0;
+size_t host_usb_transfers = 0;
+
+namespace
+{
+constexpr size_t CDC_PACKET_BYTES = 64; // Full-speed bulk endpoint.
+
+HarpCApp app_instance;
+bool muted = false;
+std::vector<uint8_t> cdc_tx_fifo;
+size_t cdc_tx_space = SIZE_MAX;
+bool cdc_in_busy = false; /// a packet is on the bus.
+uint64_t cdc_in_start_time_us = 0;
+std::vector<uint8_t> host_rx_bytes; /// read but not yet a whole frame.
+
+/**
+ * \brief send the next packet from the TX FIFO if the IN endpoint is free.
+ *  The host takes whole frames out of what it has read.
+ */
+uint32_t start_cdc_in_transfer()
+{
+    if (cdc_in_busy || cdc_tx_fifo.empty())
+        return 0;
+    size_t num_bytes = std::min(cdc_tx_fifo.size(), CDC_PACKET_BYTES);
+    host_rx_bytes.insert(host_rx_bytes.end(), cdc_tx_fifo.begin(),
+                         cdc_tx_fifo.begin() + num_bytes);
+    cdc_tx_fifo.erase(cdc_tx_fifo.begin(), cdc_tx_fifo.begin() + num_bytes);
+    cdc_in_busy = true;
+    cdc_in_start_time_us = time_us_64();
+    ++host_usb_transfers;
+    size_t i = 0;
+    while ((i + 2 <= host_rx_bytes.size())
+           && (i + host_rx_bytes[i + 1] + 2 <= host_rx_bytes.size()))
+    {
+        size_t frame_size = host_rx_bytes[i + 1] + 2;
+        uint8_t checksum = 0;
+        for (size_t j = i; j + 1 < i + frame_size; ++j)
+            checksum += host_rx_bytes[j];
+        if (checksum != host_rx_bytes[i + frame_size - 1])
+            ++host_bad_frames;
+        host_harp_frames.emplace_back(host_rx_bytes.begin() + i,
+                                      host_rx_bytes.begin() + i + frame_size);
+        i += frame_size;
+    }
+    host_rx_bytes.erase(host_rx_bytes.begin(), host_rx_bytes.begin() + i);
+    return uint32_t(num_bytes);
+}
+
+/**
+ * \brief finish the packet on the bus once virtual time has moved on, and
+ *  send the next one, as TinyUSB does when a transfer completes.
+ */
+void complete_cdc_in_transfer()
+{
+    if (!cdc_in_busy || (time_us_64() == cdc_in_start_time_us))
+        return;
+    cdc_in_busy = false;
+    start_cdc_in_transfer();
+}
+}
+
+
+void host_set_harp_muted(bool new_muted)
+{muted = new_muted;}
+
+
+void host_set_cdc_tx_space(size_t num_bytes)
+{cdc_tx_space = num_bytes;}
+
+
+void host_reset_usb()
+{
+    cdc_tx_fifo.clear();
+    host_rx_bytes.clear();
+    cdc_in_busy = false;
+}
+
+
+uint32_t tud_cdc_write(const void* buffer, uint32_t num_bytes)
+{
+    complete_cdc_in_transfer();
+    size_t space = tud_cdc_write_available();
+    if (num_bytes > space)
+        num_bytes = uint32_t(space);
+    const uint8_t* bytes = (const uint8_t*)buffer;
+    cdc_tx_fifo.insert(cdc_tx_fifo.end(), bytes, bytes + num_bytes);
+    return num_bytes;
+}
+
+
+uint32_t tud_cdc_write_flush()
+{
+    complete_cdc_in_transfer();
+    return start_cdc_in_transfer();
+}
+
+
+uint32_t tud_cdc_write_available()
+{
+    complete_cdc_in_transfer();
+    if (cdc_tx_space < cdc_tx_fifo.size())
+        return 0;
+    return uint32_t(std::min<size_t>(cdc_tx_space - cdc_tx_fifo.size(),
+                                     UINT32_MAX));
+}
+
+
+void tud_task()
+{complete_cdc_in_transfer();}
+
+
+std::vector<uint8_t> host_harp_frame(msg_type_t type, uint8_t address,
+                                     reg_type_t payload_type,
+                                     const volatile uint8_t* payload,
+                                     size_t num_bytes, int64_t timestamp_us)
+{
+    bool has_timestamp = (timestamp_us >= 0);
+    std::vector<uint8_t> frame{type,
+        uint8_t(num_bytes + (has_timestamp? 10: 4)), address, 255,
+        uint8_t(payload_type | (has_timestamp? HAS_TIMESTAMP: 0))};
+    if (has_timestamp)
+    {
+        // Seconds and 32[us] ticks.
+        uint32_t seconds = uint32_t(timestamp_us / 1'000'000);
+        uint16_t ticks = uint16_t((timestamp_us % 1'000'000) / 32);
+        for (size_t i = 0; i < 4; ++i)
+            frame.push_back(uint8_t(seconds >> (8 * i)));
+        frame.push_back(uint8_t(ticks));
+        frame.push_back(uint8_t(ticks >> 8));
+    }
+    for (size_t i = 0; i < num_bytes; ++i)
+        frame.push_back(uint8_t(payload[i]));
+    uint8_t checksum = 0;
+    for (uint8_t byte: frame)
+        checksum += byte;
+    frame.push_back(checksum);
+    return frame;
+}
+
+
+HarpCApp& HarpCApp::init(uint16_t who_am_i, uint8_t hw_version_major,
+                         uint8_t hw_version_minor, uint8_t assembly_version,
+                         uint8_t harp_version_major,
+                         uint8_t harp_version_minor, uint16_t serial_number,
+                         const char name[], const uint8_t tag[],
+                         RegSpec* app_reg_specs, size_t app_reg_count,
+                         void (*update_fn)(), void (*reset_fn)())
+{
+    app_instance.app_reg_specs_ = app_reg_specs;
+    app_instance.app_reg_count_ = app_reg_count;
+    app_instance.update_fn_ = update_fn;
+    app_instance.reset_fn_ = reset_fn;
+    return app_instance;
+}
+
+
+HarpCApp& HarpCApp::instance()
+{return app_instance;}
+
+
+bool HarpCApp::dispatch(uint8_t* frame)
+{
+    msg_header_t& header = *(msg_header_t*)frame;
+    size_t frame_size = header.raw_length + 2;
+    uint8_t checksum = 0;
+    for (size_t i = 0; i + 1 < frame_size; ++i)
+        checksum += frame[i];
+    if ((header.raw_length < 4) || (checksum != frame[frame_size - 1]))
+        return false;
+    if ((header.address < APP_REG_START_ADDRESS)
+        || (header.address >= APP_REG_START_ADDRESS + app_reg_count_))
+        return false;
+    const RegSpec& spec = reg_address_to_spec(header.address);
+    if (header.type == READ)
+    {
+        spec.read_fn_ptr(header.address);
+        return true;
+    }
+    if (header.type != WRITE)
+        return false;
+    msg_t msg{header, frame + (header.has_timestamp()? 11: 5),
+              frame[frame_size - 1]};
+    spec.write_fn_ptr(msg);
+    return true;
+}
+
+
+void HarpCore::copy_msg_payload_to_register(msg_t& msg)
+{
+    const RegSpec& spec = reg_address_to_spec(msg.header.address);
+    size_t num_bytes = msg.payload_length();
+    if (num_bytes > spec.num_bytes)
+        num_bytes = spec.num_bytes;
+    for (size_t i = 0; i < num_bytes; ++i)
+        spec.base_ptr[i] = ((const uint8_t*)msg.payload)[i];
+}
+
+
+void HarpCore::send_harp_reply(msg_type_t reply_type, uint8_t reg_address)
+{send_harp_reply(reply_type, reg_address, harp_time_us_64());}
+
+
+void HarpCore::send_harp_reply(msg_type_t reply_type, uint8_t reg_address,
+                               uint64_t harp_time_us)
+{
+    const RegSpec& spec = reg_address_to_spec(reg_address);
+    send_harp_reply(reply_type, reg_address, spec.base_ptr, spec.num_bytes,
+                    spec.payload_type, harp_time_us);
+}
+
+
+void HarpCore::send_harp_reply(msg_type_t reply_type, uint8_t reg_address,
+                               const volatile uint8_t* data,
+                               uint8_t num_bytes, reg_type_t payload_type,
+                               uint64_t harp_time_us)
+{
+    // Like core.pico: write the frame to the CDC TX FIFO, then flush it.
+    std::vector<uint8_t> frame = host_harp_frame(reply_type, reg_address,
+                                                 payload_type, data, num_bytes,
+                                                 int64_t(harp_time_us));
+    tud_cdc_write(frame.data(), uint32_t(frame.size()));
+    tud_cdc_write_flush();
+}
+
+
+bool HarpCore::is_muted()
+{return muted;}
+
+
+const RegSpec& HarpCore::reg_address_to_spec(uint8_t reg_address)
+{return app_instance.app_reg_specs_[reg_address - APP_REG_START_ADDRESS];}
+
+
+uint64_t HarpCore::harp_time_us_64()
+{return time_us_64();}
+
+
+uint64_t HarpCore::system_to_harp_us_64(uint64_t system_time_us)
+{return system_time_us;}
+
+
+void HarpCore::read_reg_generic(uint8_t reg_address)
+{
+    if (!is_muted())
+        send_harp_reply(READ, reg_address);
+}
+
+
+void HarpCore::write_reg_generic(msg_t& msg)
+{
+    copy_msg_payload_to_register(msg);
+    if (!is_muted())
+        send_harp_reply(WRITE, msg.header.address);
+}
+
+
+void HarpCore::read_reg_error(uint8_t reg_address)
+{
+    if (!is_muted())
+        send_harp_reply(READ_ERROR, reg_address);
+}
+
+
+void HarpCore::write_reg_error(msg_t& msg)
+{
+    if (!is_muted())
+        send_harp_reply(WRITE_ERROR, msg.header.address);
+}
@@ -0,0 +1,1361 @@
+#include <pico/stdlib.h>
+#include <pico_host.h>
+#include <cuttlefish_app.h>
+#include <app_sim.h>
+#include <tusb.h>
+#include <host_test.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Host replay harness for the Harp register handlers in cuttlefish_app.cpp.
+// Command frames are handed to their handlers one at a time, as
+// HarpCApp::run() does, with core1 simulated in virtual time whenever core0
+// waits on it. Replies are checked, and the host CPU time spent in each
+// handler (minus the simulated core1) is reported per message type along with
+// the host message rate that the handlers plus update_app_state() can sustain.
+// A burst of input edges then measures the cost of each edge EVENT on core0
+// and how many of them share a USB transfer.
+// Host ns are a relative measure: compare them between commits, not against
+// the RP2040.
+//
+// Usage:
+//   harp_replay                               built-in scenarios + benchmark.
+//   harp_replay commands.bin [replies.bin]    replay a recorded stream.
+// A stream is raw Harp frames back-to-back (i.e: the `.frame` of each pyharp
+// message). Every command must get one reply for its register, either of the
+// same type or its error. Recorded replies, if given, are compared on type,
+// address, and payload. Timestamps and events are ignored.
+
+using bench_clock = std::chrono::steady_clock;
+using frame_t = std::vector<uint8_t>;
+
+inline constexpr uint32_t MESSAGE_GAP_US = 100; // Virtual time between commands.
+inline constexpr size_t BENCHMARK_MESSAGES = 20000;
+inline constexpr size_t BENCHMARK_EDGES = 200000;
+inline constexpr uint32_t BENCHMARK_EDGE_GAP_US = 5; // 100k events/s.
+inline constexpr port_t ALL_CHANNELS = port_t((1ull << NUM_GPIOS) - 1);
+
+// Register addresses the scenarios use (see app_reg_specs).
+inline constexpr uint8_t PORT_DIR_ADDRESS = Harp::APP_REG_START_ADDRESS + 0;
+inline constexpr uint8_t PORT_STATE_ADDRESS = Harp::APP_REG_START_ADDRESS + 1;
+inline constexpr uint8_t PORT_SET_ADDRESS = Harp::APP_REG_START_ADDRESS + 2;
+inline constexpr uint8_t PORT_CLEAR_ADDRESS = Harp::APP_REG_START_ADDRESS + 3;
+inline constexpr uint8_t ENABLE_RISING_EDGE_EVENTS_ADDRESS =
+    Harp::APP_REG_START_ADDRESS + 4;
+inline constexpr uint8_t ENABLE_FALLING_EDGE_EVENTS_ADDRESS =
+    Harp::APP_REG_START_ADDRESS + 6;
+inline constexpr uint8_t SCHEDULE_DIAGNOSTICS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 0;
+inline constexpr uint8_t EDGE_MERGE_TOLERANCE_US_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 1;
+inline constexpr uint8_t STREAM_MODE_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 5;
+inline constexpr uint8_t STREAM_RECORDS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 6;
+inline constexpr uint8_t PWM_RANDOM_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 10;
+inline constexpr uint8_t PWM_RAMP_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 11;
+inline constexpr uint8_t PWM_BURST_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 12;
+inline constexpr uint8_t STORED_CONFIGURATION_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 15;
+inline constexpr uint8_t BOOT_ACTION_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 16;
+inline constexpr uint8_t LOGIC_ANALYZER_RATE_HZ_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 17;
+inline constexpr uint8_t PWM_GATE_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 20;
+inline constexpr uint8_t PWM_PHASE_LOCK_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 22;
+inline constexpr uint8_t OUTPUT_ENGINE_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 25;
+inline constexpr uint8_t INPUT_CAPTURE_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 26;
+inline constexpr uint8_t PWM_OVERLAY_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 29;
+inline constexpr uint8_t PWM_TRIAL_SETTINGS_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 30;
+inline constexpr uint8_t STATE_MACHINE_PROGRAM_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 32;
+inline constexpr uint8_t STATE_MACHINE_CONTROL_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 33;
+inline constexpr uint8_t LOOPBACK_CALIBRATION_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 35;
+inline constexpr uint8_t LATENCY_COMPENSATION_ADDRESS =
+    PWM_SETTINGS_ADDRESS + NUM_GPIOS + 36;
+
+struct message_stats_t
+{
+    size_t count = 0;
+    bench_clock::duration total{0};
+    bench_clock::duration max{0};
+
+    void add(bench_clock::duration elapsed)
+    {
+        ++count;
+        total += elapsed;
+        if (elapsed > max)
+            max = elapsed;
+    }
+
+    double mean_ns() const
+    {
+        return count? std::chrono::duration<double, std::nano>(total).count()
+                      / count: 0;
+    }
+};
+
+std::map<std::pair<uint8_t, uint8_t>, message_stats_t> handler_stats;
+message_stats_t update_stats;
+message_stats_t edge_update_stats; /// update_app_state() during edge bursts.
+size_t edge_events = 0;
+size_t edge_event_transfers = 0;
+
+const char* reg_name(uint8_t address)
+{
+    static const char* const names_before_pwm_settings[] =
+        {"PortDir", "PortState", "PortSet", "PortClear",
+         "EnableRisingEdgeEvents", "RisingEdgeEvents",
+         "EnableFallingEdgeEvents", "FallingEdgeEvents", "PwmState"};
+    static const char* const names_after_pwm_settings[] =
+        {"ScheduleDiagnostics", "EdgeMergeToleranceUs",
+         "EnableOutputEdgeEvents", "OutputEdgeEvents",
+         "OutputEdgeEventsDropped", "StreamMode", "StreamRecords",
+         "StreamLowWatermark", "StreamLowWatermarkReached", "StreamUnderrun",
+         "PwmRandomSettings", "PwmRampSettings", "PwmBurstSettings",
+         "ScheduleSlot", "SaveScheduleSlot", "StoredConfiguration",
+         "BootAction", "LogicAnalyzerRateHz", "LogicAnalyzerSamples",
+         "LogicAnalyzerOverflow", "PwmGateSettings", "PwmGateState",
+         "PwmPhaseLockSettings", "PwmPhaseLockState",
+         "PwmPhaseLockStatistics", "OutputEngine", "InputCapture",
+         "InputCaptureEvents", "InputCaptureOverflow",
+         "PwmOverlaySettings", "PwmTrialSettings", "PwmTrialStart",
+         "StateMachineProgram", "StateMachineControl",
+         "StateMachineTransition", "LoopbackCalibration",
+         "LatencyCompensation", "LatencyStatistics"};
+    static std::string name;
+    if (address < PWM_SETTINGS_ADDRESS)
+        return names_before_pwm_settings[address - Harp::APP_REG_START_ADDRESS];
+    if (address < PWM_SETTINGS_ADDRESS + NUM_GPIOS)
+    {
+        name = "PwmSettings" + std::to_string(address - PWM_SETTINGS_ADDRESS);
+        return name.c_str();
+    }
+    size_t index = address - PWM_SETTINGS_ADDRESS - NUM_GPIOS;
+    if (index < std::size(names_after_pwm_settings))
+        return names_after_pwm_settings[index];
+    name = "Register" + std::to_string(address);
+    return name.c_str();
+}
+
+frame_t write_frame(uint8_t address, reg_type_t payload_type,
+                    const void* payload, size_t num_bytes)
+{
+    return host_harp_frame(WRITE, address, payload_type,
+                           (const volatile uint8_t*)payload, num_bytes);
+}
+
+frame_t write_u8(uint8_t address, uint8_t value)
+{return write_frame(address, U8, &value, sizeof(value));}
+
+frame_t write_u32(uint8_t address, uint32_t value)
+{return write_frame(address, U32, &value, sizeof(value));}
+
+frame_t write_port(uint8_t address, port_t value)
+{return write_frame(address, reg_type_t(sizeof(port_t)), &value, sizeof(value));}
+
+frame_t write_pwm_settings(size_t channel, const pwm_settings_t& settings)
+{
+    // Packed like pyharp's "<LLLLB".
+    uint8_t payload[sizeof(pwm_settings_t)];
+    memcpy(payload, &settings, sizeof(settings));
+    return write_frame(uint8_t(PWM_SETTINGS_ADDRESS + channel), U8, payload,
+                       sizeof(payload));
+}
+
+/**
+ * \brief write a packed settings struct to its U8 array register.
+ */
+template <typename Settings>
+frame_t write_settings(uint8_t address, const Settings& settings)
+{return write_frame(address, U8, &settings, sizeof(settings));}
+
+frame_t write_trial_settings(const pwm_trial_settings_t& settings)
+{
+    uint8_t payload[sizeof(pwm_trial_settings_t)];
+    memcpy(payload, &settings, sizeof(settings));
+    return write_frame(PWM_TRIAL_SETTINGS_ADDRESS, U8, payload,
+                       sizeof(payload));
+}
+
+frame_t write_state_machine_program(const std::vector<sm_state_t>& states)
+{
+    return write_frame(STATE_MACHINE_PROGRAM_ADDRESS, U8, states.data(),
+                       states.size() * sizeof(sm_state_t));
+}
+
+frame_t write_loopback_calibration(const loopback_calibration_t& settings)
+{return write_frame(LOOPBACK_CALIBRATION_ADDRESS, U8, &settings,
+                    sizeof(settings));}
+
+frame_t write_latency_compensation(const latency_compensation_t& compensation)
+{
+    uint32_t payload[2] = {compensation.alarm_lead_us,
+                           compensation.input_latency_us};
+    return write_frame(LATENCY_COMPENSATION_ADDRESS, U32, payload,
+                       sizeof(payload));
+}
+
+/**
+ * \brief StreamRecords block that toggles channel 0 every \p delta_us.
+ */
+frame_t write_stream_records(const std::vector<uint32_t>& deltas_us)
+{
+    std::vector<uint32_t> payload;
+    for (size_t i = 0; i < deltas_us.size(); ++i)
+    {
+        payload.insert(payload.end(),
+                       {deltas_us[i], 0x01, uint32_t((i & 1)? 0: 0x01)});
+    }
+    return write_frame(STREAM_RECORDS_ADDRESS, U32, payload.data(),
+                       payload.size() * sizeof(uint32_t));
+}
+
+frame_t read_frame(uint8_t address)
+{
+    const RegSpec& spec = Harp::reg_address_to_spec(address);
+    return host_harp_frame(READ, address, spec.payload_type, nullptr, 0);
+}
+
+/**
+ * \brief hand one command frame to its handler, then run the main loop once.
+ * \returns the replies (not events) that the command produced.
+ */
+std::vector<frame_t> replay(frame_t frame)
+{
+    size_t first_frame = host_harp_frames.size();
+    // Let core1 run whenever the handler waits on it, and leave its time out.
+    sim_enable_idle_hook(true);
+    auto core1_start_time = sim_core1_time;
+    auto start = bench_clock::now();
+    bool handled = app.dispatch(frame.data());
+    auto elapsed = (bench_clock::now() - start)
+                   - (sim_core1_time - core1_start_time);
+    sim_enable_idle_hook(false);
+    if (handled)
+        handler_stats[{frame[0], frame[2]}].add(elapsed);
+    start = bench_clock::now();
+    app.update();
+    update_stats.add(bench_clock::now() - start);
+
+    std::vector<frame_t> replies;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        if (host_harp_frames[i][0] != EVENT)
+            replies.push_back(host_harp_frames[i]);
+    }
+    return replies;
+}
+
+const uint8_t* payload_of(const frame_t& frame)
+{return &frame[(frame[4] & HAS_TIMESTAMP)? 11: 5];}
+
+size_t payload_size_of(const frame_t& frame)
+{return frame[1] - ((frame[4] & HAS_TIMESTAMP)? 10: 4);}
+
+/**
+ * \brief replay a command and check that it got exactly one reply for its
+ *  register of type \p expected_type by the time the next command is due.
+ * \returns the reply (empty if there was none).
+ */
+frame_t expect(const frame_t& command, msg_type_t expected_type,
+               const char* what)
+{
+    size_t first_frame = host_harp_frames.size();
+    replay(command);
+    // Replies that wait for core1 (i.e: to slot writes) follow in the gap.
+    sim_run_for_us(MESSAGE_GAP_US);
+    std::vector<frame_t> replies;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        if (host_harp_frames[i][0] != EVENT)
+            replies.push_back(host_harp_frames[i]);
+    }
+    bool ok = (replies.size() == 1) && (replies[0][0] == expected_type)
+              && (replies[0][2] == command[2]);
+    check(ok, what);
+    return ok? replies[0]: frame_t{};
+}
+
+/**
+ * \brief Harp time of a timestamped frame in 32us ticks.
+ */
+uint64_t time_ticks_of(const frame_t& frame)
+{
+    uint32_t seconds;
+    uint16_t ticks;
+    memcpy(&seconds, &frame[5], sizeof(seconds));
+    memcpy(&ticks, &frame[9], sizeof(ticks));
+    return uint64_t(seconds) * 31250 + ticks;
+}
+
+/**
+ * \brief whether an EVENT from register \p address was sent since frame
+ *  \p first_frame.
+ */
+bool event_sent(uint8_t address, size_t first_frame)
+{
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        if ((host_harp_frames[i][0] == EVENT)
+            && (host_harp_frames[i][2] == address))
+            return true;
+    }
+    return false;
+}
+
+bool gpio_out_high(size_t channel)
+{return (host_gpio_out() >> (PORT_BASE + channel)) & 1u;}
+
+// Scenarios. Each mirrors one of the software/pyharp scripts.
+
+void toggle_ports()
+{
+    expect(write_port(PORT_DIR_ADDRESS, ALL_CHANNELS), WRITE,
+           "toggle_ports: PortDir");
+    frame_t reply = expect(write_port(PORT_STATE_ADDRESS, ALL_CHANNELS), WRITE,
+                           "toggle_ports: PortState on");
+    check(!reply.empty() && (*(port_t*)payload_of(reply) == ALL_CHANNELS),
+          "toggle_ports: all outputs read back high");
+    reply = expect(write_port(PORT_STATE_ADDRESS, 0), WRITE,
+                   "toggle_ports: PortState off");
+    check(!reply.empty() && (*(port_t*)payload_of(reply) == 0),
+          "toggle_ports: all outputs read back low");
+    expect(write_port(PORT_SET_ADDRESS, 0x01), WRITE, "toggle_ports: PortSet");
+    reply = expect(read_frame(PORT_STATE_ADDRESS), READ,
+                   "toggle_ports: read PortState");
+    check(!reply.empty() && (*(port_t*)payload_of(reply) == 0x01),
+          "toggle_ports: PortSet drives one output");
+    expect(read_frame(PORT_SET_ADDRESS), READ_ERROR,
+           "toggle_ports: PortSet is write-only");
+}
+
+void send_waveform()
+{
+    expect(write_port(PORT_DIR_ADDRESS, ALL_CHANNELS), WRITE,
+           "send_waveform: PortDir");
+    expect(write_pwm_settings(0, {0, 500, 500, 10, 0}), WRITE,
+           "send_waveform: PwmSettings0");
+    size_t first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, "send_waveform: start");
+    sim_run_for_us(15000); // 10 cycles of 1[ms] and then some.
+    check(event_sent(PWM_STATE_ADDRESS, first_frame),
+          "send_waveform: PwmState EVENT when the schedule finishes");
+    frame_t reply = expect(read_frame(PWM_STATE_ADDRESS), READ,
+                           "send_waveform: read PwmState");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "send_waveform: stopped after the last cycle");
+}
+
+/**
+ * \brief queue idle hook for a core1 that does not answer: time passes, but
+ *  core1 does not run.
+ */
+void stall_core1()
+{host_advance_time_us(1);}
+
+void start_timeout()
+{
+    expect(write_pwm_settings(0, {0, 500, 500, 0, 0}), WRITE,
+           "start_timeout: PwmSettings0");
+    size_t first_frame = host_harp_frames.size();
+    host_set_queue_idle_hook(stall_core1);
+    app.dispatch(write_u8(PWM_STATE_ADDRESS, 1).data());
+    host_set_queue_idle_hook(nullptr);
+    check((host_harp_frames.size() == first_frame + 1)
+          && (host_harp_frames.back()[0] == WRITE_ERROR),
+          "start_timeout: error once core1 does not answer in time");
+    // Core1 catches up and sees the start cancelled.
+    sim_run_for_us(2000);
+    check(!gpio_out_high(0) && !event_sent(PWM_STATE_ADDRESS, first_frame),
+          "start_timeout: core1 does not start after the error");
+    frame_t reply = expect(read_frame(PWM_STATE_ADDRESS), READ,
+                           "start_timeout: read PwmState");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "start_timeout: both cores stopped");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "start_timeout: start again");
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE, "start_timeout: stop");
+}
+
+void update_waveform_error()
+{
+    pwm_settings_t settings{0, 500, 500, 0, 0}; // Loop forever.
+    expect(write_pwm_settings(0, settings), WRITE,
+           "update_waveform_error: PwmSettings0");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "update_waveform_error: start");
+    sim_run_for_us(5000);
+    expect(write_pwm_settings(0, settings), WRITE_ERROR,
+           "update_waveform_error: settings rejected while running");
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE,
+           "update_waveform_error: stop");
+}
+
+void set_interrupts()
+{
+    expect(write_port(PORT_DIR_ADDRESS, 0), WRITE, "set_interrupts: PortDir");
+    expect(write_port(ENABLE_RISING_EDGE_EVENTS_ADDRESS, 0x01), WRITE,
+           "set_interrupts: EnableRisingEdgeEvents");
+    size_t first_frame = host_harp_frames.size();
+    host_set_gpio_in(1u << PORT_BASE, 1u << PORT_BASE);
+    sim_run_for_us(HARP_TX_FLUSH_US + 10); // Events go out once per frame.
+    check(event_sent(RISING_EDGE_EVENTS_ADDRESS, first_frame),
+          "set_interrupts: RisingEdgeEvents EVENT on a rising edge");
+    first_frame = host_harp_frames.size();
+    host_set_gpio_in(1u << PORT_BASE, 0);
+    sim_run_for_us(HARP_TX_FLUSH_US + 10);
+    check(!event_sent(FALLING_EDGE_EVENTS_ADDRESS, first_frame),
+          "set_interrupts: no FallingEdgeEvents EVENT when disabled");
+}
+
+/**
+ * \brief toggle input channel 0 \p num_edges times, \p gap_us apart.
+ */
+void toggle_input(size_t num_edges, uint32_t gap_us)
+{
+    for (size_t i = 0; i < num_edges; ++i)
+    {
+        host_set_gpio_in(1u << PORT_BASE, (gpio_get_all() ^ (1u << PORT_BASE)));
+        sim_run_for_us(gap_us);
+    }
+}
+
+/**
+ * \brief edge EVENTs since frame \p first_frame, checking that they
+ *  alternate between rising and falling and keep their timestamps in order.
+ */
+size_t count_edge_events(size_t first_frame, const char* what)
+{
+    size_t count = 0;
+    bool ok = true;
+    uint64_t last_ticks = 0;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        const frame_t& frame = host_harp_frames[i];
+        if ((frame[0] != EVENT) || ((frame[2] != RISING_EDGE_EVENTS_ADDRESS)
+                                    && (frame[2] != FALLING_EDGE_EVENTS_ADDRESS)))
+            continue;
+        uint64_t time_ticks = time_ticks_of(frame);
+        ok &= (frame[2] == ((count % 2)? FALLING_EDGE_EVENTS_ADDRESS
+                                       : RISING_EDGE_EVENTS_ADDRESS))
+              && (time_ticks >= last_ticks);
+        last_ticks = time_ticks;
+        ++count;
+    }
+    check(ok, what);
+    return count;
+}
+
+void event_batching()
+{
+    expect(write_port(PORT_DIR_ADDRESS, 0), WRITE, "event_batching: PortDir");
+    expect(write_port(ENABLE_RISING_EDGE_EVENTS_ADDRESS, 0x01), WRITE,
+           "event_batching: EnableRisingEdgeEvents");
+    expect(write_port(ENABLE_FALLING_EDGE_EVENTS_ADDRESS, 0x01), WRITE,
+           "event_batching: EnableFallingEdgeEvents");
+    sim_run_for_us(HARP_TX_FLUSH_US);
+    size_t first_frame = host_harp_frames.size();
+    size_t first_transfer = host_usb_transfers;
+    toggle_input(10, 20);
+    check(count_edge_events(first_frame, "event_batching: order") == 0,
+          "event_batching: events wait for the end of the USB frame");
+    sim_run_for_us(HARP_TX_FLUSH_US);
+    check(count_edge_events(first_frame, "event_batching: order") == 10,
+          "event_batching: every edge is reported");
+    // The first 13 B event goes out alone. The other 9 fill two packets.
+    check(host_usb_transfers - first_transfer == 3,
+          "event_batching: a frame's events share USB packets");
+    // Events that USB cannot take yet go out with a later frame, and replies
+    // sent meanwhile never split one of them.
+    host_set_cdc_tx_space(40);
+    first_frame = host_harp_frames.size();
+    toggle_input(10, 20);
+    sim_run_for_us(HARP_TX_FLUSH_US);
+    check(count_edge_events(first_frame, "event_batching: order when full")
+          < 10, "event_batching: USB takes part of the batch");
+    replay(read_frame(PORT_DIR_ADDRESS));
+    host_set_cdc_tx_space(SIZE_MAX);
+    sim_run_for_us(2 * HARP_TX_FLUSH_US);
+    check(count_edge_events(first_frame, "event_batching: order when full")
+          == 10, "event_batching: the rest follows");
+    check(host_bad_frames == 0,
+          "event_batching: replies go between whole events");
+}
+
+/**
+ * \brief (trial, Harp time in 32us ticks) of the PwmTrialStart EVENTs since
+ *  frame \p first_frame.
+ */
+std::vector<std::pair<uint32_t, uint64_t>> trial_starts(size_t first_frame)
+{
+    std::vector<std::pair<uint32_t, uint64_t>> starts;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        const frame_t& frame = host_harp_frames[i];
+        if ((frame[0] != EVENT) || (frame[2] != PWM_TRIAL_START_ADDRESS))
+            continue;
+        uint32_t trial;
+        memcpy(&trial, payload_of(frame), sizeof(trial));
+        starts.emplace_back(trial, time_ticks_of(frame));
+    }
+    return starts;
+}
+
+/**
+ * \brief run 3 trials of a 3-cycle train with random ITIs.
+ * \returns the intervals between trial starts in 32us ticks.
+ */
+std::vector<uint64_t> run_random_trials(const char* what)
+{
+    expect(write_trial_settings({1, 3, RandomInterval::UNIFORM, 1234, 0,
+                                 1000, 20000, 0, 0}),
+           WRITE, what);
+    size_t first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, what);
+    sim_run_for_us(60000);
+    auto starts = trial_starts(first_frame);
+    std::vector<uint64_t> intervals;
+    for (size_t i = 1; i < starts.size(); ++i)
+        intervals.push_back(starts[i].second - starts[i - 1].second);
+    return intervals;
+}
+
+void repeat_trials()
+{
+    expect(write_port(PORT_DIR_ADDRESS, 0x01), WRITE, "repeat_trials: PortDir");
+    expect(write_pwm_settings(0, {0, 500, 500, 3, 0}), WRITE,
+           "repeat_trials: PwmSettings0");
+    expect(write_trial_settings({1, 3, 0, 0, 0, 2000, 0, 0, 0}), WRITE,
+           "repeat_trials: fixed ITI");
+    size_t first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, "repeat_trials: start");
+    sim_run_for_us(12000); // Still in the third trial.
+    check(!event_sent(PWM_STATE_ADDRESS, first_frame),
+          "repeat_trials: no PwmState EVENT between trials");
+    sim_run_for_us(8000);
+    check(event_sent(PWM_STATE_ADDRESS, first_frame),
+          "repeat_trials: PwmState EVENT after the last trial");
+    auto starts = trial_starts(first_frame);
+    bool ok = (starts.size() == 3);
+    for (size_t i = 0; ok && (i < starts.size()); ++i)
+        ok = (starts[i].first == i);
+    check(ok, "repeat_trials: one PwmTrialStart EVENT per trial, in order");
+    if (ok)
+    {
+        // A trial lasts 2.5ms (to its last edge), then waits out the ITI.
+        uint64_t first_interval = starts[1].second - starts[0].second;
+        uint64_t second_interval = starts[2].second - starts[1].second;
+        check((first_interval >= (2500 + 2000) / 32)
+              && (first_interval <= (3000 + 2000) / 32 + 1)
+              && (second_interval + 1 >= first_interval)
+              && (second_interval <= first_interval + 1),
+              "repeat_trials: trials start a fixed ITI after the last ends");
+    }
+    // The same seed replays the same ITIs.
+    std::vector<uint64_t> intervals = run_random_trials(
+        "repeat_trials: random ITI");
+    check((intervals.size() == 2) && (intervals[0] != intervals[1]),
+          "repeat_trials: ITIs are random");
+    // Intervals between timestamps may round to a tick either way.
+    std::vector<uint64_t> replayed = run_random_trials(
+        "repeat_trials: random ITI again");
+    bool replays = (replayed.size() == intervals.size());
+    for (size_t i = 0; replays && (i < intervals.size()); ++i)
+        replays = (replayed[i] + 1 >= intervals[i])
+                  && (replayed[i] <= intervals[i] + 1);
+    check(replays, "repeat_trials: the seed replays the ITIs");
+    // Channel 1 triggers every trial after the first, until stopped.
+    expect(write_trial_settings({1, 0, 0, 0, 0, 1000, 0,
+                                 TrialRepeat::RISING, 0}), WRITE_ERROR,
+           "repeat_trials: the trigger must be an input");
+    expect(write_trial_settings({1, 0, 0, 0, 0, 1000, 0,
+                                 TrialRepeat::RISING, 1}), WRITE,
+           "repeat_trials: triggered trials");
+    first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "repeat_trials: start triggered");
+    sim_run_for_us(10000);
+    check(trial_starts(first_frame).size() == 1,
+          "repeat_trials: the next trial waits for the trigger");
+    host_set_gpio_in(1u << (PORT_BASE + 1), 1u << (PORT_BASE + 1));
+    sim_run_for_us(HARP_TX_FLUSH_US + 10);
+    auto triggered = trial_starts(first_frame);
+    check((triggered.size() == 2) && (triggered[1].first == 1),
+          "repeat_trials: a trigger edge starts the next trial");
+    host_set_gpio_in(1u << (PORT_BASE + 1), 0);
+    sim_run_for_us(10000);
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE,
+           "repeat_trials: stop between trials");
+    frame_t reply = expect(read_frame(PWM_STATE_ADDRESS), READ,
+                           "repeat_trials: read PwmState");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "repeat_trials: stopped");
+}
+
+/**
+ * \brief (event, Harp time in 32us ticks) of the StateMachineTransition
+ *  EVENTs since frame \p first_frame.
+ */
+std::vector<std::pair<sm_event_t, uint64_t>> transitions(size_t first_frame)
+{
+    std::vector<std::pair<sm_event_t, uint64_t>> events;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        const frame_t& frame = host_harp_frames[i];
+        if ((frame[0] != EVENT)
+            || (frame[2] != STATE_MACHINE_TRANSITION_ADDRESS))
+            continue;
+        sm_event_t event;
+        memcpy(&event, payload_of(frame), sizeof(event));
+        events.emplace_back(event, time_ticks_of(frame));
+    }
+    return events;
+}
+
+void state_machine_trial()
+{
+    using SM = CuttlefishStateMachine;
+    using enum sm_condition_t;
+    constexpr uint8_t POKE = 1;
+    constexpr uint8_t REWARD = 2;
+    // Wait for a poke, play a 3-cycle cue on channel 0, then reward a poke
+    // within 5ms.
+    std::vector<sm_state_t> program = {
+        {0, 0, 0, 0, SM::END, {{uint8_t(RISING), POKE, 1}, {}}},
+        {0, 0, SM::SCHEDULE_START, 0, SM::END,
+         {{uint8_t(SCHEDULE_DONE), 0, 2}, {}}},
+        {0, 0, 0, 5000, 4, {{uint8_t(RISING), POKE, 3}, {}}},
+        {1u << REWARD, 0, 0, 1000, 4, {}},
+        {0, 1u << REWARD, 0, 1, SM::END, {}},
+    };
+    expect(write_u8(STATE_MACHINE_CONTROL_ADDRESS, 1), WRITE_ERROR,
+           "state_machine: no program, no start");
+    program[0].transitions[0].next = 7;
+    expect(write_state_machine_program(program), WRITE_ERROR,
+           "state_machine: states lead to states");
+    program[0].transitions[0].next = 1;
+    expect(write_state_machine_program(program), WRITE,
+           "state_machine: StateMachineProgram");
+    expect(write_port(PORT_DIR_ADDRESS, 0x01), WRITE, "state_machine: PortDir");
+    expect(write_pwm_settings(0, {0, 500, 500, 3, 0}), WRITE,
+           "state_machine: PwmSettings0");
+    expect(write_u8(STATE_MACHINE_CONTROL_ADDRESS, 1), WRITE_ERROR,
+           "state_machine: the reward must be an output");
+    expect(write_port(PORT_DIR_ADDRESS, 0x05), WRITE,
+           "state_machine: PortDir with the reward");
+    size_t first_frame = host_harp_frames.size();
+    expect(write_u8(STATE_MACHINE_CONTROL_ADDRESS, 1), WRITE,
+           "state_machine: start");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE_ERROR,
+           "state_machine: it owns the schedule");
+    expect(write_state_machine_program(program), WRITE_ERROR,
+           "state_machine: no uploads while running");
+    expect(write_pwm_settings(1, {0, 100, 100, 0, 0}), WRITE_ERROR,
+           "state_machine: no schedule writes while running");
+    host_set_gpio_in(1u << (PORT_BASE + POKE), 1u << (PORT_BASE + POKE));
+    sim_run_for_us(10);
+    check(gpio_out_high(0), "state_machine: a poke starts the cue");
+    host_set_gpio_in(1u << (PORT_BASE + POKE), 0);
+    sim_run_for_us(4000);
+    check(!gpio_out_high(REWARD), "state_machine: no reward without a poke");
+    host_set_gpio_in(1u << (PORT_BASE + POKE), 1u << (PORT_BASE + POKE));
+    sim_run_for_us(5);
+    check(gpio_out_high(REWARD),
+          "state_machine: a poke in the window drives the reward within 5us");
+    sim_run_for_us(1000 + HARP_TX_FLUSH_US + 10);
+    check(!gpio_out_high(REWARD), "state_machine: the reward turns off");
+    auto events = transitions(first_frame);
+    const uint8_t expected[] = {0, 1, 2, 3, 4, SM::END};
+    bool ok = (events.size() == std::size(expected));
+    for (size_t i = 0; ok && (i < events.size()); ++i)
+        ok = (events[i].first.state == expected[i]);
+    check(ok, "state_machine: one StateMachineTransition EVENT per state");
+    if (ok)
+    {
+        // The reward lasts its 1ms timeout.
+        uint64_t reward_ticks = events[4].second - events[3].second;
+        check((reward_ticks + 1 >= 1000 / 32) && (reward_ticks <= 1000 / 32 + 1),
+              "state_machine: EVENTs carry the time of each transition");
+    }
+    check(event_sent(PWM_STATE_ADDRESS, first_frame),
+          "state_machine: PwmState EVENTs follow the cue");
+    frame_t reply = expect(read_frame(STATE_MACHINE_CONTROL_ADDRESS), READ,
+                           "state_machine: read StateMachineControl");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "state_machine: the program ended");
+    // Stopping mid-trial reports where it stopped.
+    expect(write_u8(STATE_MACHINE_CONTROL_ADDRESS, 1), WRITE,
+           "state_machine: start again");
+    sim_run_for_us(1000);
+    expect(write_u8(STATE_MACHINE_CONTROL_ADDRESS, 0), WRITE,
+           "state_machine: stop");
+    sim_run_for_us(HARP_TX_FLUSH_US + 10);
+    reply = expect(read_frame(STATE_MACHINE_TRANSITION_ADDRESS), READ,
+                   "state_machine: read StateMachineTransition");
+    check(!reply.empty() && (payload_of(reply)[0] == SM::END)
+          && (payload_of(reply)[1] == 0)
+          && (payload_of(reply)[2] == uint8_t(sm_cause_t::STOP)),
+          "state_machine: stopped in the first state");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "state_machine: the schedule is free again");
+}
+
+/**
+ * \brief us from starting a schedule with channel 0 rising after 1ms until
+ *  it rises.
+ */
+uint64_t output_rise_delay_us()
+{
+    expect(write_pwm_settings(0, {1000, 500, 500, 1, 0}), WRITE,
+           "loopback_calibration: PwmSettings0");
+    uint64_t start_time_us = time_us_64();
+    replay(write_u8(PWM_STATE_ADDRESS, 1));
+    while (!gpio_out_high(0) && (time_us_64() - start_time_us < 2000))
+        sim_run_for_us(1);
+    uint64_t delay_us = time_us_64() - start_time_us;
+    sim_run_for_us(1000);
+    return delay_us;
+}
+
+/**
+ * \brief Harp time of the RisingEdgeEvents EVENT for a rising edge on
+ *  channel 1 minus the Harp time of the edge, in us. The EVENT is in 32us
+ *  ticks, so this is in (-32, 0] plus any timestamp correction.
+ */
+int64_t input_rise_offset_us()
+{
+    host_set_gpio_in(1u << (PORT_BASE + 1), 0);
+    sim_run_for_us(1000);
+    size_t first_frame = host_harp_frames.size();
+    int64_t edge_time_us = Harp::system_to_harp_us_64(time_us_64());
+    host_set_gpio_in(1u << (PORT_BASE + 1), 1u << (PORT_BASE + 1));
+    sim_run_for_us(HARP_TX_FLUSH_US + 10);
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        if ((host_harp_frames[i][0] == EVENT)
+            && (host_harp_frames[i][2] == RISING_EDGE_EVENTS_ADDRESS))
+            return int64_t(time_ticks_of(host_harp_frames[i]) * 32)
+                   - edge_time_us;
+    }
+    return INT64_MAX;
+}
+
+void loopback_calibration()
+{
+    // Compensation shifts outputs and input timestamps.
+    expect(write_port(PORT_DIR_ADDRESS, 0x01), WRITE,
+           "loopback_calibration: PortDir");
+    expect(write_port(ENABLE_RISING_EDGE_EVENTS_ADDRESS, 0x02), WRITE,
+           "loopback_calibration: EnableRisingEdgeEvents");
+    uint64_t delay_us = output_rise_delay_us();
+    int64_t offset_us = input_rise_offset_us();
+    check((offset_us > -32) && (offset_us <= 0),
+          "loopback_calibration: RisingEdgeEvents EVENT at the edge");
+    expect(write_latency_compensation({MAX_ALARM_LEAD_US + 1, 0}),
+           WRITE_ERROR, "loopback_calibration: the alarm lead is limited");
+    expect(write_latency_compensation({3, MAX_INPUT_LATENCY_US}), WRITE,
+           "loopback_calibration: LatencyCompensation");
+    check(output_rise_delay_us() + 3 == delay_us,
+          "loopback_calibration: alarms fire early by the alarm lead");
+    offset_us = input_rise_offset_us() + MAX_INPUT_LATENCY_US;
+    check((offset_us > -32) && (offset_us <= 0),
+          "loopback_calibration: edges are timestamped earlier by the "
+          "input latency");
+
+    // Calibrate from channel 0 to channel 1.
+    expect(write_loopback_calibration({1, 0, 0}), WRITE_ERROR,
+           "loopback_calibration: the input is not the output");
+    expect(write_loopback_calibration({1, 1, 0}), WRITE_ERROR,
+           "loopback_calibration: the input is not an output");
+    expect(write_pwm_settings(2, {0, 500, 500, 0, 0}), WRITE,
+           "loopback_calibration: PwmSettings2");
+    host_set_gpio_in(1u << (PORT_BASE + 1), 0);
+    size_t first_frame = host_harp_frames.size();
+    expect(write_loopback_calibration({1, 0, 1}), WRITE,
+           "loopback_calibration: start");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE_ERROR,
+           "loopback_calibration: it owns the schedule");
+    expect(write_latency_compensation({0, 0}), WRITE_ERROR,
+           "loopback_calibration: no compensation writes while measuring");
+    // The jumper. The simulated edge capture sees nothing, so the
+    // calibration measures no edges and keeps the compensation. Putting the
+    // schedule back when it is done waits on core1.
+    sim_enable_idle_hook(true);
+    size_t edges = 0;
+    for (uint32_t i = 0; (i < LOOPBACK_CALIBRATION_EDGES * 250)
+                         && (edges < LOOPBACK_CALIBRATION_EDGES); ++i)
+    {
+        if (gpio_out_high(0) != bool(gpio_get_all() & (1u << (PORT_BASE + 1))))
+        {
+            host_set_gpio_in(1u << (PORT_BASE + 1),
+                             gpio_out_high(0)? 1u << (PORT_BASE + 1): 0);
+            ++edges;
+        }
+        sim_run_for_us(1);
+    }
+    check(edges == LOOPBACK_CALIBRATION_EDGES,
+          "loopback_calibration: the output toggles for every edge");
+    // It keeps measuring for a while after its schedule is done.
+    sim_run_for_us(2 * LOOPBACK_CALIBRATION_SPACING_US);
+    expect(write_pwm_settings(2, {0, 100, 100, 0, 0}), WRITE_ERROR,
+           "loopback_calibration: no schedule writes while it settles");
+    sim_enable_idle_hook(true); // replay() turns it off.
+    sim_run_for_us(LOOPBACK_CALIBRATION_SETTLE_US + HARP_TX_FLUSH_US + 10);
+    sim_enable_idle_hook(false);
+    check(event_sent(LATENCY_STATISTICS_ADDRESS, first_frame),
+          "loopback_calibration: LatencyStatistics EVENT when it is done");
+    check(!event_sent(RISING_EDGE_EVENTS_ADDRESS, first_frame)
+          && !event_sent(PWM_STATE_ADDRESS, first_frame),
+          "loopback_calibration: its edges and schedule are not reported");
+    frame_t reply = expect(read_frame(LATENCY_STATISTICS_ADDRESS), READ,
+                           "loopback_calibration: read LatencyStatistics");
+    latency_stats_t stats{};
+    if (!reply.empty())
+        memcpy(&stats, payload_of(reply), sizeof(stats));
+    check(!reply.empty() && (stats.output_edges == 0)
+          && (stats.input_edges == 0),
+          "loopback_calibration: no edges captured");
+    reply = expect(read_frame(LATENCY_COMPENSATION_ADDRESS), READ,
+                   "loopback_calibration: read LatencyCompensation");
+    check(!reply.empty() && (((uint32_t*)payload_of(reply))[0] == 3)
+          && (((uint32_t*)payload_of(reply))[1] == MAX_INPUT_LATENCY_US),
+          "loopback_calibration: too few edges keep the compensation");
+    reply = expect(read_frame(LOOPBACK_CALIBRATION_ADDRESS), READ,
+                   "loopback_calibration: read LoopbackCalibration");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "loopback_calibration: done");
+    reply = expect(read_frame(PORT_DIR_ADDRESS), READ,
+                   "loopback_calibration: read PortDir");
+    check(!reply.empty() && (*(port_t*)payload_of(reply) == 0x05),
+          "loopback_calibration: the schedule's outputs are put back");
+    first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "loopback_calibration: the schedule is free again");
+    sim_run_for_us(100);
+    check(gpio_out_high(2),
+          "loopback_calibration: the schedule is put back");
+}
+
+/**
+ * \brief StreamUnderrun value (records played) if an EVENT from it was sent
+ *  since frame \p first_frame, or -1 if none was.
+ */
+int64_t stream_underrun(size_t first_frame)
+{
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        const frame_t& frame = host_harp_frames[i];
+        if ((frame[0] != EVENT) || (frame[2] != STREAM_UNDERRUN_ADDRESS))
+            continue;
+        uint32_t played;
+        memcpy(&played, payload_of(frame), sizeof(played));
+        return played;
+    }
+    return -1;
+}
+
+void stream_waveform()
+{
+    expect(write_port(PORT_DIR_ADDRESS, 0x01), WRITE,
+           "stream_waveform: PortDir");
+    expect(write_u8(STREAM_MODE_ADDRESS, 1), WRITE,
+           "stream_waveform: StreamMode");
+    // Records due together (i.e: closer than the alarm ISR's latency) are
+    // played back-to-back instead of failing the stream as late.
+    expect(write_stream_records({100, 0, 200, 0, 200, 0}), WRITE,
+           "stream_waveform: StreamRecords");
+    size_t first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, "stream_waveform: start");
+    sim_run_for_us(2000);
+    check(stream_underrun(first_frame) == 6,
+          "stream_waveform: records below the ISR latency are played");
+    check(event_sent(PWM_STATE_ADDRESS, first_frame),
+          "stream_waveform: PwmState EVENT when the stream runs out");
+    frame_t reply = expect(read_frame(SCHEDULE_DIAGNOSTICS_ADDRESS), READ,
+                           "stream_waveform: read ScheduleDiagnostics");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "stream_waveform: no missed deadline");
+    // Records that a stopped stream never played are dropped, but those
+    // written after the stop are kept for the next one.
+    expect(write_stream_records({5000, 5000, 5000}), WRITE,
+           "stream_waveform: records to stop");
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, "stream_waveform: restart");
+    sim_run_for_us(1000);
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE, "stream_waveform: stop");
+    expect(write_stream_records({100, 100}), WRITE,
+           "stream_waveform: records after the stop");
+    first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "stream_waveform: start again");
+    sim_run_for_us(1000);
+    check(stream_underrun(first_frame) == 2,
+          "stream_waveform: only the records after the stop are played");
+    // Core1 may only take the new mode after the new records are written.
+    replay(write_u8(STREAM_MODE_ADDRESS, 0));
+    replay(write_u8(STREAM_MODE_ADDRESS, 1));
+    replay(write_stream_records({100, 100, 100}));
+    sim_run_for_us(MESSAGE_GAP_US);
+    first_frame = host_harp_frames.size();
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE,
+           "stream_waveform: start after re-entering StreamMode");
+    sim_run_for_us(1000);
+    check(stream_underrun(first_frame) == 3,
+          "stream_waveform: re-entering StreamMode keeps the new records");
+    expect(write_u8(STREAM_MODE_ADDRESS, 0), WRITE,
+           "stream_waveform: leave StreamMode");
+}
+
+void slot_writes()
+{
+    expect(write_pwm_settings(0, {0, 500, 500, 0, 0}), WRITE,
+           "slot_writes: PwmSettings0");
+    expect(write_u8(SAVE_SCHEDULE_SLOT_ADDRESS, 2), WRITE,
+           "slot_writes: save slot 2");
+    expect(write_pwm_settings(1, {0, 300, 300, 0, 0}), WRITE,
+           "slot_writes: PwmSettings1");
+    expect(write_u8(SAVE_SCHEDULE_SLOT_ADDRESS, 3), WRITE,
+           "slot_writes: save slot 3");
+    expect(write_u8(SCHEDULE_SLOT_ADDRESS, 5), WRITE_ERROR,
+           "slot_writes: error loading an empty slot");
+    // The schedule cannot change until core1 has loaded the slot.
+    std::vector<frame_t> replies = replay(write_u8(SCHEDULE_SLOT_ADDRESS, 2));
+    check(replies.empty(), "slot_writes: no reply before core1 answers");
+    replies = replay(write_pwm_settings(1, {0, 300, 300, 0, 0}));
+    check((replies.size() == 1) && (replies[0][0] == WRITE_ERROR),
+          "slot_writes: error changing the schedule while loading");
+    size_t first_frame = host_harp_frames.size();
+    sim_run_for_us(MESSAGE_GAP_US);
+    check((host_harp_frames.size() == first_frame + 1)
+          && (host_harp_frames.back()[0] == WRITE)
+          && (host_harp_frames.back()[2] == SCHEDULE_SLOT_ADDRESS),
+          "slot_writes: reply once core1 loaded the slot");
+    frame_t reply = expect(read_frame(SCHEDULE_SLOT_ADDRESS), READ,
+                           "slot_writes: read ScheduleSlot");
+    check(!reply.empty() && (payload_of(reply)[0] == 2),
+          "slot_writes: slot 2 loaded");
+    // Core0 waits for core1 to start the slot that it loaded.
+    first_frame = host_harp_frames.size();
+    app.dispatch(write_u8(SCHEDULE_SLOT_ADDRESS, 2 | SCHEDULE_SLOT_START)
+                 .data());
+    sim_step_core1();
+    sim_enable_idle_hook(true);
+    app.update();
+    sim_enable_idle_hook(false);
+    check((host_harp_frames.size() == first_frame + 1)
+          && (host_harp_frames.back()[0] == WRITE)
+          && (host_harp_frames.back()[4] & HAS_TIMESTAMP),
+          "slot_writes: timestamped reply to a load and start");
+    sim_run_for_us(MESSAGE_GAP_US);
+    check(gpio_out_high(0), "slot_writes: slot 2 started");
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE, "slot_writes: stop");
+    // A load that core1 answers late is refused in time, then reported.
+    first_frame = host_harp_frames.size();
+    app.dispatch(write_u8(SCHEDULE_SLOT_ADDRESS, 3).data());
+    for (uint32_t t = 0; t <= SCHEDULE_SLOT_TIMEOUT_US; t += 1000)
+    {
+        host_advance_time_us(1000);
+        app.update();
+    }
+    check((host_harp_frames.size() == first_frame + 1)
+          && (host_harp_frames.back()[0] == WRITE_ERROR),
+          "slot_writes: error once core1 does not answer in time");
+    sim_run_for_us(2000); // Events go out once per USB frame.
+    check(event_sent(SCHEDULE_SLOT_ADDRESS, first_frame),
+          "slot_writes: late load reported as an EVENT");
+    reply = expect(read_frame(SCHEDULE_SLOT_ADDRESS), READ,
+                   "slot_writes: read ScheduleSlot after the late load");
+    check(!reply.empty() && (payload_of(reply)[0] == 3),
+          "slot_writes: registers follow the late load");
+}
+
+void stored_configuration()
+{
+    expect(write_port(PORT_DIR_ADDRESS, 0x0F), WRITE,
+           "stored_configuration: PortDir");
+    expect(write_u8(STORED_CONFIGURATION_ADDRESS,
+                    uint8_t(stored_config_cmd_t::SAVE)),
+           WRITE, "stored_configuration: save");
+    app.reset();
+    sim_run_for_us(MESSAGE_GAP_US);
+    frame_t reply = expect(read_frame(STORED_CONFIGURATION_ADDRESS), READ,
+                           "stored_configuration: read");
+    check(!reply.empty() && (payload_of(reply)[0] == 1),
+          "stored_configuration: valid after save");
+    expect(write_u8(STORED_CONFIGURATION_ADDRESS,
+                    uint8_t(stored_config_cmd_t::LOAD)), WRITE,
+           "stored_configuration: load");
+    reply = expect(read_frame(PORT_DIR_ADDRESS), READ,
+                   "stored_configuration: read PortDir");
+    check(!reply.empty() && (*(port_t*)payload_of(reply) == 0x0F),
+          "stored_configuration: PortDir restored");
+    expect(write_u8(STORED_CONFIGURATION_ADDRESS,
+                    uint8_t(stored_config_cmd_t::ERASE)), WRITE,
+           "stored_configuration: erase");
+}
+
+/**
+ * \brief the error paths of the write handlers that the other scenarios only
+ *  exercise with valid settings.
+ */
+void register_errors()
+{
+    using enum RandomInterval::distribution_t;
+    // Per-output settings need the output's PwmSettings first.
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{0, UNIFORM, 1, 0, 100, 200}),
+           WRITE_ERROR, "register_errors: random needs PwmSettings");
+    expect(write_settings(PWM_RAMP_SETTINGS_ADDRESS,
+                          pwm_ramp_settings_t{0, 1, 1000, 500, 5000, 5000,
+                                              10000}),
+           WRITE_ERROR, "register_errors: ramp needs PwmSettings");
+    expect(write_settings(PWM_BURST_SETTINGS_ADDRESS,
+                          pwm_burst_settings_t{0, 3, 100, 1, 0, 0}),
+           WRITE_ERROR, "register_errors: burst needs PwmSettings");
+    expect(write_settings(PWM_OVERLAY_SETTINGS_ADDRESS,
+                          pwm_overlay_settings_t{0, 0, 1, 0, 10, 10, 0}),
+           WRITE_ERROR, "register_errors: overlay needs PwmSettings");
+    expect(write_u8(SAVE_SCHEDULE_SLOT_ADDRESS, 0), WRITE_ERROR,
+           "register_errors: nothing to save to a slot");
+
+    expect(write_port(PORT_DIR_ADDRESS, 0x05), WRITE,
+           "register_errors: PortDir");
+    expect(write_pwm_settings(0, {0, 500, 500, 0, 0}), WRITE,
+           "register_errors: PwmSettings0");
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{NUM_GPIOS, UNIFORM, 1, 0, 100,
+                                                200}),
+           WRITE_ERROR, "register_errors: random channel out of range");
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{0, UNIFORM, 1, 0, 300, 200}),
+           WRITE_ERROR, "register_errors: random min above max");
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{0, EXPONENTIAL, 1, 0, 0, 200}),
+           WRITE_ERROR, "register_errors: exponential needs a mean");
+    expect(write_settings(PWM_RAMP_SETTINGS_ADDRESS,
+                          pwm_ramp_settings_t{0, 1, 1000, 500,
+                                              PeriodRamp::DUTY_SCALE, 5000,
+                                              10000}),
+           WRITE_ERROR, "register_errors: ramp duty must be below 100%");
+    expect(write_settings(PWM_BURST_SETTINGS_ADDRESS,
+                          pwm_burst_settings_t{0, 3, 0, 2, 0, 0}),
+           WRITE_ERROR, "register_errors: burst gap of 0");
+    // Gate inputs and phase lock references must be other inputs.
+    expect(write_settings(PWM_GATE_SETTINGS_ADDRESS,
+                          pwm_gate_settings_t{0, 0, OutputGate::CONTINUE, 0}),
+           WRITE_ERROR, "register_errors: gate on its own output");
+    expect(write_settings(PWM_GATE_SETTINGS_ADDRESS,
+                          pwm_gate_settings_t{0, 2, OutputGate::CONTINUE, 0}),
+           WRITE_ERROR, "register_errors: gate on an output");
+    expect(write_settings(PWM_GATE_SETTINGS_ADDRESS,
+                          pwm_gate_settings_t{0, 1, OutputGate::FREEZE + 1,
+                                              0}),
+           WRITE_ERROR, "register_errors: unknown gate mode");
+    expect(write_settings(PWM_PHASE_LOCK_SETTINGS_ADDRESS,
+                          pwm_phase_lock_settings_t{0, 2, PhaseLock::TRACK, 0,
+                                                    0}),
+           WRITE_ERROR, "register_errors: phase lock to an output");
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{0, UNIFORM, 1, 0, 100, 200}),
+           WRITE, "register_errors: random off time");
+    expect(write_settings(PWM_PHASE_LOCK_SETTINGS_ADDRESS,
+                          pwm_phase_lock_settings_t{0, 1, PhaseLock::TRACK, 0,
+                                                    0}),
+           WRITE_ERROR, "register_errors: phase lock needs fixed timing");
+    expect(write_settings(PWM_OVERLAY_SETTINGS_ADDRESS,
+                          pwm_overlay_settings_t{0, PWM_OVERLAY_TASKS, 1, 0,
+                                                 10, 10, 0}),
+           WRITE_ERROR, "register_errors: overlay index out of range");
+    expect(write_settings(PWM_OVERLAY_SETTINGS_ADDRESS,
+                          pwm_overlay_settings_t{0, 0,
+                              uint8_t(combine_op_t::XOR) + 1, 0, 10, 10, 0}),
+           WRITE_ERROR, "register_errors: unknown overlay combine");
+    // A rejected trial setting leaves the old one.
+    expect(write_trial_settings({2, 0, 0, 0, 0, 1000, 0, 0, 0}), WRITE_ERROR,
+           "register_errors: unknown trial repeat");
+    frame_t reply = expect(read_frame(PWM_TRIAL_SETTINGS_ADDRESS), READ,
+                           "register_errors: read PwmTrialSettings");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "register_errors: rejected trial settings are not kept");
+    // Values out of range.
+    expect(write_u8(SAVE_SCHEDULE_SLOT_ADDRESS, SCHEDULE_SLOT_COUNT),
+           WRITE_ERROR, "register_errors: save slot out of range");
+    expect(write_u8(BOOT_ACTION_ADDRESS,
+                    uint8_t(boot_action_t::RESTORE_AND_START) + 1),
+           WRITE_ERROR, "register_errors: unknown boot action");
+    reply = expect(read_frame(BOOT_ACTION_ADDRESS), READ,
+                   "register_errors: read BootAction");
+    check(!reply.empty() && (payload_of(reply)[0] == 0),
+          "register_errors: rejected boot action is not kept");
+    expect(write_u8(STORED_CONFIGURATION_ADDRESS, 0xFF), WRITE_ERROR,
+           "register_errors: unknown stored configuration command");
+    expect(write_u32(LOGIC_ANALYZER_RATE_HZ_ADDRESS,
+                     LOGIC_ANALYZER_MAX_RATE_HZ + 1),
+           WRITE_ERROR, "register_errors: logic analyzer rate too high");
+    expect(write_u8(INPUT_CAPTURE_ADDRESS, 2), WRITE_ERROR,
+           "register_errors: unknown input capture mode");
+    expect(write_u8(OUTPUT_ENGINE_ADDRESS,
+                    uint8_t(output_engine_t::PIO) + 1),
+           WRITE_ERROR, "register_errors: unknown output engine");
+    // The PIO engine cannot play streams.
+    expect(write_u8(STREAM_MODE_ADDRESS, 1), WRITE,
+           "register_errors: StreamMode");
+    expect(write_u8(OUTPUT_ENGINE_ADDRESS, uint8_t(output_engine_t::PIO)),
+           WRITE_ERROR, "register_errors: PIO engine with a stream");
+    expect(write_u8(STREAM_MODE_ADDRESS, 0), WRITE,
+           "register_errors: StreamMode off");
+    expect(write_u8(OUTPUT_ENGINE_ADDRESS, uint8_t(output_engine_t::PIO)),
+           WRITE, "register_errors: PIO engine");
+    expect(write_u8(STREAM_MODE_ADDRESS, 1), WRITE_ERROR,
+           "register_errors: stream with the PIO engine");
+    expect(write_u8(OUTPUT_ENGINE_ADDRESS, uint8_t(output_engine_t::ALARM)),
+           WRITE, "register_errors: alarm engine");
+    // Nothing that changes the schedule is taken while it runs.
+    expect(write_u8(PWM_STATE_ADDRESS, 1), WRITE, "register_errors: start");
+    sim_run_for_us(1000);
+    expect(write_settings(PWM_RANDOM_SETTINGS_ADDRESS,
+                          pwm_random_settings_t{0, NONE, 0, 0, 0, 0}),
+           WRITE_ERROR, "register_errors: random while running");
+    expect(write_settings(PWM_BURST_SETTINGS_ADDRESS,
+                          pwm_burst_settings_t{0, 0, 0, 0, 0, 0}),
+           WRITE_ERROR, "register_errors: burst while running");
+    expect(write_u32(EDGE_MERGE_TOLERANCE_US_ADDRESS, 5), WRITE_ERROR,
+           "register_errors: merge tolerance while running");
+    expect(write_u8(STREAM_MODE_ADDRESS, 1), WRITE_ERROR,
+           "register_errors: stream mode while running");
+    expect(write_u8(OUTPUT_ENGINE_ADDRESS, uint8_t(output_engine_t::PIO)),
+           WRITE_ERROR, "register_errors: output engine while running");
+    expect(write_u8(SAVE_SCHEDULE_SLOT_ADDRESS, 0), WRITE_ERROR,
+           "register_errors: save slot while running");
+    expect(write_u8(STORED_CONFIGURATION_ADDRESS,
+                    uint8_t(stored_config_cmd_t::SAVE)),
+           WRITE_ERROR, "register_errors: save configuration while running");
+    expect(write_u8(PWM_STATE_ADDRESS, 0), WRITE, "register_errors: stop");
+}
+
+void run_scenarios()
+{
+    for (auto scenario: {toggle_ports, send_waveform, start_timeout,
+                         update_waveform_error,
+                         set_interrupts, event_batching, repeat_trials,
+                         state_machine_trial, loopback_calibration,
+                         stream_waveform, slot_writes,
+                         stored_configuration, register_errors})
+    {
+        sim_setup();
+        scenario();
+    }
+    sim_setup();
+    frame_t bad_checksum = write_port(PORT_DIR_ADDRESS, 0);
+    ++bad_checksum.back();
+    check(!app.dispatch(bad_checksum.data()), "bad checksum is dropped");
+}
+
+/**
+ * \brief replay a mixed stream of the commands a rig sends most.
+ */
+void run_benchmark()
+{
+    sim_setup();
+    handler_stats.clear();
+    update_stats = {};
+    const std::vector<frame_t> commands
+    {
+        write_port(PORT_DIR_ADDRESS, ALL_CHANNELS),
+        write_port(PORT_STATE_ADDRESS, ALL_CHANNELS),
+        write_port(PORT_STATE_ADDRESS, 0),
+        write_port(PORT_SET_ADDRESS, 0x01),
+        write_port(PORT_CLEAR_ADDRESS, 0x01),
+        read_frame(PORT_STATE_ADDRESS),
+        write_port(ENABLE_RISING_EDGE_EVENTS_ADDRESS, 0),
+        write_pwm_settings(0, {0, 500, 500, 0, 0}),
+        write_pwm_settings(1, {100, 200, 800, 0, 1}),
+        write_u32(EDGE_MERGE_TOLERANCE_US_ADDRESS, 0),
+        read_frame(SCHEDULE_DIAGNOSTICS_ADDRESS),
+        write_u8(PWM_STATE_ADDRESS, 1),
+        write_u8(PWM_STATE_ADDRESS, 0),
+    };
+    for (size_t i = 0; i < BENCHMARK_MESSAGES; ++i)
+    {
+        const frame_t& command = commands[i % commands.size()];
+        std::vector<frame_t> replies = replay(command);
+        sim_run_for_us(10);
+        check((replies.size() == 1) && (replies[0][0] == command[0])
+              && (replies[0][2] == command[2]),
+              "benchmark: every command succeeds");
+    }
+}
+
+/**
+ * \brief report an edge EVENT for every input edge of a long burst.
+ */
+void run_event_benchmark()
+{
+    sim_setup();
+    expect(write_port(PORT_DIR_ADDRESS, 0), WRITE, "event benchmark: PortDir");
+    expect(write_port(ENABLE_RISING_EDGE_EVENTS_ADDRESS, 0x01), WRITE,
+           "event benchmark: EnableRisingEdgeEvents");
+    expect(write_port(ENABLE_FALLING_EDGE_EVENTS_ADDRESS, 0x01), WRITE,
+           "event benchmark: EnableFallingEdgeEvents");
+    sim_run_for_us(HARP_TX_FLUSH_US);
+    size_t first_frame = host_harp_frames.size();
+    size_t first_transfer = host_usb_transfers;
+    for (size_t i = 0; i < BENCHMARK_EDGES; ++i)
+    {
+        host_set_gpio_in(1u << PORT_BASE, (gpio_get_all() ^ (1u << PORT_BASE)));
+        for (uint32_t t = 0; t < BENCHMARK_EDGE_GAP_US; ++t)
+        {
+            sim_step_core1();
+            auto start = bench_clock::now();
+            app.update();
+            edge_update_stats.add(bench_clock::now() - start);
+        }
+    }
+    sim_run_for_us(HARP_TX_FLUSH_US);
+    edge_events = count_edge_events(first_frame, "event benchmark: order");
+    edge_event_transfers = host_usb_transfers - first_transfer;
+    check(edge_events == BENCHMARK_EDGES,
+          "event benchmark: every edge is reported");
+}
+
+void report()
+{
+    static const std::map<uint8_t, const char*> type_names
+        {{READ, "READ"}, {WRITE, "WRITE"}};
+    printf("%-6s %-26s %8s %10s %10s\r\n", "Type", "Register", "Count",
+           "Mean [ns]", "Max [ns]");
+    double total_ns = 0;
+    size_t total_count = 0;
+    for (const auto& [key, stats]: handler_stats)
+    {
+        printf("%-6s %-26s %8zu %10.1f %10.1f\r\n", type_names.at(key.first),
+               reg_name(key.second), stats.count, stats.mean_ns(),
+               std::chrono::duration<double, std::nano>(stats.max).count());
+        total_ns += std::chrono::duration<double, std::nano>(stats.total).count();
+        total_count += stats.count;
+    }
+    printf("%-33s %8zu %10.1f %10.1f\r\n", "update_app_state()",
+           update_stats.count, update_stats.mean_ns(),
+           std::chrono::duration<double, std::nano>(update_stats.max).count());
+    if (edge_events)
+    {
+        double per_event_ns =
+            std::chrono::duration<double, std::nano>(edge_update_stats.total)
+                .count() / edge_events;
+        printf("Edge EVENTs: %zu in %zu USB transfers (%.1f per transfer), "
+               "%.1f host ns each\r\n", edge_events, edge_event_transfers,
+               double(edge_events) / std::max<size_t>(edge_event_transfers, 1),
+               per_event_ns);
+    }
+    if (!total_count)
+        return;
+    double per_message_ns = total_ns / total_count + update_stats.mean_ns();
+    printf("Max sustained host rate: %.0f messages/s (%.1f host ns per "
+           "message incl. update_app_state())\r\n", 1e9 / per_message_ns,
+           per_message_ns);
+}
+
+std::vector<frame_t> read_frames(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        printf("Cannot open %s\r\n", path);
+        exit(2);
+    }
+    std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(file),
+                               std::istreambuf_iterator<char>()};
+    std::vector<frame_t> frames;
+    size_t i = 0;
+    while (i + 2 <= bytes.size())
+    {
+        size_t frame_size = bytes[i + 1] + 2;
+        if (i + frame_size > bytes.size())
+            break;
+        frames.emplace_back(bytes.begin() + i, bytes.begin() + i + frame_size);
+        i += frame_size;
+    }
+    if (i != bytes.size())
+        printf("%s: ignoring %zu trailing bytes\r\n", path, bytes.size() - i);
+    return frames;
+}
+
+void replay_file(const char* commands_path, const char* replies_path)
+{
+    std::vector<frame_t> commands = read_frames(commands_path);
+    std::vector<frame_t> expected;
+    if (replies_path)
+    {
+        for (frame_t& frame: read_frames(replies_path))
+        {
+            if (frame[0] != EVENT)
+                expected.push_back(std::move(frame));
+        }
+    }
+    sim_setup();
+    size_t expected_index = 0;
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        const frame_t& command = commands[i];
+        std::vector<frame_t> replies = replay(command);
+        sim_run_for_us(MESSAGE_GAP_US);
+        std::string where = "message " + std::to_string(i) + " ("
+                            + reg_name(command[2]) + ")";
+        if ((replies.size() != 1) || (replies[0][2] != command[2])
+            || ((replies[0][0] & ~0x08) != command[0]))
+        {
+            check(false, (where + ": no reply for this register").c_str());
+            continue;
+        }
+        if (!replies_path)
+            continue;
+        if (expected_index >= expected.size())
+        {
+            check(false, (where + ": no recorded reply left").c_str());
+            continue;
+        }
+        const frame_t& reply = replies[0];
+        const frame_t& recorded = expected[expected_index++];
+        bool same = (reply[0] == recorded[0]) && (reply[2] == recorded[2])
+            && (payload_size_of(reply) == payload_size_of(recorded))
+            && std::equal(payload_of(reply),
+                          payload_of(reply) + payload_size_of(reply),
+                          payload_of(recorded));
+        check(same, (where + ": reply differs from the recording").c_str());
+    }
+    printf("Replayed %zu messages.\r\n", commands.size());
+}
+
+int main(int argc, char* argv[])
+{
+    host_test::quiet = true; // Thousands of replies are checked.
+    if (argc > 1)
+    {
+        replay_file(argv[1], (argc > 2)? argv[2]: nullptr);
+    }
+    else
+    {
+        run_scenarios();
+        run_benchmark();
+        run_event_benchmark();
+    }
+    report();
+    return report_failures();
+}
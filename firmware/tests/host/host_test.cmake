@@ -0,0 +1,17 @@
+# Settings and helper shared by the host (PC) test programs that build
+# firmware sources without the pico-sdk. include() this after project().
+
+set(CMAKE_CXX_STANDARD 23)
+if(NOT CMAKE_BUILD_TYPE)
+    set(CMAKE_BUILD_TYPE Release)
+endif()
+
+set(HOST_TEST_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+# add_host_test(<name> <source>...)
+# A test program that sees the firmware headers and host_test.h.
+function(add_host_test name)
+    add_executable(${name} ${ARGN})
+    target_include_directories(${name} PRIVATE ${HOST_TEST_DIR}/../../inc
+                               ${HOST_TEST_DIR}/inc)
+endfunction()
@@ -0,0 +1,14 @@
+#ifndef PICO_HOST_HARDWARE_CLOCKS_H
+#define PICO_HOST_HARDWARE_CLOCKS_H
+#include <pico/stdlib.h>
+
+enum clock_index
+{
+    clk_ref = 4,
+    clk_sys = 5,
+};
+
+inline uint32_t clock_get_hz(clock_index clk_index)
+{return (clk_index == clk_sys)? 125'000'000: 12'000'000;}
+
+#endif
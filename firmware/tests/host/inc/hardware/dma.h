@@ -0,0 +1,76 @@
+#ifndef PICO_HOST_HARDWARE_DMA_H
+#define PICO_HOST_HARDWARE_DMA_H
+#include <pico/stdlib.h>
+
+// DMA channels are claimed and configured, but never transfer on the host.
+struct dma_channel_hw_t
+{
+    io_rw_32 read_addr;
+    io_rw_32 write_addr;
+    io_rw_32 transfer_count;
+    io_rw_32 ctrl_trig;
+    io_rw_32 al1_ctrl;
+    io_rw_32 al1_read_addr;
+    io_rw_32 al1_write_addr;
+    io_rw_32 al1_transfer_count_trig;
+    io_rw_32 al2_ctrl;
+    io_rw_32 al2_transfer_count;
+    io_rw_32 al2_read_addr;
+    io_rw_32 al2_write_addr_trig;
+    io_rw_32 al3_ctrl;
+    io_rw_32 al3_write_addr;
+    io_rw_32 al3_transfer_count;
+    io_rw_32 al3_read_addr_trig;
+};
+struct dma_hw_t
+{
+    dma_channel_hw_t ch[12];
+};
+extern dma_hw_t* const dma_hw;
+
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB 11
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS 0x00007800
+
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+struct dma_channel_config
+{
+    uint32_t ctrl;
+};
+
+int dma_claim_unused_channel(bool required);
+inline dma_channel_config dma_channel_get_default_config(uint channel)
+{return {};}
+inline void channel_config_set_transfer_data_size(dma_channel_config* c,
+    dma_channel_transfer_size size) {}
+inline void channel_config_set_read_increment(dma_channel_config* c,
+                                              bool incr) {}
+inline void channel_config_set_write_increment(dma_channel_config* c,
+                                               bool incr) {}
+inline void channel_config_set_ring(dma_channel_config* c, bool write,
+                                    uint size_bits) {}
+inline void channel_config_set_dreq(dma_channel_config* c, uint dreq) {}
+inline void channel_config_set_chain_to(dma_channel_config* c,
+                                        uint chain_to) {}
+void dma_channel_configure(uint channel, const dma_channel_config* config,
+                           volatile void* write_addr,
+                           const volatile void* read_addr,
+                           uint transfer_count, bool trigger);
+inline void dma_channel_abort(uint channel) {}
+inline bool dma_channel_is_busy(uint channel)
+{return dma_hw->ch[channel].transfer_count != 0;}
+inline void dma_channel_transfer_from_buffer_now(uint channel,
+                                                 const volatile void* read_addr,
+                                                 uint32_t transfer_count)
+{dma_hw->ch[channel].transfer_count = transfer_count;}
+
+inline void hw_write_masked(io_rw_32* addr, uint32_t values,
+                            uint32_t write_mask)
+{*addr = (*addr & ~write_mask) | (values & write_mask);}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef PICO_HOST_HARDWARE_FLASH_H
+#define PICO_HOST_HARDWARE_FLASH_H
+#include <pico/stdlib.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+
+// Erase and program the host's flash image (see XIP_BASE).
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t* data,
+                         size_t count);
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef PICO_HOST_HARDWARE_GPIO_H
+#define PICO_HOST_HARDWARE_GPIO_H
+#include <pico/stdlib.h>
+#endif
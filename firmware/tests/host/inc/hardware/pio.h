@@ -0,0 +1,87 @@
+#ifndef PICO_HOST_HARDWARE_PIO_H
+#define PICO_HOST_HARDWARE_PIO_H
+#include <pico/stdlib.h>
+
+/**
+ * \brief a register whose bits are cleared by writing 1s to them.
+ */
+struct io_w1c_32
+{
+    volatile uint32_t bits = 0;
+
+    operator uint32_t() const
+    {return bits;}
+
+    io_w1c_32& operator=(uint32_t clear_bits)
+    {
+        bits &= ~clear_bits;
+        return *this;
+    }
+};
+
+// PIO state machines are claimed and configured, but never run on the host.
+struct pio_hw_t
+{
+    io_rw_32 ctrl;
+    io_ro_32 fstat;
+    io_w1c_32 fdebug;
+    io_ro_32 flevel;
+    io_rw_32 txf[4];
+    io_ro_32 rxf[4];
+};
+typedef pio_hw_t* PIO;
+#define PIO_FDEBUG_RXSTALL_LSB 0
+extern pio_hw_t* const pio0;
+extern pio_hw_t* const pio1;
+
+struct pio_program_t
+{
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+};
+
+struct pio_sm_config
+{
+    uint32_t clkdiv;
+    uint32_t execctrl;
+    uint32_t shiftctrl;
+    uint32_t pinctrl;
+};
+
+enum pio_fifo_join
+{
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+int pio_claim_unused_sm(PIO pio, bool required);
+bool pio_can_add_program(PIO pio, const pio_program_t* program);
+uint pio_add_program(PIO pio, const pio_program_t* program);
+void pio_remove_program(PIO pio, const pio_program_t* program,
+                        uint loaded_offset);
+inline pio_sm_config pio_get_default_sm_config() {return {};}
+inline void sm_config_set_wrap(pio_sm_config* c, uint wrap_target, uint wrap) {}
+inline void sm_config_set_in_pins(pio_sm_config* c, uint in_base) {}
+inline void sm_config_set_in_shift(pio_sm_config* c, bool shift_right,
+                                   bool autopush, uint push_threshold) {}
+inline void sm_config_set_out_pins(pio_sm_config* c, uint out_base,
+                                   uint out_count) {}
+inline void sm_config_set_out_shift(pio_sm_config* c, bool shift_right,
+                                    bool autopull, uint pull_threshold) {}
+inline void sm_config_set_fifo_join(pio_sm_config* c, pio_fifo_join join) {}
+inline void sm_config_set_clkdiv_int_frac(pio_sm_config* c, uint16_t div_int,
+                                          uint8_t div_frac) {}
+inline void pio_sm_init(PIO pio, uint sm, uint initial_pc,
+                        const pio_sm_config* config) {}
+inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {}
+inline void pio_sm_clear_fifos(PIO pio, uint sm) {}
+inline void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values,
+                                      uint32_t pin_mask) {}
+inline void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs,
+                                         uint32_t pin_mask) {}
+inline void pio_sm_exec(PIO pio, uint sm, uint instr) {}
+inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {return 0;}
+
+#endif
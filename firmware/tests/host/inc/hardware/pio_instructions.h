@@ -0,0 +1,20 @@
+#ifndef PICO_HOST_HARDWARE_PIO_INSTRUCTIONS_H
+#define PICO_HOST_HARDWARE_PIO_INSTRUCTIONS_H
+#include <pico/stdlib.h>
+
+enum pio_src_dest
+{
+    pio_pins = 0u,
+    pio_x = 1u,
+};
+
+inline uint16_t pio_encode_in(pio_src_dest src, uint count)
+{return 0x4000 | (uint16_t(src) << 5) | (count & 0x1fu);}
+
+inline uint16_t pio_encode_out(pio_src_dest dest, uint count)
+{return 0x6000 | (uint16_t(dest) << 5) | (count & 0x1fu);}
+
+inline uint16_t pio_encode_jmp_x_dec(uint addr)
+{return 0x0040 | (addr & 0x1fu);}
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef PICO_HOST_HARDWARE_REGS_ADDRESSMAP_H
+#define PICO_HOST_HARDWARE_REGS_ADDRESSMAP_H
+#include <stdint.h>
+
+// Execute-in-place reads of flash land in a host array.
+extern uint8_t host_flash_image[];
+#define XIP_BASE (uintptr_t(host_flash_image))
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef PICO_HOST_HARDWARE_SYNC_H
+#define PICO_HOST_HARDWARE_SYNC_H
+#include <pico/stdlib.h>
+#include <atomic>
+
+inline void __dmb()
+{std::atomic_thread_fence(std::memory_order_seq_cst);}
+
+inline void __compiler_memory_barrier()
+{std::atomic_signal_fence(std::memory_order_seq_cst);}
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef PICO_HOST_HARDWARE_TIMER_H
+#define PICO_HOST_HARDWARE_TIMER_H
+#include <pico/stdlib.h>
+#endif
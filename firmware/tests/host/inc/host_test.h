@@ -0,0 +1,35 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+#include <cstddef>
+#include <cstdio>
+
+// PASS/FAIL checks shared by the host (PC) test programs.
+
+namespace host_test
+{
+inline size_t failures = 0;
+inline bool quiet = false; /// print only the checks that fail.
+}
+
+/**
+ * \brief print whether \p condition holds and count it if it does not.
+ */
+inline void check(bool condition, const char* description)
+{
+    if (!condition || !host_test::quiet)
+        printf("%s: %s\r\n", condition? "PASS": "FAIL", description);
+    if (!condition)
+        ++host_test::failures;
+}
+
+/**
+ * \brief print how many checks failed.
+ * \returns the exit code of the test program: 0 if they all passed.
+ */
+inline int report_failures()
+{
+    printf("%zu failures\r\n", host_test::failures);
+    return host_test::failures? 1: 0;
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,149 @@
+#ifndef PICO_HOST_STDLIB_H
+#define PICO_HOST_STDLIB_H
+// Host stand-in for <pico/stdlib.h>. Only what the firmware uses.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint32_t io_ro_32;
+
+// Memory placement has no meaning on the host.
+#define __not_in_flash(group)
+#define __not_in_flash_func(func_name) func_name
+#define __time_critical_func(func_name) func_name
+#define __scratch_x(group)
+#define __scratch_y(group)
+#define __force_inline inline
+
+/**
+ * \brief an ALARMx register. Writing it arms the alarm, even with the time
+ *  that it already holds.
+ */
+struct host_alarm_reg_t
+{
+    uint32_t time_us = 0;
+    bool armed = false;
+    /// armed with a time that had already passed, which the hardware only
+    /// matches once the timer wraps.
+    bool missed = false;
+
+    host_alarm_reg_t& operator=(uint32_t new_time_us);
+
+    operator uint32_t() const
+    {return time_us;}
+};
+
+/**
+ * \brief the ARMED register. Writing a 1 disarms that alarm.
+ */
+struct host_armed_reg_t
+{
+    host_armed_reg_t& operator=(uint32_t mask);
+    host_armed_reg_t& operator|=(uint32_t mask);
+    operator uint32_t() const;
+};
+
+struct timer_hw_t
+{
+    io_rw_32 timehw;
+    io_rw_32 timelw;
+    io_ro_32 timehr;
+    io_ro_32 timelr;
+    host_alarm_reg_t alarm[4];
+    host_armed_reg_t armed;
+    io_ro_32 timerawh;
+    io_ro_32 timerawl;
+    io_rw_32 dbgpause;
+    io_rw_32 pause;
+    io_rw_32 intr;
+    io_rw_32 inte;
+    io_rw_32 intf;
+    io_ro_32 ints;
+};
+extern timer_hw_t* const timer_hw;
+
+struct io_bank0_hw_t
+{
+    struct
+    {
+        io_ro_32 status;
+        io_rw_32 ctrl;
+    } io[30];
+    io_rw_32 intr[4];
+};
+#define IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB 0
+#define IO_BANK0_GPIO0_CTRL_FUNCSEL_BITS 0x0000001f
+extern io_bank0_hw_t* const io_bank0_hw;
+
+enum irq_num_t: uint
+{
+    TIMER_IRQ_0 = 0,
+    TIMER_IRQ_1 = 1,
+    TIMER_IRQ_2 = 2,
+    TIMER_IRQ_3 = 3,
+    DMA_IRQ_0 = 11,
+    DMA_IRQ_1 = 12,
+    IO_IRQ_BANK0 = 13,
+};
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#define GPIO_IRQ_CALLBACK_ORDER_PRIORITY PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+typedef void (*irq_handler_t)(void);
+
+enum gpio_irq_level
+{
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+enum gpio_function
+{
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+};
+
+enum gpio_override
+{
+    GPIO_OVERRIDE_NORMAL = 0,
+    GPIO_OVERRIDE_INVERT = 1,
+    GPIO_OVERRIDE_LOW = 2,
+    GPIO_OVERRIDE_HIGH = 3,
+};
+
+// Time.
+uint64_t time_us_64();
+uint32_t time_us_32();
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us_32(uint32_t us);
+inline void tight_loop_contents() {}
+
+// GPIO.
+void gpio_init(uint gpio);
+void gpio_init_mask(uint32_t gpio_mask);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_dir_masked(uint32_t mask, uint32_t value);
+void gpio_put(uint gpio, bool value);
+void gpio_put_masked(uint32_t mask, uint32_t value);
+bool gpio_get(uint gpio);
+bool gpio_get_out_level(uint gpio);
+uint32_t gpio_get_all();
+void gpio_set_outover(uint gpio, uint value);
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+
+// Interrupts.
+int hardware_alarm_claim_unused(bool required);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_add_shared_handler(uint num, irq_handler_t handler,
+                            uint8_t order_priority);
+void irq_set_enabled(uint num, bool enabled);
+void irq_clear(uint num);
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
+inline uint get_core_num() {return 0;}
+
+#endif // PICO_HOST_STDLIB_H
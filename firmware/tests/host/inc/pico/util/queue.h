@@ -0,0 +1,24 @@
+#ifndef PICO_HOST_QUEUE_H
+#define PICO_HOST_QUEUE_H
+#include <pico/stdlib.h>
+
+/**
+ * \brief Host stand-in for the pico-sdk's inter-core queue. Single-threaded.
+ */
+struct queue_t
+{
+    uint8_t* data;
+    uint element_size;
+    uint element_count;
+    uint rptr;
+    uint wptr;
+};
+
+void queue_init(queue_t* q, uint element_size, uint element_count);
+void queue_free(queue_t* q);
+uint queue_get_level(queue_t* q);
+bool queue_try_add(queue_t* q, const void* data);
+bool queue_try_remove(queue_t* q, void* data);
+bool queue_try_peek(queue_t* q, void* data);
+
+#endif
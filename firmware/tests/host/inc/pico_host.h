@@ -0,0 +1,78 @@
+#ifndef PICO_HOST_H
+#define PICO_HOST_H
+#include <stdint.h>
+
+/**
+ * \brief Host-side controls for the simulated RP2040 peripherals.
+ * \details Time only moves when a test moves it.
+ */
+
+/**
+ * \brief set the virtual 64-bit microsecond timer.
+ */
+void host_set_time_us(uint64_t time_us);
+
+/**
+ * \brief advance the virtual timer.
+ */
+void host_advance_time_us(uint64_t delta_us);
+
+/**
+ * \brief advance the virtual timer by \p cost_us after every read of it
+ *  (time_us_32() or time_us_64()), as if the code between reads took that
+ *  long.
+ */
+void host_set_time_read_cost_us(uint32_t cost_us);
+
+/**
+ * \brief time that the given hardware alarm is armed for.
+ * \return true if the alarm is armed.
+ */
+bool host_alarm_armed(uint32_t alarm_num, uint32_t& alarm_time_us);
+
+/**
+ * \brief Move the virtual timer to the armed alarm's time and run its IRQ
+ *  handler, as the hardware would.
+ * \return false if the alarm is not armed, or was armed with a time that had
+ *  already passed. The hardware only fires those after the timer wraps.
+ */
+bool host_fire_alarm(uint32_t alarm_num);
+
+/**
+ * \brief hold up every alarm's IRQ handler by \p latency_us past the alarm
+ *  time, like a busy core would.
+ */
+void host_set_alarm_irq_latency_us(uint32_t latency_us);
+
+/**
+ * \brief raw state of all GPIO output drivers (before pad overrides).
+ */
+uint32_t host_gpio_out();
+
+/**
+ * \brief GPIO output enables.
+ */
+uint32_t host_gpio_oe();
+
+/**
+ * \brief drive the pads of input pins.
+ */
+void host_set_gpio_in(uint32_t mask, uint32_t value);
+
+/**
+ * \brief reset all simulated peripherals to their power-on state.
+ */
+void host_reset();
+
+/**
+ * \brief call \p hook whenever a queue is polled while empty, i.e: to step a
+ *  simulated core1 while core0 waits for it. Not re-entered. nullptr = none.
+ */
+void host_set_queue_idle_hook(void (*hook)());
+
+/**
+ * \brief fill the flash image with 0xFF (erased).
+ */
+void host_erase_flash();
+
+#endif // PICO_HOST_H
@@ -0,0 +1,413 @@
+#include <pico/stdlib.h>
+#include <pico/util/queue.h>
+#include <hardware/flash.h>
+#include <hardware/regs/addressmap.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <pico_host.h>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+constexpr size_t NUM_IRQS = 32;
+constexpr size_t NUM_ALARMS = 4;
+constexpr size_t NUM_GPIOS = 30;
+
+timer_hw_t timer_regs{};
+io_bank0_hw_t io_bank0_regs{};
+uint64_t time_us = 0;
+uint32_t alarm_irq_latency_us = 0;
+uint32_t time_read_cost_us = 0;
+
+irq_handler_t irq_handlers[NUM_IRQS]{};
+bool irq_enabled[NUM_IRQS]{};
+bool alarm_claimed[NUM_ALARMS]{};
+
+uint32_t gpio_out = 0;
+uint32_t gpio_oe = 0;
+uint32_t gpio_in = 0;
+uint32_t gpio_invert = 0;
+uint32_t gpio_force_low = 0;
+uint32_t gpio_force_high = 0;
+uint32_t gpio_rise_irq_enabled = 0;
+uint32_t gpio_fall_irq_enabled = 0;
+
+void (*queue_idle_hook)() = nullptr;
+bool in_queue_idle_hook = false;
+
+pio_hw_t pio_regs[2]{};
+uint32_t pio_sms_claimed[2]{};
+dma_hw_t dma_regs{};
+uint32_t dma_channels_claimed = 0;
+
+void sync_timer_regs()
+{
+    timer_regs.timerawl = uint32_t(time_us);
+    timer_regs.timerawh = uint32_t(time_us >> 32);
+    timer_regs.timelr = uint32_t(time_us);
+    timer_regs.timehr = uint32_t(time_us >> 32);
+}
+
+uint32_t pad_state()
+{
+    uint32_t output = ((gpio_out ^ gpio_invert) & ~gpio_force_low)
+                      | gpio_force_high;
+    uint32_t driven = output & gpio_oe;
+    return driven | (gpio_in & ~gpio_oe);
+}
+}
+
+timer_hw_t* const timer_hw = &timer_regs;
+
+host_alarm_reg_t& host_alarm_reg_t::operator=(uint32_t new_time_us)
+{
+    time_us = new_time_us;
+    armed = true;
+    missed = (int32_t(new_time_us - uint32_t(::time_us)) < 0);
+    return *this;
+}
+
+host_armed_reg_t& host_armed_reg_t::operator=(uint32_t mask)
+{
+    for (size_t i = 0; i < NUM_ALARMS; ++i)
+    {
+        if (mask & (1u << i))
+            timer_regs.alarm[i].armed = false;
+    }
+    return *this;
+}
+
+host_armed_reg_t& host_armed_reg_t::operator|=(uint32_t mask)
+{return *this = mask;}
+
+host_armed_reg_t::operator uint32_t() const
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < NUM_ALARMS; ++i)
+        mask |= uint32_t(timer_regs.alarm[i].armed) << i;
+    return mask;
+}
+io_bank0_hw_t* const io_bank0_hw = &io_bank0_regs;
+pio_hw_t* const pio0 = &pio_regs[0];
+pio_hw_t* const pio1 = &pio_regs[1];
+dma_hw_t* const dma_hw = &dma_regs;
+uint8_t host_flash_image[PICO_FLASH_SIZE_BYTES];
+
+// Host controls.
+void host_set_time_us(uint64_t new_time_us)
+{
+    time_us = new_time_us;
+    sync_timer_regs();
+}
+
+void host_advance_time_us(uint64_t delta_us)
+{host_set_time_us(time_us + delta_us);}
+
+bool host_alarm_armed(uint32_t alarm_num, uint32_t& alarm_time_us)
+{
+    alarm_time_us = timer_regs.alarm[alarm_num].time_us;
+    return timer_regs.alarm[alarm_num].armed;
+}
+
+bool host_fire_alarm(uint32_t alarm_num)
+{
+    uint32_t alarm_time_us;
+    if (!host_alarm_armed(alarm_num, alarm_time_us)
+        || timer_regs.alarm[alarm_num].missed)
+        return false;
+    // Alarms compare against the lower 32 bits of the timer.
+    uint32_t delta_us = alarm_time_us - uint32_t(time_us);
+    if (int32_t(delta_us) > 0)
+        host_advance_time_us(delta_us);
+    host_advance_time_us(alarm_irq_latency_us);
+    timer_regs.alarm[alarm_num].armed = false;
+    timer_regs.intr |= (1u << alarm_num);
+    irq_handler_t handler = irq_handlers[TIMER_IRQ_0 + alarm_num];
+    if (handler && irq_enabled[TIMER_IRQ_0 + alarm_num])
+        handler();
+    return true;
+}
+
+void host_set_time_read_cost_us(uint32_t cost_us)
+{time_read_cost_us = cost_us;}
+
+void host_set_alarm_irq_latency_us(uint32_t latency_us)
+{alarm_irq_latency_us = latency_us;}
+
+uint32_t host_gpio_out()
+{return gpio_out;}
+
+uint32_t host_gpio_oe()
+{return gpio_oe;}
+
+void host_set_gpio_in(uint32_t mask, uint32_t value)
+{
+    uint32_t old_state = pad_state();
+    gpio_in = (gpio_in & ~mask) | (value & mask);
+    uint32_t new_state = pad_state();
+    uint32_t rise = ~old_state & new_state & gpio_rise_irq_enabled;
+    uint32_t fall = old_state & ~new_state & gpio_fall_irq_enabled;
+    if (!(rise | fall))
+        return;
+    for (size_t pin = 0; pin < NUM_GPIOS; ++pin)
+    {
+        uint32_t flags = (((rise >> pin) & 1u) << 3)
+                         | (((fall >> pin) & 1u) << 2);
+        io_bank0_regs.intr[pin / 8] |= flags << ((pin % 8) * 4);
+    }
+    if (!irq_handlers[IO_IRQ_BANK0] || !irq_enabled[IO_IRQ_BANK0])
+        return;
+    uint32_t pending[std::size(io_bank0_regs.intr)];
+    for (size_t reg = 0; reg < std::size(pending); ++reg)
+        pending[reg] = io_bank0_regs.intr[reg];
+    irq_handlers[IO_IRQ_BANK0]();
+    // The handler acknowledges edges by writing 1s to them (write-to-clear).
+    for (size_t reg = 0; reg < std::size(pending); ++reg)
+        io_bank0_regs.intr[reg] = pending[reg] & ~io_bank0_regs.intr[reg];
+}
+
+void host_reset()
+{
+    timer_regs = timer_hw_t{};
+    io_bank0_regs = io_bank0_hw_t{};
+    time_us = 0;
+    alarm_irq_latency_us = 0;
+    time_read_cost_us = 0;
+    gpio_out = gpio_oe = gpio_in = gpio_invert = 0;
+    gpio_force_low = gpio_force_high = 0;
+    gpio_rise_irq_enabled = gpio_fall_irq_enabled = 0;
+    sync_timer_regs();
+}
+
+void host_set_queue_idle_hook(void (*hook)())
+{queue_idle_hook = hook;}
+
+void host_erase_flash()
+{memset(host_flash_image, 0xFF, sizeof(host_flash_image));}
+
+// Time.
+uint64_t time_us_64()
+{
+    uint64_t now_us = time_us;
+    host_advance_time_us(time_read_cost_us);
+    return now_us;
+}
+
+uint32_t time_us_32()
+{return uint32_t(time_us_64());}
+
+void sleep_us(uint64_t us)
+{host_advance_time_us(us);}
+
+void sleep_ms(uint32_t ms)
+{host_advance_time_us(uint64_t(ms) * 1000);}
+
+void busy_wait_us_32(uint32_t us)
+{host_advance_time_us(us);}
+
+// GPIO.
+void gpio_init(uint gpio)
+{gpio_init_mask(1u << gpio);}
+
+void gpio_init_mask(uint32_t gpio_mask)
+{
+    gpio_oe &= ~gpio_mask;
+    gpio_out &= ~gpio_mask;
+    gpio_invert &= ~gpio_mask;
+    gpio_force_low &= ~gpio_mask;
+    gpio_force_high &= ~gpio_mask;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{gpio_set_dir_masked(1u << gpio, out? (1u << gpio): 0);}
+
+void gpio_set_dir_masked(uint32_t mask, uint32_t value)
+{gpio_oe = (gpio_oe & ~mask) | (value & mask);}
+
+void gpio_put(uint gpio, bool value)
+{gpio_put_masked(1u << gpio, value? (1u << gpio): 0);}
+
+void gpio_put_masked(uint32_t mask, uint32_t value)
+{gpio_out = (gpio_out & ~mask) | (value & mask);}
+
+bool gpio_get(uint gpio)
+{return (pad_state() >> gpio) & 1u;}
+
+bool gpio_get_out_level(uint gpio)
+{return (gpio_out >> gpio) & 1u;}
+
+uint32_t gpio_get_all()
+{return pad_state();}
+
+void gpio_set_outover(uint gpio, uint value)
+{
+    uint32_t pin_mask = 1u << gpio;
+    gpio_invert &= ~pin_mask;
+    gpio_force_low &= ~pin_mask;
+    gpio_force_high &= ~pin_mask;
+    if (value == GPIO_OVERRIDE_INVERT)
+        gpio_invert |= pin_mask;
+    else if (value == GPIO_OVERRIDE_LOW)
+        gpio_force_low |= pin_mask;
+    else if (value == GPIO_OVERRIDE_HIGH)
+        gpio_force_high |= pin_mask;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+    uint32_t pin_mask = 1u << gpio;
+    if (event_mask & GPIO_IRQ_EDGE_RISE)
+        gpio_rise_irq_enabled = enabled? (gpio_rise_irq_enabled | pin_mask)
+                                       : (gpio_rise_irq_enabled & ~pin_mask);
+    if (event_mask & GPIO_IRQ_EDGE_FALL)
+        gpio_fall_irq_enabled = enabled? (gpio_fall_irq_enabled | pin_mask)
+                                       : (gpio_fall_irq_enabled & ~pin_mask);
+}
+
+// Interrupts.
+int hardware_alarm_claim_unused(bool required)
+{
+    for (size_t i = 0; i < NUM_ALARMS; ++i)
+    {
+        if (alarm_claimed[i])
+            continue;
+        alarm_claimed[i] = true;
+        return int(i);
+    }
+    return -1;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{irq_handlers[num] = handler;}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler,
+                            uint8_t order_priority)
+{irq_handlers[num] = handler;}
+
+void irq_set_enabled(uint num, bool enabled)
+{irq_enabled[num] = enabled;}
+
+void irq_clear(uint num)
+{}
+
+uint32_t save_and_disable_interrupts()
+{return 0;}
+
+void restore_interrupts(uint32_t status)
+{}
+
+// Queues.
+void queue_init(queue_t* q, uint element_size, uint element_count)
+{
+    // One spare slot tells a full queue apart from an empty one.
+    q->data = (uint8_t*)calloc(element_count + 1, element_size);
+    q->element_size = element_size;
+    q->element_count = element_count;
+    q->rptr = 0;
+    q->wptr = 0;
+}
+
+void queue_free(queue_t* q)
+{
+    free(q->data);
+    q->data = nullptr;
+}
+
+uint queue_get_level(queue_t* q)
+{
+    int level = int(q->wptr) - int(q->rptr);
+    return (level < 0)? level + q->element_count + 1: level;
+}
+
+bool queue_try_add(queue_t* q, const void* data)
+{
+    uint next_wptr = (q->wptr + 1) % (q->element_count + 1);
+    if (next_wptr == q->rptr)
+        return false;
+    memcpy(q->data + q->wptr * q->element_size, data, q->element_size);
+    q->wptr = next_wptr;
+    return true;
+}
+
+bool queue_try_remove(queue_t* q, void* data)
+{
+    if (q->rptr == q->wptr)
+    {
+        if (queue_idle_hook && !in_queue_idle_hook)
+        {
+            in_queue_idle_hook = true;
+            queue_idle_hook();
+            in_queue_idle_hook = false;
+        }
+        return false;
+    }
+    memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    q->rptr = (q->rptr + 1) % (q->element_count + 1);
+    return true;
+}
+
+bool queue_try_peek(queue_t* q, void* data)
+{
+    if (q->rptr == q->wptr)
+        return false;
+    memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    return true;
+}
+
+// Flash.
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{memset(host_flash_image + flash_offs, 0xFF, count);}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data,
+                         size_t count)
+{
+    // Programming can only clear bits.
+    for (size_t i = 0; i < count; ++i)
+        host_flash_image[flash_offs + i] &= data[i];
+}
+
+// PIO and DMA.
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    uint32_t& claimed = pio_sms_claimed[pio - pio_regs];
+    for (uint sm = 0; sm < 4; ++sm)
+    {
+        if (claimed & (1u << sm))
+            continue;
+        claimed |= 1u << sm;
+        return int(sm);
+    }
+    return -1;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t* program)
+{return true;}
+
+uint pio_add_program(PIO pio, const pio_program_t* program)
+{return 0;}
+
+void pio_remove_program(PIO pio, const pio_program_t* program,
+                        uint loaded_offset)
+{}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint channel = 0; channel < 12; ++channel)
+    {
+        if (dma_channels_claimed & (1u << channel))
+            continue;
+        dma_channels_claimed |= 1u << channel;
+        return int(channel);
+    }
+    return -1;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* config,
+                           volatile void* write_addr,
+                           const volatile void* read_addr,
+                           uint transfer_count, bool trigger)
+{
+    dma_regs.ch[channel].transfer_count = transfer_count;
+}
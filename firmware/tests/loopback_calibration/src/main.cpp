@@ -0,0 +1,244 @@
+#include <loopback_calibration.h>
+#include <host_test.h>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+// Host test of LoopbackCalibration. A simulated jumper loops an output back
+// to an input: the output changes some time after its alarm, the edge
+// capture timestamps the change at its sample resolution, and the GPIO
+// interrupt timestamps it in whole us some time later. Calibrating on these
+// edges must recover the latencies, and applying the compensation it
+// computes must put outputs and timestamps back on time.
+
+inline constexpr uint32_t INPUT_PIN = 3;
+inline constexpr uint32_t PIN_MASK = 1u << INPUT_PIN;
+inline constexpr uint64_t FIRST_EDGE_US = 1'000'200;
+inline constexpr uint32_t SPACING_US = 200;
+inline constexpr uint32_t NUM_EDGES = 4000;
+inline constexpr uint32_t SAMPLE_NS = 64; /// of the edge capture.
+inline constexpr uint32_t MAX_LEAD_US = 2;
+
+/**
+ * \brief one looped back edge, timestamped both ways.
+ */
+struct loopback_edge_t
+{
+    uint64_t true_ns;     /// when the output changed.
+    uint64_t captured_ns; /// edge capture timestamp.
+    uint64_t interrupt_us; /// GPIO interrupt timestamp.
+    uint32_t rise_pins;
+    uint32_t fall_pins;
+};
+
+/**
+ * \brief edges of a schedule fired \p lead_us early, with output latency
+ *  uniform in [output_min_ns, output_min_ns + output_range_ns] and input
+ *  latency uniform in [input_min_ns, input_min_ns + input_range_ns].
+ */
+std::vector<loopback_edge_t> loopback_edges(uint32_t lead_us,
+                                            uint32_t output_min_ns,
+                                            uint32_t output_range_ns,
+                                            uint32_t input_min_ns,
+                                            uint32_t input_range_ns,
+                                            uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> output_ns(
+        output_min_ns, output_min_ns + output_range_ns);
+    std::uniform_int_distribution<uint32_t> input_ns(
+        input_min_ns, input_min_ns + input_range_ns);
+    std::vector<loopback_edge_t> edges;
+    for (uint32_t i = 0; i < NUM_EDGES; ++i)
+    {
+        loopback_edge_t edge;
+        uint64_t alarm_us = FIRST_EDGE_US + i * SPACING_US - lead_us;
+        edge.true_ns = alarm_us * 1000 + output_ns(gen);
+        edge.captured_ns = (edge.true_ns / SAMPLE_NS) * SAMPLE_NS;
+        edge.interrupt_us = (edge.true_ns + input_ns(gen)) / 1000;
+        edge.rise_pins = (i & 1)? 0: PIN_MASK;
+        edge.fall_pins = (i & 1)? PIN_MASK: 0;
+        edges.push_back(edge);
+    }
+    return edges;
+}
+
+void calibrate(LoopbackCalibration& calibration,
+               const std::vector<loopback_edge_t>& edges)
+{
+    calibration.start(FIRST_EDGE_US, SPACING_US, NUM_EDGES, PIN_MASK);
+    for (const auto& edge: edges)
+    {
+        calibration.add_captured_edge(edge.captured_ns, edge.rise_pins,
+                                      edge.fall_pins);
+        calibration.add_interrupt_edge(edge.interrupt_us, edge.rise_pins,
+                                       edge.fall_pins);
+    }
+    calibration.stop();
+}
+
+void distributions()
+{
+    LatencyDistribution latency;
+    check((latency.count() == 0) && (latency.mean_ns() == 0)
+          && (latency.sd_ns() == 0) && (latency.min_ns() == 0),
+          "distribution: empty");
+    latency.add(-1000);
+    latency.add(1000);
+    check((latency.count() == 2) && (latency.mean_ns() == 0)
+          && (latency.sd_ns() == 1000) && (latency.min_ns() == -1000)
+          && (latency.max_ns() == 1000),
+          "distribution: mean, sd, and range");
+    latency.reset();
+    for (int32_t i = 0; i < 100000; ++i)
+        latency.add(2'000'000 + (i & 1));
+    check((latency.mean_ns() == 2'000'001) && (latency.sd_ns() == 0),
+          "distribution: large offsets keep ns resolution");
+}
+
+void measure()
+{
+    LoopbackCalibration calibration;
+    auto edges = loopback_edges(0, 1800, 400, 2600, 600, 1);
+    calibrate(calibration, edges);
+    latency_stats_t stats = calibration.stats();
+    // Captures read up to one sample early, 32ns on average.
+    check((stats.output_edges == NUM_EDGES)
+          && (std::abs(stats.output_mean_ns - (2000 - 32)) <= 10)
+          && (std::abs(int32_t(stats.output_sd_ns) - 117) <= 10)
+          && (stats.output_min_ns >= 1800 - int32_t(SAMPLE_NS))
+          && (stats.output_max_ns <= 2200),
+          "measure: output latency");
+    // The interrupt reads whole us, after the edge capture.
+    int64_t input_sum_ns = 0;
+    for (const auto& edge: edges)
+        input_sum_ns += int64_t(edge.interrupt_us * 1000 - edge.captured_ns);
+    int64_t input_mean_ns = input_sum_ns / int64_t(NUM_EDGES);
+    check((stats.input_edges == NUM_EDGES)
+          && (std::abs(stats.input_mean_ns - input_mean_ns) <= 1)
+          && (stats.input_min_ns > 2600 - 1000)
+          && (stats.input_max_ns < 3200 + int32_t(SAMPLE_NS)),
+          "measure: input latency");
+    check(calibration.alarm_lead_us(MAX_LEAD_US) == 2,
+          "measure: alarm lead rounds to the nearest us");
+    check(calibration.input_latency_us() == 3,
+          "measure: input latency compensation");
+    check(calibration.alarm_lead_us(1) == 1, "measure: alarm lead is limited");
+
+    calibrate(calibration, loopback_edges(0, 100, 100, 100, 100, 2));
+    check((calibration.alarm_lead_us(MAX_LEAD_US) == 0)
+          && (calibration.input_latency_us() == 0),
+          "measure: sub-us latencies need no compensation");
+}
+
+void compensate()
+{
+    LoopbackCalibration calibration;
+    auto edges = loopback_edges(0, 1800, 400, 2600, 600, 3);
+    calibrate(calibration, edges);
+    uint32_t lead_us = calibration.alarm_lead_us(MAX_LEAD_US);
+    uint32_t input_latency_us = calibration.input_latency_us();
+
+    // Rerun with the alarm lead and correct the interrupt timestamps.
+    edges = loopback_edges(lead_us, 1800, 400, 2600, 600, 4);
+    calibrate(calibration, edges);
+    check(std::abs(calibration.output_latency().mean_ns()) < 100,
+          "compensate: outputs change on time on average");
+    int64_t error_sum_us = 0;
+    uint32_t max_error_us = 0;
+    for (const auto& edge: edges)
+    {
+        int64_t error_us = int64_t(edge.interrupt_us - input_latency_us)
+                           - int64_t(edge.true_ns / 1000);
+        error_sum_us += error_us;
+        max_error_us = std::max(max_error_us, uint32_t(std::abs(error_us)));
+    }
+    check((std::abs(error_sum_us) < int64_t(NUM_EDGES / 2))
+          && (max_error_us <= 1),
+          "compensate: timestamps read like the timer at the edge");
+}
+
+void match_edges()
+{
+    auto edges = loopback_edges(0, 1800, 400, 2600, 600, 5);
+    LoopbackCalibration calibration;
+    calibration.start(FIRST_EDGE_US, SPACING_US, NUM_EDGES, PIN_MASK);
+    // Drop some edges both ways. Interrupts arrive in bursts, ahead of the
+    // edge capture.
+    size_t dropped_captures = 0;
+    size_t matched = 0;
+    for (size_t burst = 0; burst < edges.size(); burst += 16)
+    {
+        for (size_t i = burst; i < burst + 16; ++i)
+        {
+            if (i % 7)
+                calibration.add_interrupt_edge(edges[i].interrupt_us,
+                                               edges[i].rise_pins,
+                                               edges[i].fall_pins);
+        }
+        for (size_t i = burst; i < burst + 16; ++i)
+        {
+            if (i % 10 == 0)
+            {
+                ++dropped_captures;
+                continue;
+            }
+            calibration.add_captured_edge(edges[i].captured_ns,
+                                          edges[i].rise_pins,
+                                          edges[i].fall_pins);
+            if (i % 7)
+                ++matched;
+        }
+    }
+    check(calibration.output_latency().count()
+          == NUM_EDGES - dropped_captures,
+          "match: missing edges do not shift the others");
+    check((calibration.input_latency().count() == matched)
+          && (calibration.input_latency().max_ns() < 4000),
+          "match: interrupts pair with their own captured edge");
+
+    // Interrupts too far ahead of their capture are forgotten, and late
+    // captures do not take the place of newer edges.
+    calibration.start(FIRST_EDGE_US, SPACING_US, NUM_EDGES, PIN_MASK);
+    for (size_t i = 0; i < 2 * LoopbackCalibration::PENDING_EDGES; ++i)
+        calibration.add_interrupt_edge(edges[i].interrupt_us,
+                                       edges[i].rise_pins, edges[i].fall_pins);
+    for (size_t i = 0; i < 2 * LoopbackCalibration::PENDING_EDGES; ++i)
+        calibration.add_captured_edge(edges[i].captured_ns,
+                                      edges[i].rise_pins, edges[i].fall_pins);
+    check(calibration.input_latency().count()
+          == LoopbackCalibration::PENDING_EDGES,
+          "match: only recent edges wait for their other timestamp");
+}
+
+void ignore_edges()
+{
+    LoopbackCalibration calibration;
+    calibration.start(FIRST_EDGE_US, SPACING_US, NUM_EDGES, PIN_MASK);
+    uint64_t first_ns = FIRST_EDGE_US * 1000;
+    uint64_t last_ns = first_ns + uint64_t(NUM_EDGES - 1) * SPACING_US * 1000;
+    calibration.add_captured_edge(first_ns + 2000, PIN_MASK << 1, 0);
+    calibration.add_captured_edge(first_ns + 2000, 0, PIN_MASK);
+    calibration.add_captured_edge(first_ns + 2000, PIN_MASK, PIN_MASK);
+    check(calibration.output_latency().count() == 0,
+          "ignore: other pins, wrong directions, and glitches");
+    calibration.add_captured_edge(first_ns - SPACING_US * 1000, PIN_MASK, 0);
+    calibration.add_captured_edge(last_ns + SPACING_US * 1000, PIN_MASK, 0);
+    check(calibration.output_latency().count() == 0,
+          "ignore: edges outside the schedule");
+    calibration.stop();
+    calibration.add_captured_edge(first_ns + 2000, PIN_MASK, 0);
+    check(calibration.output_latency().count() == 0,
+          "ignore: edges after the calibration stops");
+}
+
+int main()
+{
+    distributions();
+    measure();
+    compensate();
+    match_edges();
+    ignore_edges();
+    return report_failures();
+}
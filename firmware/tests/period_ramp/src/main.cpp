@@ -0,0 +1,121 @@
+#include <period_ramp.h>
+#include <host_test.h>
+#include <algorithm>
+#include <cmath>
+
+// Host test of PeriodRamp. Each cycle's period must follow the ideal linear
+// or geometric sweep from start to end, including steep and long ramps, and
+// the ramp must add up to its duration.
+
+struct sweep_stats_t
+{
+    double max_error_us = 0; /// beyond the 0.5us rounding of each period.
+    uint64_t duration_us = 0;
+    uint32_t last_period_us = 0;
+};
+
+sweep_stats_t sweep(PeriodRamp::profile_t profile, uint32_t start_period_us,
+                    uint32_t end_period_us, PeriodRamp& ramp)
+{
+    sweep_stats_t stats;
+    double p0 = start_period_us;
+    double p1 = end_period_us;
+    double steps = ramp.ramp_cycles() - 1;
+    for (uint32_t cycle = 0; cycle < ramp.ramp_cycles(); ++cycle)
+    {
+        double expected = (steps == 0)? p0
+            : (profile == PeriodRamp::EXPONENTIAL)?
+                p0 * pow(p1 / p0, cycle / steps)
+                : p0 + (p1 - p0) * cycle / steps;
+        stats.last_period_us = ramp.on_time_us() + ramp.off_time_us();
+        stats.max_error_us = std::max(stats.max_error_us,
+            std::abs(stats.last_period_us - expected) - 0.5);
+        stats.duration_us += stats.last_period_us;
+        ramp.advance();
+    }
+    return stats;
+}
+
+void check_sweep(PeriodRamp::profile_t profile, uint32_t start_period_us,
+                 uint32_t end_period_us, uint32_t ramp_duration_us,
+                 double max_error_us, const char* name)
+{
+    PeriodRamp ramp;
+    bool configured = ramp.configure(profile, start_period_us, end_period_us,
+                                     5000, 5000, ramp_duration_us);
+    sweep_stats_t stats = sweep(profile, start_period_us, end_period_us,
+                                ramp);
+    // The cycle count is rounded, so the sweep may be up to one of its
+    // longest periods off.
+    uint64_t duration_error_us = (stats.duration_us > ramp_duration_us)?
+        stats.duration_us - ramp_duration_us
+        : ramp_duration_us - stats.duration_us;
+    double duration_tolerance_us = std::max(start_period_us, end_period_us)
+                                   + ramp_duration_us * 0.01;
+    check(configured && (stats.max_error_us <= max_error_us)
+          && (stats.last_period_us == end_period_us)
+          && (duration_error_us <= duration_tolerance_us), name);
+    ramp.advance();
+    check((ramp.on_time_us() + ramp.off_time_us() == end_period_us)
+          && (ramp.on_time_us() == end_period_us / 2), "holds the end values");
+}
+
+void linear()
+{
+    using enum PeriodRamp::profile_t;
+    check_sweep(LINEAR, 1000, 100, 1000000, 0.01, "linear: down");
+    check_sweep(LINEAR, 100, 1000, 1000000, 0.01, "linear: up");
+}
+
+void exponential()
+{
+    using enum PeriodRamp::profile_t;
+    check_sweep(EXPONENTIAL, 1000, 100, 1000000, 0.01, "exponential: down");
+    check_sweep(EXPONENTIAL, 100, 1000, 1000000, 0.01, "exponential: up");
+    // A per-cycle ratio of ~1000 and ~1/1000 (beyond the old Q24 range).
+    check_sweep(EXPONENTIAL, 2, 2000000, 2000003, 0.01, "exponential: steep up");
+    check_sweep(EXPONENTIAL, 2000000, 2, 2000003, 0.01, "exponential: steep down");
+    // Millions of cycles, each a tiny ratio. With MIN_RATIO_BITS (8) of
+    // precision, the sweep may drift by up to ~0.2% of ln(200/100).
+    check_sweep(EXPONENTIAL, 100, 200, 1000000000, 0.5,
+                "exponential: long ramp");
+}
+
+void rejected()
+{
+    using enum PeriodRamp::profile_t;
+    PeriodRamp ramp;
+    // ln(1.001) over ~4e6 cycles is below 2^-32 * 2^MIN_RATIO_BITS.
+    check(!ramp.configure(EXPONENTIAL, 1000, 1001, 5000, 5000, 4000000000u)
+          && !ramp.enabled(), "rejected: ratio rounds to 1");
+    check(ramp.configure(LINEAR, 1000, 1001, 5000, 5000, 4000000000u),
+          "rejected: the same sweep is fine linear");
+}
+
+void duty()
+{
+    using enum PeriodRamp::profile_t;
+    PeriodRamp ramp;
+    ramp.configure(LINEAR, 1000, 1000, 1000, 9000, 101000);
+    bool increasing = true;
+    uint32_t last_on_us = ramp.on_time_us();
+    check(last_on_us == 100, "duty: starts at the start duty");
+    for (uint32_t cycle = 1; cycle < ramp.ramp_cycles(); ++cycle)
+    {
+        ramp.advance();
+        increasing &= (ramp.on_time_us() >= last_on_us);
+        last_on_us = ramp.on_time_us();
+    }
+    check(increasing && (last_on_us == 900), "duty: sweeps to the end duty");
+    check((ramp.min_on_time_us() == 100) && (ramp.min_off_time_us() == 100),
+          "duty: shortest on and off times");
+}
+
+int main()
+{
+    linear();
+    exponential();
+    rejected();
+    duty();
+    return report_failures();
+}
@@ -0,0 +1,167 @@
+#include <pio_edge_encoder.h>
+#include <host_test.h>
+#include <vector>
+#include <random>
+#include <cstdio>
+
+// Host test of PioEdgeEncoder. Timed port writes are encoded into words and
+// the words are played back the way the state machine does: each one waits
+// its delay and then writes its state. Every write must land on the system
+// clock cycle of its time, and the bridging words in between must not change
+// the pins.
+
+struct Write
+{
+    uint32_t time_us;
+    uint32_t mask;
+    uint32_t state;
+};
+
+struct Playback
+{
+    size_t words = 0;
+    size_t misplaced = 0; // writes off their cycle.
+    size_t wrong_state = 0; // writes or bridging words with the wrong state.
+    bool push_refused_while_pending = true;
+};
+
+uint64_t cycles(uint64_t time_us, uint32_t clock_hz)
+{return (time_us * clock_hz) / 1'000'000;}
+
+/**
+ * \brief encode \p writes starting at \p origin_us and play the words back.
+ */
+template <size_t NUM_CHANNELS>
+Playback play(const std::vector<Write>& writes, uint32_t clock_hz,
+              uint32_t origin_us, uint32_t port_state = 0)
+{
+    using Encoder = PioEdgeEncoder<NUM_CHANNELS>;
+    Encoder encoder;
+    encoder.reset(clock_hz, origin_us, port_state);
+    Playback playback;
+    uint64_t cycle = 0;
+    uint32_t pins = port_state;
+    for (const Write& write: writes)
+    {
+        encoder.push(write.mask, write.state, write.time_us);
+        if (encoder.push(write.mask, write.state, write.time_us))
+            playback.push_refused_while_pending = false;
+        uint32_t expected = ((pins & ~write.mask) | (write.state & write.mask))
+                            & Encoder::STATE_MASK;
+        uint32_t word;
+        while (encoder.pop(word))
+        {
+            ++playback.words;
+            cycle += Encoder::word_delay_cycles(word);
+            uint32_t state = Encoder::word_state(word);
+            if (encoder.pending())
+            {
+                if (state != pins)
+                    ++playback.wrong_state;
+                continue;
+            }
+            if (state != expected)
+                ++playback.wrong_state;
+            if (cycle != cycles(uint32_t(write.time_us - origin_us), clock_hz))
+                ++playback.misplaced;
+            pins = state;
+        }
+    }
+    return playback;
+}
+
+/**
+ * \brief PWM-like writes on random channels, at least \p min_spacing_us
+ *  apart.
+ */
+std::vector<Write> random_writes(size_t count, size_t num_channels,
+                                 uint32_t start_us, uint32_t min_spacing_us,
+                                 uint32_t max_spacing_us, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> spacing(min_spacing_us,
+                                                    max_spacing_us);
+    std::uniform_int_distribution<uint32_t> bits(0, (1u << num_channels) - 1);
+    std::vector<Write> writes;
+    uint32_t time_us = start_us;
+    for (size_t i = 0; i < count; ++i)
+    {
+        time_us += spacing(gen);
+        writes.push_back({time_us, bits(gen), bits(gen)});
+    }
+    return writes;
+}
+
+int main()
+{
+    {
+        auto writes = random_writes(20000, 8, 200, 1, 500, 1);
+        Playback playback = play<8>(writes, 125'000'000, 0);
+        check(!playback.misplaced && !playback.wrong_state,
+              "8 channels at 125MHz: writes land on their cycle");
+        check(playback.push_refused_while_pending,
+              "push waits for the words of the last write");
+    }
+    {
+        auto writes = random_writes(20000, 8, 200, 1, 500, 2);
+        Playback playback = play<8>(writes, 133'000'000, 0);
+        check(!playback.misplaced && !playback.wrong_state,
+              "8 channels at 133MHz: writes land on their cycle");
+    }
+    {
+        // 24 channels leave 8 delay bits, i.e. at most 258 cycles per word.
+        auto writes = random_writes(2000, 24, 200, 1, 200, 3);
+        Playback playback = play<24>(writes, 125'000'000, 0);
+        check(!playback.misplaced && !playback.wrong_state,
+              "24 channels: writes land on their cycle");
+        check(playback.words > writes.size(),
+              "24 channels: long gaps are bridged");
+    }
+    {
+        // Gaps of seconds to minutes.
+        auto writes = random_writes(50, 8, 200, 1'000'000, 100'000'000, 4);
+        Playback playback = play<8>(writes, 125'000'000, 0);
+        check(!playback.misplaced && !playback.wrong_state,
+              "long gaps: writes land on their cycle");
+    }
+    {
+        // The 32-bit microsecond timer wraps during the schedule.
+        uint32_t origin_us = 0xFFFF0000;
+        auto writes = random_writes(5000, 8, origin_us + 200, 1, 100, 5);
+        Playback playback = play<8>(writes, 125'000'000, origin_us);
+        check((writes.back().time_us < origin_us) && !playback.misplaced
+              && !playback.wrong_state,
+              "timer wrap: writes land on their cycle");
+    }
+    {
+        using Encoder = PioEdgeEncoder<8>;
+        Encoder encoder;
+        encoder.reset(125'000'000, 1000, 0x01);
+        uint32_t word;
+        // Due before the origin: happens as soon as possible.
+        encoder.push(0xFF, 0x02, 990);
+        check(encoder.pop(word) && !encoder.pending()
+              && (Encoder::word_delay_cycles(word)
+                  == Encoder::MIN_DELAY_CYCLES)
+              && (Encoder::word_state(word) == 0x02)
+              && (encoder.late_edges() == 1),
+              "a write due before the origin is late");
+        // Two writes at the same time: the second follows the first.
+        encoder.push(0x04, 0x04, 1010);
+        while (encoder.pop(word)) {}
+        uint64_t cycle = encoder.cycle();
+        encoder.push(0x08, 0x08, 1010);
+        check(encoder.pop(word)
+              && (encoder.cycle() == cycle + Encoder::MIN_DELAY_CYCLES)
+              && (encoder.port_state() == 0x0E)
+              && (encoder.late_edges() == 2),
+              "a write at the time of the last one is late");
+        // Later writes are back on their cycle.
+        encoder.push(0xFF, 0x00, 1020);
+        while (encoder.pop(word)) {}
+        check((encoder.cycle() == 20 * 125) && (encoder.time_us() == 1020)
+              && (encoder.late_edges() == 2),
+              "later writes are on time again");
+    }
+    return report_failures();
+}
@@ -0,0 +1,128 @@
+#include <random_interval.h>
+#include <host_test.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Host test of RandomInterval. Every distribution must stay within its
+// bounds and have the expected mean, and a seed must always replay the same
+// intervals.
+
+inline constexpr size_t NUM_DRAWS = 200000;
+
+struct draw_stats_t
+{
+    uint32_t min_us = UINT32_MAX;
+    uint32_t max_us = 0;
+    double mean_us = 0;
+};
+
+draw_stats_t draw(RandomInterval& interval)
+{
+    draw_stats_t stats;
+    double sum_us = 0;
+    for (size_t i = 0; i < NUM_DRAWS; ++i)
+    {
+        uint32_t interval_us = interval.next();
+        stats.min_us = std::min(stats.min_us, interval_us);
+        stats.max_us = std::max(stats.max_us, interval_us);
+        sum_us += interval_us;
+    }
+    stats.mean_us = sum_us / NUM_DRAWS;
+    return stats;
+}
+
+bool near(double value, double expected, double tolerance)
+{return std::abs(value - expected) <= tolerance;}
+
+void neg_log()
+{
+    double max_error = 0;
+    for (uint64_t x = 1; x < (1ull << 32); x = x * 3 + 1)
+    {
+        double expected = -std::log(double(x) / 4294967296.0);
+        double actual = RandomInterval::neg_log_q16(uint32_t(x)) / 65536.0;
+        max_error = std::max(max_error, std::abs(actual - expected));
+    }
+    check(max_error < 1e-3, "neg_log_q16: within 0.001 of -ln(x / 2^32)");
+}
+
+void uniform()
+{
+    RandomInterval interval;
+    interval.configure(RandomInterval::UNIFORM, 7, 0, 100, 300);
+    draw_stats_t stats = draw(interval);
+    check((stats.min_us == 100) && (stats.max_us == 300),
+          "uniform: reaches both bounds and stays within them");
+    check(near(stats.mean_us, 200, 1), "uniform: mean");
+}
+
+void exponential()
+{
+    using enum RandomInterval::distribution_t;
+    RandomInterval interval;
+    interval.configure(EXPONENTIAL, 11, 1000, 50, UINT32_MAX);
+    draw_stats_t stats = draw(interval);
+    check((stats.min_us >= 50) && near(stats.mean_us, 1050, 15),
+          "exponential: min + Exp(mean)");
+
+    interval.configure(EXPONENTIAL, 11, 1000, 0, UINT32_MAX);
+    stats = draw(interval);
+    check((stats.min_us < 5) && near(stats.mean_us, 1000, 15),
+          "exponential: a zero floor gives Exp(mean)");
+
+    interval.configure(EXPONENTIAL, 13, 1000, 0, 500);
+    stats = draw(interval);
+    // P(X > 500) = e^-0.5, and those draws are clipped to 500.
+    double clipped_mean_us = 1000 * (1 - std::exp(-0.5));
+    check((stats.max_us == 500) && near(stats.mean_us, clipped_mean_us, 10),
+          "exponential: clipped to max");
+
+    interval.configure(TRUNCATED_EXPONENTIAL, 17, 1000, 100, 600);
+    stats = draw(interval);
+    // Mean of Exp(1000) conditioned to <= 500, plus the floor.
+    double truncated_mean_us = 100 + 1000
+        - 500 * std::exp(-0.5) / (1 - std::exp(-0.5));
+    check((stats.min_us >= 100) && (stats.max_us <= 600)
+          && (stats.max_us > 590)
+          && near(stats.mean_us, truncated_mean_us, 10),
+          "truncated exponential: conditioned to [min, max]");
+}
+
+void seeding()
+{
+    using enum RandomInterval::distribution_t;
+    RandomInterval interval;
+    interval.configure(EXPONENTIAL, 42, 1000, 10, 100000);
+    std::vector<uint32_t> first;
+    for (size_t i = 0; i < 1000; ++i)
+        first.push_back(interval.next());
+    interval.reseed();
+    bool replayed = true;
+    for (size_t i = 0; i < first.size(); ++i)
+        replayed &= (interval.next() == first[i]);
+    check(replayed, "seeding: reseeding replays the same intervals");
+
+    RandomInterval other;
+    other.configure(EXPONENTIAL, 43, 1000, 10, 100000);
+    size_t same = 0;
+    for (size_t i = 0; i < first.size(); ++i)
+        same += (other.next() == first[i]);
+    check(same < first.size() / 10, "seeding: other seeds draw other intervals");
+
+    interval.configure(UNIFORM, 0, 0, 1, 1000);
+    check((interval.seed() == 1) && (interval.next() != interval.next()),
+          "seeding: a zero seed still draws");
+    interval.configure(NONE, 5, 0, 123, 456);
+    check(!interval.enabled() && (interval.next() == 123),
+          "seeding: disabled intervals are the floor");
+}
+
+int main()
+{
+    neg_log();
+    uniform();
+    exponential();
+    seeding();
+    return report_failures();
+}
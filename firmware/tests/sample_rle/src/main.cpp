@@ -0,0 +1,149 @@
+#include <sample_rle.h>
+#include <host_test.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+
+// Host test of SampleRleEncoder with synthetic sample streams. Batches are
+// decoded back into samples (using each batch's start index) and compared
+// against the input.
+
+inline constexpr size_t BATCH_RUNS = 24;
+using Encoder = SampleRleEncoder<BATCH_RUNS>;
+
+/**
+ * \brief what the PC reconstructs from the batches it receives.
+ */
+struct Decoded
+{
+    std::vector<uint32_t> samples; // index -> state. Skipped = 0xFFFFFFFF.
+    size_t batches = 0;
+    size_t max_batch_runs = 0;
+    uint64_t max_batch_span = 0;
+    bool contiguous = true; // each batch starts where the last one ended.
+
+    void add(const Encoder& encoder)
+    {
+        uint64_t index = encoder.batch_start_index();
+        if (index < samples.size())
+            contiguous = false;
+        samples.resize(index, 0xFFFFFFFF);
+        uint64_t span = 0;
+        for (size_t i = 0; i < encoder.batch_size(); ++i)
+        {
+            const sample_run_t& run = encoder.batch()[i];
+            samples.insert(samples.end(), run.length, run.state);
+            span += run.length;
+        }
+        ++batches;
+        max_batch_runs = std::max(max_batch_runs, encoder.batch_size());
+        max_batch_span = std::max(max_batch_span, span);
+    }
+};
+
+/**
+ * \brief feed \p samples in chunks of \p chunk like the firmware does.
+ */
+void encode(Encoder& encoder, const std::vector<uint32_t>& samples,
+            size_t chunk, Decoded& decoded)
+{
+    size_t offset = 0;
+    while (offset < samples.size())
+    {
+        if (encoder.batch_ready())
+        {
+            decoded.add(encoder);
+            encoder.pop_batch();
+        }
+        size_t count = std::min(chunk, samples.size() - offset);
+        offset += encoder.push(&samples[offset], count);
+    }
+    encoder.flush();
+    if (encoder.batch_ready())
+    {
+        decoded.add(encoder);
+        encoder.pop_batch();
+    }
+}
+
+std::vector<uint32_t> noisy_samples(size_t count, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::vector<uint32_t> samples(count);
+    uint32_t state = 0;
+    for (auto& sample: samples)
+    {
+        if (gen() % 16 == 0)
+            state = gen() & 0xFF;
+        sample = state;
+    }
+    return samples;
+}
+
+int main()
+{
+    printf("SampleRleEncoder test.\r\n");
+    {
+        Encoder encoder;
+        Decoded decoded;
+        std::vector<uint32_t> samples = noisy_samples(100000, 1);
+        encode(encoder, samples, 512, decoded);
+        check(decoded.samples == samples, "noisy stream round trips");
+        check(decoded.contiguous, "batches are contiguous");
+        check(decoded.max_batch_runs <= BATCH_RUNS, "batches are bounded");
+        check(decoded.batches < samples.size() / 100,
+              "noisy stream is compressed");
+    }
+    {
+        Encoder encoder;
+        encoder.set_flush_samples(1000);
+        Decoded decoded;
+        std::vector<uint32_t> samples(10500, 0x5A); // Quiet port.
+        encode(encoder, samples, 37, decoded);
+        check(decoded.samples == samples, "quiet stream round trips");
+        check((decoded.batches == 11) && (decoded.max_batch_span == 1000),
+              "quiet stream is flushed every flush_samples");
+    }
+    {
+        // A full batch must not swallow the sample that starts the next one.
+        Encoder encoder;
+        Decoded decoded;
+        std::vector<uint32_t> samples(5 * BATCH_RUNS + 3);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = i & 1;
+        encode(encoder, samples, samples.size(), decoded);
+        check((decoded.samples == samples)
+              && (decoded.max_batch_runs == BATCH_RUNS),
+              "alternating stream fills whole batches");
+    }
+    {
+        // Overflow: samples 3000-4999 are lost.
+        Encoder encoder;
+        encoder.set_flush_samples(512);
+        Decoded decoded;
+        std::vector<uint32_t> samples = noisy_samples(8000, 2);
+        std::vector<uint32_t> head(samples.begin(), samples.begin() + 3000);
+        std::vector<uint32_t> tail(samples.begin() + 5000, samples.end());
+        encode(encoder, head, 100, decoded);
+        check(!encoder.batch_ready() && encoder.skip(2000), "skip succeeds");
+        encode(encoder, tail, 100, decoded);
+        std::vector<uint32_t> expected = samples;
+        std::fill(expected.begin() + 3000, expected.begin() + 5000, 0xFFFFFFFF);
+        check(decoded.samples == expected,
+              "samples after a gap keep their index");
+    }
+    {
+        Encoder encoder;
+        uint32_t sample = 1;
+        encoder.push(&sample, 1);
+        encoder.flush();
+        check(encoder.batch_ready() && !encoder.skip(10),
+              "skip waits for a pending batch");
+        encoder.reset(42);
+        check(!encoder.batch_ready() && (encoder.next_index() == 42)
+              && (encoder.batch_start_index() == 42),
+              "reset restarts at the given index");
+    }
+    return report_failures();
+}
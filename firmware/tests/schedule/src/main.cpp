@@ -1,6 +1,7 @@
 #include <pwm_settings.h>
 #include <array>
 #include <pico/stdlib.h>
+#include <config.h>
 #include <pwm_scheduler.h>
 #include <pwm_settings.h>
 #include "hardware/clocks.h"
@@ -8,9 +9,9 @@
 
 
 
-__not_in_flash("scheduler") PWMScheduler scheduler;
+__not_in_flash("scheduler") PWMScheduler<NUM_GPIOS> scheduler;
 
-std::array<pwm_settings_t, 8> pwm_settings
+std::array<pwm_settings_t, NUM_GPIOS> pwm_settings
 {{{0, 500, 500, 12, 0},     // offset, on time, off time, cycles, invert
   {75, 500, 500, 12, 0}, // offset can be as little as 10us if PICO_COPY_TO_RAM=1
   {150, 500, 500, 12, 0},
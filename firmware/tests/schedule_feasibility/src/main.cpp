@@ -0,0 +1,155 @@
+#include <schedule_feasibility.h>
+#include <pico_host.h>
+#include <host_test.h>
+#include <config.h>
+#include <vector>
+
+// Host test of analyze_schedule(). Each verdict, and the statistics behind
+// it, must match what can be worked out by hand for small schedules.
+
+using enum schedule_error_t;
+
+feasibility_params_t default_params()
+{
+    return {DEFAULT_EDGE_COST_US, MIN_EDGE_SPACING_US, 0, 8,
+            FEASIBILITY_MAX_EDGES, FEASIBILITY_MAX_SPAN_US, 0};
+}
+
+feasibility_report_t analyze(const std::vector<task_timing_t>& tasks,
+                             const feasibility_params_t& params)
+{return analyze_schedule(tasks.data(), tasks.size(), params);}
+
+void invalid_settings()
+{
+    feasibility_params_t params = default_params();
+    check(analyze({{0, 500, 500, 0}}, params).error
+          == uint8_t(INVALID_SETTINGS), "invalid: on time of a whole period");
+    check(analyze({{0, 0, 500, 0}}, params).error
+          == uint8_t(INVALID_SETTINGS), "invalid: no on time");
+    check(analyze({{0, 100, 0, 0}}, params).error
+          == uint8_t(INVALID_SETTINGS), "invalid: no period");
+    params.merge_tolerance_us = 100;
+    check(analyze({{0, 100, 1000, 0}}, params).error
+          == uint8_t(INVALID_SETTINGS),
+          "invalid: merging would fold a task's own edges");
+    std::vector<task_timing_t> too_many(33, {0, 100, 1000, 0});
+    check(analyze(too_many, default_params()).error
+          == uint8_t(INVALID_SETTINGS), "invalid: more tasks than GPIOs");
+}
+
+void feasible()
+{
+    // Two outputs 100us apart. The first starts high, so the PortEvents are
+    // at 100, 500, 600, 1000, and 1100us.
+    feasibility_report_t report = analyze({{0, 500, 1000, 0},
+                                           {100, 500, 1000, 0}},
+                                          default_params());
+    check(report.error == uint8_t(NONE), "feasible: no error");
+    check(report.min_edge_spacing_us == 100, "feasible: min edge spacing");
+    // The last 4 events follow the first by 1000us.
+    check(report.peak_edge_rate_hz == 4 * 1000000 / 1000,
+          "feasible: peak edge rate over the lookahead");
+    check(report.edge_cost_us == DEFAULT_EDGE_COST_US,
+          "feasible: edge cost echoed");
+    check(report.analyzed_span_us == 1100,
+          "feasible: analyzed a hyperperiod past the latest offset");
+}
+
+void horizon()
+{
+    // Coprime periods: the hyperperiod is their product.
+    feasibility_report_t report = analyze({{0, 100, 300, 0},
+                                           {0, 100, 700, 0}},
+                                          default_params());
+    check((report.error == uint8_t(NONE))
+          && (report.analyzed_span_us == 2100),
+          "horizon: hyperperiod of coprime periods");
+    // A finite task past the hyperperiod extends the horizon to its end.
+    report = analyze({{0, 100, 300, 0}, {0, 100, 1000, 5}}, default_params());
+    check(report.analyzed_span_us == 5000,
+          "horizon: the end of the last finite task");
+    feasibility_params_t params = default_params();
+    params.max_span_us = 1500;
+    report = analyze({{0, 100, 300, 0}, {0, 100, 700, 0}}, params);
+    check(report.analyzed_span_us <= 1500, "horizon: bounded by max_span_us");
+    params = default_params();
+    params.max_edges = 10;
+    report = analyze({{0, 100, 300, 0}, {0, 100, 700, 0}}, params);
+    check((report.error == uint8_t(NONE)) && (report.analyzed_span_us < 2100),
+          "horizon: bounded by max_edges");
+}
+
+void edges_too_close()
+{
+    // Rising edges at 100 and 102us.
+    feasibility_report_t report = analyze({{100, 500, 1000, 0},
+                                           {102, 500, 1000, 0}},
+                                          default_params());
+    check(report.error == uint8_t(EDGES_TOO_CLOSE), "too close: rejected");
+    check(report.violation_time_us == 102, "too close: first violation");
+    check(report.min_edge_spacing_us == 2, "too close: min edge spacing");
+    // Merged into one PortEvent, they are fine.
+    feasibility_params_t params = default_params();
+    params.merge_tolerance_us = 2;
+    report = analyze({{100, 500, 1000, 0}, {102, 500, 1000, 0}}, params);
+    check(report.error == uint8_t(NONE), "too close: fine when merged");
+}
+
+void lookahead_overrun()
+{
+    // 10 outputs 20us apart with a 25us edge cost. Without lookahead, the
+    // second edge is computed only once the first fired, so it is late.
+    std::vector<task_timing_t> tasks;
+    for (uint32_t i = 0; i < 10; ++i)
+        tasks.push_back({100 + i * 20, 500, 1000, 0});
+    feasibility_params_t params = default_params();
+    params.edge_cost_us = 25;
+    params.lookahead_depth = 0;
+    feasibility_report_t report = analyze(tasks, params);
+    check((report.error == uint8_t(LOOKAHEAD_OVERRUN))
+          && (report.violation_time_us == 120),
+          "overrun: rejected without lookahead");
+    // Queued ahead, the same edges are computed in time.
+    params.lookahead_depth = 16;
+    report = analyze(tasks, params);
+    check(report.error == uint8_t(NONE), "overrun: fine with lookahead");
+}
+
+void time_budget()
+{
+    // Host time stands still, so a time budget never runs out here.
+    feasibility_params_t params = default_params();
+    params.max_time_us = FEASIBILITY_MAX_TIME_US;
+    feasibility_report_t report = analyze({{0, 100, 300, 0},
+                                           {0, 100, 700, 0}}, params);
+    check(report.analyzed_span_us == 2100, "time: budget not reached");
+    // Rising edges at 5000 and 5002us, after ~50 PortEvents of a fast task.
+    std::vector<task_timing_t> tasks = {{0, 100, 200, 0},
+                                        {5000, 100, 1000, 0},
+                                        {5002, 100, 1000, 0}};
+    params.max_time_us = 0;
+    report = analyze(tasks, params);
+    check((report.error == uint8_t(EDGES_TOO_CLOSE))
+          && (report.violation_time_us == 5002),
+          "time: violation found without a budget");
+    // Each time read costs 1us, so 10us run out long before the violation.
+    host_set_time_read_cost_us(1);
+    params.max_time_us = 10;
+    report = analyze(tasks, params);
+    host_set_time_read_cost_us(0);
+    check((report.error == uint8_t(ANALYSIS_INCOMPLETE))
+          && (report.violation_time_us < 5000)
+          && (report.analyzed_span_us < report.violation_time_us),
+          "time: running out of budget is an error");
+}
+
+int main()
+{
+    invalid_settings();
+    feasible();
+    horizon();
+    edges_too_close();
+    lookahead_overrun();
+    time_budget();
+    return report_failures();
+}
@@ -0,0 +1,127 @@
+#include <pico/stdlib.h>
+#include <pico_host.h>
+#include <pwm_scheduler.h>
+#include <port_layout.h>
+#include <chrono>
+#include <cstdio>
+
+// Host benchmark of the scheduler's hot path for 8, 16, and 24 channels.
+// Time is virtual, so deadlines are never missed; what is measured is the
+// host CPU time spent in update() (per PortEvent) and in the alarm ISR. These
+// are host figures, for comparing runs of this benchmark with each other. They
+// say nothing about core1's cycles on the RP2040, which only a PROFILE_CPU
+// build on the device measures. RAM is the size of the scheduler (tasks,
+// queues, and undo log) per channel.
+// Staggered schedules give every channel its own edges. Shared schedules
+// drive a camera and two alternating groups of lasers (some inverted), whose
+// channels the scheduler coalesces into one task per group.
+
+using bench_clock = std::chrono::steady_clock;
+
+inline constexpr size_t NUM_PORT_EVENTS = 200000;
+
+uint32_t missed_deadlines = 0;
+
+void handle_missed_deadline()
+{++missed_deadlines;}
+
+template <size_t NUM_CHANNELS, size_t PIN_BASE>
+void bench_scheduler(bool shared_timing)
+{
+    using Scheduler = PWMScheduler<NUM_CHANNELS>;
+    host_reset();
+    missed_deadlines = 0;
+    static Scheduler scheduler; // Claims the alarm once per instantiation.
+    scheduler.reset();
+    for (size_t i = 0; i < NUM_CHANNELS; ++i)
+    {
+        uint32_t pin_mask = 1u << (PIN_BASE + i);
+        if (!shared_timing)
+        {
+            // Camera-plus-laser style schedule: staggered offsets, mixed
+            // periods.
+            uint32_t period_us = 1000 * (1 + (i % 4));
+            scheduler.schedule_pwm_task(10 * (i + 1), period_us / 4, period_us,
+                                        pin_mask, 0, false);
+        }
+        else if (i == 0) // Camera: exposes during both laser pulses.
+            scheduler.schedule_pwm_task(0, 900, 1000, pin_mask, 0, false);
+        else // Lasers: alternate between odd and even channels.
+            scheduler.schedule_pwm_task((i % 2)? 50: 500, 350, 1000, pin_mask,
+                                        0, (i % 4) == 3);
+    }
+    uint32_t alarm_time_us = 0;
+    scheduler.start();
+    size_t port_events = 0;
+    bench_clock::duration update_time{0};
+    bench_clock::duration isr_time{0};
+    while (port_events < NUM_PORT_EVENTS)
+    {
+        // Let the ISR consume the next PortEvent at its scheduled time.
+        if (!host_alarm_armed(Scheduler::alarm_num(), alarm_time_us))
+        {
+            printf("%zu channels: the alarm is not armed.\r\n", NUM_CHANNELS);
+            break;
+        }
+        host_set_time_us(alarm_time_us);
+        auto isr_start = bench_clock::now();
+        Scheduler::set_new_ttl_pin_state();
+        isr_time += bench_clock::now() - isr_start;
+        ++port_events;
+        // Refill the lookahead queue.
+        auto update_start = bench_clock::now();
+        scheduler.update();
+        update_time += bench_clock::now() - update_start;
+    }
+    scheduler.reset();
+    printf("%2zu channels (%s): update(): %6.1f host ns/PortEvent | ISR: "
+           "%5.1f host ns"
+           " | RAM: %4zu B/channel | missed deadlines: %u\r\n", NUM_CHANNELS,
+           shared_timing? "shared": "staggered",
+           std::chrono::duration<double, std::nano>(update_time).count()
+               / port_events,
+           std::chrono::duration<double, std::nano>(isr_time).count()
+               / port_events,
+           sizeof(Scheduler) / NUM_CHANNELS, missed_deadlines);
+}
+
+template <size_t NUM_CHANNELS, size_t PIN_BASE>
+void bench_edge_capture()
+{
+    using Port = PortLayout<NUM_CHANNELS, PIN_BASE>;
+    constexpr size_t NUM_CAPTURES = 10000000;
+    uint32_t rise_pins;
+    uint32_t fall_pins;
+    uint32_t checksum = 0;
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < NUM_CAPTURES; ++i)
+    {
+        // Pretend every port pin saw an edge.
+        for (size_t reg = Port::FIRST_INTR_REG; reg <= Port::LAST_INTR_REG; ++reg)
+            io_bank0_hw->intr[reg] = uint32_t(i) * 0x9E3779B9u;
+        Port::read_and_clear_edges(io_bank0_hw->intr, rise_pins, fall_pins);
+        checksum += rise_pins ^ fall_pins;
+    }
+    auto elapsed = bench_clock::now() - start;
+    printf("%2zu channels: edge capture unpack: %5.2f host ns "
+           "(checksum 0x%08x)\r\n",
+           NUM_CHANNELS,
+           std::chrono::duration<double, std::nano>(elapsed).count()
+               / NUM_CAPTURES, checksum);
+}
+
+int main()
+{
+    printf("PWMScheduler host benchmark (%zu PortEvents per run, "
+           "%zu B/PWMTask).\r\n", NUM_PORT_EVENTS, sizeof(PWMTask));
+    for (bool shared_timing: {false, true})
+    {
+        bench_scheduler<8, 8>(shared_timing);
+        bench_scheduler<16, 8>(shared_timing);
+        bench_scheduler<24, 2>(shared_timing);
+    }
+    bench_edge_capture<8, 8>();
+    bench_edge_capture<16, 8>();
+    bench_edge_capture<24, 2>();
+    return 0;
+}
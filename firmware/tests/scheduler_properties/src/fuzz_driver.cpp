@@ -0,0 +1,45 @@
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// Runs the fuzz target without libFuzzer, for compilers that lack
+// -fsanitize=fuzzer: on each input file given, or else on random inputs.
+//
+// Usage: schedule_fuzz [input files...]
+
+inline constexpr size_t NUM_RANDOM_INPUTS = 500;
+inline constexpr size_t MAX_RANDOM_INPUT_SIZE = 512;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file)
+        {
+            printf("Cannot open %s\r\n", argv[i]);
+            return 2;
+        }
+        std::vector<uint8_t> input{std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>()};
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    if (argc > 1)
+        return 0;
+    std::mt19937 rng(0);
+    for (size_t i = 0; i < NUM_RANDOM_INPUTS; ++i)
+    {
+        std::vector<uint8_t> input(rng() % MAX_RANDOM_INPUT_SIZE);
+        for (uint8_t& byte: input)
+            byte = uint8_t(rng());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    printf("Ran %zu random inputs.\r\n", NUM_RANDOM_INPUTS);
+    return 0;
+}
@@ -0,0 +1,1170 @@
+#include <pico/stdlib.h>
+#include <pico_host.h>
+#include <pwm_scheduler.h>
+#include <pwm_settings.h>
+#include <schedule_ctrl_queues.h>
+#include <core1_main.h>
+#include <host_test.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Property test of the PWMScheduler against a closed-form model of its edges.
+// Random channel settings (zero offsets, coincident edges, inverted outputs,
+// finite and endless trains) are run in virtual time, starting anywhere
+// including just before the 32-bit timer wraps. Every transition on every pad
+// must match the model: exactly with no merge tolerance, and at most the
+// tolerance early otherwise. Schedules are uploaded either directly or the
+// way core1 does it, through sync_schedule(), sometimes over a different
+// schedule. Each schedule is then stopped and restarted and must replay the
+// same edges. Channels with the same timing as an earlier channel must be
+// coalesced into its task.
+// Gated schedules additionally toggle gate inputs at random times. A gated
+// pad must idle while its gate is closed and otherwise follow the model,
+// either in real time (CONTINUE) or in time that only passes while the gate is
+// open (FREEZE).
+// Phase-locked schedules are re-anchored by reference edges that drift
+// against their period, and must move onto the reference's grid of cycles
+// (with a tracked period when asked to) without disturbing other channels.
+// Overlaid schedules add trains to some channels that combine with the
+// channel's own train, and each pad must follow the combined model exactly.
+//
+// Usage: scheduler_properties [num_schedules] [first_seed]
+// A failing seed is printed so that it can be rerun on its own.
+
+inline constexpr size_t NUM_CHANNELS = NUM_GPIOS;
+inline constexpr size_t PIN_BASE = PORT_BASE;
+inline constexpr size_t DEFAULT_NUM_SCHEDULES = 20000;
+inline constexpr size_t MAX_EDGES_PER_CHANNEL = 64; // Horizon for endless trains.
+inline constexpr size_t MAX_ALARMS = 100000; // Per run. Guards against hangs.
+inline constexpr uint32_t RESTART_DELAY_US = 54321; // After the first run.
+inline constexpr size_t GATE_PINS[] = {2, 3}; // Off the port. Always inputs.
+inline constexpr size_t MAX_GATE_TOGGLES = 24;
+inline constexpr size_t REFERENCE_PIN = 4; // Off the port. Always an input.
+inline constexpr size_t PHASE_LOCK_REFERENCE_EDGES = 40;
+
+// Read by core1's sync_schedule().
+queue_t pwm_settings_queue;
+queue_t pwm_timing_queue;
+queue_t schedule_config_queue;
+queue_t core1_ctrl_queue;
+queue_t core1_next_state_queue;
+queue_t schedule_error_queue;
+queue_t schedule_slot_ack_queue;
+queue_t gate_event_queue;
+queue_t reference_edge_queue;
+queue_t phase_lock_event_queue;
+queue_t trial_settings_queue;
+queue_t trial_event_queue;
+queue_t state_machine_program_queue;
+queue_t state_machine_event_queue;
+
+/**
+ * \brief how a schedule gets into the scheduler.
+ */
+enum class upload_t: uint8_t
+{
+    DIRECT, /// schedule_pwm_task().
+    SYNC, /// sync_schedule(), like core1.
+    SYNC_OVER_OTHER, /// sync_schedule() over another schedule's tasks.
+};
+
+/**
+ * \brief a pad changing level.
+ */
+struct edge_t
+{
+    uint32_t time_us; /// since the schedule started.
+    bool level;
+
+    bool operator==(const edge_t&) const = default;
+};
+
+/**
+ * \brief edges of one channel's pad in [0, horizon_us).
+ * \details A train with offset d, on time t_on, and period P pulses high at
+ *  d + k*P for t_on, for k < cycles (or forever if cycles is 0). The pad idles
+ *  at the invert level before starting.
+ */
+std::vector<edge_t> model_edges(const pwm_settings_t& settings,
+                                uint64_t horizon_us)
+{
+    std::vector<edge_t> edges;
+    bool invert = settings.invert;
+    uint32_t period_us = settings.period_us();
+    for (uint32_t k = 0; (settings.cycles == 0) || (k < settings.cycles); ++k)
+    {
+        uint64_t rise_us = settings.offset_us + uint64_t(k) * period_us;
+        if (rise_us >= horizon_us)
+            break;
+        edges.push_back({uint32_t(rise_us), !invert});
+        uint64_t fall_us = rise_us + settings.on_duration_us;
+        if (fall_us >= horizon_us)
+            break;
+        edges.push_back({uint32_t(fall_us), invert});
+    }
+    return edges;
+}
+
+/**
+ * \brief a gate input changing level. Applied after any edges at the same
+ *  time.
+ */
+struct gate_toggle_t
+{
+    uint32_t time_us; /// since the schedule started.
+    size_t pin;
+    bool level;
+};
+
+/**
+ * \brief edges of a gated channel's pad in [0, horizon_us).
+ * \details The pad follows the ungated model while the gate is open and idles
+ *  while it is closed. A FREEZE gate also stops the model's clock.
+ */
+std::vector<edge_t> model_gated_edges(const pwm_settings_t& settings,
+                                      const pwm_gate_settings_t& gate,
+                                      uint32_t gate_levels,
+                                      const std::vector<gate_toggle_t>& toggles,
+                                      uint64_t horizon_us)
+{
+    bool invert = settings.invert;
+    auto gate_open = [&]()
+    {
+        return (gate.mode == OutputGate::NONE)
+               || (bool((gate_levels >> gate.gate_channel) & 1u)
+                   != bool(gate.active_low));
+    };
+    bool freeze = (gate.mode == OutputGate::FREEZE);
+    // Every ungated edge happens within the horizon of the model's clock.
+    std::vector<edge_t> waveform = model_edges(settings, horizon_us);
+    std::vector<edge_t> edges;
+    uint64_t time_us = 0;
+    uint64_t model_time_us = 0;
+    size_t next_edge = 0;
+    size_t next_toggle = 0;
+    bool level = invert;
+    bool pad = invert;
+    while (true)
+    {
+        // Apply the edges that are due, then the gate toggles.
+        while ((next_edge < waveform.size())
+               && (waveform[next_edge].time_us <= model_time_us))
+            level = waveform[next_edge++].level;
+        while ((next_toggle < toggles.size())
+               && (toggles[next_toggle].time_us <= time_us))
+        {
+            const gate_toggle_t& toggle = toggles[next_toggle++];
+            gate_levels = (gate_levels & ~(1u << toggle.pin))
+                          | (uint32_t(toggle.level) << toggle.pin);
+        }
+        bool clock_running = gate_open() || !freeze;
+        bool new_pad = gate_open()? level: invert;
+        if (new_pad != pad)
+            edges.push_back({uint32_t(time_us), new_pad});
+        pad = new_pad;
+        // Advance to whatever happens next.
+        uint64_t next_time_us = horizon_us;
+        if (clock_running && (next_edge < waveform.size()))
+            next_time_us = std::min(next_time_us, time_us
+                + waveform[next_edge].time_us - model_time_us);
+        if (next_toggle < toggles.size())
+            next_time_us = std::min(next_time_us,
+                                    uint64_t(toggles[next_toggle].time_us));
+        if (next_time_us >= horizon_us)
+            return edges;
+        if (clock_running)
+            model_time_us += next_time_us - time_us;
+        time_us = next_time_us;
+    }
+}
+
+/**
+ * \brief random settings that tend to produce corner cases.
+ */
+std::vector<pwm_settings_t> random_schedule(std::mt19937& rng)
+{
+    auto uniform = [&](uint32_t lo, uint32_t hi)
+        {return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);};
+    // A shared time unit makes coincident edges across channels likely.
+    static const uint32_t units_us[] = {1, 5, 10, 100};
+    uint32_t unit_us = units_us[uniform(0, 3)];
+    std::vector<pwm_settings_t> schedule(uniform(1, NUM_CHANNELS));
+    for (size_t i = 0; i < schedule.size(); ++i)
+    {
+        pwm_settings_t& settings = schedule[i];
+        bool same_timing = (i > 0) && (uniform(0, 3) == 0);
+        if (same_timing)
+            settings = schedule[uniform(0, i - 1)]; // Same edges as another.
+        else
+        {
+            settings.offset_us = (uniform(0, 3) == 0)? 0: unit_us * uniform(0, 20);
+            settings.on_duration_us = unit_us * uniform(1, 20);
+            settings.off_duration_us = unit_us * uniform(1, 20);
+        }
+        // Keep the count of copies half of the time, so that they coalesce.
+        if (!same_timing || uniform(0, 1))
+            settings.cycles = (uniform(0, 2) == 0)? 0: uniform(1, 15);
+        settings.invert = (uniform(0, 3) == 0);
+    }
+    return schedule;
+}
+
+/**
+ * \brief an input that the scheduler handles between its alarms, i.e: a gate
+ *  toggle or a reference edge.
+ */
+struct input_event_t
+{
+    uint32_t time_us; /// since the schedule started.
+    /// applies the input, with virtual time at time_us. Its argument is the
+    /// start time of the run.
+    std::function<void(uint32_t)> apply;
+};
+
+uint32_t started_coalesced_outputs = 0; /// as of the last run()'s start.
+bool masked_edges_logged = false; /// by any run() since this was cleared.
+size_t logged_writes = 0; /// output events logged by the last run().
+
+/**
+ * \brief run the uploaded schedule from \p start_time_us until it finishes or
+ *  reaches \p horizon_us, applying \p inputs (in order of their time) along
+ *  the way.
+ * \details Output events are logged, and a logged write that includes an
+ *  output whose gate is closed sets masked_edges_logged.
+ * \returns the edges seen on each channel's pad.
+ */
+std::vector<std::vector<edge_t>> run(
+    uint32_t start_time_us, uint32_t horizon_us,
+    const std::vector<input_event_t>& inputs = {})
+{
+    std::vector<std::vector<edge_t>> edges(NUM_CHANNELS);
+    output_event_log.clear();
+    output_event_log_enabled = true;
+    logged_writes = 0;
+    uint32_t pads = gpio_get_all();
+    auto record_edges = [&]()
+    {
+        uint32_t new_pads = gpio_get_all();
+        for (size_t ch = 0; ch < NUM_CHANNELS; ++ch)
+        {
+            uint32_t pin_mask = 1u << (PIN_BASE + ch);
+            if ((new_pads ^ pads) & pin_mask)
+                edges[ch].push_back({time_us_32() - start_time_us,
+                                     bool(new_pads & pin_mask)});
+        }
+        pads = new_pads;
+    };
+    host_set_time_us(start_time_us);
+    scheduler.start();
+    started_coalesced_outputs = scheduler.coalesced_outputs();
+    record_edges();
+    size_t next_input = 0;
+    uint32_t alarm_time_us = 0;
+    for (size_t i = 0; (i < MAX_ALARMS) && !scheduler.finished(); ++i)
+    {
+        scheduler.update(); // Keep the lookahead queue topped up, like core1.
+        bool armed = host_alarm_armed(scheduler.alarm_num(), alarm_time_us);
+        // Edges at the same time as an input go first.
+        if ((next_input < inputs.size())
+            && (!armed || (inputs[next_input].time_us
+                           < alarm_time_us - start_time_us)))
+        {
+            const input_event_t& input = inputs[next_input++];
+            if (input.time_us >= horizon_us)
+                break;
+            host_set_time_us(start_time_us + input.time_us);
+            input.apply(start_time_us);
+            record_edges();
+            continue;
+        }
+        if (!armed || (alarm_time_us - start_time_us >= horizon_us))
+            break;
+        uint32_t closed_outputs = scheduler.gated_outputs()
+                                  & ~scheduler.open_gated_outputs();
+        host_fire_alarm(scheduler.alarm_num());
+        record_edges();
+        // The output log leaves out the writes that a closed gate masked.
+        OutputEvent event;
+        while (output_event_log.pop(event))
+        {
+            ++logged_writes;
+            if (event.mask & closed_outputs)
+                masked_edges_logged = true;
+        }
+    }
+    scheduler.stop();
+    output_event_log_enabled = false;
+    return edges;
+}
+
+/**
+ * \brief compare each channel's edges with \p model(channel), which is only
+ *  asked for the channels of \p schedule. Others must stay idle.
+ * \returns false (after printing the first mismatch) if any differ.
+ */
+bool edges_match(const std::vector<pwm_settings_t>& schedule,
+                 const std::vector<std::vector<edge_t>>& edges,
+                 const std::function<std::vector<edge_t>(size_t)>& model,
+                 const char* run)
+{
+    for (size_t ch = 0; ch < NUM_CHANNELS; ++ch)
+    {
+        std::vector<edge_t> expected;
+        if (ch < schedule.size())
+            expected = model(ch);
+        if (edges[ch] == expected)
+            continue;
+        printf("%s: channel %zu: %zu edges, expected %zu\r\n", run, ch,
+               edges[ch].size(), expected.size());
+        for (size_t i = 0; i < std::max(edges[ch].size(), expected.size());
+             ++i)
+        {
+            if ((i < edges[ch].size()) && (i < expected.size())
+                && (edges[ch][i] == expected[i]))
+                continue;
+            printf("  first difference: edge %zu\r\n", i);
+            break;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief run the uploaded schedule as in run() from \p start_time_us, and
+ *  again after restarting it, and check both runs.
+ * \param check compares the edges of a run (named by its second argument)
+ *  with what they should be, and prints why not.
+ * \param before_run sets the inputs' levels at the start of a run, if any.
+ * \returns false (after printing why) if a run fails its check, misses a
+ *  deadline, or logs a masked edge.
+ */
+bool run_and_restart(
+    uint32_t start_time_us, uint32_t horizon_us,
+    const std::vector<input_event_t>& inputs,
+    const std::function<bool(std::vector<std::vector<edge_t>>,
+                             const char*)>& check,
+    const std::function<void()>& before_run = nullptr)
+{
+    schedule_failed = false;
+    masked_edges_logged = false;
+    // Stopped schedules must restart from the beginning.
+    for (uint32_t restart_us: {0u, RESTART_DELAY_US})
+    {
+        if (before_run)
+            before_run();
+        if (!check(run(start_time_us + restart_us, horizon_us, inputs),
+                   restart_us? "restart": "first run"))
+            return false;
+    }
+    if (schedule_failed)
+    {
+        printf("missed a deadline in virtual time\r\n");
+        return false;
+    }
+    if (masked_edges_logged)
+    {
+        printf("logged an edge that a closed gate masked\r\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief check one run against the model.
+ * \returns false (after printing why) on the first mismatch.
+ */
+bool check_edges(const std::vector<pwm_settings_t>& schedule,
+                 const std::vector<std::vector<edge_t>>& edges,
+                 uint32_t horizon_us, uint32_t tolerance_us, const char* run)
+{
+    for (size_t ch = 0; ch < NUM_CHANNELS; ++ch)
+    {
+        // Merging may pull edges from just past the horizon inside of it.
+        std::vector<edge_t> expected;
+        if (ch < schedule.size())
+            expected = model_edges(schedule[ch],
+                                   uint64_t(horizon_us) + tolerance_us);
+        size_t min_edges = 0;
+        while ((min_edges < expected.size())
+               && (expected[min_edges].time_us < horizon_us))
+            ++min_edges;
+        const std::vector<edge_t>& actual = edges[ch];
+        if ((actual.size() < min_edges) || (actual.size() > expected.size()))
+        {
+            printf("%s: channel %zu: %zu edges, expected %zu\r\n", run, ch,
+                   actual.size(), min_edges);
+            return false;
+        }
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            uint32_t early_us = expected[i].time_us - actual[i].time_us;
+            if ((actual[i].level != expected[i].level)
+                || (int32_t(early_us) < 0) || (early_us > tolerance_us))
+            {
+                printf("%s: channel %zu edge %zu: %s at %u[us], expected %s at "
+                       "%u[us]\r\n", run, ch, i,
+                       actual[i].level? "rise": "fall", actual[i].time_us,
+                       expected[i].level? "rise": "fall", expected[i].time_us);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void print_schedule(const std::vector<pwm_settings_t>& schedule,
+                    uint32_t tolerance_us, uint32_t start_time_us)
+{
+    printf("  merge tolerance: %u[us] | start time: 0x%08x\r\n", tolerance_us,
+           start_time_us);
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        const pwm_settings_t& s = schedule[ch];
+        printf("  ch%zu: {%u, %u, %u, %u, %u}\r\n", ch, s.offset_us,
+               s.on_duration_us, s.off_duration_us, s.cycles, s.invert);
+    }
+}
+
+/**
+ * \brief send \p schedule to core1's sync_schedule() as core0 would.
+ */
+void sync_settings(const std::vector<pwm_settings_t>& schedule,
+                   uint32_t tolerance_us)
+{
+    schedule_config_msg_t config{schedule_param_t::EDGE_MERGE_TOLERANCE_US,
+                                 tolerance_us};
+    queue_try_add(&schedule_config_queue, &config);
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        pwm_specs_core_msg_t msg;
+        msg.pin = PIN_BASE + ch;
+        msg.specs = schedule[ch];
+        queue_try_add(&pwm_settings_queue, &msg);
+    }
+    sync_schedule();
+}
+
+/**
+ * \brief replace the scheduler's tasks with \p schedule.
+ */
+void upload(const std::vector<pwm_settings_t>& schedule, uint32_t tolerance_us,
+            upload_t method)
+{
+    scheduler.reset();
+    if (method == upload_t::SYNC_OVER_OTHER)
+    {
+        // Same channels, other settings.
+        std::mt19937 rng(schedule.size() + tolerance_us);
+        std::vector<pwm_settings_t> other;
+        while (other.size() != schedule.size())
+            other = random_schedule(rng);
+        sync_settings(other, 0);
+    }
+    if (method != upload_t::DIRECT)
+    {
+        sync_settings(schedule, tolerance_us);
+        return;
+    }
+    scheduler.set_merge_tolerance_us(tolerance_us);
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        const pwm_settings_t& s = schedule[ch];
+        scheduler.schedule_pwm_task(s.offset_us, s.on_duration_us,
+                                    s.period_us(), 1u << (PIN_BASE + ch),
+                                    s.cycles, s.invert);
+    }
+}
+
+/**
+ * \brief replace the scheduler's tasks with \p schedule plus extra timing
+ *  per channel: through sync_schedule() like core1 if \p sync, else
+ *  directly.
+ * \param timing the timing message that core0 would send for a channel.
+ * \param configure adds the same timing to a channel's task spec.
+ */
+void upload_with_timing(
+    const std::vector<pwm_settings_t>& schedule, bool sync,
+    const std::function<pwm_timing_core_msg_t(size_t)>& timing,
+    const std::function<void(size_t, pwm_task_spec_t&)>& configure)
+{
+    scheduler.reset();
+    if (sync)
+        sync_settings(schedule, 0);
+    else
+        scheduler.set_merge_tolerance_us(0);
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        uint32_t pin = PIN_BASE + ch;
+        if (!sync)
+        {
+            const pwm_settings_t& s = schedule[ch];
+            pwm_task_spec_t spec{s.offset_us, s.on_duration_us, s.period_us(),
+                                 1u << pin, s.cycles, bool(s.invert)};
+            configure(ch, spec);
+            scheduler.schedule_pwm_task(spec);
+            continue;
+        }
+        pwm_timing_core_msg_t msg = timing(ch);
+        msg.pin = pin;
+        queue_try_add(&pwm_timing_queue, &msg);
+        sync_schedule();
+    }
+}
+
+/**
+ * \brief drop the pulses that start and end at the same time, i.e: a gate
+ *  closing right after an edge, which leave nothing on the pad.
+ */
+void drop_zero_width_pulses(std::vector<std::vector<edge_t>>& edges)
+{
+    for (std::vector<edge_t>& channel_edges: edges)
+    {
+        std::vector<edge_t> kept;
+        for (const edge_t& edge: channel_edges)
+        {
+            if (!kept.empty() && (kept.back().time_us == edge.time_us))
+                kept.pop_back();
+            else
+                kept.push_back(edge);
+        }
+        channel_edges = std::move(kept);
+    }
+}
+
+/**
+ * \brief generate, run, and check a gated schedule for one seed.
+ */
+bool check_gated_seed(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    auto uniform = [&](uint32_t lo, uint32_t hi)
+        {return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);};
+    std::vector<pwm_settings_t> schedule = random_schedule(rng);
+    std::vector<pwm_gate_settings_t> gates(schedule.size());
+    uint32_t horizon_us = 1;
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        const pwm_settings_t& settings = schedule[ch];
+        uint32_t cycles = settings.cycles? settings.cycles
+                                         : MAX_EDGES_PER_CHANNEL / 2;
+        horizon_us = std::max(horizon_us, settings.offset_us
+                                          + cycles * settings.period_us() + 1);
+        gates[ch].channel = ch;
+        gates[ch].mode = uniform(0, 2);
+        gates[ch].gate_channel = GATE_PINS[uniform(0, 1)]; // As a pin.
+        gates[ch].active_low = uniform(0, 1);
+    }
+    // Leave time for frozen trains to finish.
+    horizon_us *= 2;
+    uint32_t gate_levels = 0;
+    for (size_t pin: GATE_PINS)
+        gate_levels |= uniform(0, 1) << pin;
+    std::vector<gate_toggle_t> toggles;
+    uint32_t levels = gate_levels;
+    std::vector<uint32_t> toggle_times(uniform(0, MAX_GATE_TOGGLES));
+    for (uint32_t& time_us: toggle_times)
+        time_us = uniform(0, horizon_us - 1);
+    // A gate cannot close and open at the same time.
+    std::sort(toggle_times.begin(), toggle_times.end());
+    toggle_times.erase(std::unique(toggle_times.begin(), toggle_times.end()),
+                       toggle_times.end());
+    for (uint32_t time_us: toggle_times)
+    {
+        size_t pin = GATE_PINS[uniform(0, 1)];
+        levels ^= 1u << pin;
+        toggles.push_back({time_us, pin, bool((levels >> pin) & 1u)});
+    }
+    uint32_t start_time_us = uniform(0, UINT32_MAX);
+    bool sync = uniform(0, 1);
+    upload_with_timing(schedule, sync, [&](size_t ch)
+    {
+        pwm_timing_core_msg_t msg;
+        msg.mode = pwm_timing_mode_t::GATE;
+        msg.gate = gates[ch];
+        return msg;
+    },
+    [&](size_t ch, pwm_task_spec_t& spec)
+    {
+        spec.gate.configure(OutputGate::mode_t(gates[ch].mode),
+                            gates[ch].gate_channel, gates[ch].active_low);
+    });
+    std::vector<input_event_t> inputs;
+    for (const gate_toggle_t& toggle: toggles)
+    {
+        inputs.push_back({toggle.time_us, [toggle](uint32_t)
+        {
+            host_set_gpio_in(1u << toggle.pin,
+                             uint32_t(toggle.level) << toggle.pin);
+            scheduler.update_gates();
+        }});
+    }
+    uint32_t gate_mask = 0;
+    for (size_t pin: GATE_PINS)
+        gate_mask |= 1u << pin;
+    bool ok = run_and_restart(start_time_us, horizon_us, inputs,
+        [&](std::vector<std::vector<edge_t>> edges, const char* run)
+    {
+        drop_zero_width_pulses(edges);
+        return edges_match(schedule, edges, [&](size_t ch)
+        {
+            return model_gated_edges(schedule[ch], gates[ch], gate_levels,
+                                     toggles, horizon_us);
+        }, run);
+    },
+    [&]()
+    {
+        host_set_gpio_in(gate_mask, gate_levels);
+    });
+    if (!ok)
+    {
+        printf("  upload: %s | gate levels: 0x%x\r\n", sync? "sync": "direct",
+               gate_levels);
+        print_schedule(schedule, 0, start_time_us);
+        for (const pwm_gate_settings_t& g: gates)
+            printf("  gate ch%u: mode %u, pin %u, active low %u\r\n",
+                   g.channel, g.mode, g.gate_channel, g.active_low);
+        for (const gate_toggle_t& t: toggles)
+            printf("  toggle: pin %zu -> %u at %u[us]\r\n", t.pin, t.level,
+                   t.time_us);
+    }
+    return ok;
+}
+
+/**
+ * \brief a reference edge and when the scheduler gets to re-anchor with it.
+ */
+struct reference_edge_t
+{
+    uint32_t time_us; /// since the schedule started.
+    uint32_t process_us; /// since the schedule started. Not before time_us.
+};
+
+/**
+ * \brief generate, run, and check a phase-locked schedule for one seed.
+ * \details Locked channels must free-run like the model until the first
+ *  reference edge is applied. After that, every edge must be on the grid of
+ *  cycles that start the lock delay after the last applied reference edge,
+ *  and for tracking channels the grid's period must converge to the
+ *  reference period over the cycles per reference period. Other channels
+ *  must not notice.
+ */
+bool check_phase_locked_seed(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    auto uniform = [&](uint32_t lo, uint32_t hi)
+        {return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);};
+    std::vector<pwm_settings_t> schedule = random_schedule(rng);
+    // Locked channels need fixed, endless timing with edges far enough apart
+    // to move.
+    std::vector<pwm_phase_lock_settings_t> locks(schedule.size());
+    uint32_t period_us = uniform(40, 400);
+    uint32_t ratio = uniform(1, 4); // Output cycles per reference period.
+    bool track = uniform(0, 1);
+    // Tracking pulls in up to an eighth of the period.
+    int32_t max_drift_us = track? period_us / 8: 3 * period_us / 8;
+    int32_t drift_us = (uniform(0, 1) == 0)? int32_t(uniform(0, 4)) - 2
+        : int32_t(uniform(0, 2 * max_drift_us)) - max_drift_us;
+    uint32_t reference_period_us = ratio * period_us + drift_us;
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        locks[ch].channel = ch;
+        if ((ch > 0) && (uniform(0, 2) == 0))
+            continue;
+        pwm_settings_t& settings = schedule[ch];
+        settings.on_duration_us = uniform(MIN_EDGE_SPACING_US,
+                                          period_us - MIN_EDGE_SPACING_US);
+        settings.off_duration_us = period_us - settings.on_duration_us;
+        settings.offset_us = uniform(0, 3 * period_us);
+        settings.cycles = 0;
+        locks[ch].mode = track? PhaseLock::TRACK: PhaseLock::ANCHOR;
+        locks[ch].reference_channel = REFERENCE_PIN; // As a pin.
+        locks[ch].delay_us = uniform(0, 3 * period_us);
+    }
+    std::vector<reference_edge_t> references;
+    uint32_t time_us = uniform(0, 4 * period_us);
+    for (size_t i = 0; i < PHASE_LOCK_REFERENCE_EDGES; ++i)
+    {
+        references.push_back({time_us, time_us + uniform(0, 20)});
+        time_us += reference_period_us;
+    }
+    uint32_t horizon_us = time_us + reference_period_us;
+    uint32_t start_time_us = uniform(0, UINT32_MAX);
+    bool sync = uniform(0, 1);
+    upload_with_timing(schedule, sync, [&](size_t ch)
+    {
+        pwm_timing_core_msg_t msg;
+        msg.mode = pwm_timing_mode_t::PHASE_LOCK;
+        msg.phase_lock = locks[ch];
+        return msg;
+    },
+    [&](size_t ch, pwm_task_spec_t& spec)
+    {
+        spec.phase_lock.configure(PhaseLock::mode_t(locks[ch].mode),
+                                  locks[ch].reference_channel, false,
+                                  locks[ch].delay_us);
+    });
+    // Outputs lock once the per-reference error is within the tolerance and
+    // never lock otherwise.
+    uint32_t locked_pins = 0;
+    for (size_t ch = 0; ch < schedule.size(); ++ch)
+    {
+        if (locks[ch].mode)
+            locked_pins |= 1u << (PIN_BASE + ch);
+    }
+    bool lockable = track
+        || (uint32_t(std::abs(drift_us)) <= PhaseLock::LOCK_TOLERANCE_US);
+    uint32_t expected_locked_outputs = lockable? locked_pins: 0;
+    uint32_t locked_outputs = 0; // After the last reference edge.
+    std::vector<input_event_t> inputs;
+    for (const reference_edge_t& reference: references)
+    {
+        inputs.push_back({reference.process_us,
+                          [&, reference](uint32_t start_time_us)
+        {
+            scheduler.lock_phase(1u << REFERENCE_PIN, 0,
+                                 start_time_us + reference.time_us);
+            scheduler.check_phase_locks();
+            locked_outputs = scheduler.locked_outputs();
+        }});
+    }
+    bool ok = run_and_restart(start_time_us, horizon_us, inputs,
+        [&](std::vector<std::vector<edge_t>> edges, const char* run)
+    {
+        bool on_grid = true;
+        auto fail = [&](size_t ch, size_t i, const char* why)
+        {
+            printf("%s: channel %zu edge %zu: %s\r\n", run, ch, i, why);
+            on_grid = false;
+        };
+        for (size_t ch = 0; on_grid && (ch < schedule.size()); ++ch)
+        {
+            const pwm_settings_t& settings = schedule[ch];
+            const std::vector<edge_t>& actual = edges[ch];
+            std::vector<edge_t> expected = model_edges(settings, horizon_us);
+            if (!locks[ch].mode)
+            {
+                if (actual != expected)
+                    fail(ch, 0, "unlocked channel differs from the model");
+                continue;
+            }
+            uint32_t grid_period_us = 0; // Tracked period of the grid.
+            size_t reference = 0;
+            uint32_t last_rise_us = 0;
+            for (size_t i = 0; on_grid && (i < actual.size()); ++i)
+            {
+                const edge_t& edge = actual[i];
+                if ((i > 0) && (actual[i - 1].time_us == edge.time_us))
+                    fail(ch, i, "zero-width pulse");
+                size_t applied = 0;
+                while ((applied < references.size())
+                       && (references[applied].process_us < edge.time_us))
+                    ++applied;
+                if (applied == 0)
+                {
+                    if ((i >= expected.size()) || (expected[i] != edge))
+                        fail(ch, i, "differs from the model before the lock");
+                    continue;
+                }
+                bool rise = (edge.level != bool(settings.invert));
+                uint32_t anchor_us = references[applied - 1].time_us
+                                     + locks[ch].delay_us;
+                if (!track)
+                {
+                    uint32_t cycle_us = edge.time_us - anchor_us
+                                        - (rise? 0: settings.on_duration_us);
+                    if (int32_t(cycle_us) % int32_t(period_us) != 0)
+                        fail(ch, i, "off the reference grid");
+                    continue;
+                }
+                // A tracking grid's period is the spacing of its rises.
+                if (!rise)
+                    continue;
+                if (applied != reference)
+                {
+                    reference = applied;
+                    grid_period_us = 0;
+                }
+                else if (grid_period_us == 0)
+                    grid_period_us = edge.time_us - last_rise_us;
+                last_rise_us = edge.time_us;
+                if (grid_period_us
+                    && (int32_t(edge.time_us - anchor_us)
+                        % int32_t(grid_period_us) != 0))
+                    fail(ch, i, "off the tracking grid");
+                // The loop has converged well before the end.
+                int32_t target_error_us = int32_t(ratio * grid_period_us)
+                                          - int32_t(reference_period_us);
+                if (grid_period_us
+                    && (applied > PHASE_LOCK_REFERENCE_EDGES / 2)
+                    && (std::abs(target_error_us) > int32_t(ratio)))
+                    fail(ch, i, "tracked period did not converge");
+            }
+            if (on_grid
+                && (actual.empty() || (actual.back().time_us
+                                       <= references.back().process_us)))
+                fail(ch, actual.size(),
+                     "stalled after the last reference edge");
+        }
+        if (on_grid && (locked_outputs != expected_locked_outputs))
+        {
+            printf("%s: locked outputs: 0x%x, expected 0x%x\r\n", run,
+                   locked_outputs, expected_locked_outputs);
+            on_grid = false;
+        }
+        return on_grid;
+    },
+    [&]()
+    {
+        locked_outputs = 0;
+    });
+    if (!ok)
+    {
+        printf("  upload: %s | %s | reference period: %u[us] | ratio: %u\r\n",
+               sync? "sync": "direct", track? "track": "anchor",
+               reference_period_us, ratio);
+        print_schedule(schedule, 0, start_time_us);
+        for (const pwm_phase_lock_settings_t& l: locks)
+            printf("  lock ch%u: mode %u, delay %u[us]\r\n", l.channel, l.mode,
+                   l.delay_us);
+        printf("  first reference edge: %u[us]\r\n", references[0].time_us);
+    }
+    return ok;
+}
+
+/**
+ * \brief edges of a channel's pad in [0, horizon_us) when \p overlays
+ *  combine (in order) with its own train \p settings.
+ */
+std::vector<edge_t> model_overlaid_edges(
+    const pwm_settings_t& settings,
+    const std::vector<pwm_overlay_settings_t>& overlays, uint64_t horizon_us)
+{
+    // Uninverted levels of every train. The pad inverts the combination.
+    std::vector<std::vector<edge_t>> trains;
+    pwm_settings_t train = settings;
+    train.invert = 0;
+    trains.push_back(model_edges(train, horizon_us));
+    for (const pwm_overlay_settings_t& overlay: overlays)
+    {
+        train = {overlay.offset_us, overlay.on_duration_us,
+                 overlay.off_duration_us, overlay.cycles, 0};
+        trains.push_back(model_edges(train, horizon_us));
+    }
+    std::vector<uint32_t> times;
+    for (const std::vector<edge_t>& edges: trains)
+    {
+        for (const edge_t& edge: edges)
+            times.push_back(edge.time_us);
+    }
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    std::vector<edge_t> edges;
+    std::vector<size_t> next_edge(trains.size(), 0);
+    std::vector<bool> levels(trains.size(), false);
+    bool pad = settings.invert;
+    for (uint32_t time_us: times)
+    {
+        for (size_t i = 0; i < trains.size(); ++i)
+        {
+            while ((next_edge[i] < trains[i].size())
+                   && (trains[i][next_edge[i]].time_us <= time_us))
+                levels[i] = trains[i][next_edge[i]++].level;
+        }
+        bool level = levels[0];
+        for (size_t i = 1; i < trains.size(); ++i)
+        {
+            switch (combine_op_t(overlays[i - 1].combine))
+            {
+                case combine_op_t::OR: level = level || levels[i]; break;
+                case combine_op_t::AND: level = level && levels[i]; break;
+                default: level = (level != levels[i]); break;
+            }
+        }
+        bool new_pad = (level != bool(settings.invert));
+        if (new_pad != pad)
+            edges.push_back({time_us, new_pad});
+        pad = new_pad;
+    }
+    return edges;
+}
+
+/**
+ * \brief generate, run, and check an overlaid schedule for one seed.
+ * \details Overlays are uploaded directly, or through sync_schedule() along
+ *  with an extra overlay that is removed again before the run.
+ */
+bool check_overlaid_seed(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    auto uniform = [&](uint32_t lo, uint32_t hi)
+        {return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);};
+    std::vector<pwm_settings_t> schedule = random_schedule(rng);
+    // Overlays share the time unit of the schedule's first channel so that
+    // their edges coincide with its edges.
+    uint32_t unit_us = std::max(1u, std::min({schedule[0].on_duration_us,
+                                              schedule[0].off_duration_us}));
+    std::vector<std::vector<pwm_overlay_settings_t>> overlays(schedule.size());
+    std::vector<pwm_overlay_settings_t> added; // In upload order.
+    size_t num_overlays = uniform(1, PWM_OVERLAY_TASKS - 1);
+    for (size_t i = 0; i < num_overlays; ++i)
+    {
+        pwm_overlay_settings_t overlay{};
+        overlay.channel = uniform(0, schedule.size() - 1);
+        overlay.overlay = overlays[overlay.channel].size();
+        overlay.combine = uniform(1, 3);
+        overlay.offset_us = (uniform(0, 2) == 0)? 0: unit_us * uniform(0, 30);
+        overlay.on_duration_us = unit_us * uniform(1, 40);
+        overlay.off_duration_us = unit_us * uniform(1, 40);
+        overlay.cycles = (uniform(0, 2) == 0)? 0: uniform(1, 10);
+        overlays[overlay.channel].push_back(overlay);
+        added.push_back(overlay);
+    }
+    uint32_t horizon_us = 1;
+    for (const pwm_settings_t& settings: schedule)
+    {
+        uint32_t cycles = settings.cycles? settings.cycles
+                                         : MAX_EDGES_PER_CHANNEL / 2;
+        horizon_us = std::max(horizon_us, settings.offset_us
+                                          + cycles * settings.period_us() + 1);
+    }
+    uint32_t start_time_us = uniform(0, UINT32_MAX);
+    bool sync = uniform(0, 1);
+    scheduler.reset();
+    if (sync)
+    {
+        sync_settings(schedule, 0);
+        // Remove an overlay from somewhere in the middle of the tasks.
+        pwm_overlay_settings_t extra = added[0];
+        extra.overlay = PWM_OVERLAY_TASKS - 1;
+        size_t position = uniform(0, added.size());
+        for (size_t i = 0; i <= added.size(); ++i)
+        {
+            const pwm_overlay_settings_t& overlay =
+                (i == position)? extra: added[i - (i > position)];
+            pwm_specs_core_msg_t msg(PIN_BASE + overlay.channel, overlay);
+            queue_try_add(&pwm_settings_queue, &msg);
+            sync_schedule();
+        }
+        extra.combine = uint8_t(combine_op_t::NONE);
+        pwm_specs_core_msg_t msg(PIN_BASE + extra.channel, extra);
+        queue_try_add(&pwm_settings_queue, &msg);
+        sync_schedule();
+    }
+    else
+    {
+        upload(schedule, 0, upload_t::DIRECT);
+        for (const pwm_overlay_settings_t& overlay: added)
+        {
+            pwm_specs_core_msg_t msg(PIN_BASE + overlay.channel, overlay);
+            pwm_task_spec_t spec;
+            msg.to_task_spec(spec);
+            scheduler.schedule_pwm_task(spec);
+        }
+    }
+    bool ok = run_and_restart(start_time_us, horizon_us, {},
+        [&](std::vector<std::vector<edge_t>> edges, const char* run)
+    {
+        return edges_match(schedule, edges, [&](size_t ch)
+        {
+            return model_overlaid_edges(schedule[ch], overlays[ch],
+                                        horizon_us);
+        }, run);
+    });
+    if (!ok)
+    {
+        printf("  upload: %s\r\n", sync? "sync": "direct");
+        print_schedule(schedule, 0, start_time_us);
+        for (const pwm_overlay_settings_t& o: added)
+            printf("  overlay ch%u.%u: combine %u, {%u, %u, %u, %u}\r\n",
+                   o.channel, o.overlay, o.combine, o.offset_us,
+                   o.on_duration_us, o.off_duration_us, o.cycles);
+    }
+    return ok;
+}
+
+/**
+ * \brief generate, run, and check the schedule for one seed.
+ */
+bool check_seed(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<pwm_settings_t> schedule = random_schedule(rng);
+    uint32_t tolerance_us = 0;
+    if (std::uniform_int_distribution<uint32_t>(0, 3)(rng) == 0)
+        tolerance_us = std::uniform_int_distribution<uint32_t>(1, 20)(rng);
+    uint32_t start_time_us = std::uniform_int_distribution<uint32_t>()(rng);
+    if (rng() & 1) // Wrap the 32-bit timer during the schedule.
+        start_time_us = 0u - std::uniform_int_distribution<uint32_t>(0, 5000)(rng);
+    // Endless trains run for a fixed number of their edges.
+    uint32_t horizon_us = 0;
+    bool endless = false;
+    for (const pwm_settings_t& settings: schedule)
+    {
+        uint32_t cycles = settings.cycles? settings.cycles
+                                         : MAX_EDGES_PER_CHANNEL / 2;
+        endless |= (settings.cycles == 0);
+        horizon_us = std::max(horizon_us, settings.offset_us
+                                          + cycles * settings.period_us() + 1);
+    }
+    if (!endless)
+        horizon_us = UINT32_MAX; // Run until finished.
+
+    upload_t method = upload_t(std::uniform_int_distribution<uint32_t>(0, 2)(rng));
+    upload(schedule, tolerance_us, method);
+    std::vector<std::vector<edge_t>> first_run;
+    bool ok = run_and_restart(start_time_us, horizon_us, {},
+        [&](std::vector<std::vector<edge_t>> edges, const char* run)
+    {
+        if (first_run.empty())
+        {
+            first_run = std::move(edges);
+            return check_edges(schedule, first_run, horizon_us, tolerance_us,
+                               run);
+        }
+        if (edges == first_run)
+            return true;
+        printf("%s: edges differ from the first run\r\n", run);
+        return false;
+    });
+    // Every channel with the same timing as an earlier one is coalesced.
+    size_t coalesced = 0;
+    for (size_t i = 0; i < schedule.size(); ++i)
+    {
+        const pwm_settings_t& a = schedule[i];
+        for (size_t j = 0; j < i; ++j)
+        {
+            const pwm_settings_t& b = schedule[j];
+            if ((a.offset_us == b.offset_us)
+                && (a.on_duration_us == b.on_duration_us)
+                && (a.off_duration_us == b.off_duration_us)
+                && (a.cycles == b.cycles))
+            {
+                ++coalesced;
+                break;
+            }
+        }
+    }
+    if (ok && (size_t(__builtin_popcount(started_coalesced_outputs))
+               != coalesced))
+    {
+        printf("coalesced %d outputs, expected %zu\r\n",
+               __builtin_popcount(started_coalesced_outputs), coalesced);
+        ok = false;
+    }
+    if (!ok)
+    {
+        printf("  upload: %u\r\n", uint32_t(method));
+        print_schedule(schedule, tolerance_us, start_time_us);
+    }
+    return ok;
+}
+
+/**
+ * \brief resetting the scheduler releases its outputs: they are no longer
+ *  driven, and whatever drives them next is not inverted.
+ */
+bool check_release()
+{
+    uint32_t pin_mask = 1u << PIN_BASE;
+    scheduler.reset();
+    scheduler.schedule_pwm_task(0, 500, 1000, pin_mask, 0, true);
+    bool ok = (host_gpio_oe() & pin_mask) && (gpio_get_all() & pin_mask);
+    scheduler.reset();
+    ok = ok && !(host_gpio_oe() & pin_mask);
+    gpio_set_dir(PIN_BASE, true);
+    gpio_put(PIN_BASE, false);
+    ok = ok && !(gpio_get_all() & pin_mask);
+    gpio_set_dir(PIN_BASE, false);
+    if (!ok)
+        printf("FAIL: reset leaves an inverted output behind\r\n");
+    return ok;
+}
+
+/**
+ * \brief an ISR that is held up past the time of its next PortEvent still
+ *  writes it, rather than arming an alarm that has already passed.
+ */
+bool check_held_up_alarm()
+{
+    const uint32_t cycles = 4;
+    scheduler.reset();
+    scheduler.schedule_pwm_task(0, MIN_EDGE_SPACING_US,
+                                2 * MIN_EDGE_SPACING_US, 1u << PIN_BASE,
+                                cycles, false);
+    host_set_alarm_irq_latency_us(2 * MIN_EDGE_SPACING_US);
+    run(0, UINT32_MAX);
+    host_set_alarm_irq_latency_us(0);
+    // Edges written by the same ISR cancel out on the pad, so count writes.
+    if (logged_writes == 2 * cycles)
+        return true;
+    printf("held-up alarms: %zu writes, expected %u\r\n", logged_writes,
+           2 * cycles);
+    return false;
+}
+
+/**
+ * \brief random schedules of one feature and what they must do.
+ */
+struct property_t
+{
+    const char* schedules; /// e.g: "gated schedules".
+    const char* holds; /// e.g: "match the model".
+    bool (*check_seed)(uint32_t seed);
+    size_t share; /// runs num_schedules / share seeds.
+};
+
+const property_t PROPERTIES[] =
+{
+    {"schedules", "match the model", check_seed, 1},
+    {"gated schedules", "match the model", check_gated_seed, 4},
+    {"phase-locked schedules", "stay on the reference grid",
+     check_phase_locked_seed, 4},
+    {"overlaid schedules", "match the model", check_overlaid_seed, 4},
+};
+
+int main(int argc, char* argv[])
+{
+    size_t num_schedules = (argc > 1)? strtoul(argv[1], nullptr, 0)
+                                     : DEFAULT_NUM_SCHEDULES;
+    uint32_t first_seed = (argc > 2)? strtoul(argv[2], nullptr, 0): 0;
+    host_reset();
+    queue_init(&pwm_settings_queue, sizeof(pwm_specs_core_msg_t), NUM_GPIOS);
+    queue_init(&pwm_timing_queue, sizeof(pwm_timing_core_msg_t), NUM_GPIOS);
+    queue_init(&schedule_config_queue, sizeof(schedule_config_msg_t), 8);
+    queue_init(&schedule_error_queue, sizeof(uint8_t), 2);
+    queue_init(&schedule_slot_ack_queue, sizeof(bool), 1);
+    queue_init(&gate_event_queue, sizeof(gate_event_msg_t), 16);
+    queue_init(&reference_edge_queue, sizeof(reference_edge_msg_t), 8);
+    queue_init(&phase_lock_event_queue, sizeof(phase_lock_event_msg_t), 16);
+    queue_init(&trial_settings_queue, sizeof(pwm_trial_settings_t), 2);
+    queue_init(&trial_event_queue, sizeof(trial_event_msg_t), 16);
+    queue_init(&state_machine_program_queue,
+               sizeof(state_machine_program_msg_t), 1);
+    queue_init(&state_machine_event_queue, sizeof(state_machine_event_msg_t),
+               16);
+    for (const property_t& property: PROPERTIES)
+    {
+        size_t num_seeds = num_schedules / property.share;
+        size_t passed = 0;
+        for (size_t i = 0; i < num_seeds; ++i)
+        {
+            if (property.check_seed(first_seed + i))
+                ++passed;
+            else
+                printf("FAIL: %s seed %zu\r\n", property.schedules,
+                       first_seed + i);
+        }
+        char summary[96];
+        snprintf(summary, sizeof(summary), "%zu of %zu %s %s", passed,
+                 num_seeds, property.schedules, property.holds);
+        check(passed == num_seeds, summary);
+    }
+    check(check_release(), "reset releases the outputs");
+    check(check_held_up_alarm(), "held-up alarms still write their edges");
+    return report_failures();
+}
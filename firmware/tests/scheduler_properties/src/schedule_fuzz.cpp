@@ -0,0 +1,137 @@
+#include <app_sim.h>
+#include <cuttlefish_app.h>
+#include <pico_host.h>
+#include <cstdlib>
+
+// libFuzzer target for the settings path: Harp commands to the app registers,
+// their core0 handlers, the inter-core queues, and core1's sync_schedule(),
+// admission control, and scheduler, all in virtual time. The input is a
+// script of commands, each starting with an opcode byte:
+//   0: write a register: address byte, then the register's payload bytes.
+//   1: read a register: address byte.
+//   2: let time pass: 2 bytes [us] (capped).
+//   3: reset the app.
+//   4: run the schedule: start it, let time pass as in 2, and stop it.
+// Besides the sanitizers, every command must get exactly one reply for its
+// register.
+
+inline constexpr uint32_t MAX_IDLE_US = 20000;
+inline constexpr uint32_t MAX_REPLY_DELAY_US = SCHEDULE_SLOT_TIMEOUT_US;
+
+namespace
+{
+size_t input_offset;
+const uint8_t* input_data;
+size_t input_size;
+
+uint8_t next_byte()
+{return (input_offset < input_size)? input_data[input_offset++]: 0;}
+
+uint8_t next_address()
+{return Harp::APP_REG_START_ADDRESS + next_byte() % APP_REG_COUNT;}
+
+void idle()
+{
+    uint32_t idle_us = next_byte() | (uint32_t(next_byte()) << 8);
+    sim_run_for_us(idle_us % MAX_IDLE_US);
+    host_harp_frames.clear();
+}
+
+/**
+ * \brief number of replies since \p first_frame. Aborts on a reply that is
+ *  not of \p frame's type or its error, or not from its register.
+ */
+size_t replies_to(const std::vector<uint8_t>& frame, size_t first_frame)
+{
+    size_t replies = 0;
+    for (size_t i = first_frame; i < host_harp_frames.size(); ++i)
+    {
+        const std::vector<uint8_t>& reply = host_harp_frames[i];
+        if (reply[0] == EVENT)
+            continue;
+        if ((reply[2] != frame[2]) || ((reply[0] & ~0x08) != frame[0]))
+            abort();
+        ++replies;
+    }
+    return replies;
+}
+
+/**
+ * \brief dispatch a command and check that it got one reply, of the command's
+ *  type or its error.
+ */
+void send(std::vector<uint8_t> frame)
+{
+    size_t first_frame = host_harp_frames.size();
+    sim_enable_idle_hook(true);
+    app.dispatch(frame.data());
+    sim_enable_idle_hook(false);
+    app.update();
+    // Slot writes are answered once core1 has acted on them, and a slot that
+    // is also started waits for core1 again.
+    for (uint32_t t = 0; (t < MAX_REPLY_DELAY_US)
+                         && !replies_to(frame, first_frame); ++t)
+    {
+        sim_step_core1();
+        sim_enable_idle_hook(true);
+        app.update();
+        sim_enable_idle_hook(false);
+    }
+    if (replies_to(frame, first_frame) != 1)
+        abort();
+    host_harp_frames.clear();
+}
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    input_data = data;
+    input_size = size;
+    input_offset = 0;
+    sim_setup();
+    while (input_offset < input_size)
+    {
+        switch (next_byte() % 5)
+        {
+            case 0:
+            {
+                uint8_t address = next_address();
+                const RegSpec& spec = Harp::reg_address_to_spec(address);
+                uint8_t payload[UINT8_MAX];
+                for (size_t i = 0; i < spec.num_bytes; ++i)
+                    payload[i] = next_byte();
+                send(host_harp_frame(WRITE, address, spec.payload_type,
+                                     payload, spec.num_bytes));
+                break;
+            }
+            case 1:
+            {
+                uint8_t address = next_address();
+                const RegSpec& spec = Harp::reg_address_to_spec(address);
+                send(host_harp_frame(READ, address, spec.payload_type,
+                                     nullptr, 0));
+                break;
+            }
+            case 2:
+                idle();
+                break;
+            case 3:
+                app.reset();
+                host_harp_frames.clear();
+                break;
+            case 4:
+            {
+                uint8_t pwm_state = 1;
+                send(host_harp_frame(WRITE, PWM_STATE_ADDRESS, U8, &pwm_state,
+                                     sizeof(pwm_state)));
+                idle();
+                pwm_state = 0;
+                send(host_harp_frame(WRITE, PWM_STATE_ADDRESS, U8, &pwm_state,
+                                     sizeof(pwm_state)));
+                break;
+            }
+        }
+    }
+    return 0;
+}
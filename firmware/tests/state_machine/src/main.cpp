@@ -0,0 +1,269 @@
+#include <trial_state_machine.h>
+#include <host_test.h>
+#include <vector>
+#include <cstdio>
+
+// Host test of TrialStateMachine in virtual time. A rig steps the machine
+// every microsecond, like core1's loop, applies the entry actions of the
+// states it enters, and plays a stand-in PWM schedule of fixed length.
+
+inline constexpr size_t MAX_STATES = 12;
+using StateMachine = TrialStateMachine<MAX_STATES>;
+inline constexpr uint8_t END = StateMachine::END;
+
+// Channels of the behavioral task.
+inline constexpr uint8_t POKE = 0;
+inline constexpr uint8_t LICK = 1;
+inline constexpr uint8_t REWARD = 4;
+inline constexpr uint32_t CUE_US = 100'000;
+inline constexpr uint32_t WINDOW_US = 500'000;
+inline constexpr uint32_t REWARD_US = 50'000;
+inline constexpr uint32_t PENALTY_US = 2'000'000;
+
+struct logged_event_t
+{
+    sm_event_t event;
+    uint32_t time_us;
+};
+
+/**
+ * \brief the machine, its pins, and a PWM schedule that runs for CUE_US once
+ *  started.
+ */
+struct Rig
+{
+    StateMachine machine;
+    uint32_t time_us = 0;
+    uint32_t inputs = 0;
+    uint32_t outputs = 0;
+    bool schedule_running = false;
+    uint32_t schedule_end_us = 0;
+    size_t schedule_starts = 0;
+    std::vector<logged_event_t> events;
+
+    void start()
+    {
+        sm_event_t event;
+        if (machine.start(time_us, inputs, event))
+            apply(event);
+    }
+
+    void stop()
+    {
+        sm_event_t event;
+        if (machine.stop(event))
+            apply(event);
+    }
+
+/**
+ * \brief one pass of core1's loop, then 1us.
+ */
+    void step()
+    {
+        if (schedule_running && (int32_t(time_us - schedule_end_us) >= 0))
+            schedule_running = false;
+        sm_event_t event;
+        if (machine.update(time_us, inputs, schedule_running, event))
+            apply(event);
+        ++time_us;
+    }
+
+    void run_for_us(uint32_t duration_us)
+    {
+        for (uint32_t i = 0; i < duration_us; ++i)
+            step();
+    }
+
+    void apply(const sm_event_t& event)
+    {
+        events.push_back({event, time_us});
+        if (!machine.running())
+            return;
+        const sm_state_t& state = machine.current();
+        outputs = (outputs & ~state.clear_channels) | state.set_channels;
+        if (state.schedule == StateMachine::SCHEDULE_STOP)
+            schedule_running = false;
+        if (state.schedule == StateMachine::SCHEDULE_START)
+        {
+            schedule_running = true;
+            schedule_end_us = time_us + CUE_US;
+            ++schedule_starts;
+        }
+    }
+
+    void set_input(uint8_t channel, bool level)
+    {
+        inputs = level? (inputs | (1u << channel)): (inputs & ~(1u << channel));
+    }
+
+    bool output(uint8_t channel) const
+    {return (outputs >> channel) & 1u;}
+
+    const logged_event_t& last_event() const
+    {return events.back();}
+};
+
+sm_transition_t on(sm_condition_t condition, uint8_t channel, uint8_t next)
+{return {uint8_t(condition), channel, next};}
+
+/**
+ * \brief wait for a nose poke, play a cue, then reward a lick within the
+ *  response window or time out.
+ */
+std::vector<sm_state_t> lick_task()
+{
+    using enum sm_condition_t;
+    return {
+        // 0: wait for a poke.
+        {0, 0, 0, 0, END, {on(RISING, POKE, 1), {}}},
+        // 1: cue.
+        {0, 0, StateMachine::SCHEDULE_START, 0, END,
+         {on(SCHEDULE_DONE, 0, 2), {}}},
+        // 2: response window.
+        {0, 0, 0, WINDOW_US, 4, {on(RISING, LICK, 3), {}}},
+        // 3: reward.
+        {1u << REWARD, 0, 0, REWARD_US, 5, {}},
+        // 4: penalty.
+        {0, 0, 0, PENALTY_US, END, {}},
+        // 5: reward off.
+        {0, 1u << REWARD, 0, 0, END, {on(SCHEDULE_DONE, 0, END), {}}},
+    };
+}
+
+int main()
+{
+    std::vector<sm_state_t> program = lick_task();
+    {
+        Rig rig;
+        rig.machine.load(program.data(), program.size());
+        rig.start();
+        check(rig.machine.running() && (rig.machine.state() == 0)
+              && (rig.last_event().event.cause == uint8_t(sm_cause_t::START)),
+              "start enters state 0");
+        rig.run_for_us(10'000);
+        check(rig.machine.state() == 0, "a state waits for its transition");
+        rig.set_input(POKE, true);
+        uint32_t poke_us = rig.time_us;
+        rig.run_for_us(10);
+        check((rig.machine.state() == 1) && (rig.schedule_starts == 1)
+              && (rig.events[1].time_us == poke_us),
+              "a poke starts the cue within one pass");
+        // Licks during the cue do not count, and neither does holding the
+        // lick sensor into the window.
+        rig.set_input(LICK, true);
+        rig.run_for_us(CUE_US);
+        check(rig.machine.state() == 2, "the end of the cue opens the window");
+        rig.run_for_us(1000);
+        check(rig.machine.state() == 2,
+              "edges from before a state was entered do not count");
+        rig.set_input(LICK, false);
+        rig.run_for_us(200'000);
+        rig.set_input(LICK, true);
+        uint32_t lick_us = rig.time_us;
+        rig.run_for_us(1);
+        check(rig.output(REWARD) && (rig.machine.state() == 3)
+              && (rig.last_event().time_us == lick_us)
+              && (rig.last_event().event.cause
+                  == uint8_t(sm_cause_t::TRANSITION_0)),
+              "a lick in the window drives the reward within one pass");
+        rig.run_for_us(REWARD_US - 1);
+        check(rig.output(REWARD), "the reward lasts its timeout");
+        rig.run_for_us(2);
+        check(!rig.output(REWARD) && !rig.machine.running()
+              && (rig.last_event().event.state == END)
+              && (rig.last_event().event.previous == 5),
+              "the reward turns off and the program ends");
+        check(rig.events.size() == 6, "every transition is reported once");
+    }
+    {
+        Rig rig;
+        rig.machine.load(program.data(), program.size());
+        rig.start();
+        rig.set_input(POKE, true);
+        rig.run_for_us(CUE_US + 10);
+        uint32_t window_us = rig.last_event().time_us;
+        rig.run_for_us(WINDOW_US + 10);
+        check((rig.machine.state() == 4)
+              && (rig.last_event().time_us - window_us == WINDOW_US)
+              && (rig.last_event().event.cause
+                  == uint8_t(sm_cause_t::TIMEOUT)),
+              "no lick times out exactly at the end of the window");
+        rig.run_for_us(PENALTY_US);
+        check(!rig.machine.running() && !rig.output(REWARD),
+              "the penalty ends the program");
+    }
+    {
+        // States that leave immediately take one pass each.
+        using enum sm_condition_t;
+        std::vector<sm_state_t> chain = {
+            {0, 0, 0, 0, END, {on(SCHEDULE_DONE, 0, 1), {}}},
+            {0, 0, 0, 0, END, {on(SCHEDULE_DONE, 0, 2), {}}},
+            {0, 0, 0, 0, END, {on(SCHEDULE_DONE, 0, 0), {}}},
+        };
+        Rig rig;
+        rig.machine.load(chain.data(), chain.size());
+        rig.start();
+        rig.run_for_us(300);
+        bool one_per_pass = (rig.events.size() == 301);
+        for (size_t i = 1; one_per_pass && (i < rig.events.size()); ++i)
+            one_per_pass = (rig.events[i].time_us == i - 1)
+                           && (rig.events[i].event.state == i % 3);
+        check(one_per_pass, "at most one transition per update");
+        rig.stop();
+        check(!rig.machine.running()
+              && (rig.last_event().event.cause == uint8_t(sm_cause_t::STOP))
+              && (rig.last_event().event.state == END),
+              "stopping reports the state it stopped in");
+    }
+    {
+        // The second transition, and timeouts across the timer's wrap.
+        using enum sm_condition_t;
+        std::vector<sm_state_t> choice = {
+            {0, 0, 0, 1000, 1, {on(FALLING, 2, 2), on(RISING, 3, 3)}},
+            {0, 0, 0, 0, END, {}},
+            {0, 0, 0, 0, END, {}},
+            {0, 0, 0, 0, END, {}},
+        };
+        Rig rig;
+        rig.time_us = 0xFFFFFF00;
+        rig.machine.load(choice.data(), choice.size());
+        rig.start();
+        rig.run_for_us(1000);
+        check(rig.machine.state() == 0, "timeouts do not fire early on a wrap");
+        rig.run_for_us(1);
+        check(rig.machine.state() == 1, "timeouts fire on time on a wrap");
+        rig.stop();
+        rig.set_input(2, true);
+        rig.start();
+        rig.set_input(3, true);
+        rig.run_for_us(1);
+        check((rig.machine.state() == 3)
+              && (rig.last_event().event.cause
+                  == uint8_t(sm_cause_t::TRANSITION_1)),
+              "the second transition is taken on its own edge");
+        rig.stop();
+        rig.set_input(3, false);
+        rig.start();
+        rig.set_input(2, false);
+        rig.set_input(3, true);
+        rig.run_for_us(1);
+        check(rig.machine.state() == 2,
+              "the first transition wins and falling edges count");
+    }
+    {
+        StateMachine machine;
+        sm_event_t event;
+        check(!machine.start(0, 0, event) && !machine.running(),
+              "no program, no start");
+        std::vector<sm_state_t> program = lick_task();
+        machine.load(program.data(), program.size());
+        // A transition that leaves the program ends it.
+        program[0].transitions[0].next = 9;
+        machine.load(program.data(), 1);
+        machine.start(0, 0, event);
+        check(machine.update(1, 1u << POKE, false, event)
+              && (event.state == END) && !machine.running(),
+              "a transition past the program ends it");
+    }
+    return report_failures();
+}
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Fail the build if a timing-critical symbol was linked into flash.
+
+Reads the GNU ld map file of the firmware and checks that every function and
+object on core1's and the interrupts' hot paths has an SRAM address, and that
+core1's own state sits in its scratch bank. Functions that the compiler
+inlined or discarded do not appear in the map and are skipped, unless they
+can only be missing from a broken build or map file. Their names are
+matched in both their mangled and demangled form, so this works whether or not
+the linker demangled the map.
+
+Usage: check_ram_placement.py <firmware.elf.map>
+"""
+import re
+import sys
+
+FLASH = (0x10000000, 0x11000000)  # XIP
+SRAM = (0x20000000, 0x20042000)   # Striped banks 0-3 and scratch banks 4, 5.
+SCRATCH_X = (0x20040000, 0x20041000)  # SRAM4: core1's stack and state.
+
+# Hot code: must not execute from flash. Each entry is (function, always
+# linked). Functions that are always linked have their address taken (core1's
+# entry point and the interrupt handlers) or are called from another
+# translation unit, so the compiler cannot inline them away.
+HOT_CODE = [
+    # core1 main loop.
+    ("core1_main", True),
+    ("run_task_loop", False),
+    ("start_schedule", False),
+    ("run_state_machine", False),
+    ("TrialStateMachine::update", False),
+    ("PWMScheduler::update", False),
+    ("PWMScheduler::update_gates", False),
+    ("PWMScheduler::lock_phase", False),
+    ("PWMScheduler::check_phase_locks", False),
+    ("PWMScheduler::trim_checkpoints", False),
+    ("PWMScheduler::rewind", False),
+    ("PWMScheduler::queue_runnable_tasks", False),
+    ("PWMTask::update", True),
+    ("PWMTask::set_gate_override", True),
+    ("RandomInterval::next", True),
+    ("RandomInterval::neg_log_q16", False),
+    ("PeriodRamp::advance", True),
+    ("PeriodRamp::set_cycle_times", False),
+    ("PioOutput::push", True),
+    ("PioOutput::fill_ring", False),
+    ("PioOutput::service", True),
+    ("PioOutput::idle", True),
+    ("queue_try_add", True),
+    ("queue_try_remove", True),
+    # Priority queue heap operations that etl leaves out of line.
+    ("std::__adjust_heap", False),
+    ("std::__push_heap", False),
+    # Interrupts: the scheduler's alarm (core1) and GPIO edges (core0).
+    ("PWMScheduler::set_new_ttl_pin_state", True),
+    ("handle_edge_event_callback", True),
+    ("time_us_64", True),
+]
+
+# Hot data that only core1 touches: must sit in its scratch bank. Each entry
+# is (variable, __scratch_x section name, always linked). These are plain
+# globals, so the map lists them unmangled and they are matched exactly.
+# The scheduler is not listed: it does not fit in the 4KB bank next to core1's
+# stack, and its ISR data are template statics, whose section attributes GCC
+# ignores.
+CORE1_DATA = [
+    ("state", "core1_next_state", True),
+    ("schedule_failed", "schedule_failed", True),
+    ("trial_repeat", "trial_repeat", True),
+    ("isr_latency_probe", "isr_latency_probe", False),  # PROFILE_CPU only.
+]
+
+
+def demangled_pattern(name):
+    """Regex for `name` as a demangled symbol or a section name suffix."""
+    parts = [re.escape(part) for part in name.split("::")]
+    template_args = r"(?:<[^()]*>)?"
+    return re.compile(r"(?:^|[\s.*&(])" + (template_args + "::").join(parts)
+                      + template_args + r"(?:\(|$)")
+
+
+def mangled_pattern(name):
+    """Regex for `name` inside an Itanium-mangled symbol or section name."""
+    parts = name.split("::")
+    if parts[0] == "std":
+        prefix = "St"
+        parts = parts[1:]
+    else:
+        prefix = ""
+    nested = len(parts) > 1
+    encoded = "".join(f"{len(part)}{re.escape(part)}(?:I.*?E)?"
+                      for part in parts)
+    return re.compile(r"_ZN?K?" + prefix + encoded
+                      + ("E" if nested else r"(?:I.*?E)?[a-zA-Z]"))
+
+
+def read_symbols(map_path):
+    """(address, name) of every symbol and input section in the memory map."""
+    symbols = []
+    in_memory_map = False
+    section = None  # Input section name waiting for its address line.
+    with open(map_path) as map_file:
+        for line in map_file:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            # Input section: " .name 0xaddr 0xsize object", and names too
+            # long for their column get their own line.
+            match = re.match(r"^ (\.\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x[0-9a-fA-F]+"
+                             r"\s+\S.*)?$", line)
+            if match:
+                section = match.group(1)
+                if match.group(2):
+                    symbols.append((int(match.group(2), 16), section))
+                    section = None
+                continue
+            match = re.match(r"^\s+0x([0-9a-fA-F]+)\s+0x[0-9a-fA-F]+\s+\S", line)
+            if match and section:
+                symbols.append((int(match.group(1), 16), section))
+                section = None
+                continue
+            section = None
+            # Symbol: "                0xaddr                name"
+            match = re.match(r"^\s+0x([0-9a-fA-F]+)\s+(\S.*)$", line)
+            if match and ("=" not in match.group(2)) \
+                    and not match.group(2).startswith("0x") \
+                    and not match.group(2).startswith("PROVIDE"):
+                symbols.append((int(match.group(1), 16), match.group(2)))
+    return symbols
+
+
+def find(symbols, name):
+    """Matches of `name`, once per address (a section and its symbol share
+    theirs)."""
+    patterns = (demangled_pattern(name), mangled_pattern(name))
+    matches = {}
+    for address, symbol in symbols:
+        if any(pattern.search(symbol) for pattern in patterns):
+            matches.setdefault(address, symbol)
+    return sorted(matches.items())
+
+
+def find_exact(symbols, name, section):
+    """Matches of global variable `name` or of its `.scratch_x.section`."""
+    matches = {}
+    for address, symbol in symbols:
+        if symbol in (name, f".scratch_x.{section}"):
+            matches.setdefault(address, symbol)
+    return sorted(matches.items())
+
+
+def main(map_path):
+    symbols = read_symbols(map_path)
+    errors = []
+    checked = 0
+    for name, required in HOT_CODE:
+        matches = find(symbols, name)
+        if required and not matches:
+            errors.append(f"{name} is missing from {map_path}")
+        for address, symbol in matches:
+            checked += 1
+            if FLASH[0] <= address < FLASH[1]:
+                errors.append(f"{name} is in flash: {symbol} @ 0x{address:08x}")
+            elif not (SRAM[0] <= address < SRAM[1]):
+                errors.append(f"{name} is not in SRAM: {symbol} "
+                              f"@ 0x{address:08x}")
+    for name, section, required in CORE1_DATA:
+        matches = find_exact(symbols, name, section)
+        if required and not matches:
+            errors.append(f"{name} is missing from {map_path}")
+        for address, symbol in matches:
+            checked += 1
+            if not (SCRATCH_X[0] <= address < SCRATCH_X[1]):
+                errors.append(f"{name} is not in scratch_x: {symbol} "
+                              f"@ 0x{address:08x}")
+    if checked == 0:
+        errors.append(f"no hot symbols found in {map_path}. Is it a map file?")
+    for error in errors:
+        print(f"RAM placement error: {error}", file=sys.stderr)
+    if errors:
+        return 1
+    print(f"RAM placement: {checked} hot symbols and sections are in SRAM.")
+    return 0
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print(__doc__, file=sys.stderr)
+        sys.exit(2)
+    sys.exit(main(sys.argv[1]))
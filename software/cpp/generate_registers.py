@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Generate the typed register table of the C++ host client from device.yml.
+
+Every app register becomes a struct in namespace cuttlefish::regs that holds
+its address, payload type, length and access, so that Client::write<R>() and
+Client::read<R>() encode and decode the right payload at compile time. Bit
+masks become enums.
+
+Usage: generate_registers.py <device.yml> <registers.h>
+"""
+import sys
+import textwrap
+
+import yaml
+
+PAYLOAD_TYPES = {
+    # Harp type: (C++ element type, PayloadType).
+    "U8": ("uint8_t", "U8"),
+    "S8": ("int8_t", "S8"),
+    "U16": ("uint16_t", "U16"),
+    "S16": ("int16_t", "S16"),
+    "U32": ("uint32_t", "U32"),
+    "S32": ("int32_t", "S32"),
+    "U64": ("uint64_t", "U64"),
+    "S64": ("int64_t", "S64"),
+    "Float": ("float", "Float"),
+}
+
+HEADER = """\
+// Generated from device.yml by generate_registers.py. Do not edit.
+#ifndef CUTTLEFISH_REGISTERS_H
+#define CUTTLEFISH_REGISTERS_H
+#include <cuttlefish/harp_frame.h>
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cuttlefish
+{{
+
+inline constexpr uint16_t WHO_AM_I = {who_am_i};
+inline constexpr const char DEVICE_NAME[] = "{device}";
+
+namespace regs
+{{
+"""
+
+FOOTER = """\
+/**
+ * \\brief an app register, for code that handles registers at run time.
+ */
+struct register_spec_t
+{{
+    const char* name;
+    uint8_t address;
+    PayloadType payload_type;
+    size_t length; /// elements.
+    bool writeable;
+    bool has_events;
+}};
+
+inline constexpr register_spec_t REGISTER_SPECS[] =
+{{
+{specs}
+}};
+
+/**
+ * \\brief the app register at \\p address, or nullptr if there is none.
+ */
+constexpr const register_spec_t* find_register(uint8_t address)
+{{
+    for (const register_spec_t& spec: REGISTER_SPECS)
+    {{
+        if (spec.address == address)
+            return &spec;
+    }}
+    return nullptr;
+}}
+
+}} // namespace cuttlefish
+
+#endif // CUTTLEFISH_REGISTERS_H
+"""
+
+
+def access_of(register):
+    access = register.get("access", [])
+    return [access] if isinstance(access, str) else access
+
+
+def register_struct(name, register):
+    element, payload_type = PAYLOAD_TYPES[register.get("type", "U8")]
+    length = register.get("length", 1)
+    access = access_of(register)
+    value = element if length == 1 else f"std::array<{element}, {length}>"
+    description = " ".join(register.get("description", "").split())
+    brief = textwrap.wrap(f"\\brief {description or name + '.'}", width=76,
+                          subsequent_indent=" ")
+    lines = ["/**"] + [f" * {line}" for line in brief] + [
+        " */",
+        f"struct {name}",
+        "{",
+        f"    static constexpr uint8_t address = {register['address']};",
+        f"    static constexpr PayloadType payload_type = PayloadType::{payload_type};",
+        f"    using element_type = {element};",
+        f"    static constexpr size_t length = {length};",
+        f"    using value_type = {value};",
+        f"    static constexpr bool writeable = {str('Write' in access).lower()};",
+        f"    static constexpr bool has_events = {str('Event' in access).lower()};",
+        "};",
+    ]
+    return "\n".join(lines)
+
+
+def spec_entry(name, register):
+    _, payload_type = PAYLOAD_TYPES[register.get("type", "U8")]
+    access = access_of(register)
+    return (f"    {{\"{name}\", {register['address']}, "
+            f"PayloadType::{payload_type}, {register.get('length', 1)}, "
+            f"{str('Write' in access).lower()}, "
+            f"{str('Event' in access).lower()}}},")
+
+
+def bit_mask_enum(name, mask):
+    lines = [f"enum class {name}: uint32_t", "{"]
+    for bit, value in mask["bits"].items():
+        lines.append(f"    {bit} = {value:#x},")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main(device_path, header_path):
+    with open(device_path) as file:
+        device = yaml.safe_load(file)
+    registers = device["registers"]
+    parts = [HEADER.format(who_am_i=device["whoAmI"], device=device["device"])]
+    parts.append("\n\n".join(register_struct(name, register)
+                             for name, register in registers.items()))
+    parts.append("\n\n} // namespace regs\n\n")
+    masks = device.get("bitMasks", {})
+    for name, mask in masks.items():
+        parts.append(bit_mask_enum(name, mask) + "\n\n")
+    specs = "\n".join(spec_entry(name, register)
+                      for name, register in registers.items())
+    parts.append(FOOTER.format(specs=specs))
+    with open(header_path, "w") as file:
+        file.write("".join(parts))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    main(sys.argv[1], sys.argv[2])
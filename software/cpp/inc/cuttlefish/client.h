@@ -0,0 +1,209 @@
+#ifndef CUTTLEFISH_CLIENT_H
+#define CUTTLEFISH_CLIENT_H
+#include <cuttlefish/frame_reader.h>
+#include <cuttlefish/harp_frame.h>
+#include <cuttlefish/registers.h>
+#include <cuttlefish/transport.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cuttlefish
+{
+
+inline constexpr int DEFAULT_TIMEOUT_MS = 1000;
+
+#pragma pack(push, 1)
+/**
+ * \brief payload of the PwmSettings registers.
+ */
+struct pwm_settings_t
+{
+    uint32_t offset_us;
+    uint32_t on_duration_us;
+    uint32_t off_duration_us;
+    uint32_t cycles; // 0 = forever.
+    uint8_t invert;
+};
+#pragma pack(pop)
+static_assert(sizeof(pwm_settings_t) == regs::PwmSettings0::length);
+
+/**
+ * \brief WRITE messages encoded back-to-back, to be sent in one transfer.
+ * \details Reuse a batch to encode without allocating.
+ */
+class WriteBatch
+{
+public:
+/**
+ * \brief queue a write of \p value to register \p R.
+ */
+    template <typename R>
+    void add(const typename R::value_type& value)
+    {
+        static_assert(R::writeable, "register is not writeable");
+        add(R::address, R::payload_type, &value, sizeof(value));
+    }
+
+/**
+ * \brief queue a write of \p values to register \p R, i.e: fewer than
+ *  R::length elements to a variable-length register.
+ */
+    template <typename R>
+    void add(std::span<const typename R::element_type> values)
+    {
+        static_assert(R::writeable, "register is not writeable");
+        add(R::address, R::payload_type, values.data(), values.size_bytes());
+    }
+
+/**
+ * \brief queue a write of the PWM settings of output \p channel.
+ */
+    void add_pwm_settings(size_t channel, const pwm_settings_t& settings)
+    {
+        add(uint8_t(regs::PwmSettings0::address + channel), PayloadType::U8,
+            &settings, sizeof(settings));
+    }
+
+    void add(uint8_t address, PayloadType payload_type, const void* payload,
+             size_t num_bytes)
+    {
+        encode_frame(bytes_, MessageType::WRITE, address, payload_type,
+                     payload, num_bytes);
+        ++messages_;
+    }
+
+    void clear()
+    {
+        bytes_.clear();
+        messages_ = 0;
+    }
+
+    std::span<const uint8_t> bytes() const
+    {return bytes_;}
+
+    size_t messages() const
+    {return messages_;}
+
+private:
+    std::vector<uint8_t> bytes_;
+    size_t messages_ = 0;
+};
+
+/**
+ * \brief typed access to the Cuttlefish's registers over a Transport.
+ * \details Reads and writes wait for their reply. Frames that arrive in the
+ *  meantime (i.e: EVENTs) go to the event handler, so none are lost. All
+ *  frames are decoded in place from one read buffer, so a FrameView passed to
+ *  a handler is only valid during the call.
+ */
+class Client
+{
+public:
+    using FrameHandler = std::function<void(const FrameView&)>;
+
+/**
+ * \param buffer_bytes size of the read buffer.
+ */
+    explicit Client(Transport& transport, size_t buffer_bytes = 1 << 20);
+
+/**
+ * \brief handle frames that are not the reply being waited for.
+ */
+    void set_event_handler(FrameHandler handler)
+    {event_handler_ = std::move(handler);}
+
+/**
+ * \brief write \p value to register \p R.
+ * \returns false on a WRITE_ERROR or on timeout.
+ */
+    template <typename R>
+    bool write(const typename R::value_type& value,
+               int timeout_ms = DEFAULT_TIMEOUT_MS)
+    {
+        batch_.clear();
+        batch_.add<R>(value);
+        return send(batch_, timeout_ms) == 1;
+    }
+
+/**
+ * \brief read register \p R.
+ * \returns nothing on a READ_ERROR or on timeout.
+ */
+    template <typename R>
+    std::optional<typename R::value_type> read(
+        int timeout_ms = DEFAULT_TIMEOUT_MS)
+    {
+        using value_type = typename R::value_type;
+        request_.clear();
+        encode_frame(request_, MessageType::READ, R::address, R::payload_type,
+                     nullptr, 0);
+        std::optional<value_type> value;
+        if (!transport_.write(request_))
+            return value;
+        wait_for_replies(R::address, 1, timeout_ms,
+            [&value](const FrameView& reply)
+            {
+                if (reply.is_error())
+                    return;
+                value_type decoded{};
+                std::span<const uint8_t> payload = reply.payload();
+                memcpy(&decoded, payload.data(),
+                       std::min(payload.size(), sizeof(decoded)));
+                value = decoded;
+            });
+        return value;
+    }
+
+/**
+ * \brief send the writes of \p batch in one transfer.
+ * \returns the number of writes that the device accepted.
+ */
+    size_t send(const WriteBatch& batch, int timeout_ms = DEFAULT_TIMEOUT_MS);
+
+/**
+ * \brief read what the device sent, waiting up to \p timeout_ms, and call
+ *  \p on_frame(const FrameView&) for each frame.
+ * \returns the number of frames.
+ */
+    template <typename F>
+    size_t poll(F&& on_frame, int timeout_ms = 0)
+    {
+        fill(timeout_ms);
+        return reader_.parse(on_frame);
+    }
+
+/**
+ * \brief bytes skipped to resynchronize on the device's stream.
+ */
+    uint64_t skipped_bytes() const
+    {return reader_.skipped_bytes();}
+
+private:
+    bool fill(int timeout_ms);
+
+    static constexpr int ANY_ADDRESS = -1;
+
+/**
+ * \brief wait until \p count replies to reads or writes of register
+ *  \p address (or of any register) arrived, calling \p on_reply for each.
+ * \returns the number of replies.
+ */
+    size_t wait_for_replies(int address, size_t count, int timeout_ms,
+        const std::function<void(const FrameView&)>& on_reply);
+
+    Transport& transport_;
+    FrameReader reader_;
+    FrameHandler event_handler_;
+    WriteBatch batch_; /// reused by write().
+    std::vector<uint8_t> request_; /// reused by read().
+};
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_CLIENT_H
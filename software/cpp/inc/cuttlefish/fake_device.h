@@ -0,0 +1,92 @@
+#ifndef CUTTLEFISH_FAKE_DEVICE_H
+#define CUTTLEFISH_FAKE_DEVICE_H
+#include <cuttlefish/frame_reader.h>
+#include <cuttlefish/harp_frame.h>
+#include <cuttlefish/registers.h>
+#include <cuttlefish/transport.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace cuttlefish
+{
+
+/**
+ * \brief a stand-in for the Cuttlefish on the device end of a Transport
+ *  (i.e: a PtyLink), to test host code without hardware.
+ * \details Replies to reads and writes of the registers in REGISTER_SPECS as
+ *  the firmware does: a write stores its payload and is echoed back, a read
+ *  returns the last value written (zeros at first), and anything else gets an
+ *  error reply. It does not run schedules. Tests drive EVENTs with
+ *  send_events() instead. All replies and EVENTs are timestamped with the time
+ *  since construction.
+ */
+class FakeDevice
+{
+public:
+    explicit FakeDevice(Transport& transport);
+
+/**
+ * \brief stops serving.
+ */
+    ~FakeDevice();
+
+    FakeDevice(const FakeDevice&) = delete;
+    FakeDevice& operator=(const FakeDevice&) = delete;
+
+/**
+ * \brief make writes to \p address fail (with WRITE_ERROR) or succeed.
+ */
+    void reject_writes(uint8_t address, bool reject = true);
+
+/**
+ * \brief send \p count EVENTs of register \p address with \p payload, as few
+ *  transfers as possible, like the firmware's per-USB-frame batches.
+ */
+    void send_events(uint8_t address, PayloadType payload_type,
+                     std::span<const uint8_t> payload, size_t count);
+
+/**
+ * \brief the bytes last written to register \p address.
+ */
+    std::vector<uint8_t> value(uint8_t address);
+
+/**
+ * \brief the number of commands that were received.
+ */
+    size_t commands() const
+    {return commands_;}
+
+/**
+ * \brief the number of transfers that carried them.
+ */
+    size_t transfers() const
+    {return transfers_;}
+
+private:
+    void serve();
+    void handle(const FrameView& command, std::vector<uint8_t>& replies);
+    void encode(std::vector<uint8_t>& out, MessageType type, uint8_t address,
+                PayloadType payload_type, std::span<const uint8_t> payload);
+
+    Transport& transport_;
+    FrameReader reader_{1 << 16};
+    std::chrono::steady_clock::time_point start_time_;
+    std::mutex mutex_; /// guards values_, rejected_, and writes.
+    std::array<std::vector<uint8_t>, 256> values_;
+    std::array<bool, 256> rejected_{};
+    std::atomic<size_t> commands_ = 0;
+    std::atomic<size_t> transfers_ = 0;
+    std::atomic<bool> stopping_ = false;
+    std::thread thread_;
+};
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_FAKE_DEVICE_H
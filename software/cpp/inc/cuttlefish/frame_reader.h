@@ -0,0 +1,104 @@
+#ifndef CUTTLEFISH_FRAME_READER_H
+#define CUTTLEFISH_FRAME_READER_H
+#include <cuttlefish/harp_frame.h>
+#include <cstring>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cuttlefish
+{
+
+/**
+ * \brief split a stream of bytes into Harp frames in place.
+ * \details Bytes are read straight into one large buffer (see space() and
+ *  commit()), and parse() hands out a FrameView of each whole frame where it
+ *  lies. The only copy is of a partial frame at the end of the buffer, which
+ *  moves to the front once the buffer fills up. Bytes that do not start a
+ *  valid frame are skipped one at a time until the stream is back in sync.
+ */
+class FrameReader
+{
+public:
+/**
+ * \param capacity buffer size [bytes]. Larger buffers take more frames per
+ *  read.
+ */
+    explicit FrameReader(size_t capacity = 1 << 20)
+    : buffer_(capacity < 2 * MAX_FRAME_BYTES? 2 * MAX_FRAME_BYTES: capacity)
+    {}
+
+/**
+ * \brief free space at the end of the buffer to read into.
+ * \note invalidates the FrameViews of earlier parse() calls.
+ */
+    std::span<uint8_t> space()
+    {
+        if ((buffer_.size() - end_ < MAX_FRAME_BYTES) && begin_)
+        {
+            memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        return {buffer_.data() + end_, buffer_.size() - end_};
+    }
+
+/**
+ * \brief add \p num_bytes that were written to space().
+ */
+    void commit(size_t num_bytes)
+    {end_ += num_bytes;}
+
+/**
+ * \brief call \p on_frame(const FrameView&) for every whole frame received.
+ * \returns the number of frames.
+ */
+    template <typename F>
+    size_t parse(F&& on_frame)
+    {
+        size_t frames = 0;
+        FrameView frame;
+        while (begin_ < end_)
+        {
+            size_t num_bytes = FrameView::parse(
+                {buffer_.data() + begin_, end_ - begin_}, frame);
+            if (num_bytes == 0)
+                break;
+            if (num_bytes == SIZE_MAX)
+            {
+                ++skipped_bytes_;
+                ++begin_;
+                continue;
+            }
+            begin_ += num_bytes;
+            ++frames;
+            on_frame(frame);
+        }
+        if (begin_ == end_)
+            begin_ = end_ = 0;
+        return frames;
+    }
+
+/**
+ * \brief drop all buffered bytes.
+ */
+    void clear()
+    {begin_ = end_ = 0;}
+
+/**
+ * \brief bytes skipped to resynchronize, i.e: after corruption.
+ */
+    uint64_t skipped_bytes() const
+    {return skipped_bytes_;}
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t begin_ = 0; /// first byte not parsed yet.
+    size_t end_ = 0; /// one past the last byte received.
+    uint64_t skipped_bytes_ = 0;
+};
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_FRAME_READER_H
@@ -0,0 +1,228 @@
+#ifndef CUTTLEFISH_HARP_FRAME_H
+#define CUTTLEFISH_HARP_FRAME_H
+#include <cstring>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cuttlefish
+{
+
+enum class MessageType: uint8_t
+{
+    READ = 1,
+    WRITE = 2,
+    EVENT = 3,
+    READ_ERROR = 9,
+    WRITE_ERROR = 10,
+};
+
+enum class PayloadType: uint8_t
+{
+    U8 = 0x01,
+    S8 = 0x81,
+    U16 = 0x02,
+    S16 = 0x82,
+    U32 = 0x04,
+    S32 = 0x84,
+    U64 = 0x08,
+    S64 = 0x88,
+    Float = 0x44,
+};
+
+inline constexpr uint8_t HAS_TIMESTAMP = 0x10;
+inline constexpr uint8_t DEFAULT_PORT = 0xFF;
+inline constexpr uint32_t HARP_TICK_US = 32; /// timestamp resolution.
+inline constexpr size_t MAX_FRAME_BYTES = 3 + 2 + 0xFFFF; /// extended length.
+
+inline constexpr size_t payload_element_size(PayloadType type)
+{return uint8_t(type) & 0x0F;}
+
+/**
+ * \brief sum of \p num_bytes bytes from \p data, modulo 256.
+ */
+inline uint8_t harp_checksum(const uint8_t* data, size_t num_bytes)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < num_bytes; ++i)
+        sum += data[i];
+    return sum;
+}
+
+/**
+ * \brief a Harp frame, read in place from the buffer that holds it.
+ * \details Views are valid until their buffer is refilled. Nothing is copied
+ *  until a payload is decoded.
+ */
+class FrameView
+{
+public:
+    FrameView() = default;
+
+/**
+ * \brief view the frame of \p num_bytes (checksum included) at \p data.
+ * \note use FrameView::parse() for bytes that may not hold a whole frame.
+ */
+    FrameView(const uint8_t* data, size_t num_bytes, size_t header_bytes)
+    : data_{data}, num_bytes_{num_bytes}, header_bytes_{header_bytes} {}
+
+/**
+ * \brief find the frame at the start of \p bytes.
+ * \returns bytes the frame takes, 0 if \p bytes ends before the frame does,
+ *  or SIZE_MAX if \p bytes does not start with a valid frame.
+ */
+    static size_t parse(std::span<const uint8_t> bytes, FrameView& frame)
+    {
+        if (bytes.size() < 2)
+            return 0;
+        uint8_t type = bytes[0] & ~0x08; // Bit 3 flags errors.
+        if ((type < uint8_t(MessageType::READ))
+            || (type > uint8_t(MessageType::EVENT)))
+            return SIZE_MAX;
+        // A length of 255 is followed by the real length as a U16.
+        size_t length = bytes[1];
+        size_t length_bytes = 1;
+        if (length == 0xFF)
+        {
+            if (bytes.size() < 4)
+                return 0;
+            length = bytes[2] | (size_t(bytes[3]) << 8);
+            length_bytes = 3;
+        }
+        size_t header_bytes = 1 + length_bytes + 3;
+        size_t num_bytes = 1 + length_bytes + length;
+        if (num_bytes < header_bytes + 1)
+            return SIZE_MAX;
+        if (bytes.size() < num_bytes)
+            return 0;
+        if (harp_checksum(bytes.data(), num_bytes - 1) != bytes[num_bytes - 1])
+            return SIZE_MAX;
+        uint8_t payload_type = bytes[header_bytes - 1];
+        if ((payload_type & HAS_TIMESTAMP)
+            && (num_bytes < header_bytes + 6 + 1))
+            return SIZE_MAX;
+        frame = FrameView(bytes.data(), num_bytes, header_bytes);
+        return num_bytes;
+    }
+
+    inline MessageType type() const
+    {return MessageType(data_[0]);}
+
+    inline bool is_error() const
+    {return data_[0] & 0x08;}
+
+    inline uint8_t address() const
+    {return data_[header_bytes_ - 3];}
+
+    inline uint8_t port() const
+    {return data_[header_bytes_ - 2];}
+
+    inline PayloadType payload_type() const
+    {return PayloadType(data_[header_bytes_ - 1] & ~HAS_TIMESTAMP);}
+
+    inline bool has_timestamp() const
+    {return data_[header_bytes_ - 1] & HAS_TIMESTAMP;}
+
+/**
+ * \brief device time of the message [us], at 32us resolution.
+ */
+    inline uint64_t harp_time_us() const
+    {
+        if (!has_timestamp())
+            return 0;
+        uint32_t seconds;
+        uint16_t ticks;
+        memcpy(&seconds, data_ + header_bytes_, sizeof(seconds));
+        memcpy(&ticks, data_ + header_bytes_ + 4, sizeof(ticks));
+        return uint64_t(seconds) * 1'000'000 + uint64_t(ticks) * HARP_TICK_US;
+    }
+
+    inline std::span<const uint8_t> payload() const
+    {
+        size_t start = header_bytes_ + (has_timestamp()? 6: 0);
+        return {data_ + start, num_bytes_ - start - 1};
+    }
+
+/**
+ * \brief number of payload elements of \p T.
+ */
+    template <typename T>
+    inline size_t count() const
+    {return payload().size() / sizeof(T);}
+
+/**
+ * \brief payload element \p index as \p T (unaligned).
+ */
+    template <typename T>
+    inline T get(size_t index = 0) const
+    {
+        T value;
+        memcpy(&value, payload().data() + index * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    inline std::span<const uint8_t> bytes() const
+    {return {data_, num_bytes_};}
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t num_bytes_ = 0;
+    size_t header_bytes_ = 0; /// up to and including the payload type.
+};
+
+/**
+ * \brief append a frame to \p out, timestamped with \p harp_time_us unless
+ *  it is nullptr.
+ * \details \p out only grows when its capacity is exceeded, so a reused
+ *  buffer encodes without allocating.
+ */
+inline void encode_frame(std::vector<uint8_t>& out, MessageType type,
+                         uint8_t address, PayloadType payload_type,
+                         const void* payload, size_t num_bytes,
+                         const uint64_t* harp_time_us,
+                         uint8_t port = DEFAULT_PORT)
+{
+    size_t start = out.size();
+    size_t timestamp_bytes = harp_time_us? 6: 0;
+    size_t length = 4 + timestamp_bytes + num_bytes;
+    out.push_back(uint8_t(type));
+    if (length >= 0xFF)
+    {
+        out.push_back(0xFF);
+        out.push_back(uint8_t(length));
+        out.push_back(uint8_t(length >> 8));
+    }
+    else
+        out.push_back(uint8_t(length));
+    out.push_back(address);
+    out.push_back(port);
+    out.push_back(uint8_t(payload_type) | (harp_time_us? HAS_TIMESTAMP: 0));
+    if (harp_time_us)
+    {
+        uint32_t seconds = uint32_t(*harp_time_us / 1'000'000);
+        uint16_t ticks = uint16_t((*harp_time_us % 1'000'000) / HARP_TICK_US);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&seconds);
+        out.insert(out.end(), bytes, bytes + sizeof(seconds));
+        bytes = reinterpret_cast<const uint8_t*>(&ticks);
+        out.insert(out.end(), bytes, bytes + sizeof(ticks));
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    out.insert(out.end(), bytes, bytes + num_bytes);
+    out.push_back(harp_checksum(out.data() + start, out.size() - start));
+}
+
+/**
+ * \brief append a frame without a timestamp to \p out, i.e: a command.
+ */
+inline void encode_frame(std::vector<uint8_t>& out, MessageType type,
+                         uint8_t address, PayloadType payload_type,
+                         const void* payload, size_t num_bytes)
+{
+    encode_frame(out, type, address, payload_type, payload, num_bytes,
+                 nullptr);
+}
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_HARP_FRAME_H
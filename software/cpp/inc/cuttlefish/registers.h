@@ -0,0 +1,1078 @@
+// Generated from device.yml by generate_registers.py. Do not edit.
+#ifndef CUTTLEFISH_REGISTERS_H
+#define CUTTLEFISH_REGISTERS_H
+#include <cuttlefish/harp_frame.h>
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cuttlefish
+{
+
+inline constexpr uint16_t WHO_AM_I = 1403;
+inline constexpr const char DEVICE_NAME[] = "Cuttlefish";
+
+namespace regs
+{
+/**
+ * \brief Set the direction of the pins. 0 = input; 1 = output
+ */
+struct PinDirection
+{
+    static constexpr uint8_t address = 32;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Read or write the state of the pins.
+ */
+struct PinState
+{
+    static constexpr uint8_t address = 33;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Set pins specified in the mask to logic HIGH by setting the
+ *  corresponding bit.
+ */
+struct PinSet
+{
+    static constexpr uint8_t address = 34;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Set specified pins in the mask to logic LOW by setting the
+ *  corresponding bit.
+ */
+struct PinClear
+{
+    static constexpr uint8_t address = 35;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Enable Events from the RisingEdgeEvents register for the specified
+ *  pins in the mask when any of the the corresponding pins transitions from
+ *  logic LOW to logic HIGH.
+ */
+struct EnableRisingEdgeEvents
+{
+    static constexpr uint8_t address = 36;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Event Only. Returns a timestamped message with the Port state when
+ *  any of the pins specified in the EnableRisingEdgeEvents register
+ *  transitions from logic LOW to logic HIGH.
+ */
+struct RisingEdgeEvents
+{
+    static constexpr uint8_t address = 37;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Enable Events from the FallingEdgeEvents register for the specified
+ *  pins in the mask when any of the the corresponding pins transitions from
+ *  logic HIGH to logic LOW.
+ */
+struct EnableFallingEdgeEvents
+{
+    static constexpr uint8_t address = 38;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Event Only. Returns a timestamped message with the Port state when
+ *  any of the pins specified in the EnableRisingEdgeEvents register
+ *  transitions from logic HIGH to logic LOW.
+ */
+struct FallingEdgeEvents
+{
+    static constexpr uint8_t address = 39;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Write a nonzero value to this register to start the PWM schedule.
+ *  Write zero to stop the schedule. Receive an event with payload=0 when the
+ *  pwm schedule has finished.
+ */
+struct PwmState
+{
+    static constexpr uint8_t address = 40;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Struct to configure PWM0 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings0
+{
+    static constexpr uint8_t address = 41;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM1 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings1
+{
+    static constexpr uint8_t address = 42;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM2 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings2
+{
+    static constexpr uint8_t address = 43;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM3 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings3
+{
+    static constexpr uint8_t address = 44;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM4 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings4
+{
+    static constexpr uint8_t address = 45;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM5 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings5
+{
+    static constexpr uint8_t address = 46;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM6 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings6
+{
+    static constexpr uint8_t address = 47;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct to configure PWM7 settings: offset_us (U32), on_duration_us
+ *  (U32), off_duration_us (U32), cycles (U32), invert (U8)
+ */
+struct PwmSettings7
+{
+    static constexpr uint8_t address = 48;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 17;
+    using value_type = std::array<uint8_t, 17>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct with the outcome of the schedule feasibility analysis, updated
+ *  when the PWM schedule is started: error (U8), min_edge_spacing_us (U32),
+ *  peak_edge_rate_hz (U32), edge_cost_us (U32), violation_time_us (U32),
+ *  analyzed_span_us (U32). error: 0 = none, 1 = invalid settings, 2 = edges
+ *  too close, 3 = lookahead overrun, 4 = missed deadline while running, 5 =
+ *  analysis incomplete (it ran out of CPU time). The analysis stops after 1024
+ *  edges, 60 s of schedule, or 0.5 ms of CPU time; analyzed_span_us tells how
+ *  far it got. Writing a nonzero value to PwmState is rejected with an error
+ *  if the schedule is infeasible.
+ */
+struct ScheduleDiagnostics
+{
+    static constexpr uint8_t address = 49;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 21;
+    using value_type = std::array<uint8_t, 21>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Edges of different PWM outputs that fall within this many
+ *  microseconds of each other are applied together at the earliest edge time.
+ *  Must be smaller than every on and off duration. Default: 0.
+ */
+struct EdgeMergeToleranceUs
+{
+    static constexpr uint8_t address = 50;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Enable logging of the port writes issued by the PWM schedule for the
+ *  specified pins in the mask. Logged writes are sent in batches from the
+ *  OutputEdgeEvents register.
+ */
+struct EnableOutputEdgeEvents
+{
+    static constexpr uint8_t address = 51;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Event Only. Batch of port writes issued by the PWM schedule on pins
+ *  enabled in EnableOutputEdgeEvents, timestamped with the time of the first
+ *  write in the batch. The payload holds up to 16 records of 3 values each:
+ *  time offset (us) from the message timestamp, pin mask, pin state.
+ */
+struct OutputEdgeEvents
+{
+    static constexpr uint8_t address = 52;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Number of logged port writes that were dropped because the log was
+ *  full.
+ */
+struct OutputEdgeEventsDropped
+{
+    static constexpr uint8_t address = 53;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief 0 = starting the schedule plays the PwmSettings of each output. 1 =
+ *  starting the schedule plays the records written to StreamRecords. Only
+ *  writeable while the schedule is stopped. Default: 0.
+ */
+struct StreamMode
+{
+    static constexpr uint8_t address = 54;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Block of up to 16 waveform records of 3 values each: delay (us) since
+ *  the previous record (or since the schedule start), pin mask, pin state.
+ *  Records are buffered on the device (1024 records) before and during
+ *  playback. Only pins configured as outputs are driven. Records that are all
+ *  zero are ignored. A block that does not fit in the buffer is rejected with
+ *  an error and may be resent later. Playback ends when the buffer runs empty.
+ */
+struct StreamRecords
+{
+    static constexpr uint8_t address = 55;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 48;
+    using value_type = std::array<uint32_t, 48>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Number of buffered records at or below which the
+ *  StreamLowWatermarkReached event is sent during playback. Default: 256.
+ */
+struct StreamLowWatermark
+{
+    static constexpr uint8_t address = 56;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Event Only. Sent once each time the number of buffered records drops
+ *  to StreamLowWatermark during playback. Holds the number of buffered
+ *  records.
+ */
+struct StreamLowWatermarkReached
+{
+    static constexpr uint8_t address = 57;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Event Only. Sent when the streamed waveform ran out of records. Holds
+ *  the number of records that were played. The schedule then stops as if it
+ *  had finished.
+ */
+struct StreamUnderrun
+{
+    static constexpr uint8_t address = 58;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Draw the off time of each cycle of one PWM output on the device. The
+ *  on time stays fixed. Payload: channel (U8), distribution (U8), seed (U32),
+ *  mean_us (U32), min_us (U32), max_us (U32). distribution: 0 = fixed (use the
+ *  PwmSettings period), 1 = uniform in [min, max], 2 = min + exponential with
+ *  the given mean, clipped to max, 3 = min + exponential with the given mean,
+ *  truncated at max. min_us may be 0 for the exponential distributions. Off
+ *  times shorter than 5us are lengthened to 5us. Write the channel's
+ *  PwmSettings first. A seed of 0 is replaced with a new seed that is echoed
+ *  in the reply. Every run with the same seed produces the same off times.
+ *  Only writeable while the schedule is stopped.
+ */
+struct PwmRandomSettings
+{
+    static constexpr uint8_t address = 59;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 18;
+    using value_type = std::array<uint8_t, 18>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Sweep the period and duty cycle of one PWM output (chirp). Payload:
+ *  channel (U8), profile (U8), start_period_us (U32), end_period_us (U32),
+ *  start_duty (U16), end_duty (U16), ramp_duration_us (U32). Duty cycles are
+ *  in units of 0.01%. profile: 0 = fixed (use the PwmSettings period), 1 =
+ *  linear (the period changes by a fixed step each cycle), 2 = exponential
+ *  (the period changes by a fixed ratio each cycle; a sweep so flat for its
+ *  length that the ratio rounds to ~1 is rejected, use linear instead). The
+ *  duty cycle changes linearly. After ramp_duration_us the end values are
+ *  held. Write the channel's PwmSettings first; its offset, cycles and invert
+ *  still apply. Replaces PwmRandomSettings on that channel. Only writeable
+ *  while the schedule is stopped.
+ */
+struct PwmRampSettings
+{
+    static constexpr uint8_t address = 60;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 18;
+    using value_type = std::array<uint8_t, 18>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Group the pulses of one PWM output into bursts, and bursts into
+ *  trains. Payload: channel (U8), pulses_per_burst (U32), burst_gap_us (U32),
+ *  bursts_per_train (U32), train_gap_us (U32), trains (U32). Gaps are the off
+ *  time between the last pulse of a burst (or train) and the first pulse of
+ *  the next one, and must be nonzero where used (burst_gap_us if
+ *  bursts_per_train > 1, train_gap_us if trains != 1). trains: 0 = repeat
+ *  forever. The last pulse of the last train is followed by the PwmSettings
+ *  off time. pulses_per_burst: 0 = no bursts. The burst structure replaces the
+ *  PwmSettings cycles and can be combined with random or ramped timing. Write
+ *  the channel's PwmSettings first. Only writeable while the schedule is
+ *  stopped.
+ */
+struct PwmBurstSettings
+{
+    static constexpr uint8_t address = 61;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 21;
+    using value_type = std::array<uint8_t, 21>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Replace the current PWM schedule with one of 8 slots saved with
+ *  SaveScheduleSlot. Set bit 7 to also start the slot, in which case the reply
+ *  is timestamped with the start time. PwmSettings and EdgeMergeToleranceUs
+ *  are updated to match the slot. Only writeable while the schedule is
+ *  stopped. The reply follows once the slot is loaded. If that takes longer
+ *  than 20ms, the write is answered with an error, and a late load is reported
+ *  as an EVENT. Other schedule writes are refused until then. Reads back the
+ *  last loaded slot.
+ */
+struct ScheduleSlot
+{
+    static constexpr uint8_t address = 62;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Save the current PWM schedule (PwmSettings, random, ramp, burst, gate
+ *  and phase-lock settings, and EdgeMergeToleranceUs) into one of 8 slots.
+ *  Slots are cleared on reset. Only writeable while the schedule is stopped.
+ *  Answered like ScheduleSlot once the slot is saved.
+ */
+struct SaveScheduleSlot
+{
+    static constexpr uint8_t address = 63;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Write 1 to store the port directions, edge event enables,
+ *  StreamLowWatermark, BootAction, LatencyCompensation, the current PWM
+ *  schedule and all schedule slots in flash. Write 2 to restore them and 3 to
+ *  erase them. Only writeable while the schedule is stopped. Reads 1 if a
+ *  valid configuration is stored, 0 otherwise.
+ */
+struct StoredConfiguration
+{
+    static constexpr uint8_t address = 64;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief What to do with the stored configuration at power up. 0 = nothing, 1
+ *  = restore it, 2 = restore it and start the PWM schedule. Takes effect once
+ *  saved with StoredConfiguration.
+ */
+struct BootAction
+{
+    static constexpr uint8_t address = 65;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Sample all port pins at (close to) this rate [Hz], up to 1MHz, and
+ *  send them through LogicAnalyzerSamples. 0 = stop. Reads back the rate in
+ *  use. Samples taken before stopping are still sent.
+ */
+struct LogicAnalyzerRateHz
+{
+    static constexpr uint8_t address = 66;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Up to 24 (port state, run length) pairs of run-length encoded port
+ *  samples. The timestamp is the time of the first sample. Sent when full, or
+ *  at least every 10ms.
+ */
+struct LogicAnalyzerSamples
+{
+    static constexpr uint8_t address = 67;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 48;
+    using value_type = std::array<uint32_t, 48>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Number of samples dropped since starting because they were
+ *  overwritten before they could be sent. An EVENT is timestamped with the
+ *  time of the first dropped sample.
+ */
+struct LogicAnalyzerOverflow
+{
+    static constexpr uint8_t address = 68;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Gate a PWM output with an input pin. Bytes are channel, gate_channel,
+ *  mode and active_low. mode: 0 = no gate, 1 = continue (the waveform keeps
+ *  running while the gate is closed and the output idles), 2 = freeze (the
+ *  waveform pauses while the gate is closed and resumes where it left off).
+ *  active_low: 1 = the gate is open while the gate channel is low. The gate
+ *  channel must be an input. Write the channel's PwmSettings first. Only
+ *  writeable while the schedule is stopped.
+ */
+struct PwmGateSettings
+{
+    static constexpr uint8_t address = 69;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 4;
+    using value_type = std::array<uint8_t, 4>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Outputs whose gate is open. An EVENT is sent when the schedule starts
+ *  and whenever a gate opens or closes, timestamped with the time the change
+ *  was applied.
+ */
+struct PwmGateState
+{
+    static constexpr uint8_t address = 70;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Lock the phase of a PWM output to the edges of an input. Bytes are
+ *  channel, reference_channel, mode, falling_edge, and delay_us (U32). mode: 0
+ *  = no lock, 1 = anchor (every reference edge re-anchors the output so that a
+ *  cycle starts delay_us after it), 2 = track (also adjust the period to the
+ *  reference period divided by the number of output cycles per reference
+ *  period, within 12.5% of the PwmSettings period). falling_edge: 1 = anchor
+ *  on falling edges of the reference. The reference channel must be an input
+ *  and the output must have fixed timing (no random, ramp or burst settings).
+ *  Write the channel's PwmSettings first. Only writeable while the schedule is
+ *  stopped.
+ */
+struct PwmPhaseLockSettings
+{
+    static constexpr uint8_t address = 71;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 8;
+    using value_type = std::array<uint8_t, 8>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Phase-locked outputs that are locked, i.e: whose last 4 reference
+ *  edges were within 5us of where the output expected them. An EVENT is sent
+ *  when the schedule starts and whenever an output gains or loses its lock,
+ *  including when its reference stops for two of its periods.
+ */
+struct PwmPhaseLockState
+{
+    static constexpr uint8_t address = 72;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Struct with the phase-lock statistics of all phase-locked outputs
+ *  since the schedule started: reference_edges (U32), reference_period_us
+ *  (U32), last_error_us (S32), min_error_us (S32), max_error_us (S32),
+ *  mean_abs_error_us (U32). A positive error means the output was running
+ *  ahead of the reference.
+ */
+struct PwmPhaseLockStatistics
+{
+    static constexpr uint8_t address = 73;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 24;
+    using value_type = std::array<uint8_t, 24>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief 0 = the scheduler's alarm interrupt writes the outputs. 1 = a PIO
+ *  state machine fed by DMA writes the outputs, so edges land on their system
+ *  clock cycle instead of jittering with interrupt latency. The schedule
+ *  starts 200us later. Not available with StreamMode, freeze-mode gates, or
+ *  phase locks; schedules that would need them run on the alarm interrupt.
+ *  Only writeable while the schedule is stopped. Default: 0.
+ */
+struct OutputEngine
+{
+    static constexpr uint8_t address = 74;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief 0 = the edges enabled in EnableRisingEdgeEvents and
+ *  EnableFallingEdgeEvents are timestamped by the GPIO interrupt and sent as
+ *  RisingEdgeEvents and FallingEdgeEvents. 1 = a PIO state machine samples all
+ *  port pins every 10 system clock cycles (80ns) and the enabled edges are
+ *  sent in batches through InputCaptureEvents instead. Default: 0.
+ */
+struct InputCapture
+{
+    static constexpr uint8_t address = 75;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Event Only. Batch of input edges captured while InputCapture is 1,
+ *  timestamped with the time of the first edge in the batch (rounded down to
+ *  the microsecond). The payload holds up to 16 records of 3 values each: time
+ *  offset (ns) from the first edge's microsecond, rising pins, falling pins.
+ *  Sent when full, or at least every 1ms.
+ */
+struct InputCaptureEvents
+{
+    static constexpr uint8_t address = 76;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 48;
+    using value_type = std::array<uint32_t, 48>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Number of capture records lost since InputCapture was last enabled
+ *  because they were overwritten before they could be decoded or because the
+ *  capture FIFO was full. An EVENT is sent whenever records are lost.
+ */
+struct InputCaptureOverflow
+{
+    static constexpr uint8_t address = 77;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Add, change, or remove a pulse train that combines with a PWM output.
+ *  Bytes are channel, overlay, combine, offset_us (U32), on_duration_us (U32),
+ *  off_duration_us (U32), and cycles (U32, 0 = forever). overlay (0-3) picks
+ *  which of the channel's overlays to write. combine: 0 = remove the overlay,
+ *  1 = OR, 2 = AND, 3 = XOR. The output is the PwmSettings train combined with
+ *  each overlay in the order they were added, then inverted if the PwmSettings
+ *  invert it. Up to 4 overlays are shared by all channels. Write the channel's
+ *  PwmSettings first. Only writeable while the schedule is stopped.
+ */
+struct PwmOverlaySettings
+{
+    static constexpr uint8_t address = 78;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 19;
+    using value_type = std::array<uint8_t, 19>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Repeat a finite PWM schedule as a series of trials. Bytes are repeat
+ *  (0 = run once, 1 = repeat), trials (U32, including the first, 0 = until
+ *  stopped), distribution, seed (U32), mean_us (U32), min_us (U32), max_us
+ *  (U32), trigger, and trigger_channel. The inter-trial interval (ITI) counts
+ *  from the end of a trial. distribution: 0 = a fixed ITI of min_us, 1 =
+ *  uniform in [min_us, max_us], 2 = min_us + exponential with mean_us, clipped
+ *  to max_us, 3 = the same, truncated at max_us. A seed of 0 is replaced with
+ *  one from the timer and echoed back. trigger: 0 = none, 1 = rising, 2 =
+ *  falling; the next trial then waits for the first edge of the
+ *  trigger_channel input after the ITI. Only writeable while the schedule is
+ *  stopped.
+ */
+struct PwmTrialSettings
+{
+    static constexpr uint8_t address = 79;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 24;
+    using value_type = std::array<uint8_t, 24>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Index of the last trial of a repeated schedule that started. An EVENT
+ *  is sent as each trial starts (including the first), timestamped with its
+ *  start time.
+ */
+struct PwmTrialStart
+{
+    static constexpr uint8_t address = 80;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 1;
+    using value_type = uint32_t;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief A trial state machine program of 1 to 12 states, 20 bytes each:
+ *  set_channels (U32) and clear_channels (U32), the outputs driven high and
+ *  low on entry; schedule, the action on entry (0 = none, 1 = stop the PWM
+ *  schedule, 2 = start it, 0x80 | slot = load a schedule slot and start it);
+ *  timeout_us (U32, from entry, 0 = none) and timeout_next; then two
+ *  transitions of condition, channel, and next. condition: 0 = none, 1 =
+ *  rising edge of the channel input, 2 = falling edge, 3 = the PWM schedule is
+ *  not running. Transitions are checked in order before the timeout, and only
+ *  edges after entering the state count. A next state of 255 ends the program.
+ *  Only writeable while the state machine is stopped.
+ */
+struct StateMachineProgram
+{
+    static constexpr uint8_t address = 81;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 240;
+    using value_type = std::array<uint8_t, 240>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief 1 starts the state machine program in state 0, 0 stops it. Reads 0
+ *  once the program ends. Outputs of the program must be outputs, inputs must
+ *  be inputs, and the PWM schedule must be stopped. While the state machine
+ *  runs, it owns the PWM schedule, so PwmState and ScheduleSlot writes are
+ *  refused.
+ */
+struct StateMachineControl
+{
+    static constexpr uint8_t address = 82;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 1;
+    using value_type = uint8_t;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief The last state change of the state machine: state (255 once the
+ *  program ended), previous state (255 on start), and cause (0 = start, 1 =
+ *  timeout, 2 = first transition, 3 = second transition, 4 = stopped). An
+ *  EVENT is sent on every change, timestamped with the time of the change.
+ */
+struct StateMachineTransition
+{
+    static constexpr uint8_t address = 83;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 3;
+    using value_type = std::array<uint8_t, 3>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+/**
+ * \brief Measure this board's output and input latency through a jumper from
+ *  an output to an input. Payload: run (U8, 1 to start, 0 to stop early),
+ *  output_channel (U8), input_channel (U8). Toggles the output 4000 times,
+ *  200us apart, on its own. The schedule is set aside meanwhile and put back
+ *  afterwards. Only writeable while the schedule, InputCapture, trials, and
+ *  the state machine are stopped, with the ALARM OutputEngine. Reads run = 1
+ *  until done.
+ */
+struct LoopbackCalibration
+{
+    static constexpr uint8_t address = 84;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 3;
+    using value_type = std::array<uint8_t, 3>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief alarm_lead_us (U32, up to 5): the scheduler fires its alarm this
+ *  early so outputs change on time. input_latency_us (U32, up to 100):
+ *  subtracted from the interrupt timestamps of input edges. Set by
+ *  LoopbackCalibration when it sees at least half of its edges both ways, and
+ *  kept with StoredConfiguration. Only writeable while the schedule is
+ *  stopped.
+ */
+struct LatencyCompensation
+{
+    static constexpr uint8_t address = 85;
+    static constexpr PayloadType payload_type = PayloadType::U32;
+    using element_type = uint32_t;
+    static constexpr size_t length = 2;
+    using value_type = std::array<uint32_t, 2>;
+    static constexpr bool writeable = true;
+    static constexpr bool has_events = false;
+};
+
+/**
+ * \brief Struct with the latencies measured by the last LoopbackCalibration:
+ *  output_edges (U32), output_mean_ns (S32), output_sd_ns (U32), output_min_ns
+ *  (S32), output_max_ns (S32), input_edges (U32), input_mean_ns (S32),
+ *  input_sd_ns (U32), input_min_ns (S32), input_max_ns (S32). Output latency
+ *  is from the scheduled time to the edge, and input latency from the edge to
+ *  its interrupt timestamp. An EVENT is sent when the calibration is done.
+ */
+struct LatencyStatistics
+{
+    static constexpr uint8_t address = 86;
+    static constexpr PayloadType payload_type = PayloadType::U8;
+    using element_type = uint8_t;
+    static constexpr size_t length = 40;
+    using value_type = std::array<uint8_t, 40>;
+    static constexpr bool writeable = false;
+    static constexpr bool has_events = true;
+};
+
+} // namespace regs
+
+enum class Pins: uint32_t
+{
+    None = 0x0,
+    Pin0 = 0x1,
+    Pin1 = 0x2,
+    Pin2 = 0x4,
+    Pin3 = 0x8,
+    Pin4 = 0x10,
+    Pin5 = 0x20,
+    Pin6 = 0x40,
+    Pin7 = 0x80,
+};
+
+/**
+ * \brief an app register, for code that handles registers at run time.
+ */
+struct register_spec_t
+{
+    const char* name;
+    uint8_t address;
+    PayloadType payload_type;
+    size_t length; /// elements.
+    bool writeable;
+    bool has_events;
+};
+
+inline constexpr register_spec_t REGISTER_SPECS[] =
+{
+    {"PinDirection", 32, PayloadType::U8, 1, true, false},
+    {"PinState", 33, PayloadType::U8, 1, true, false},
+    {"PinSet", 34, PayloadType::U8, 1, true, false},
+    {"PinClear", 35, PayloadType::U8, 1, true, false},
+    {"EnableRisingEdgeEvents", 36, PayloadType::U8, 1, true, false},
+    {"RisingEdgeEvents", 37, PayloadType::U8, 1, false, true},
+    {"EnableFallingEdgeEvents", 38, PayloadType::U8, 1, true, false},
+    {"FallingEdgeEvents", 39, PayloadType::U8, 1, false, true},
+    {"PwmState", 40, PayloadType::U8, 1, true, true},
+    {"PwmSettings0", 41, PayloadType::U8, 17, true, false},
+    {"PwmSettings1", 42, PayloadType::U8, 17, true, false},
+    {"PwmSettings2", 43, PayloadType::U8, 17, true, false},
+    {"PwmSettings3", 44, PayloadType::U8, 17, true, false},
+    {"PwmSettings4", 45, PayloadType::U8, 17, true, false},
+    {"PwmSettings5", 46, PayloadType::U8, 17, true, false},
+    {"PwmSettings6", 47, PayloadType::U8, 17, true, false},
+    {"PwmSettings7", 48, PayloadType::U8, 17, true, false},
+    {"ScheduleDiagnostics", 49, PayloadType::U8, 21, false, false},
+    {"EdgeMergeToleranceUs", 50, PayloadType::U32, 1, true, false},
+    {"EnableOutputEdgeEvents", 51, PayloadType::U8, 1, true, false},
+    {"OutputEdgeEvents", 52, PayloadType::U32, 1, false, true},
+    {"OutputEdgeEventsDropped", 53, PayloadType::U32, 1, false, false},
+    {"StreamMode", 54, PayloadType::U8, 1, true, false},
+    {"StreamRecords", 55, PayloadType::U32, 48, true, false},
+    {"StreamLowWatermark", 56, PayloadType::U32, 1, true, false},
+    {"StreamLowWatermarkReached", 57, PayloadType::U32, 1, false, true},
+    {"StreamUnderrun", 58, PayloadType::U32, 1, false, true},
+    {"PwmRandomSettings", 59, PayloadType::U8, 18, true, false},
+    {"PwmRampSettings", 60, PayloadType::U8, 18, true, false},
+    {"PwmBurstSettings", 61, PayloadType::U8, 21, true, false},
+    {"ScheduleSlot", 62, PayloadType::U8, 1, true, false},
+    {"SaveScheduleSlot", 63, PayloadType::U8, 1, true, false},
+    {"StoredConfiguration", 64, PayloadType::U8, 1, true, false},
+    {"BootAction", 65, PayloadType::U8, 1, true, false},
+    {"LogicAnalyzerRateHz", 66, PayloadType::U32, 1, true, false},
+    {"LogicAnalyzerSamples", 67, PayloadType::U32, 48, false, true},
+    {"LogicAnalyzerOverflow", 68, PayloadType::U32, 1, false, true},
+    {"PwmGateSettings", 69, PayloadType::U8, 4, true, false},
+    {"PwmGateState", 70, PayloadType::U8, 1, false, true},
+    {"PwmPhaseLockSettings", 71, PayloadType::U8, 8, true, false},
+    {"PwmPhaseLockState", 72, PayloadType::U8, 1, false, true},
+    {"PwmPhaseLockStatistics", 73, PayloadType::U8, 24, false, false},
+    {"OutputEngine", 74, PayloadType::U8, 1, true, false},
+    {"InputCapture", 75, PayloadType::U8, 1, true, false},
+    {"InputCaptureEvents", 76, PayloadType::U32, 48, false, true},
+    {"InputCaptureOverflow", 77, PayloadType::U32, 1, false, true},
+    {"PwmOverlaySettings", 78, PayloadType::U8, 19, true, false},
+    {"PwmTrialSettings", 79, PayloadType::U8, 24, true, false},
+    {"PwmTrialStart", 80, PayloadType::U32, 1, false, true},
+    {"StateMachineProgram", 81, PayloadType::U8, 240, true, false},
+    {"StateMachineControl", 82, PayloadType::U8, 1, true, false},
+    {"StateMachineTransition", 83, PayloadType::U8, 3, false, true},
+    {"LoopbackCalibration", 84, PayloadType::U8, 3, true, false},
+    {"LatencyCompensation", 85, PayloadType::U32, 2, true, false},
+    {"LatencyStatistics", 86, PayloadType::U8, 40, false, true},
+};
+
+/**
+ * \brief the app register at \p address, or nullptr if there is none.
+ */
+constexpr const register_spec_t* find_register(uint8_t address)
+{
+    for (const register_spec_t& spec: REGISTER_SPECS)
+    {
+        if (spec.address == address)
+            return &spec;
+    }
+    return nullptr;
+}
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_REGISTERS_H
@@ -0,0 +1,102 @@
+#ifndef CUTTLEFISH_TRANSPORT_H
+#define CUTTLEFISH_TRANSPORT_H
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace cuttlefish
+{
+
+/**
+ * \brief a byte stream to the device.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+/**
+ * \brief read whatever is available into \p buffer, waiting up to
+ *  \p timeout_ms for the first byte.
+ * \returns bytes read. 0 on timeout.
+ */
+    virtual size_t read(std::span<uint8_t> buffer, int timeout_ms) = 0;
+
+/**
+ * \brief write all of \p bytes.
+ * \returns false if the link failed.
+ */
+    virtual bool write(std::span<const uint8_t> bytes) = 0;
+};
+
+/**
+ * \brief a POSIX file descriptor in raw mode, i.e: the device's USB serial
+ *  port, or one end of a pseudo-terminal.
+ * \details The Cuttlefish enumerates as a USB CDC device, so the baud rate is
+ *  ignored and data moves at USB speed.
+ */
+class FdTransport: public Transport
+{
+public:
+/**
+ * \brief open the serial port at \p path (i.e: "/dev/ttyACM0").
+ * \throws std::system_error if the port cannot be opened.
+ */
+    explicit FdTransport(const std::string& path);
+
+/**
+ * \brief take ownership of the open descriptor \p fd.
+ */
+    explicit FdTransport(int fd);
+
+    ~FdTransport() override;
+
+    FdTransport(const FdTransport&) = delete;
+    FdTransport& operator=(const FdTransport&) = delete;
+
+    size_t read(std::span<uint8_t> buffer, int timeout_ms) override;
+    bool write(std::span<const uint8_t> bytes) override;
+
+    int fd() const
+    {return fd_;}
+
+private:
+    int fd_ = -1;
+};
+
+/**
+ * \brief a pseudo-terminal that stands in for the device's serial port.
+ * \details The client opens port_path() like a real port, and a FakeDevice
+ *  (or a test) serves the other end through device().
+ */
+class PtyLink
+{
+public:
+/**
+ * \throws std::system_error if no pseudo-terminal is available.
+ */
+    PtyLink();
+
+/**
+ * \brief path of the client end, i.e: "/dev/pts/3".
+ */
+    const std::string& port_path() const
+    {return port_path_;}
+
+/**
+ * \brief the device end.
+ */
+    FdTransport& device()
+    {return device_;}
+
+private:
+    static int open_master();
+
+    FdTransport device_;
+    std::string port_path_;
+};
+
+} // namespace cuttlefish
+
+#endif // CUTTLEFISH_TRANSPORT_H
@@ -0,0 +1,71 @@
+#include <cuttlefish/client.h>
+#include <chrono>
+
+namespace cuttlefish
+{
+
+Client::Client(Transport& transport, size_t buffer_bytes)
+: transport_{transport}, reader_{buffer_bytes}
+{}
+
+
+size_t Client::send(const WriteBatch& batch, int timeout_ms)
+{
+    if (!batch.messages() || !transport_.write(batch.bytes()))
+        return 0;
+    size_t accepted = 0;
+    wait_for_replies(ANY_ADDRESS, batch.messages(), timeout_ms,
+        [&accepted](const FrameView& reply)
+        {
+            if (!reply.is_error())
+                ++accepted;
+        });
+    return accepted;
+}
+
+
+bool Client::fill(int timeout_ms)
+{
+    std::span<uint8_t> space = reader_.space();
+    size_t num_bytes = transport_.read(space, timeout_ms);
+    reader_.commit(num_bytes);
+    return num_bytes;
+}
+
+
+size_t Client::wait_for_replies(int address, size_t count, int timeout_ms,
+    const std::function<void(const FrameView&)>& on_reply)
+{
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t replies = 0;
+    auto on_frame = [&](const FrameView& frame)
+        {
+            // Replies come back in the order of their requests.
+            bool reply = (frame.type() != MessageType::EVENT)
+                         && ((address == ANY_ADDRESS)
+                             || (frame.address() == address))
+                         && (replies < count);
+            if (reply)
+            {
+                ++replies;
+                on_reply(frame);
+            }
+            else if (event_handler_)
+                event_handler_(frame);
+        };
+    // Frames already buffered go first.
+    reader_.parse(on_frame);
+    while (replies < count)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - clock::now()).count();
+        if (remaining <= 0)
+            break;
+        if (fill(int(remaining)))
+            reader_.parse(on_frame);
+    }
+    return replies;
+}
+
+} // namespace cuttlefish
@@ -0,0 +1,110 @@
+#include <cuttlefish/fake_device.h>
+
+namespace cuttlefish
+{
+
+FakeDevice::FakeDevice(Transport& transport)
+: transport_{transport}, start_time_{std::chrono::steady_clock::now()}
+{
+    thread_ = std::thread([this]() {serve();});
+}
+
+
+FakeDevice::~FakeDevice()
+{
+    stopping_ = true;
+    thread_.join();
+}
+
+
+void FakeDevice::reject_writes(uint8_t address, bool reject)
+{
+    std::lock_guard lock(mutex_);
+    rejected_[address] = reject;
+}
+
+
+void FakeDevice::send_events(uint8_t address, PayloadType payload_type,
+                             std::span<const uint8_t> payload, size_t count)
+{
+    std::vector<uint8_t> events;
+    for (size_t i = 0; i < count; ++i)
+        encode(events, MessageType::EVENT, address, payload_type, payload);
+    std::lock_guard lock(mutex_);
+    transport_.write(events);
+}
+
+
+std::vector<uint8_t> FakeDevice::value(uint8_t address)
+{
+    std::lock_guard lock(mutex_);
+    return values_[address];
+}
+
+
+void FakeDevice::serve()
+{
+    std::vector<uint8_t> replies;
+    while (!stopping_)
+    {
+        std::span<uint8_t> space = reader_.space();
+        size_t num_bytes = transport_.read(space, 10);
+        if (!num_bytes)
+            continue;
+        ++transfers_;
+        reader_.commit(num_bytes);
+        replies.clear();
+        reader_.parse([this, &replies](const FrameView& command)
+            {handle(command, replies);});
+        if (replies.empty())
+            continue;
+        std::lock_guard lock(mutex_);
+        transport_.write(replies);
+    }
+}
+
+
+void FakeDevice::handle(const FrameView& command, std::vector<uint8_t>& replies)
+{
+    ++commands_;
+    const register_spec_t* spec = find_register(command.address());
+    MessageType type = command.type();
+    std::lock_guard lock(mutex_);
+    std::vector<uint8_t>& value = values_[command.address()];
+    if (spec && (type == MessageType::WRITE) && spec->writeable
+        && !rejected_[command.address()]
+        && (command.payload_type() == spec->payload_type)
+        && (command.payload().size()
+            <= spec->length * payload_element_size(spec->payload_type)))
+    {
+        value.assign(command.payload().begin(), command.payload().end());
+        encode(replies, MessageType::WRITE, command.address(),
+               spec->payload_type, value);
+        return;
+    }
+    if (spec && (type == MessageType::READ))
+    {
+        if (value.empty())
+            value.resize(spec->length * payload_element_size(spec->payload_type));
+        encode(replies, MessageType::READ, command.address(),
+               spec->payload_type, value);
+        return;
+    }
+    MessageType error = (type == MessageType::READ)? MessageType::READ_ERROR
+                                                   : MessageType::WRITE_ERROR;
+    encode(replies, error, command.address(), command.payload_type(), {});
+}
+
+
+void FakeDevice::encode(std::vector<uint8_t>& out, MessageType type,
+                        uint8_t address, PayloadType payload_type,
+                        std::span<const uint8_t> payload)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start_time_;
+    uint64_t harp_time_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    encode_frame(out, type, address, payload_type, payload.data(),
+                 payload.size(), &harp_time_us);
+}
+
+} // namespace cuttlefish
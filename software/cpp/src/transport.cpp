@@ -0,0 +1,109 @@
+#include <cuttlefish/transport.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <system_error>
+#include <termios.h>
+#include <unistd.h>
+
+namespace cuttlefish
+{
+
+namespace
+{
+
+[[noreturn]] void throw_errno(const char* what)
+{throw std::system_error(errno, std::generic_category(), what);}
+
+/**
+ * \brief raw 8-bit mode: no echo, line editing, or byte translation.
+ */
+void make_raw(int fd)
+{
+    termios settings;
+    if (tcgetattr(fd, &settings) < 0)
+        return; // Not a terminal (i.e: a pipe).
+    cfmakeraw(&settings);
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &settings);
+}
+
+} // namespace
+
+
+FdTransport::FdTransport(const std::string& path)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0)
+        throw_errno(path.c_str());
+    make_raw(fd_);
+}
+
+
+FdTransport::FdTransport(int fd)
+: fd_{fd}
+{
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    make_raw(fd_);
+}
+
+
+FdTransport::~FdTransport()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+
+size_t FdTransport::read(std::span<uint8_t> buffer, int timeout_ms)
+{
+    pollfd request{fd_, POLLIN, 0};
+    if (poll(&request, 1, timeout_ms) <= 0)
+        return 0;
+    ssize_t num_bytes = ::read(fd_, buffer.data(), buffer.size());
+    return (num_bytes > 0)? size_t(num_bytes): 0;
+}
+
+
+bool FdTransport::write(std::span<const uint8_t> bytes)
+{
+    while (!bytes.empty())
+    {
+        ssize_t written = ::write(fd_, bytes.data(), bytes.size());
+        if (written > 0)
+        {
+            bytes = bytes.subspan(size_t(written));
+            continue;
+        }
+        if ((written < 0) && (errno != EAGAIN) && (errno != EINTR))
+            return false;
+        // The other end is behind. Wait for room.
+        pollfd request{fd_, POLLOUT, 0};
+        if (poll(&request, 1, 1000) <= 0)
+            return false;
+    }
+    return true;
+}
+
+
+PtyLink::PtyLink()
+: device_{open_master()}
+{
+    const char* name = ptsname(device_.fd());
+    if (!name)
+        throw_errno("ptsname");
+    port_path_ = name;
+}
+
+
+int PtyLink::open_master()
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if ((fd < 0) || (grantpt(fd) < 0) || (unlockpt(fd) < 0))
+        throw_errno("posix_openpt");
+    return fd;
+}
+
+} // namespace cuttlefish
@@ -0,0 +1,113 @@
+#include <cuttlefish/client.h>
+#include <cuttlefish/fake_device.h>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Throughput of the host client in messages/s:
+//  1. parsing edge EVENTs already in memory (the client's ceiling),
+//  2. receiving edge EVENTs from a FakeDevice over a pty,
+//  3. round trips of batched PWM settings and port writes over a pty.
+// The device sends at most one batch of events per 1ms USB frame, so (2) is
+// bounded by the pty here, not by the USB link.
+
+using namespace cuttlefish;
+using bench_clock = std::chrono::steady_clock;
+
+inline constexpr size_t PARSE_EVENTS = 10'000'000;
+inline constexpr size_t LINK_EVENTS = 1'000'000;
+inline constexpr size_t EVENTS_PER_BATCH = 1000;
+inline constexpr size_t WRITE_BATCHES = 2000;
+
+double seconds_since(bench_clock::time_point start)
+{return std::chrono::duration<double>(bench_clock::now() - start).count();}
+
+void parse_from_memory()
+{
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < EVENTS_PER_BATCH; ++i)
+    {
+        uint8_t pins = uint8_t(i);
+        uint64_t time_us = i * 32;
+        encode_frame(stream, MessageType::EVENT,
+                     regs::RisingEdgeEvents::address, PayloadType::U8, &pins,
+                     sizeof(pins), &time_us);
+    }
+    FrameReader reader;
+    uint64_t checksum = 0;
+    size_t events = 0;
+    auto start = bench_clock::now();
+    while (events < PARSE_EVENTS)
+    {
+        std::span<uint8_t> space = reader.space();
+        memcpy(space.data(), stream.data(), stream.size());
+        reader.commit(stream.size());
+        events += reader.parse([&checksum](const FrameView& frame)
+            {checksum += frame.get<uint8_t>() + frame.harp_time_us();});
+    }
+    double seconds = seconds_since(start);
+    printf("Parse in memory: %.1fM events/s, %.0fMB/s (checksum %llu).\r\n",
+           events / seconds / 1e6,
+           events / EVENTS_PER_BATCH * stream.size() / seconds / 1e6,
+           (unsigned long long)checksum);
+}
+
+void receive_over_pty()
+{
+    PtyLink link;
+    FakeDevice device(link.device());
+    FdTransport port(link.port_path());
+    Client client(port);
+    std::thread sender([&device]()
+        {
+            uint8_t pins = 0x01;
+            for (size_t i = 0; i < LINK_EVENTS / EVENTS_PER_BATCH; ++i)
+                device.send_events(regs::RisingEdgeEvents::address,
+                                   PayloadType::U8, {&pins, 1},
+                                   EVENTS_PER_BATCH);
+        });
+    size_t events = 0;
+    auto start = bench_clock::now();
+    auto last_event = start;
+    while ((events < LINK_EVENTS) && (seconds_since(last_event) < 1.0))
+    {
+        if (client.poll([&events](const FrameView&) {++events;}, 100))
+            last_event = bench_clock::now();
+    }
+    double seconds = seconds_since(start);
+    sender.join();
+    printf("Receive over a pty: %.2fM events/s (%zu of %zu).\r\n",
+           events / seconds / 1e6, events, LINK_EVENTS);
+}
+
+void batched_writes()
+{
+    PtyLink link;
+    FakeDevice device(link.device());
+    FdTransport port(link.port_path());
+    Client client(port);
+    WriteBatch batch;
+    size_t accepted = 0;
+    auto start = bench_clock::now();
+    for (size_t i = 0; i < WRITE_BATCHES; ++i)
+    {
+        batch.clear();
+        for (size_t channel = 0; channel < 8; ++channel)
+            batch.add_pwm_settings(channel, {0, 500, 500, uint32_t(i), 0});
+        batch.add<regs::PinSet>(uint8_t(i));
+        accepted += client.send(batch);
+    }
+    double seconds = seconds_since(start);
+    printf("Batched writes over a pty: %.0fk writes/s in %.0f batches/s "
+           "(%zu of %zu accepted).\r\n", accepted / seconds / 1e3,
+           WRITE_BATCHES / seconds, accepted, WRITE_BATCHES * 9);
+}
+
+int main()
+{
+    parse_from_memory();
+    receive_over_pty();
+    batched_writes();
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <cuttlefish/client.h>
+#include <cuttlefish/fake_device.h>
+#include <cstdio>
+#include <vector>
+
+// Tests of the host client: frame encoding and in-place parsing, then typed
+// reads, writes, batches, and EVENTs against a FakeDevice on a pty.
+
+using namespace cuttlefish;
+
+size_t failures = 0;
+
+void check(bool condition, const char* description)
+{
+    printf("%s: %s\r\n", condition? "PASS": "FAIL", description);
+    if (!condition)
+        ++failures;
+}
+
+/**
+ * \brief the frames that \p reader finds in \p stream, fed \p chunk bytes at
+ *  a time.
+ */
+std::vector<std::vector<uint8_t>> parse_in_chunks(
+    FrameReader& reader, const std::vector<uint8_t>& stream, size_t chunk)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t i = 0; i < stream.size();)
+    {
+        std::span<uint8_t> space = reader.space();
+        size_t num_bytes = std::min({chunk, stream.size() - i, space.size()});
+        memcpy(space.data(), stream.data() + i, num_bytes);
+        i += num_bytes;
+        reader.commit(num_bytes);
+        reader.parse([&frames](const FrameView& frame)
+            {frames.emplace_back(frame.bytes().begin(), frame.bytes().end());});
+    }
+    return frames;
+}
+
+void frames()
+{
+    std::vector<uint8_t> stream;
+    uint32_t value = 0x12345678;
+    uint64_t time_us = 3'000'064;
+    encode_frame(stream, MessageType::EVENT, regs::PwmTrialStart::address,
+                 PayloadType::U32, &value, sizeof(value), &time_us);
+    FrameView frame;
+    check((FrameView::parse(stream, frame) == stream.size())
+          && (frame.type() == MessageType::EVENT)
+          && (frame.address() == regs::PwmTrialStart::address)
+          && (frame.payload_type() == PayloadType::U32)
+          && (frame.harp_time_us() == time_us)
+          && (frame.get<uint32_t>() == value),
+          "frames: a timestamped EVENT decodes in place");
+    // 300 bytes need the extended length.
+    std::vector<uint8_t> big_payload(300, 0xA5);
+    size_t small_bytes = stream.size();
+    encode_frame(stream, MessageType::WRITE, 40, PayloadType::U8,
+                 big_payload.data(), big_payload.size());
+    check((FrameView::parse(std::span(stream).subspan(small_bytes), frame)
+           == stream.size() - small_bytes)
+          && (frame.payload().size() == 300) && !frame.has_timestamp(),
+          "frames: extended lengths");
+    check(FrameView::parse(std::span(stream).first(small_bytes - 1), frame)
+          == 0, "frames: a partial frame waits for more bytes");
+    stream[2] ^= 1;
+    check(FrameView::parse(stream, frame) == SIZE_MAX,
+          "frames: bad checksums are rejected");
+    stream[2] ^= 1;
+
+    // A long stream with noise, split every which way.
+    std::vector<uint8_t> noisy;
+    size_t num_frames = 0;
+    for (uint32_t i = 0; i < 20000; ++i)
+    {
+        if (i % 1000 == 0)
+            noisy.insert(noisy.end(), {0x00, 0xFF, 0x42});
+        time_us = i * 64;
+        encode_frame(noisy, MessageType::EVENT,
+                     regs::InputCaptureEvents::address, PayloadType::U32, &i,
+                     sizeof(i), &time_us);
+        ++num_frames;
+    }
+    for (size_t chunk: {size_t(1), size_t(7), size_t(4096), size_t(1 << 18)})
+    {
+        FrameReader reader(1 << 16);
+        auto parsed = parse_in_chunks(reader, noisy, chunk);
+        bool ok = (parsed.size() == num_frames);
+        for (uint32_t i = 0; ok && (i < parsed.size()); ++i)
+        {
+            FrameView::parse(parsed[i], frame);
+            ok = (frame.get<uint32_t>() == i) && (frame.harp_time_us() == i * 64);
+        }
+        check(ok && (reader.skipped_bytes() == 3 * (num_frames / 1000)),
+              "frames: every frame survives splits and noise");
+    }
+}
+
+void client()
+{
+    PtyLink link;
+    FakeDevice device(link.device());
+    FdTransport port(link.port_path());
+    Client client(port);
+    std::vector<uint8_t> event_addresses;
+    client.set_event_handler([&event_addresses](const FrameView& frame)
+        {event_addresses.push_back(frame.address());});
+
+    check(client.write<regs::PinDirection>(0x0F),
+          "client: write a U8 register");
+    check(client.read<regs::PinDirection>() == uint8_t(0x0F),
+          "client: read it back");
+    check(client.write<regs::EdgeMergeToleranceUs>(250)
+          && (client.read<regs::EdgeMergeToleranceUs>() == 250u),
+          "client: U32 registers");
+
+    // One transfer configures all 8 outputs and starts them.
+    WriteBatch batch;
+    for (size_t channel = 0; channel < 8; ++channel)
+        batch.add_pwm_settings(channel,
+                               {0, 500, 500, uint32_t(channel + 1), 0});
+    batch.add<regs::PwmState>(1);
+    size_t transfers = device.transfers();
+    size_t commands = device.commands();
+    check(client.send(batch) == 9, "client: a batch of writes is accepted");
+    check((device.transfers() == transfers + 1)
+          && (device.commands() == commands + 9),
+          "client: the batch takes one transfer");
+    auto settings = client.read<regs::PwmSettings7>();
+    pwm_settings_t decoded{};
+    if (settings)
+        memcpy(&decoded, settings->data(), sizeof(decoded));
+    check(settings && (decoded.on_duration_us == 500) && (decoded.cycles == 8),
+          "client: array registers read back as structs");
+
+    uint32_t records[] = {1, 2, 3, 4};
+    batch.clear();
+    batch.add<regs::StreamRecords>(std::span<const uint32_t>(records));
+    check((client.send(batch) == 1)
+          && (device.value(regs::StreamRecords::address).size()
+              == sizeof(records)),
+          "client: variable-length writes");
+
+    device.reject_writes(regs::PwmState::address);
+    check(!client.write<regs::PwmState>(1),
+          "client: WRITE_ERROR fails the write");
+    batch.clear();
+    batch.add(regs::ScheduleDiagnostics::address, PayloadType::U8, "", 1);
+    check(client.send(batch) == 0, "client: read-only registers refuse writes");
+
+    // EVENTs that arrive while waiting for a reply are not lost.
+    uint8_t pins = 0x01;
+    device.send_events(regs::RisingEdgeEvents::address, PayloadType::U8,
+                       {&pins, 1}, 500);
+    check(client.read<regs::PinDirection>() == uint8_t(0x0F),
+          "client: replies are found among EVENTs");
+    size_t events = event_addresses.size();
+    for (size_t i = 0; (i < 100) && (events < 500); ++i)
+        client.poll([&events](const FrameView&) {++events;}, 10);
+    check(events == 500, "client: every EVENT reaches a handler");
+    check(client.skipped_bytes() == 0, "client: the stream stays in sync");
+}
+
+int main()
+{
+    frames();
+    client();
+    printf("%zu failures\r\n", failures);
+    return failures? 1: 0;
+}
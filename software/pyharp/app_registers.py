@@ -23,3 +23,56 @@ class AppRegs(IntEnum):
     PWMSettings5 = 46
     PWMSettings6 = 47
     PWMSettings7 = 48
+
+    ScheduleDiagnostics = 49
+    EdgeMergeToleranceUs = 50
+
+    EnableOutputEdgeEvents = 51
+    OutputEdgeEvents = 52
+    OutputEdgeEventsDropped = 53
+
+    StreamMode = 54
+    StreamRecords = 55
+    StreamLowWatermark = 56
+    StreamLowWatermarkReached = 57
+    StreamUnderrun = 58
+
+    PwmRandomSettings = 59
+    PwmRampSettings = 60
+    PwmBurstSettings = 61
+
+    ScheduleSlot = 62
+    SaveScheduleSlot = 63
+
+    StoredConfiguration = 64
+    BootAction = 65
+
+    LogicAnalyzerRateHz = 66
+    LogicAnalyzerSamples = 67
+    LogicAnalyzerOverflow = 68
+
+    PwmGateSettings = 69
+    PwmGateState = 70
+
+    PwmPhaseLockSettings = 71
+    PwmPhaseLockState = 72
+    PwmPhaseLockStatistics = 73
+
+    OutputEngine = 74
+
+    InputCapture = 75
+    InputCaptureEvents = 76
+    InputCaptureOverflow = 77
+
+    PwmOverlaySettings = 78
+
+    PwmTrialSettings = 79
+    PwmTrialStart = 80
+
+    StateMachineProgram = 81
+    StateMachineControl = 82
+    StateMachineTransition = 83
+
+    LoopbackCalibration = 84
+    LatencyCompensation = 85
+    LatencyStatistics = 86